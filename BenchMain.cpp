@@ -0,0 +1,1329 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <new>
+
+#include "Users.h"
+#include "ChatRoom.h"
+#include "UserIterator.h"
+#include "MessageIterator.h"
+#include "MessageFilter.h"
+#include "RoomManager.h"
+#include "CommandJournal.h"
+#include "ReplayEngine.h"
+#include "HistoryExporter.h"
+#include "HistoryImporter.h"
+#include "ChatServer.h"
+#include "LoadGenerator.h"
+#include "PresenceAggregator.h"
+#include <sys/resource.h>
+
+/**
+ * @file BenchMain.cpp
+ * @brief Benchmark driver for the PetSpace chat system
+ * @date 19/10/2026
+ *
+ * Usage: bench [--rooms 10,100,1000] [--messages N] [--only name,name]
+ *              [--format csv|json]
+ *
+ * Every benchmark runs once per room size. Chat output produced while a
+ * benchmark runs is discarded so console I/O does not dominate the timings.
+ * Results are written once all benchmarks finish, either as CSV with one
+ * row per metric or as a JSON array with one object per run.
+ */
+
+namespace {
+
+// Counted by the replacement operator new below. The replacements are kept
+// out of line so the compiler does not pair malloc() with delete and warn.
+std::atomic<size_t> heapAllocations(0);
+
+}
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = std::malloc(size != 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief Parameters shared by every benchmark
+ */
+struct BenchConfig {
+    std::vector<size_t> roomSizes;
+    size_t messages;
+};
+
+/**
+ * @brief One benchmark run: its parameters and the metrics it measured
+ */
+struct BenchResult {
+    std::string benchmark;
+    std::vector<std::pair<std::string, double> > params;
+    std::vector<std::pair<std::string, double> > metrics;
+
+    explicit BenchResult(const std::string& name) : benchmark(name) {}
+
+    void param(const std::string& key, double value) {
+        params.push_back(std::make_pair(key, value));
+    }
+
+    void metric(const std::string& key, double value) {
+        metrics.push_back(std::make_pair(key, value));
+    }
+};
+
+std::vector<BenchResult> results;
+
+/**
+ * @brief Stream buffer that drops everything written to it
+ */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) { return count; }
+};
+
+/**
+ * @brief Silences std::cout and std::cerr for its lifetime
+ */
+class QuietScope {
+    NullBuffer sink;
+    std::streambuf* savedOut;
+    std::streambuf* savedErr;
+public:
+    QuietScope() : savedOut(std::cout.rdbuf(&sink)), savedErr(std::cerr.rdbuf(&sink)) {}
+    ~QuietScope() {
+        std::cout.rdbuf(savedOut);
+        std::cerr.rdbuf(savedErr);
+    }
+};
+
+/**
+ * @brief Small deterministic generator so every run sees the same corpus
+ */
+class Lcg {
+    unsigned long long state;
+public:
+    explicit Lcg(unsigned long long seed) : state(seed) {}
+
+    unsigned int next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<unsigned int>(state >> 33);
+    }
+
+    unsigned int below(unsigned int bound) {
+        return next() % bound;
+    }
+};
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+uint64_t nanosSince(Clock::time_point start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+}
+
+/**
+ * @brief Record p50/p90/p99/p99.9/max of a latency sample
+ */
+void percentiles(BenchResult& result, std::vector<uint64_t>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    const double points[] = { 0.50, 0.90, 0.99, 0.999 };
+    const char* const names[] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns" };
+    for (size_t i = 0; i < 4; i++) {
+        size_t index = static_cast<size_t>(points[i] * (samples.size() - 1));
+        result.metric(names[i], static_cast<double>(samples[index]));
+    }
+    result.metric("max_ns", static_cast<double>(samples.back()));
+}
+
+/**
+ * @brief A room with a given number of online members
+ */
+struct Population {
+    ChatRoom* room;
+    std::vector<User*> members;
+
+    explicit Population(size_t size) : room(new ChatRoom()) {
+        members.reserve(size);
+        for (size_t i = 0; i < size; i++) {
+            User* user = new User("user" + std::to_string(i));
+            user->setOnlineStatus(true);
+            user->joinChatRoom(room);
+            members.push_back(user);
+        }
+    }
+
+    ~Population() {
+        for (size_t i = 0; i < members.size(); i++) {
+            members[i]->leaveChatRoom(room);
+            delete members[i];
+        }
+        delete room;
+    }
+};
+
+/**
+ * @brief Build a corpus of chat-like messages
+ *
+ * Messages are 3-20 words drawn from a chat vocabulary. A small share
+ * contain links or words that appear in the filter pattern set, roughly
+ * matching the hit rate seen in real rooms.
+ */
+std::vector<std::string> buildChatCorpus(size_t messageCount, unsigned long long seed) {
+    static const char* const vocabulary[] = {
+        "hi", "hello", "hey", "lol", "thanks", "cat", "dog", "code", "bug", "fix",
+        "compile", "the", "a", "is", "it", "my", "your", "this", "that", "works",
+        "doesn't", "why", "how", "what", "when", "algorithm", "pointer", "segfault",
+        "iterator", "pattern", "observer", "mediator", "command", "kitten", "puppy",
+        "walk", "treat", "nap", "keyboard", "coffee", "today", "tomorrow", "later",
+        "anyone", "know", "help", "please", "great", "nice", "cool", "good", "bad",
+        "test", "build", "makefile", "linker", "error", "warning", "merge", "review"
+    };
+    static const size_t vocabularySize = sizeof(vocabulary) / sizeof(vocabulary[0]);
+    static const char* const rare[] = {
+        "darn", "heck", "frick", "http://free-prizes.example/win", "deadline", "outage"
+    };
+    static const size_t rareSize = sizeof(rare) / sizeof(rare[0]);
+
+    Lcg rng(seed);
+    std::vector<std::string> corpus;
+    corpus.reserve(messageCount);
+    for (size_t i = 0; i < messageCount; i++) {
+        std::string message;
+        unsigned int words = 3 + rng.below(18);
+        for (unsigned int w = 0; w < words; w++) {
+            if (w > 0) {
+                message.push_back(' ');
+            }
+            if (rng.below(100) < 2) {
+                message += rare[rng.below(rareSize)];
+            } else {
+                message += vocabulary[rng.below(vocabularySize)];
+            }
+        }
+        corpus.push_back(message);
+    }
+    return corpus;
+}
+
+/**
+ * @brief Build a filter with the requested number of patterns
+ *
+ * A handful of hand-written patterns are padded with generated words so the
+ * automaton size grows with the pattern count.
+ */
+void buildFilter(MessageFilter& filter, size_t patternCount) {
+    filter.addPattern("darn", MessageFilter::PROFANITY);
+    filter.addPattern("heck", MessageFilter::PROFANITY);
+    filter.addPattern("frick", MessageFilter::PROFANITY);
+    filter.addPattern("free-prizes.example", MessageFilter::BANNED_LINK);
+    filter.addPattern("deadline", MessageFilter::KEYWORD_ALERT);
+    filter.addPattern("outage", MessageFilter::KEYWORD_ALERT);
+
+    Lcg rng(7);
+    while (filter.getPatternCount() < patternCount) {
+        std::string word;
+        unsigned int length = 4 + rng.below(8);
+        for (unsigned int i = 0; i < length; i++) {
+            word.push_back(static_cast<char>('a' + rng.below(26)));
+        }
+        MessageFilter::Category category = MessageFilter::PROFANITY;
+        switch (rng.below(3)) {
+            case 1: category = MessageFilter::BANNED_LINK; break;
+            case 2: category = MessageFilter::KEYWORD_ALERT; break;
+            default: break;
+        }
+        filter.addPattern(word, category);
+    }
+    filter.compile();
+}
+
+/**
+ * @brief End-to-end User::sendMessage throughput for each room size
+ */
+void benchSendThroughput(const BenchConfig& config) {
+    std::vector<std::string> corpus = buildChatCorpus(1024, 1);
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        double seconds = 0.0;
+        size_t allocations = 0;
+        {
+            QuietScope quiet;
+            Population population(size);
+            User* sender = population.members[0];
+            size_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < config.messages; i++) {
+                sender->sendMessage(corpus[i & 1023], population.room);
+            }
+            seconds = secondsSince(start);
+            allocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+        }
+
+        BenchResult result("send_throughput");
+        result.param("room_size", static_cast<double>(size));
+        result.param("messages", static_cast<double>(config.messages));
+        result.metric("seconds", seconds);
+        result.metric("messages_per_s", config.messages / seconds);
+        result.metric("deliveries_per_s", config.messages * (size - 1) / seconds);
+        result.metric("allocations_per_send", static_cast<double>(allocations) / config.messages);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Latency distribution of a single send including fan-out
+ */
+void benchFanoutLatency(const BenchConfig& config) {
+    std::vector<std::string> corpus = buildChatCorpus(1024, 2);
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        std::vector<uint64_t> samples;
+        samples.reserve(config.messages);
+        {
+            QuietScope quiet;
+            Population population(size);
+            for (size_t i = 0; i < config.messages; i++) {
+                User* sender = population.members[i % size];
+                Clock::time_point start = Clock::now();
+                sender->sendMessage(corpus[i & 1023], population.room);
+                samples.push_back(nanosSince(start));
+            }
+        }
+
+        BenchResult result("fanout_latency");
+        result.param("room_size", static_cast<double>(size));
+        result.param("messages", static_cast<double>(config.messages));
+        percentiles(result, samples);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Fan-out in rooms where only one member in ten is online
+ *
+ * Large rooms are mostly idle members; the send should cost about the
+ * same as a room of just the online ones.
+ */
+void benchFanoutPresence(const BenchConfig& config) {
+    std::vector<std::string> corpus = buildChatCorpus(1024, 3);
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        double seconds = 0.0;
+        {
+            QuietScope quiet;
+            Population population(size);
+            for (size_t i = 0; i < size; i++) {
+                if (i % 10 != 0) {
+                    population.members[i]->setOnlineStatus(false);
+                }
+            }
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < config.messages; i++) {
+                population.members[(i * 10) % size]->sendMessage(corpus[i & 1023], population.room);
+            }
+            seconds = secondsSince(start);
+        }
+
+        BenchResult result("fanout_presence");
+        result.param("room_size", static_cast<double>(size));
+        result.param("online_share", 0.1);
+        result.metric("ns_per_send", seconds * 1e9 / static_cast<double>(config.messages));
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Members joining and then leaving a room
+ */
+void benchJoinLeaveChurn(const BenchConfig& config) {
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        double joinSeconds = 0.0;
+        double leaveSeconds = 0.0;
+        {
+            QuietScope quiet;
+            ChatRoom room;
+            std::vector<User*> members;
+            for (size_t i = 0; i < size; i++) {
+                members.push_back(new User("churn" + std::to_string(i)));
+                members.back()->setOnlineStatus(true);
+            }
+
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < size; i++) {
+                members[i]->joinChatRoom(&room);
+            }
+            joinSeconds = secondsSince(start);
+
+            start = Clock::now();
+            for (size_t i = 0; i < size; i++) {
+                members[i]->leaveChatRoom(&room);
+            }
+            leaveSeconds = secondsSince(start);
+
+            for (size_t i = 0; i < size; i++) {
+                delete members[i];
+            }
+        }
+
+        BenchResult result("join_leave_churn");
+        result.param("room_size", static_cast<double>(size));
+        result.metric("join_seconds", joinSeconds);
+        result.metric("leave_seconds", leaveSeconds);
+        result.metric("joins_per_s", size / joinSeconds);
+        result.metric("leaves_per_s", size / leaveSeconds);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Members joining and then leaving a room through the bulk API
+ *
+ * Same population as join_leave_churn, added with one joinUsers() call and
+ * removed with one leaveUsers() call.
+ */
+void benchBulkJoin(const BenchConfig& config) {
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        double joinSeconds = 0.0;
+        double leaveSeconds = 0.0;
+        {
+            QuietScope quiet;
+            ChatRoom room;
+            std::vector<User*> members;
+            for (size_t i = 0; i < size; i++) {
+                members.push_back(new User("bulk" + std::to_string(i)));
+                members.back()->setOnlineStatus(true);
+            }
+
+            Clock::time_point start = Clock::now();
+            room.joinUsers(members);
+            joinSeconds = secondsSince(start);
+
+            start = Clock::now();
+            room.leaveUsers(members);
+            leaveSeconds = secondsSince(start);
+
+            for (size_t i = 0; i < size; i++) {
+                delete members[i];
+            }
+        }
+
+        BenchResult result("bulk_join");
+        result.param("room_size", static_cast<double>(size));
+        result.metric("join_seconds", joinSeconds);
+        result.metric("leave_seconds", leaveSeconds);
+        result.metric("joins_per_s", size / joinSeconds);
+        result.metric("leaves_per_s", size / leaveSeconds);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Every member of a shared room dropping and reconnecting
+ *
+ * All members go offline and then back online. Without an aggregator each
+ * change notifies every member; with one, the room gets one diff per tick,
+ * and a tick is taken every 500 changes. The direct mode is only run on
+ * the smaller room, as it grows with the square of the member count.
+ */
+void benchReconnectStorm(const BenchConfig& config) {
+    (void)config;
+    const size_t sizes[] = { 1000, 10000 };
+    const size_t changesPerTick = 500;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t size = sizes[s];
+        for (int aggregated = 0; aggregated < 2; aggregated++) {
+            if (!aggregated && size > 2000) {
+                continue;
+            }
+            double seconds = 0.0;
+            uint64_t notifications = 0;
+            {
+                QuietScope quiet;
+                PresenceAggregator presence(std::chrono::milliseconds(0));
+                ChatRoom room("Storm");
+                std::vector<User*> members;
+                for (size_t i = 0; i < size; i++) {
+                    members.push_back(new User("storm" + std::to_string(i)));
+                    members.back()->setOnlineStatus(true);
+                }
+                room.joinUsers(members);
+                if (aggregated) {
+                    room.setPresenceAggregator(&presence);
+                }
+
+                Clock::time_point start = Clock::now();
+                size_t changes = 0;
+                for (int phase = 0; phase < 2; phase++) {
+                    for (size_t i = 0; i < size; i++) {
+                        members[i]->setOnlineStatus(phase == 1);
+                        if (aggregated && ++changes % changesPerTick == 0) {
+                            presence.tick();
+                        }
+                    }
+                }
+                presence.flush();
+                seconds = secondsSince(start);
+                notifications = aggregated ? presence.getDiffsSent() : 2 * size;
+
+                room.setPresenceAggregator(nullptr);
+                for (size_t i = 0; i < size; i++) {
+                    delete members[i];
+                }
+            }
+
+            BenchResult result("reconnect_storm");
+            result.param("members", static_cast<double>(size));
+            result.param("aggregated", aggregated);
+            result.metric("seconds", seconds);
+            result.metric("notifications", static_cast<double>(notifications));
+            result.metric("observer_callbacks", static_cast<double>(notifications) * size);
+            results.push_back(result);
+        }
+    }
+}
+
+/**
+ * @brief Deleting a large room, then its former members, and deleting
+ * the members of a second room before the room itself
+ *
+ * Members are restored in one step, since joining one at a time notifies
+ * every earlier member. Every phase should cost the same per member at
+ * every size.
+ */
+void benchRoomTeardown(const BenchConfig& config) {
+    (void)config;
+    const size_t sizes[] = { 10000, 100000, 1000000 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t size = sizes[s];
+        double roomSeconds = 0.0;
+        double userSeconds = 0.0;
+        double membersFirstSeconds = 0.0;
+        {
+            QuietScope quiet;
+            std::vector<User*> members;
+            members.reserve(size);
+            for (size_t i = 0; i < size; i++) {
+                members.push_back(new User("member" + std::to_string(i)));
+            }
+            ChatRoom* room = new ChatRoom("Teardown");
+            room->restoreState(members, ChatHistory());
+
+            Clock::time_point start = Clock::now();
+            delete room;
+            roomSeconds = secondsSince(start);
+
+            start = Clock::now();
+            for (size_t i = 0; i < size; i++) {
+                delete members[i];
+            }
+            userSeconds = secondsSince(start);
+
+            for (size_t i = 0; i < size; i++) {
+                members[i] = new User("member" + std::to_string(i));
+            }
+            room = new ChatRoom("Teardown");
+            room->restoreState(members, ChatHistory());
+
+            start = Clock::now();
+            for (size_t i = 0; i < size; i++) {
+                delete members[i];
+            }
+            delete room;
+            membersFirstSeconds = secondsSince(start);
+        }
+
+        BenchResult result("room_teardown");
+        result.param("members", static_cast<double>(size));
+        result.metric("room_seconds", roomSeconds);
+        result.metric("room_ns_per_member", roomSeconds * 1e9 / size);
+        result.metric("user_ns_per_member", userSeconds * 1e9 / size);
+        result.metric("members_first_ns_per_member", membersFirstSeconds * 1e9 / size);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Cost of creating user and message iterators
+ */
+void benchIteratorCreation(const BenchConfig& config) {
+    const size_t rounds = 1000;
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        double userSeconds = 0.0;
+        double messageSeconds = 0.0;
+        size_t historySize = 0;
+        {
+            QuietScope quiet;
+            Population population(size);
+            for (size_t i = 0; i < config.messages; i++) {
+                population.room->saveMessage("history entry " + std::to_string(i), population.members[0]);
+            }
+            historySize = population.room->getChatHistory().size();
+
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < rounds; i++) {
+                UserIterator* iterator = population.room->createUserIterator();
+                delete iterator;
+            }
+            userSeconds = secondsSince(start);
+
+            start = Clock::now();
+            for (size_t i = 0; i < rounds; i++) {
+                MessageIterator* iterator = population.room->createMessageIterator();
+                delete iterator;
+            }
+            messageSeconds = secondsSince(start);
+        }
+
+        BenchResult result("iterator_creation");
+        result.param("room_size", static_cast<double>(size));
+        result.param("messages", static_cast<double>(historySize));
+        result.metric("user_iterator_ns", userSeconds * 1e9 / rounds);
+        result.metric("message_iterator_ns", messageSeconds * 1e9 / rounds);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Per-append cost of saveMessage as the history grows
+ *
+ * Reports the mean cost of each tenth of the run so growth effects such as
+ * vector reallocation show up as later segments getting slower.
+ */
+void benchHistoryGrowth(const BenchConfig& config) {
+    const size_t total = config.messages * 10;
+    const size_t segment = total / 10 > 0 ? total / 10 : 1;
+    std::vector<std::string> corpus = buildChatCorpus(1024, 3);
+
+    BenchResult result("history_growth");
+    result.param("messages", static_cast<double>(total));
+    {
+        QuietScope quiet;
+        ChatRoom room;
+        User writer("writer");
+        Clock::time_point start = Clock::now();
+        Clock::time_point segmentStart = start;
+        for (size_t i = 1; i <= total; i++) {
+            room.saveMessage(corpus[i & 1023], &writer);
+            if (i % segment == 0) {
+                result.metric("segment" + std::to_string(i / segment) + "_ns_per_append",
+                              secondsSince(segmentStart) * 1e9 / segment);
+                segmentStart = Clock::now();
+            }
+        }
+        result.metric("ns_per_append", secondsSince(start) * 1e9 / total);
+    }
+    results.push_back(result);
+}
+
+/**
+ * @brief Cost of retracting one message from a large history
+ *
+ * The history holds 100x the configured message count. Messages are
+ * retracted from the oldest, middle and newest thirds; with tombstones the
+ * cost should not depend on the position.
+ */
+void benchRetract(const BenchConfig& config) {
+    const size_t total = config.messages * 100;
+    const size_t retractions = config.messages / 10 > 0 ? config.messages / 10 : 1;
+    const char* const regions[] = { "oldest", "middle", "newest" };
+
+    BenchResult result("retract");
+    result.param("history", static_cast<double>(total));
+    result.param("retractions", static_cast<double>(retractions));
+    {
+        QuietScope quiet;
+        ChatRoom room;
+        User writer("writer");
+        for (size_t i = 0; i < total; i++) {
+            room.saveMessage("history entry", &writer);
+        }
+        ChatHistory::MessageId firstId = room.getChatHistory().getEntry(0).id;
+
+        for (size_t r = 0; r < 3; r++) {
+            ChatHistory::MessageId base = firstId + r * (total / 3);
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < retractions; i++) {
+                room.retractMessage(base + i);
+            }
+            result.metric(std::string(regions[r]) + "_ns_per_retract", secondsSince(start) * 1e9 / retractions);
+        }
+    }
+    results.push_back(result);
+}
+
+/**
+ * @brief Cost of editing and deleting by id, and of one compaction pass
+ *
+ * Edits and deletes touch a single entry in place. Every fourth message is
+ * then deleted and the history compacted once, which is what the default
+ * threshold would trigger.
+ */
+void benchEditDelete(const BenchConfig& config) {
+    const size_t total = config.messages * 100;
+    const size_t operations = config.messages / 10 > 0 ? config.messages / 10 : 1;
+
+    BenchResult result("edit_delete");
+    result.param("history", static_cast<double>(total));
+    result.param("operations", static_cast<double>(operations));
+    {
+        QuietScope quiet;
+        ChatRoom room;
+        User writer("writer");
+        room.setCompactionThreshold(0.0, 0);
+        for (size_t i = 0; i < total; i++) {
+            room.saveMessage("history entry", &writer);
+        }
+        ChatHistory::MessageId firstId = room.getChatHistory().getEntry(0).id;
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < operations; i++) {
+            room.editMessage(firstId + (i * 97) % total, "edited entry", &writer);
+        }
+        result.metric("ns_per_edit", secondsSince(start) * 1e9 / operations);
+
+        start = Clock::now();
+        for (size_t i = 0; i < total; i += 4) {
+            room.deleteMessage(firstId + i, &writer);
+        }
+        result.metric("ns_per_delete", secondsSince(start) * 1e9 / ((total + 3) / 4));
+
+        start = Clock::now();
+        size_t dropped = room.compactHistory();
+        result.metric("compact_ms", secondsSince(start) * 1e3);
+        result.metric("dropped", static_cast<double>(dropped));
+    }
+    results.push_back(result);
+}
+
+/**
+ * @brief Compression ratio and read throughput of segmented history
+ *
+ * A history of 100x the configured message count is built from the chat
+ * corpus with 50 senders, once raw and once in 4096-message segments, and
+ * then read end to end.
+ */
+void benchHistoryCompression(const BenchConfig& config) {
+    const size_t total = config.messages * 100;
+    std::vector<std::string> corpus = buildChatCorpus(total, 9);
+    Lcg rng(10);
+    for (size_t i = 0; i < corpus.size(); i++) {
+        corpus[i] = "[member" + std::to_string(rng.below(50)) + "]: " + corpus[i] + "\n";
+    }
+
+    const size_t segmentSizes[] = { 0, 4096 };
+    for (size_t s = 0; s < sizeof(segmentSizes) / sizeof(segmentSizes[0]); s++) {
+        ChatHistory history;
+        history.setSegmentSize(segmentSizes[s]);
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < corpus.size(); i++) {
+            history.append(corpus[i]);
+        }
+        double appendSeconds = secondsSince(start);
+
+        size_t bytes = 0;
+        start = Clock::now();
+        for (const ChatHistory::Text& message : history) {
+            bytes += message.size();
+        }
+        double readSeconds = secondsSince(start);
+
+        BenchResult result("history_compression");
+        result.param("segment", static_cast<double>(segmentSizes[s]));
+        result.param("messages", static_cast<double>(total));
+        result.metric("ns_per_append", appendSeconds * 1e9 / total);
+        result.metric("read_mb_per_s", (bytes / 1e6) / readSeconds);
+        result.metric("cold_raw_bytes", static_cast<double>(history.getColdRawBytes()));
+        result.metric("cold_compressed_bytes", static_cast<double>(history.getColdCompressedBytes()));
+        if (history.getColdCompressedBytes() != 0) {
+            result.metric("ratio", static_cast<double>(history.getColdRawBytes()) / history.getColdCompressedBytes());
+        }
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Streaming export and bulk import throughput for both formats
+ *
+ * A history of 100x the configured message count is exported to memory
+ * and imported into an empty room.
+ */
+void benchHistoryExport(const BenchConfig& config) {
+    const size_t total = config.messages * 100;
+    std::vector<std::string> corpus = buildChatCorpus(1024, 11);
+    ChatHistory history;
+    for (size_t i = 0; i < total; i++) {
+        history.append("[member" + std::to_string(i % 50) + "]: " + corpus[i % corpus.size()] + "\n");
+    }
+
+    const HistoryExporter::Format formats[] = { HistoryExporter::NDJSON, HistoryExporter::BINARY };
+    const char* const names[] = { "ndjson", "binary" };
+    for (size_t f = 0; f < 2; f++) {
+        std::stringstream stream;
+        HistoryExporter exporter(stream, formats[f]);
+        Clock::time_point start = Clock::now();
+        exporter.exportHistory(history);
+        double exportSeconds = secondsSince(start);
+
+        double importSeconds = 0.0;
+        size_t imported = 0;
+        {
+            QuietScope quiet;
+            ChatRoom room;
+            HistoryImporter importer(stream, formats[f]);
+            start = Clock::now();
+            importer.importInto(room);
+            importSeconds = secondsSince(start);
+            imported = room.getChatHistory().size();
+        }
+
+        double megabytes = exporter.getBytesWritten() / 1e6;
+        BenchResult result("history_export");
+        result.param("format", static_cast<double>(f));
+        result.param("messages", static_cast<double>(total));
+        result.metric(std::string(names[f]) + "_bytes_per_message", static_cast<double>(exporter.getBytesWritten()) / total);
+        result.metric(std::string(names[f]) + "_export_mb_per_s", megabytes / exportSeconds);
+        result.metric(std::string(names[f]) + "_import_mb_per_s", megabytes / importSeconds);
+        result.metric(std::string(names[f]) + "_imported", static_cast<double>(imported));
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Content filter throughput in MB/s for several pattern set sizes
+ */
+void benchMessageFilter(const BenchConfig& config) {
+    std::vector<std::string> corpus = buildChatCorpus(config.messages * 10, 42);
+    size_t bytes = 0;
+    for (size_t i = 0; i < corpus.size(); i++) {
+        bytes += corpus[i].size();
+    }
+
+    const size_t patternCounts[] = { 6, 100, 1000, 10000 };
+    for (size_t p = 0; p < sizeof(patternCounts) / sizeof(patternCounts[0]); p++) {
+        MessageFilter filter;
+        buildFilter(filter, patternCounts[p]);
+
+        int sink = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < corpus.size(); i++) {
+            sink |= filter.scanCategories(corpus[i].data(), corpus[i].size());
+        }
+        double scanSeconds = secondsSince(start);
+
+        size_t flagged = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < corpus.size(); i++) {
+            if (filter.scan(corpus[i]).categories != 0) {
+                flagged++;
+            }
+        }
+        double verdictSeconds = secondsSince(start);
+
+        BenchResult result("message_filter");
+        result.param("patterns", static_cast<double>(filter.getPatternCount()));
+        result.param("messages", static_cast<double>(corpus.size()));
+        result.metric("bytes", static_cast<double>(bytes));
+        result.metric("scan_mb_per_s", (bytes / 1e6) / scanSeconds);
+        result.metric("verdict_mb_per_s", (bytes / 1e6) / verdictSeconds);
+        result.metric("flagged", static_cast<double>(flagged));
+        result.metric("categories_seen", static_cast<double>(sink));
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief One announcement to four overlapping rooms: a send per room
+ * against a single broadcast
+ *
+ * Every member belongs to two of the four rooms, so per-room sends deliver
+ * each message twice to everyone while the broadcast delivers it once.
+ */
+void benchBroadcast(const BenchConfig& config) {
+    const size_t roomCount = 4;
+    std::vector<std::string> corpus = buildChatCorpus(1024, 6);
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        double perRoomSeconds = 0.0;
+        double broadcastSeconds = 0.0;
+        {
+            QuietScope quiet;
+            std::vector<ChatRoom*> rooms;
+            for (size_t r = 0; r < roomCount; r++) {
+                rooms.push_back(new ChatRoom("room" + std::to_string(r)));
+            }
+            std::vector<User*> members;
+            for (size_t i = 0; i < size * roomCount / 2; i++) {
+                User* user = new User("user" + std::to_string(i));
+                user->setOnlineStatus(true);
+                user->joinChatRoom(rooms[i % roomCount]);
+                user->joinChatRoom(rooms[(i + 1) % roomCount]);
+                members.push_back(user);
+            }
+            User* herald = new User("herald");
+            herald->setOnlineStatus(true);
+            for (size_t r = 0; r < roomCount; r++) {
+                herald->joinChatRoom(rooms[r]);
+            }
+
+            size_t messages = config.messages / roomCount;
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < messages; i++) {
+                for (size_t r = 0; r < roomCount; r++) {
+                    herald->sendMessage(corpus[i & 1023], rooms[r]);
+                }
+            }
+            perRoomSeconds = secondsSince(start);
+
+            start = Clock::now();
+            for (size_t i = 0; i < messages; i++) {
+                herald->broadcastMessage(corpus[i & 1023], rooms);
+            }
+            broadcastSeconds = secondsSince(start);
+
+            members.push_back(herald);
+            for (size_t i = 0; i < members.size(); i++) {
+                std::vector<ChatRoom*> joined = members[i]->getChatRooms();
+                for (size_t r = 0; r < joined.size(); r++) {
+                    members[i]->leaveChatRoom(joined[r]);
+                }
+                delete members[i];
+            }
+            for (size_t r = 0; r < roomCount; r++) {
+                delete rooms[r];
+            }
+        }
+
+        size_t messages = config.messages / roomCount;
+        BenchResult result("broadcast");
+        result.param("room_size", static_cast<double>(size));
+        result.param("rooms", static_cast<double>(roomCount));
+        result.param("messages", static_cast<double>(messages));
+        result.metric("per_room_us_per_message", perRoomSeconds * 1e6 / messages);
+        result.metric("broadcast_us_per_message", broadcastSeconds * 1e6 / messages);
+        result.metric("speedup", perRoomSeconds / broadcastSeconds);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Private 1:1 messages through a two-member room against a
+ * DirectChannel, with each sender holding many conversations
+ */
+void benchDirectMessage(const BenchConfig& config) {
+    std::vector<std::string> corpus = buildChatCorpus(1024, 8);
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t peers = config.roomSizes[s];
+        double roomSeconds = 0.0;
+        double directSeconds = 0.0;
+        {
+            QuietScope quiet;
+            User* sender = new User("sender");
+            sender->setOnlineStatus(true);
+            std::vector<User*> others;
+            std::vector<ChatRoom*> rooms;
+            for (size_t i = 0; i < peers; i++) {
+                User* other = new User("peer" + std::to_string(i));
+                other->setOnlineStatus(true);
+                ChatRoom* room = new ChatRoom("dm" + std::to_string(i));
+                sender->joinChatRoom(room);
+                other->joinChatRoom(room);
+                others.push_back(other);
+                rooms.push_back(room);
+            }
+
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < config.messages; i++) {
+                sender->sendMessage(corpus[i & 1023], rooms[i % peers]);
+            }
+            roomSeconds = secondsSince(start);
+
+            start = Clock::now();
+            for (size_t i = 0; i < config.messages; i++) {
+                sender->sendDirectMessage(corpus[i & 1023], others[i % peers]);
+            }
+            directSeconds = secondsSince(start);
+
+            for (size_t i = 0; i < peers; i++) {
+                sender->leaveChatRoom(rooms[i]);
+                others[i]->leaveChatRoom(rooms[i]);
+                delete others[i];
+                delete rooms[i];
+            }
+            delete sender;
+        }
+
+        BenchResult result("direct_message");
+        result.param("conversations", static_cast<double>(peers));
+        result.param("messages", static_cast<double>(config.messages));
+        result.metric("room_ns_per_message", roomSeconds * 1e9 / config.messages);
+        result.metric("direct_ns_per_message", directSeconds * 1e9 / config.messages);
+        result.metric("speedup", roomSeconds / directSeconds);
+        results.push_back(result);
+    }
+}
+
+/**
+ * @brief Time to rebuild a room from its journal with and without snapshots
+ *
+ * A room of the given size is journaled while it handles the configured
+ * number of sends with some membership churn, then replayed from the
+ * in-memory journal. Snapshots refer to history segments checkpointed
+ * once, so journal_bytes should grow with the snapshot count, not with
+ * the snapshot count times the history size.
+ */
+void benchRecovery(const BenchConfig& config) {
+    const size_t intervals[] = { 0, 10000, 1000 };
+    std::vector<std::string> corpus = buildChatCorpus(1024, 9);
+    for (size_t s = 0; s < config.roomSizes.size(); s++) {
+        size_t size = config.roomSizes[s];
+        for (size_t v = 0; v < sizeof(intervals) / sizeof(intervals[0]); v++) {
+            std::stringstream journalStream;
+            double writeSeconds = 0.0;
+            uint64_t journalBytes = 0;
+            {
+                QuietScope quiet;
+                CommandJournal journal(journalStream, intervals[v]);
+                Population population(size);
+                population.room->setJournal(&journal);
+                Clock::time_point start = Clock::now();
+                for (size_t i = 0; i < config.messages; i++) {
+                    User* sender = population.members[i % size];
+                    sender->sendMessage(corpus[i & 1023], population.room);
+                    if (i % 100 == 99) {
+                        User* churn = population.members[(i / 100) % size];
+                        churn->leaveChatRoom(population.room);
+                        churn->joinChatRoom(population.room);
+                    }
+                }
+                writeSeconds = secondsSince(start);
+                journalBytes = journal.getByteCount();
+                population.room->setJournal(nullptr);
+            }
+
+            ReplayEngine replay(journalStream);
+            Clock::time_point start = Clock::now();
+            replay.replay();
+            double replaySeconds = secondsSince(start);
+
+            BenchResult result("recovery");
+            result.param("room_size", static_cast<double>(size));
+            result.param("snapshot_interval", static_cast<double>(intervals[v]));
+            result.param("messages", static_cast<double>(config.messages));
+            result.metric("journal_bytes", static_cast<double>(journalBytes));
+            result.metric("journal_write_seconds", writeSeconds);
+            result.metric("records_scanned", static_cast<double>(replay.getRecordsScanned()));
+            result.metric("records_applied", static_cast<double>(replay.getRecordsApplied()));
+            result.metric("recovery_ms", replaySeconds * 1e3);
+            results.push_back(result);
+        }
+    }
+}
+
+/**
+ * @brief Sends spread over many rooms by a RoomManager with 1-8 shards
+ *
+ * Each room has four members. Four producer threads post sends round-robin
+ * across the rooms and the clock stops once every shard has drained.
+ */
+void benchRoomSharding(const BenchConfig& config) {
+    const size_t roomCounts[] = { 100, 1000, 10000 };
+    const size_t shardCounts[] = { 1, 2, 4, 8 };
+    const size_t membersPerRoom = 4;
+    const size_t producers = 4;
+    std::vector<std::string> corpus = buildChatCorpus(1024, 5);
+
+    for (size_t r = 0; r < sizeof(roomCounts) / sizeof(roomCounts[0]); r++) {
+        size_t roomCount = roomCounts[r];
+        std::vector<User*> members;
+        {
+            QuietScope quiet;
+            for (size_t i = 0; i < roomCount * membersPerRoom; i++) {
+                User* user = new User("user" + std::to_string(i));
+                user->setOnlineStatus(true);
+                members.push_back(user);
+            }
+        }
+
+        for (size_t c = 0; c < sizeof(shardCounts) / sizeof(shardCounts[0]); c++) {
+            size_t shardCount = shardCounts[c];
+            double seconds = 0.0;
+            {
+                QuietScope quiet;
+                RoomManager manager(shardCount);
+                std::vector<RoomManager::RoomId> rooms;
+                for (size_t i = 0; i < roomCount; i++) {
+                    RoomManager::RoomId id = manager.createRoom("room" + std::to_string(i));
+                    User* const* roomMembers = &members[i * membersPerRoom];
+                    manager.post(id, [roomMembers, membersPerRoom](ChatRoom& room) {
+                        for (size_t m = 0; m < membersPerRoom; m++) {
+                            roomMembers[m]->joinChatRoom(&room);
+                        }
+                    });
+                    rooms.push_back(id);
+                }
+                manager.drain();
+
+                Clock::time_point start = Clock::now();
+                std::vector<std::thread> threads;
+                for (size_t p = 0; p < producers; p++) {
+                    threads.push_back(std::thread([&, p]() {
+                        for (size_t i = p; i < config.messages; i += producers) {
+                            size_t room = i % roomCount;
+                            manager.sendMessage(rooms[room], members[room * membersPerRoom + (i / roomCount) % membersPerRoom],
+                                                corpus[i & 1023]);
+                        }
+                    }));
+                }
+                for (size_t p = 0; p < threads.size(); p++) {
+                    threads[p].join();
+                }
+                manager.drain();
+                seconds = secondsSince(start);
+            }
+
+            BenchResult result("room_sharding");
+            result.param("rooms", static_cast<double>(roomCount));
+            result.param("shards", static_cast<double>(shardCount));
+            result.param("messages", static_cast<double>(config.messages));
+            result.metric("seconds", seconds);
+            result.metric("messages_per_s", config.messages / seconds);
+            results.push_back(result);
+        }
+
+        QuietScope quiet;
+        for (size_t i = 0; i < members.size(); i++) {
+            delete members[i];
+        }
+    }
+}
+
+/**
+ * @brief Loopback delivery rate of the epoll server with idle sockets open
+ *
+ * The server runs on its own thread. Each step adds idle connections and
+ * then runs one round of eight active clients in a shared room. Every idle
+ * connection costs two descriptors in this process, so the sweep stops at
+ * what RLIMIT_NOFILE allows. A final row reports how many frames each
+ * vectored send carried.
+ */
+void benchServerThroughput(const BenchConfig& config) {
+    const size_t idleTargets[] = { 0, 1000, 5000, 10000, 50000 };
+    const size_t clients = 8;
+    const size_t perClient = std::max<size_t>(1, config.messages / clients);
+
+    rlimit limit;
+    size_t idleCap = 0;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur > 2 * clients + 256) {
+        idleCap = (static_cast<size_t>(limit.rlim_cur) - 2 * clients - 256) / 2;
+    }
+
+    QuietScope quiet;
+    ChatServer server;
+    if (!server.start(0)) {
+        return;
+    }
+    std::thread loop([&server]() { server.run(); });
+    LoadGenerator generator("127.0.0.1", server.getPort());
+
+    for (size_t t = 0; t < sizeof(idleTargets) / sizeof(idleTargets[0]); t++) {
+        size_t target = std::min(idleTargets[t], idleCap);
+        if (t > 0 && target <= generator.getIdleCount()) {
+            break;
+        }
+        generator.openIdle(target - generator.getIdleCount());
+
+        LoadGenerator::Result round;
+        bool ok = generator.run(clients, perClient, round);
+
+        BenchResult result("server_throughput");
+        result.param("idle_connections", static_cast<double>(generator.getIdleCount()));
+        result.param("clients", static_cast<double>(clients));
+        result.param("messages", static_cast<double>(round.messagesSent));
+        result.metric("completed", ok ? 1.0 : 0.0);
+        result.metric("seconds", round.seconds);
+        result.metric("deliveries_per_s", round.seconds > 0.0 ? round.messagesReceived / round.seconds : 0.0);
+        results.push_back(result);
+    }
+
+    generator.closeIdle();
+    server.stop();
+    loop.join();
+
+    BenchResult flush("server_flush");
+    flush.param("frames", static_cast<double>(server.getFramesSent()));
+    flush.metric("send_calls", static_cast<double>(server.getWriteCalls()));
+    flush.metric("frames_per_send", server.getWriteCalls() > 0
+                 ? static_cast<double>(server.getFramesSent()) / server.getWriteCalls() : 0.0);
+    results.push_back(flush);
+}
+
+typedef void (*BenchFunction)(const BenchConfig&);
+
+struct BenchEntry {
+    const char* name;
+    BenchFunction run;
+};
+
+const BenchEntry benchmarks[] = {
+    { "send_throughput", benchSendThroughput },
+    { "fanout_latency", benchFanoutLatency },
+    { "fanout_presence", benchFanoutPresence },
+    { "join_leave_churn", benchJoinLeaveChurn },
+    { "bulk_join", benchBulkJoin },
+    { "reconnect_storm", benchReconnectStorm },
+    { "room_teardown", benchRoomTeardown },
+    { "iterator_creation", benchIteratorCreation },
+    { "history_growth", benchHistoryGrowth },
+    { "retract", benchRetract },
+    { "edit_delete", benchEditDelete },
+    { "history_compression", benchHistoryCompression },
+    { "history_export", benchHistoryExport },
+    { "message_filter", benchMessageFilter },
+    { "broadcast", benchBroadcast },
+    { "direct_message", benchDirectMessage },
+    { "room_sharding", benchRoomSharding },
+    { "server_throughput", benchServerThroughput },
+    { "recovery", benchRecovery }
+};
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+void writeCsv(std::ostream& out) {
+    out << "benchmark,params,metric,value" << std::endl;
+    for (size_t r = 0; r < results.size(); r++) {
+        std::string params;
+        for (size_t p = 0; p < results[r].params.size(); p++) {
+            std::ostringstream pair;
+            pair << (p > 0 ? ";" : "") << results[r].params[p].first << "=" << results[r].params[p].second;
+            params += pair.str();
+        }
+        for (size_t m = 0; m < results[r].metrics.size(); m++) {
+            out << results[r].benchmark << "," << params << ","
+                << results[r].metrics[m].first << "," << results[r].metrics[m].second << std::endl;
+        }
+    }
+}
+
+void writeJsonObject(std::ostream& out, const std::vector<std::pair<std::string, double> >& values) {
+    out << "{";
+    for (size_t i = 0; i < values.size(); i++) {
+        out << (i > 0 ? ", " : "") << "\"" << values[i].first << "\": " << values[i].second;
+    }
+    out << "}";
+}
+
+void writeJson(std::ostream& out) {
+    out << "[" << std::endl;
+    for (size_t r = 0; r < results.size(); r++) {
+        out << "  {\"benchmark\": \"" << results[r].benchmark << "\", \"params\": ";
+        writeJsonObject(out, results[r].params);
+        out << ", \"metrics\": ";
+        writeJsonObject(out, results[r].metrics);
+        out << "}" << (r + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig config;
+    config.roomSizes.push_back(10);
+    config.roomSizes.push_back(100);
+    config.roomSizes.push_back(1000);
+    config.messages = 10000;
+    std::vector<std::string> only;
+    bool json = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (arg == "--rooms" && !value.empty()) {
+            config.roomSizes.clear();
+            std::vector<std::string> sizes = splitList(value);
+            for (size_t s = 0; s < sizes.size(); s++) {
+                size_t size = static_cast<size_t>(std::strtoul(sizes[s].c_str(), nullptr, 10));
+                if (size > 0) {
+                    config.roomSizes.push_back(size);
+                }
+            }
+            i++;
+        } else if (arg == "--messages" && !value.empty()) {
+            config.messages = static_cast<size_t>(std::strtoul(value.c_str(), nullptr, 10));
+            i++;
+        } else if (arg == "--only" && !value.empty()) {
+            only = splitList(value);
+            i++;
+        } else if (arg == "--format" && !value.empty()) {
+            json = (value == "json");
+            i++;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--rooms 10,100,1000] [--messages N]"
+                      << " [--only name,name] [--format csv|json]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (config.roomSizes.empty() || config.messages == 0) {
+        std::cerr << "Error: room sizes and message count must be positive" << std::endl;
+        return 1;
+    }
+
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        if (!only.empty() && std::find(only.begin(), only.end(), benchmarks[b].name) == only.end()) {
+            continue;
+        }
+        std::cerr << "running " << benchmarks[b].name << std::endl;
+        benchmarks[b].run(config);
+    }
+
+    if (json) {
+        writeJson(std::cout);
+    } else {
+        writeCsv(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "BroadcastCommand.h"
+#include "ChatRoom.h"
+#include "Users.h"
+#include "Trace.h"
+#include <atomic>
+#include <iostream>
+
+namespace {
+
+// Generation 0 is never handed out, so a new user has received nothing
+std::atomic<uint64_t> nextGeneration(1);
+
+}
+
+BroadcastCommand::BroadcastCommand(const std::vector<ChatRoom*>& targetRooms, User* user, const std::string& msg)
+    : Command(targetRooms.empty() ? nullptr : targetRooms.front(), user, msg), rooms(targetRooms),
+      recipientCount(0), deliveredRoomCount(0) {
+}
+
+BroadcastCommand::~BroadcastCommand() {
+    // Destructor - base class handles cleanup
+}
+
+void BroadcastCommand::execute() {
+    TRACE_SPAN("BroadcastCommand::execute");
+    recipientCount = 0;
+    deliveredRoomCount = 0;
+    if (fromUser == nullptr || message->empty() || rooms.empty()) {
+        return;
+    }
+
+    uint64_t generation = nextGeneration.fetch_add(1, std::memory_order_relaxed);
+
+    // Rooms that mask the message get their own history entry, but the
+    // common case of the unmasked message is formatted only once.
+    MessagePtr formattedFrom;
+    std::string formattedMessage;
+    for (size_t i = 0; i < rooms.size(); i++) {
+        if (rooms[i] == nullptr) {
+            continue;
+        }
+        MessagePtr text = rooms[i]->screenMessage(message, fromUser);
+        if (!text) {
+            continue;
+        }
+        if (text != formattedFrom) {
+            formattedFrom = text;
+            Message::format(formattedMessage, fromUser->getName(), text->data(), text->size());
+        }
+        recipientCount += rooms[i]->deliverBroadcast(*text, formattedMessage, fromUser, generation);
+        deliveredRoomCount++;
+    }
+
+    std::cout << "[LOG] Timestamp: NOW"
+              << " | User: " << fromUser->getName()
+              << " | Rooms: " << deliveredRoomCount
+              << " | Recipients: " << recipientCount
+              << " | Message: \"";
+    std::cout.write(message->data(), message->size());
+    std::cout << "\"" << std::endl;
+}
+
+size_t BroadcastCommand::getRecipientCount() const {
+    return recipientCount;
+}
+
+size_t BroadcastCommand::getDeliveredRoomCount() const {
+    return deliveredRoomCount;
+}
+
+std::string BroadcastCommand::getType() const {
+    return "Broadcast";
+}
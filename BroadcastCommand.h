@@ -0,0 +1,74 @@
+/**
+ * @file BroadcastCommand.h
+ * @brief Command that sends one message to several chat rooms in a single pass
+ * @date 19/10/2026
+ */
+
+#ifndef BROADCASTCOMMAND_H
+#define BROADCASTCOMMAND_H
+
+#include "Command.h"
+#include <vector>
+
+/**
+ * @brief Command for announcing a message in several chat rooms at once
+ * 
+ * Each room still applies its own flood guard and content filter, but the
+ * history entry is formatted once, the message is logged once, and a user
+ * who is a member of several of the rooms receives it only once. Recipients
+ * are deduplicated by stamping each user with the broadcast's generation
+ * number as they are reached, so no per-broadcast set is built.
+ * 
+ * Stamps are claimed atomically, so rooms of one broadcast may deliver on
+ * different threads. A user reached by two broadcasts running at once on
+ * different threads never misses either, but may receive one of them twice.
+ */
+class BroadcastCommand : public Command {
+public:
+    /**
+     * @brief Constructor for BroadcastCommand
+     * 
+     * @param rooms The chat rooms to send to, in delivery order
+     * @param user Pointer to the User who is sending the message
+     * @param msg The message content
+     */
+    BroadcastCommand(const std::vector<ChatRoom*>& rooms, User* user, const std::string& msg);
+
+    /**
+     * @brief Destructor
+     */
+    ~BroadcastCommand();
+
+    /**
+     * @brief Deliver the message to every room and log it once
+     */
+    void execute() override;
+
+    /**
+     * @brief Get the command's type name
+     * 
+     * @return std::string "Broadcast"
+     */
+    std::string getType() const override;
+
+    /**
+     * @brief Get the number of distinct users reached by the last execute
+     * 
+     * @return size_t Recipient count
+     */
+    size_t getRecipientCount() const;
+
+    /**
+     * @brief Get the number of rooms the message was delivered to
+     * 
+     * @return size_t Rooms that accepted the message in the last execute
+     */
+    size_t getDeliveredRoomCount() const;
+
+private:
+    std::vector<ChatRoom*> rooms;
+    size_t recipientCount;
+    size_t deliveredRoomCount;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include "BumpArena.h"
+#include <cstdlib>
+#include <new>
+
+/**
+ * @file BumpArena.cpp
+ * @brief Implementation of the per-thread bump arena
+ */
+
+BumpArena& BumpArena::local() {
+    static thread_local BumpArena arena;
+    return arena;
+}
+
+BumpArena::BumpArena() : current(0), used(0), retired(0), live(0), rewinds(0) {
+}
+
+BumpArena::~BumpArena() {
+    if (live != 0) {
+        return;
+    }
+    for (const Block& block : blocks) {
+        std::free(block.data);
+    }
+}
+
+void* BumpArena::allocate(size_t bytes) {
+    bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    while (current < blocks.size() && used + bytes > blocks[current].capacity) {
+        retired += used;
+        used = 0;
+        current++;
+    }
+    if (current == blocks.size()) {
+        Block block;
+        block.capacity = bytes > BLOCK_BYTES ? bytes : BLOCK_BYTES;
+        block.data = static_cast<char*>(std::malloc(block.capacity));
+        if (block.data == nullptr) {
+            throw std::bad_alloc();
+        }
+        blocks.push_back(block);
+    }
+    void* pointer = blocks[current].data + used;
+    used += bytes;
+    live++;
+    return pointer;
+}
+
+void BumpArena::release(void* pointer) {
+    if (pointer == nullptr || live == 0) {
+        return;
+    }
+    if (--live == 0) {
+        current = 0;
+        used = 0;
+        retired = 0;
+        rewinds++;
+    }
+}
+
+size_t BumpArena::getLiveCount() const {
+    return live;
+}
+
+size_t BumpArena::getBytesInUse() const {
+    return retired + used;
+}
+
+size_t BumpArena::getCapacity() const {
+    size_t capacity = 0;
+    for (const Block& block : blocks) {
+        capacity += block.capacity;
+    }
+    return capacity;
+}
+
+size_t BumpArena::getRewindCount() const {
+    return rewinds;
+}
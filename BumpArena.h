@@ -0,0 +1,105 @@
+/**
+ * @file BumpArena.h
+ * @brief Per-thread bump arena for the short-lived objects of one send
+ * @date 19/10/2026
+ */
+
+#ifndef BUMPARENA_H
+#define BUMPARENA_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Bump allocator for objects that live for one command batch
+ *
+ * A send creates a message and two commands, executes them and deletes
+ * them again within the same call. Those objects are carved from the
+ * sending thread's arena by moving a cursor, and freeing one only counts
+ * it off. When the last one is freed, which is at the end of the
+ * executeAll() batch that ran them, the cursor rewinds to the start, so
+ * after the first few sends the arena reuses the same memory and the send
+ * path makes no heap calls for them.
+ *
+ * An allocation that outlives its batch only keeps the arena from
+ * rewinding; later allocations continue in further blocks, which are
+ * kept for reuse. Objects must be freed on the thread that allocated them.
+ * Commands a room keeps for undo are allocated on the heap instead.
+ */
+class BumpArena {
+public:
+    /** Size of each block the arena takes from the heap */
+    static const size_t BLOCK_BYTES = 16 * 1024;
+
+    /** Alignment of every allocation */
+    static const size_t ALIGNMENT = 16;
+
+    /**
+     * @brief Get the calling thread's arena
+     * @return The arena, created on first use
+     */
+    static BumpArena& local();
+
+    BumpArena();
+
+    /**
+     * @brief Destructor - returns the blocks to the heap, unless
+     * allocations are still live, in which case they are left alone
+     */
+    ~BumpArena();
+
+    /**
+     * @brief Allocate from the arena
+     * @param bytes Size of the allocation
+     * @return Memory aligned to ALIGNMENT
+     */
+    void* allocate(size_t bytes);
+
+    /**
+     * @brief Free an allocation, rewinding the arena if it was the last live one
+     * @param pointer The allocation
+     */
+    void release(void* pointer);
+
+    /**
+     * @brief Get the number of live allocations
+     * @return Allocations not yet released
+     */
+    size_t getLiveCount() const;
+
+    /**
+     * @brief Get the bytes handed out since the arena last rewound
+     * @return Bytes in use, including alignment padding
+     */
+    size_t getBytesInUse() const;
+
+    /**
+     * @brief Get the total size of the arena's blocks
+     * @return Capacity in bytes
+     */
+    size_t getCapacity() const;
+
+    /**
+     * @brief Get the number of times the arena has rewound
+     * @return Rewind count
+     */
+    size_t getRewindCount() const;
+
+private:
+    struct Block {
+        char* data;
+        size_t capacity;
+    };
+
+    std::vector<Block> blocks;
+    size_t current;         ///< Block the cursor is in
+    size_t used;            ///< Cursor offset in the current block
+    size_t retired;         ///< Bytes used in blocks before the current one
+    size_t live;
+    size_t rewinds;
+
+    BumpArena(const BumpArena&);
+    BumpArena& operator=(const BumpArena&);
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "ChatClient.h"
+#include "ChatServer.h"
+#include <chrono>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * @file ChatClient.cpp
+ * @brief Implementation of the blocking frame client
+ */
+
+ChatClient::ChatClient() : fd(-1), offset(0) {
+}
+
+ChatClient::~ChatClient() {
+    close();
+}
+
+bool ChatClient::connect(const std::string& host, uint16_t port) {
+    close();
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        return false;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close();
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return true;
+}
+
+bool ChatClient::send(const std::string& payload) {
+    if (fd < 0) {
+        return false;
+    }
+    outbound.clear();
+    ChatServer::appendFrame(outbound, payload);
+    size_t sent = 0;
+    while (sent < outbound.size()) {
+        ssize_t written = ::send(fd, outbound.data() + sent, outbound.size() - sent, MSG_NOSIGNAL);
+        if (written > 0) {
+            sent += static_cast<size_t>(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ChatClient::receive(std::string& payload, int timeoutMs) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+    char buffer[16 * 1024];
+
+    for (;;) {
+        int status = ChatServer::takeFrame(inbound, offset, payload);
+        if (status == 1) {
+            if (offset == inbound.size()) {
+                inbound.clear();
+                offset = 0;
+            }
+            return true;
+        }
+        if (status < 0 || fd < 0) {
+            return false;
+        }
+        if (offset > 0) {
+            inbound.erase(0, offset);
+            offset = 0;
+        }
+
+        int wait = -1;
+        if (timeoutMs >= 0) {
+            long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            wait = left > 0 ? static_cast<int>(left) : 0;
+        }
+        pollfd ready;
+        ready.fd = fd;
+        ready.events = POLLIN;
+        ready.revents = 0;
+        int polled = poll(&ready, 1, wait);
+        if (polled < 0 && errno == EINTR) {
+            continue;
+        }
+        if (polled <= 0) {
+            return false;
+        }
+
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            inbound.append(buffer, static_cast<size_t>(received));
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else {
+            close();
+        }
+    }
+}
+
+void ChatClient::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    inbound.clear();
+    offset = 0;
+}
+
+bool ChatClient::isConnected() const {
+    return fd >= 0;
+}
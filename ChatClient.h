@@ -0,0 +1,68 @@
+/**
+ * @file ChatClient.h
+ * @brief Blocking client for the ChatServer frame protocol
+ * @date 19/10/2026
+ */
+
+#ifndef CHATCLIENT_H
+#define CHATCLIENT_H
+
+#include <string>
+#include <stdint.h>
+
+/**
+ * @brief One TCP connection speaking ChatServer's length-prefixed frames
+ *
+ * Sends block until the whole frame is written; receives wait up to a
+ * timeout. Used by the load generator, the tests and the benchmarks.
+ */
+class ChatClient {
+public:
+    ChatClient();
+
+    /**
+     * @brief Destructor - closes the connection
+     */
+    ~ChatClient();
+
+    /**
+     * @brief Connect to a server
+     * @param host IPv4 address
+     * @param port TCP port
+     * @return False if the connection failed
+     */
+    bool connect(const std::string& host, uint16_t port);
+
+    /**
+     * @brief Send one frame
+     * @param payload Frame contents
+     * @return False if the connection failed
+     */
+    bool send(const std::string& payload);
+
+    /**
+     * @brief Receive one frame
+     * @param payload Set to the frame contents
+     * @param timeoutMs Longest wait, or -1 to wait indefinitely
+     * @return False on timeout, disconnect or a malformed frame
+     */
+    bool receive(std::string& payload, int timeoutMs);
+
+    /**
+     * @brief Close the connection
+     */
+    void close();
+
+    bool isConnected() const;
+
+private:
+    int fd;
+    std::string inbound;
+    size_t offset;
+    std::string outbound;   ///< Reused between sends
+
+    ChatClient(const ChatClient&);
+    ChatClient& operator=(const ChatClient&);
+};
+
+#endif
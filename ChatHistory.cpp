@@ -0,0 +1,954 @@
+#include "ChatHistory.h"
+#include "LzCodec.h"
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <ostream>
+#include <string.h>
+
+/**
+ * @file ChatHistory.cpp
+ * @brief Implementation of the tombstoned message history
+ */
+
+namespace {
+
+const size_t NO_SEGMENT = static_cast<size_t>(-1);
+const size_t CHUNK_BYTES = 64 * 1024;
+
+// Shared by every history, so a copied segment keeps a serial no other
+// segment content ever had
+std::atomic<uint64_t> segmentSerials(0);
+
+static_assert(sizeof(ChatHistory::Entry) == 64, "a history entry should fill exactly one cache line");
+
+bool idBefore(const ChatHistory::Entry& entry, ChatHistory::MessageId id) {
+    return entry.id < id;
+}
+
+}
+
+ChatHistory::Text::Text() : length(0) {
+}
+
+const char* ChatHistory::Text::data() const {
+    if (length != SPILLED) {
+        return bytes;
+    }
+    const char* pointer;
+    memcpy(&pointer, bytes, sizeof(pointer));
+    return pointer;
+}
+
+size_t ChatHistory::Text::size() const {
+    if (length != SPILLED) {
+        return length;
+    }
+    uint64_t count;
+    memcpy(&count, bytes + 8, sizeof(count));
+    return static_cast<size_t>(count);
+}
+
+bool ChatHistory::Text::empty() const {
+    return size() == 0;
+}
+
+bool ChatHistory::Text::isInline() const {
+    return length != SPILLED;
+}
+
+bool ChatHistory::Text::startsWith(const std::string& prefix) const {
+    return size() >= prefix.size() && memcmp(data(), prefix.data(), prefix.size()) == 0;
+}
+
+std::string ChatHistory::Text::str() const {
+    return std::string(data(), size());
+}
+
+ChatHistory::Text::operator std::string() const {
+    return str();
+}
+
+bool ChatHistory::Text::operator==(const Text& other) const {
+    size_t count = size();
+    return count == other.size() && memcmp(data(), other.data(), count) == 0;
+}
+
+bool ChatHistory::Text::operator!=(const Text& other) const {
+    return !(*this == other);
+}
+
+bool ChatHistory::Text::operator==(const std::string& other) const {
+    size_t count = size();
+    return count == other.size() && memcmp(data(), other.data(), count) == 0;
+}
+
+bool ChatHistory::Text::operator!=(const std::string& other) const {
+    return !(*this == other);
+}
+
+void ChatHistory::Text::setInline(const char* source, size_t count) {
+    memcpy(bytes, source, count);
+    length = static_cast<unsigned char>(count);
+}
+
+/**
+ * @brief Point at bytes held elsewhere: pointer, size and chunk packed into the slot
+ */
+void ChatHistory::Text::setSpilled(const char* source, size_t count, uint64_t chunk) {
+    uint64_t size64 = count;
+    memcpy(bytes, &source, sizeof(source));
+    memcpy(bytes + 8, &size64, sizeof(size64));
+    memcpy(bytes + 16, &chunk, sizeof(chunk));
+    length = SPILLED;
+}
+
+uint64_t ChatHistory::Text::getChunk() const {
+    uint64_t chunk;
+    memcpy(&chunk, bytes + 16, sizeof(chunk));
+    return chunk;
+}
+
+std::ostream& operator<<(std::ostream& out, const ChatHistory::Text& text) {
+    return out.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+ChatHistory::const_iterator::const_iterator(const ChatHistory* source, size_t start)
+    : history(source), index(start), stored(source->getStoredCount()) {
+    skipTombstones();
+}
+
+ChatHistory::const_iterator::reference ChatHistory::const_iterator::operator*() const {
+    return history->getEntry(index).text;
+}
+
+ChatHistory::const_iterator::pointer ChatHistory::const_iterator::operator->() const {
+    return &history->getEntry(index).text;
+}
+
+ChatHistory::const_iterator& ChatHistory::const_iterator::operator++() {
+    ++index;
+    skipTombstones();
+    return *this;
+}
+
+ChatHistory::const_iterator ChatHistory::const_iterator::operator++(int) {
+    const_iterator previous = *this;
+    ++(*this);
+    return previous;
+}
+
+bool ChatHistory::const_iterator::operator==(const const_iterator& other) const {
+    return index == other.index;
+}
+
+bool ChatHistory::const_iterator::operator!=(const const_iterator& other) const {
+    return index != other.index;
+}
+
+ChatHistory::MessageId ChatHistory::const_iterator::id() const {
+    return history->getEntry(index).id;
+}
+
+void ChatHistory::const_iterator::skipTombstones() {
+    while (index < stored && history->getEntry(index).tombstoned) {
+        ++index;
+    }
+}
+
+ChatHistory::ChatHistory()
+    : coldCount(0), nextId(1), tombstones(0), segmentSize(0), cachedSegment(NO_SEGMENT),
+      firstChunk(0), spilledCount(0) {
+}
+
+ChatHistory::~ChatHistory() {
+    releaseChunks();
+}
+
+ChatHistory::ChatHistory(const ChatHistory& other)
+    : coldCount(0), nextId(1), tombstones(0), segmentSize(0), cachedSegment(NO_SEGMENT),
+      firstChunk(0), spilledCount(0) {
+    copyFrom(other);
+}
+
+ChatHistory& ChatHistory::operator=(const ChatHistory& other) {
+    if (this != &other) {
+        releaseChunks();
+        copyFrom(other);
+    }
+    return *this;
+}
+
+/**
+ * @brief Copy another history, giving spilled texts their own arena
+ * 
+ * The arena must already be empty. The cache is not copied since its
+ * texts point into the other history's buffer.
+ */
+void ChatHistory::copyFrom(const ChatHistory& other) {
+    segments = other.segments;
+    segmentEnds = other.segmentEnds;
+    coldCount = other.coldCount;
+    entries = other.entries;
+    nextId = other.nextId;
+    tombstones = other.tombstones;
+    segmentSize = other.segmentSize;
+    cachedSegment = NO_SEGMENT;
+    cache.clear();
+    cacheRaw.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        Text& text = entries[i].text;
+        if (!text.isInline()) {
+            storeText(text, text.data(), text.size());
+        }
+    }
+}
+
+ChatHistory::MessageId ChatHistory::append(const std::string& text) {
+    // A short text goes straight into the slot, so nothing is allocated
+    Entry entry;
+    MessageId id = nextId++;
+    entry.id = id;
+    storeText(entry.text, text.data(), text.size());
+    entry.tombstoned = false;
+    entries.push_back(entry);
+    if (segmentSize != 0 && entries.size() >= 2 * segmentSize) {
+        sealCold();
+    }
+    return id;
+}
+
+bool ChatHistory::tombstone(MessageId id) {
+    size_t segment;
+    size_t index;
+    if (locateCold(id, segment, index)) {
+        return setColdFlag(segment, index, true);
+    }
+    Entry* entry = findEntry(id, segment);
+    if (entry == nullptr || entry->tombstoned) {
+        return false;
+    }
+    entry->tombstoned = true;
+    tombstones++;
+    return true;
+}
+
+bool ChatHistory::restore(MessageId id) {
+    size_t segment;
+    size_t index;
+    if (locateCold(id, segment, index)) {
+        return setColdFlag(segment, index, false);
+    }
+    Entry* entry = findEntry(id, segment);
+    if (entry == nullptr || !entry->tombstoned || entry->text.empty()) {
+        return false;
+    }
+    entry->tombstoned = false;
+    tombstones--;
+    return true;
+}
+
+bool ChatHistory::edit(MessageId id, const std::string& text) {
+    size_t segment;
+    Entry* entry = findEntry(id, segment);
+    if (entry == nullptr || entry->tombstoned) {
+        return false;
+    }
+    if (segment == NO_SEGMENT) {
+        releaseText(entry->text);
+        storeText(entry->text, text.data(), text.size());
+        return true;
+    }
+    // The cached copy only has to last until the segment is resealed
+    if (text.size() <= Text::INLINE_CAPACITY) {
+        entry->text.setInline(text.data(), text.size());
+    } else {
+        entry->text.setSpilled(text.data(), text.size(), 0);
+    }
+    resealSegment(segment);
+    return true;
+}
+
+bool ChatHistory::erase(MessageId id) {
+    size_t segment;
+    Entry* entry = findEntry(id, segment);
+    if (entry == nullptr || (entry->tombstoned && entry->text.empty())) {
+        return false;
+    }
+    if (!entry->tombstoned) {
+        if (segment != NO_SEGMENT) {
+            setColdFlag(segment, static_cast<size_t>(entry - cache.data()), true);
+        } else {
+            entry->tombstoned = true;
+            tombstones++;
+        }
+    }
+    if (segment == NO_SEGMENT) {
+        releaseText(entry->text);
+    }
+    entry->text = Text();
+    if (segment != NO_SEGMENT) {
+        resealSegment(segment);
+    }
+    return true;
+}
+
+size_t ChatHistory::compact() {
+    if (tombstones == 0) {
+        return 0;
+    }
+    size_t dropped = compactCold();
+    size_t write = 0;
+    for (size_t read = 0; read < entries.size(); read++) {
+        if (entries[read].tombstoned) {
+            releaseText(entries[read].text);
+        } else {
+            if (write != read) {
+                entries[write] = entries[read];
+            }
+            write++;
+        }
+    }
+    dropped += entries.size() - write;
+    entries.erase(entries.begin() + write, entries.end());
+    tombstones = 0;
+    return dropped;
+}
+
+const ChatHistory::Entry* ChatHistory::find(MessageId id) const {
+    size_t segment;
+    return const_cast<ChatHistory*>(this)->findEntry(id, segment);
+}
+
+/**
+ * @brief Locate an entry by id
+ * 
+ * Ids are stored in increasing order. Until entries are dropped out of the
+ * middle, an entry sits exactly (id - first id) places in, so that slot is
+ * checked first and binary search is only the fallback. Ids older than the
+ * hot entries are looked up in the segments.
+ * 
+ * @param segment Set to the entry's segment, or NO_SEGMENT if it is hot
+ */
+ChatHistory::Entry* ChatHistory::findEntry(MessageId id, size_t& segment) {
+    segment = NO_SEGMENT;
+    if (entries.empty() || id < entries.front().id) {
+        return findColdEntry(id, segment);
+    }
+    if (id > entries.back().id) {
+        return nullptr;
+    }
+    size_t guess = static_cast<size_t>(id - entries.front().id);
+    if (guess < entries.size() && entries[guess].id == id) {
+        return &entries[guess];
+    }
+    std::deque<Entry>::iterator it = std::lower_bound(entries.begin(), entries.end(), id, idBefore);
+    if (it == entries.end() || it->id != id) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+/**
+ * @brief Locate a compressed entry by id and decode its segment
+ * @return The entry inside the cache, or nullptr
+ */
+ChatHistory::Entry* ChatHistory::findColdEntry(MessageId id, size_t& segment) {
+    size_t index;
+    if (!locateCold(id, segment, index)) {
+        segment = NO_SEGMENT;
+        return nullptr;
+    }
+    decodeSegment(segment);
+    return &cache[index];
+}
+
+/**
+ * @brief Locate a compressed entry by id from the uncompressed ids alone
+ * @param segment Set to the entry's segment
+ * @param index Set to the entry's position in the segment
+ * @return Whether the id is a cold entry that has not been trimmed
+ */
+bool ChatHistory::locateCold(MessageId id, size_t& segment, size_t& index) const {
+    if (segments.empty() || id < segments.front().firstId || id > segments.back().lastId) {
+        return false;
+    }
+    size_t low = 0;
+    size_t high = segments.size();
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (segments[middle].lastId < id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    const Segment& candidate = segments[low];
+    if (id < candidate.firstId) {
+        return false;
+    }
+
+    if (candidate.ids.empty()) {
+        index = static_cast<size_t>(id - candidate.firstId);
+    } else {
+        std::vector<MessageId>::const_iterator it =
+            std::lower_bound(candidate.ids.begin(), candidate.ids.end(), id);
+        if (it == candidate.ids.end() || *it != id) {
+            return false;
+        }
+        index = static_cast<size_t>(it - candidate.ids.begin());
+    }
+    if (index < candidate.skipped) {
+        return false;
+    }
+    segment = low;
+    return true;
+}
+
+void ChatHistory::trimTo(size_t limit) {
+    // Whole segments are dropped and single entries skipped from flags alone,
+    // so trimming never decompresses anything
+    while (!segments.empty() && size() > limit) {
+        const Segment& front = segments.front();
+        if (size() - (front.count - front.skipped - front.tombstones) >= limit) {
+            dropFrontSegment();
+        } else {
+            skipFrontEntry();
+        }
+    }
+    while (!segments.empty() && segments.front().tombstoned[segments.front().skipped]) {
+        skipFrontEntry();
+    }
+    if (!segments.empty()) {
+        return;
+    }
+
+    while (!entries.empty() && size() > limit) {
+        if (entries.front().tombstoned) {
+            tombstones--;
+        }
+        releaseText(entries.front().text);
+        entries.pop_front();
+    }
+    while (!entries.empty() && entries.front().tombstoned) {
+        tombstones--;
+        releaseText(entries.front().text);
+        entries.pop_front();
+    }
+}
+
+void ChatHistory::clear() {
+    segments.clear();
+    segmentEnds.clear();
+    coldCount = 0;
+    cachedSegment = NO_SEGMENT;
+    cache.clear();
+    cacheRaw.clear();
+    entries.clear();
+    releaseChunks();
+    tombstones = 0;
+}
+
+bool ChatHistory::restoreEntry(MessageId id, const std::string& text, bool tombstoned) {
+    if (id == 0 || id <= getLastId()) {
+        return false;
+    }
+    Entry entry;
+    entry.id = id;
+    storeText(entry.text, text.data(), text.size());
+    entry.tombstoned = tombstoned;
+    entries.push_back(entry);
+    if (tombstoned) {
+        tombstones++;
+    }
+    if (nextId <= id) {
+        nextId = id + 1;
+    }
+    if (segmentSize != 0 && entries.size() >= 2 * segmentSize) {
+        sealCold();
+    }
+    return true;
+}
+
+bool ChatHistory::restoreSegment(const SegmentImage& image, size_t skipped, const std::vector<bool>& tombstoned) {
+    if (!entries.empty() || image.count == 0 || image.firstId == 0 || image.firstId <= getLastId() ||
+        image.lastId < image.firstId || skipped >= image.count || (skipped != 0 && !segments.empty()) ||
+        tombstoned.size() != image.count || image.erased.size() != image.count ||
+        (image.ids.empty() ? image.lastId - image.firstId + 1 != image.count : image.ids.size() != image.count)) {
+        return false;
+    }
+    segments.push_back(Segment());
+    Segment& segment = segments.back();
+    segment.serial = segmentSerials.fetch_add(1, std::memory_order_relaxed) + 1;
+    segment.firstId = image.firstId;
+    segment.lastId = image.lastId;
+    segment.ids = image.ids;
+    segment.tombstoned = tombstoned;
+    segment.erased = image.erased;
+    segment.count = image.count;
+    segment.skipped = skipped;
+    segment.tombstones = 0;
+    for (size_t i = skipped; i < image.count; i++) {
+        if (tombstoned[i]) {
+            segment.tombstones++;
+        }
+    }
+    segment.rawBytes = image.rawBytes;
+    segment.data = image.data;
+
+    coldCount += image.count - skipped;
+    tombstones += segment.tombstones;
+    if (nextId <= image.lastId) {
+        nextId = image.lastId + 1;
+    }
+    rebuildSegmentEnds();
+    return true;
+}
+
+size_t ChatHistory::size() const {
+    return coldCount + entries.size() - tombstones;
+}
+
+bool ChatHistory::empty() const {
+    return size() == 0;
+}
+
+const ChatHistory::Text& ChatHistory::front() const {
+    return *begin();
+}
+
+const ChatHistory::Text& ChatHistory::back() const {
+    size_t index = getStoredCount() - 1;
+    while (getEntry(index).tombstoned) {
+        index--;
+    }
+    return getEntry(index).text;
+}
+
+ChatHistory::const_iterator ChatHistory::begin() const {
+    return const_iterator(this, 0);
+}
+
+ChatHistory::const_iterator ChatHistory::end() const {
+    return const_iterator(this, getStoredCount());
+}
+
+size_t ChatHistory::getStoredCount() const {
+    return coldCount + entries.size();
+}
+
+size_t ChatHistory::getTombstoneCount() const {
+    return tombstones;
+}
+
+const ChatHistory::Entry& ChatHistory::getEntry(size_t index) const {
+    if (index < coldCount) {
+        return coldEntry(index);
+    }
+    return entries[index - coldCount];
+}
+
+ChatHistory::MessageId ChatHistory::getFirstId() const {
+    if (!segments.empty()) {
+        const Segment& front = segments.front();
+        return front.ids.empty() ? front.firstId + front.skipped : front.ids[front.skipped];
+    }
+    return entries.empty() ? 0 : entries.front().id;
+}
+
+ChatHistory::MessageId ChatHistory::getLastId() const {
+    if (!entries.empty()) {
+        return entries.back().id;
+    }
+    return segments.empty() ? 0 : segments.back().lastId;
+}
+
+ChatHistory::MessageId ChatHistory::getNextId() const {
+    return nextId;
+}
+
+void ChatHistory::setNextId(MessageId id) {
+    if (id > getLastId()) {
+        nextId = id;
+    }
+}
+
+void ChatHistory::setSegmentSize(size_t entryCount) {
+    segmentSize = entryCount;
+    if (segmentSize != 0 && entries.size() >= 2 * segmentSize) {
+        sealCold();
+    }
+}
+
+size_t ChatHistory::getSegmentSize() const {
+    return segmentSize;
+}
+
+size_t ChatHistory::getSegmentCount() const {
+    return segments.size();
+}
+
+size_t ChatHistory::getColdCount() const {
+    return coldCount;
+}
+
+uint64_t ChatHistory::getSegmentSerial(size_t segment) const {
+    return segments[segment].serial;
+}
+
+void ChatHistory::getSegmentImage(size_t segment, SegmentImage& image) const {
+    const Segment& source = segments[segment];
+    image.serial = source.serial;
+    image.firstId = source.firstId;
+    image.lastId = source.lastId;
+    image.count = source.count;
+    image.ids = source.ids;
+    image.erased = source.erased;
+    image.rawBytes = source.rawBytes;
+    image.data = source.data;
+}
+
+size_t ChatHistory::getSegmentSkipped(size_t segment) const {
+    return segments[segment].skipped;
+}
+
+const std::vector<bool>& ChatHistory::getSegmentTombstones(size_t segment) const {
+    return segments[segment].tombstoned;
+}
+
+size_t ChatHistory::getColdRawBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        bytes += segments[i].rawBytes;
+    }
+    return bytes;
+}
+
+size_t ChatHistory::getColdCompressedBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        bytes += segments[i].data.size();
+    }
+    return bytes;
+}
+
+size_t ChatHistory::getSpilledCount() const {
+    return spilledCount;
+}
+
+size_t ChatHistory::getOverflowBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        bytes += chunks[i].capacity;
+    }
+    return bytes;
+}
+
+bool ChatHistory::operator==(const ChatHistory& other) const {
+    size_t stored = getStoredCount();
+    if (stored != other.getStoredCount()) {
+        return false;
+    }
+    for (size_t i = 0; i < stored; i++) {
+        const Entry& mine = getEntry(i);
+        const Entry& theirs = other.getEntry(i);
+        if (mine.id != theirs.id || mine.tombstoned != theirs.tombstoned || mine.text != theirs.text) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ChatHistory::operator!=(const ChatHistory& other) const {
+    return !(*this == other);
+}
+
+const ChatHistory::Entry& ChatHistory::coldEntry(size_t index) const {
+    size_t position = index + segments.front().skipped;
+    size_t segment = cachedSegment;
+    if (segment == NO_SEGMENT || position >= segmentEnds[segment] ||
+        position < segmentEnds[segment] - segments[segment].count) {
+        segment = std::upper_bound(segmentEnds.begin(), segmentEnds.end(), position) - segmentEnds.begin();
+        decodeSegment(segment);
+    }
+    return cache[position - (segmentEnds[segment] - segments[segment].count)];
+}
+
+/**
+ * @brief Decompress a segment into the cache, unless it is already there
+ * 
+ * Texts are stored as every length, then every text, so the lengths sit
+ * together and compress well. Short texts are copied into the cached
+ * slots; long ones point into the decompressed buffer, which is kept
+ * until the next segment is decoded.
+ */
+void ChatHistory::decodeSegment(size_t segment) const {
+    if (cachedSegment == segment) {
+        return;
+    }
+    const Segment& source = segments[segment];
+    std::string& raw = cacheRaw;
+    bool ok = LzCodec::decompress(source.data, raw);
+
+    cache.resize(source.count);
+    size_t lengthPos = 0;
+    size_t textPos = 0;
+    std::vector<size_t> lengths(source.count, 0);
+    for (size_t i = 0; ok && i < source.count; i++) {
+        uint64_t length;
+        ok = LzCodec::getVarint(raw.data(), raw.size(), lengthPos, length);
+        lengths[i] = static_cast<size_t>(length);
+    }
+    textPos = lengthPos;
+    for (size_t i = 0; i < source.count; i++) {
+        cache[i].id = source.ids.empty() ? source.firstId + i : source.ids[i];
+        cache[i].tombstoned = source.tombstoned[i];
+        if (ok && lengths[i] <= raw.size() - textPos) {
+            if (lengths[i] <= Text::INLINE_CAPACITY) {
+                cache[i].text.setInline(raw.data() + textPos, lengths[i]);
+            } else {
+                cache[i].text.setSpilled(raw.data() + textPos, lengths[i], 0);
+            }
+            textPos += lengths[i];
+        } else {
+            cache[i].text = Text();
+        }
+    }
+    cachedSegment = segment;
+}
+
+void ChatHistory::encodeSegment(Segment& segment, const Entry* first, size_t count) {
+    segment.serial = segmentSerials.fetch_add(1, std::memory_order_relaxed) + 1;
+    segment.firstId = first[0].id;
+    segment.lastId = first[count - 1].id;
+    segment.count = count;
+    segment.skipped = 0;
+    segment.tombstones = 0;
+    segment.ids.clear();
+    segment.tombstoned.assign(count, false);
+    segment.erased.assign(count, false);
+
+    bool dense = segment.lastId - segment.firstId + 1 == count;
+    size_t textBytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!dense) {
+            segment.ids.push_back(first[i].id);
+        }
+        if (first[i].tombstoned) {
+            segment.tombstoned[i] = true;
+            segment.erased[i] = first[i].text.empty();
+            segment.tombstones++;
+        }
+        textBytes += first[i].text.size();
+    }
+
+    std::string raw;
+    raw.reserve(textBytes + count * 2);
+    for (size_t i = 0; i < count; i++) {
+        LzCodec::putVarint(raw, first[i].text.size());
+    }
+    for (size_t i = 0; i < count; i++) {
+        raw.append(first[i].text.data(), first[i].text.size());
+    }
+    segment.rawBytes = raw.size();
+    LzCodec::compress(raw, segment.data);
+    segment.data.shrink_to_fit();
+}
+
+/**
+ * @brief Flip a cold entry's tombstone flag without decompressing anything
+ * 
+ * The decoded copy is kept in step if the segment is the cached one. An
+ * erased entry has no text left, so it cannot be restored.
+ * 
+ * @return Whether the flag changed
+ */
+bool ChatHistory::setColdFlag(size_t segment, size_t index, bool tombstoned) {
+    Segment& target = segments[segment];
+    if (target.tombstoned[index] == tombstoned || (!tombstoned && target.erased[index])) {
+        return false;
+    }
+    target.tombstoned[index] = tombstoned;
+    if (tombstoned) {
+        target.tombstones++;
+        tombstones++;
+    } else {
+        target.tombstones--;
+        tombstones--;
+    }
+    if (cachedSegment == segment) {
+        cache[index].tombstoned = tombstoned;
+    }
+    return true;
+}
+
+/**
+ * @brief Recompress a segment after a text change made through the cache
+ * 
+ * Entries the segment had skipped are dropped for good at the same time.
+ */
+void ChatHistory::resealSegment(size_t segment) {
+    Segment& target = segments[segment];
+    encodeSegment(target, cache.data() + target.skipped, target.count - target.skipped);
+    cachedSegment = NO_SEGMENT;
+    rebuildSegmentEnds();
+}
+
+/**
+ * @brief Compress the oldest hot entries while two segments' worth are hot
+ * 
+ * Keeping a full segment of recent entries raw means edits, retractions
+ * and reads of recent messages stay on the uncompressed path.
+ */
+void ChatHistory::sealCold() {
+    if (segmentSize == 0) {
+        return;
+    }
+    std::vector<Entry> batch;
+    while (entries.size() >= 2 * segmentSize) {
+        batch.assign(entries.begin(), entries.begin() + segmentSize);
+        segments.push_back(Segment());
+        encodeSegment(segments.back(), batch.data(), segmentSize);
+        for (size_t i = 0; i < segmentSize; i++) {
+            releaseText(entries[i].text);
+        }
+        entries.erase(entries.begin(), entries.begin() + segmentSize);
+        coldCount += segmentSize;
+    }
+    rebuildSegmentEnds();
+}
+
+void ChatHistory::skipFrontEntry() {
+    Segment& front = segments.front();
+    if (front.tombstoned[front.skipped]) {
+        front.tombstones--;
+        tombstones--;
+    }
+    front.skipped++;
+    coldCount--;
+    if (front.skipped == front.count) {
+        dropFrontSegment();
+    }
+}
+
+void ChatHistory::dropFrontSegment() {
+    const Segment& front = segments.front();
+    coldCount -= front.count - front.skipped;
+    tombstones -= front.tombstones;
+    segments.erase(segments.begin());
+    cachedSegment = NO_SEGMENT;
+    rebuildSegmentEnds();
+}
+
+void ChatHistory::rebuildSegmentEnds() {
+    segmentEnds.resize(segments.size());
+    size_t total = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        total += segments[i].count;
+        segmentEnds[i] = total;
+    }
+}
+
+/**
+ * @brief Rewrite every segment that holds tombstones without them
+ * @return Number of tombstones dropped
+ */
+size_t ChatHistory::compactCold() {
+    size_t dropped = 0;
+    std::vector<Segment> kept;
+    kept.reserve(segments.size());
+    std::vector<Entry> live;
+    for (size_t s = 0; s < segments.size(); s++) {
+        Segment& source = segments[s];
+        if (source.tombstones == 0) {
+            kept.push_back(std::move(source));
+            continue;
+        }
+        decodeSegment(s);
+        live.clear();
+        for (size_t i = source.skipped; i < source.count; i++) {
+            if (!cache[i].tombstoned) {
+                live.push_back(cache[i]);
+            }
+        }
+        cachedSegment = NO_SEGMENT;
+        dropped += source.tombstones;
+        coldCount -= source.count - source.skipped - live.size();
+        if (!live.empty()) {
+            kept.push_back(Segment());
+            encodeSegment(kept.back(), live.data(), live.size());
+        }
+    }
+    segments.swap(kept);
+    cachedSegment = NO_SEGMENT;
+    rebuildSegmentEnds();
+    return dropped;
+}
+
+/**
+ * @brief Put text in a slot, spilling it to the overflow arena if too long
+ * 
+ * Only hot entries own arena bytes; each must be released exactly once,
+ * when its text changes or the entry leaves the deque.
+ */
+void ChatHistory::storeText(Text& target, const char* source, size_t count) {
+    if (count <= Text::INLINE_CAPACITY) {
+        target.setInline(source, count);
+        return;
+    }
+    if (chunks.empty() || chunks.back().capacity - chunks.back().used < count) {
+        Chunk chunk;
+        chunk.capacity = std::max(CHUNK_BYTES, count);
+        chunk.data = new char[chunk.capacity];
+        chunk.used = 0;
+        chunk.live = 0;
+        chunks.push_back(chunk);
+    }
+    Chunk& chunk = chunks.back();
+    char* destination = chunk.data + chunk.used;
+    memcpy(destination, source, count);
+    chunk.used += count;
+    chunk.live += count;
+    target.setSpilled(destination, count, firstChunk + chunks.size() - 1);
+    spilledCount++;
+}
+
+/**
+ * @brief Give a hot entry's arena bytes back
+ * 
+ * A chunk is freed once nothing in it is referenced, except the newest,
+ * which is rewound and reused. Entries leave mostly oldest first, so
+ * emptied chunks collect at the front and are popped there.
+ */
+void ChatHistory::releaseText(const Text& text) {
+    if (text.isInline()) {
+        return;
+    }
+    spilledCount--;
+    size_t index = static_cast<size_t>(text.getChunk() - firstChunk);
+    Chunk& chunk = chunks[index];
+    chunk.live -= text.size();
+    if (chunk.live != 0) {
+        return;
+    }
+    if (index + 1 == chunks.size()) {
+        chunk.used = 0;
+    } else {
+        delete[] chunk.data;
+        chunk.data = nullptr;
+        chunk.capacity = 0;
+    }
+    while (chunks.size() > 1 && chunks.front().data == nullptr) {
+        chunks.pop_front();
+        firstChunk++;
+    }
+}
+
+void ChatHistory::releaseChunks() {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        delete[] chunks[i].data;
+    }
+    chunks.clear();
+    firstChunk = 0;
+    spilledCount = 0;
+}
@@ -0,0 +1,548 @@
+/**
+ * @file ChatHistory.h
+ * @brief Append-only message history with ids and tombstones
+ * @date 19/10/2026
+ */
+
+#ifndef CHATHISTORY_H
+#define CHATHISTORY_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <iterator>
+#include <iosfwd>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * @brief A room's message history
+ * 
+ * Every appended message gets an id, one higher than the previous one and
+ * never reused, even after clear(). Removing a message only marks its entry
+ * as a tombstone, so no other entry moves and removal costs the same for
+ * the first message of a ten-million-entry history as for the last.
+ * Retracted messages keep their text and can be restored; erased messages
+ * free it. Edits replace the text in place. compact() reclaims tombstones
+ * once enough have built up.
+ * 
+ * Entries live in a deque, so appending never moves existing entries and
+ * dropping the oldest entries for a history limit is O(1) each. Each entry
+ * is one 64-byte, cache-line-aligned slot holding its id, flag and - for
+ * the common short message - its text inline, so appending a short
+ * message allocates nothing and iteration reads consecutive cache lines.
+ * Longer texts spill into an overflow arena of large chunks that are freed
+ * as the entries in them are trimmed, edited or erased.
+ * 
+ * With setSegmentSize(), cold history is compressed: once the deque holds
+ * two segments' worth of entries, the oldest segment's text is packed with
+ * LzCodec and moved out of the deque. Ids and tombstone flags stay
+ * uncompressed, so retractions, restores and trimming never touch the
+ * compressed text. find() and reading a cold entry decompress its whole
+ * segment into a one-segment cache, and editing or erasing one
+ * recompresses it.
+ * Because of that cache, references and pointers returned for cold entries
+ * stay valid only until the next access to another cold segment, and const
+ * access is not safe from several threads at once.
+ * 
+ * size(), front(), back() and iteration only see live messages.
+ */
+class ChatHistory {
+public:
+    typedef uint64_t MessageId;     ///< 0 is never a valid id
+
+    /**
+     * @brief A stored message's text: inline if short, else a view of the arena
+     *
+     * Copies of a spilled Text point at the same bytes, which belong to the
+     * history and stay valid while the entry is neither changed nor dropped.
+     */
+    class Text {
+    public:
+        static const size_t INLINE_CAPACITY = 54;
+
+        Text();
+
+        const char* data() const;
+        size_t size() const;
+        bool empty() const;
+
+        /**
+         * @brief Check whether the text is stored inside its slot
+         * @return False if it spilled to the overflow arena
+         */
+        bool isInline() const;
+
+        /**
+         * @brief Check whether the text begins with a prefix
+         * @param prefix Text to look for
+         * @return True if the text starts with prefix
+         */
+        bool startsWith(const std::string& prefix) const;
+
+        /**
+         * @brief Copy the text into a string
+         * @return The text
+         */
+        std::string str() const;
+
+        /**
+         * @brief Copy the text into a string, for callers that need one
+         */
+        operator std::string() const;
+
+        bool operator==(const Text& other) const;
+        bool operator!=(const Text& other) const;
+        bool operator==(const std::string& other) const;
+        bool operator!=(const std::string& other) const;
+
+    private:
+        friend class ChatHistory;
+
+        static const unsigned char SPILLED = 0xFF;
+
+        char bytes[INLINE_CAPACITY];    ///< The text, or its pointer, size and chunk when spilled
+        unsigned char length;           ///< Inline length, or SPILLED
+
+        void setInline(const char* source, size_t count);
+        void setSpilled(const char* source, size_t count, uint64_t chunk);
+        uint64_t getChunk() const;
+    };
+
+    /**
+     * @brief One stored message, exactly one cache line
+     */
+    struct Entry {
+        MessageId id;
+        Text text;
+        bool tombstoned;
+    };
+
+    /**
+     * @brief The parts of a compressed segment that only change when it is resealed
+     * 
+     * Lets a journal checkpoint a segment once and bring it back without
+     * decompressing it. Every seal gives the segment a serial that is
+     * unique in the process, so an image with a given serial never
+     * changes. Tombstone flags and trimming change in place, so they are
+     * not part of the image.
+     */
+    struct SegmentImage {
+        uint64_t serial;
+        MessageId firstId;
+        MessageId lastId;
+        size_t count;
+        std::vector<MessageId> ids;         ///< Empty when ids run firstId..lastId
+        std::vector<bool> erased;
+        size_t rawBytes;
+        std::string data;
+    };
+
+    /**
+     * @brief Forward iterator over the text of live messages
+     */
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Text value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Text* pointer;
+        typedef const Text& reference;
+
+        const_iterator(const ChatHistory* history, size_t index);
+
+        reference operator*() const;
+        pointer operator->() const;
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator& other) const;
+        bool operator!=(const const_iterator& other) const;
+
+        /**
+         * @brief Get the id of the current message
+         * @return Message id
+         */
+        MessageId id() const;
+
+    private:
+        const ChatHistory* history;
+        size_t index;
+        size_t stored;
+
+        void skipTombstones();
+    };
+
+    ChatHistory();
+
+    /**
+     * @brief Destructor - frees the overflow arena
+     */
+    ~ChatHistory();
+
+    ChatHistory(const ChatHistory& other);
+    ChatHistory& operator=(const ChatHistory& other);
+
+    /**
+     * @brief Append a message
+     * @param text The formatted message
+     * @return The new message's id
+     */
+    MessageId append(const std::string& text);
+
+    /**
+     * @brief Mark a message as removed
+     * @param id The message id
+     * @return True if the message was live
+     */
+    bool tombstone(MessageId id);
+
+    /**
+     * @brief Bring back a tombstoned message
+     * @param id The message id
+     * @return True if the message was a tombstone
+     */
+    bool restore(MessageId id);
+
+    /**
+     * @brief Replace a live message's text in place
+     * @param id The message id
+     * @param text The new formatted message
+     * @return True if the message was live
+     */
+    bool edit(MessageId id, const std::string& text);
+
+    /**
+     * @brief Delete a message for good, leaving an empty tombstone
+     * 
+     * Unlike tombstone(), the text is freed and the message cannot be
+     * restored.
+     * 
+     * @param id The message id
+     * @return True if the message was stored and not already deleted
+     */
+    bool erase(MessageId id);
+
+    /**
+     * @brief Drop every tombstone, keeping live messages in order
+     * 
+     * This is the only operation that moves entries. Ids are unchanged, and
+     * later lookups fall back to binary search. Tombstones that were
+     * compacted away can no longer be restored.
+     * 
+     * @return Number of tombstones dropped
+     */
+    size_t compact();
+
+    /**
+     * @brief Find a stored entry by id
+     * @param id The message id
+     * @return The entry, live or tombstoned, or nullptr if it is not stored
+     */
+    const Entry* find(MessageId id) const;
+
+    /**
+     * @brief Drop the oldest entries until at most limit live messages remain
+     * @param limit Live messages to keep
+     */
+    void trimTo(size_t limit);
+
+    /**
+     * @brief Remove every entry; ids keep counting up
+     */
+    void clear();
+
+    /**
+     * @brief Re-create a stored entry, used when restoring from a snapshot
+     * 
+     * Entries must be restored in increasing id order.
+     * 
+     * @param id The entry's original id
+     * @param text The formatted message
+     * @param tombstoned Whether the entry was a tombstone
+     * @return False if id is not above every stored id
+     */
+    bool restoreEntry(MessageId id, const std::string& text, bool tombstoned);
+
+    /**
+     * @brief Get the number of live messages
+     * @return Live message count
+     */
+    size_t size() const;
+
+    /**
+     * @brief Check whether there are no live messages
+     * @return True if every entry is a tombstone or there are none
+     */
+    bool empty() const;
+
+    /**
+     * @brief Get the oldest live message
+     * @return The message text; the history must not be empty
+     */
+    const Text& front() const;
+
+    /**
+     * @brief Get the newest live message
+     * @return The message text; the history must not be empty
+     */
+    const Text& back() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /**
+     * @brief Re-create a compressed segment from its image, used when restoring from a snapshot
+     * 
+     * Segments must be restored oldest first and before any entry. The
+     * segment gets a new serial.
+     * 
+     * @param image The segment's image
+     * @param skipped Leading entries already trimmed; only the first segment may have any
+     * @param tombstoned The segment's tombstone flags, skipped entries included
+     * @return False if the image does not fit after the stored entries
+     */
+    bool restoreSegment(const SegmentImage& image, size_t skipped, const std::vector<bool>& tombstoned);
+
+    /**
+     * @brief Get the number of stored entries, tombstones included
+     * @return Stored entry count
+     */
+    size_t getStoredCount() const;
+
+    /**
+     * @brief Get the number of tombstones
+     * @return Tombstone count
+     */
+    size_t getTombstoneCount() const;
+
+    /**
+     * @brief Get a stored entry by position, tombstones included
+     * @param index Position in [0, getStoredCount())
+     * @return The entry
+     */
+    const Entry& getEntry(size_t index) const;
+
+    /**
+     * @brief Get the id of the oldest stored entry, without decompressing anything
+     * @return First id, or 0 if nothing is stored
+     */
+    MessageId getFirstId() const;
+
+    /**
+     * @brief Get the id of the newest stored entry
+     * @return Last id, or 0 if nothing is stored
+     */
+    MessageId getLastId() const;
+
+    /**
+     * @brief Get the id the next append will use
+     * @return Next id
+     */
+    MessageId getNextId() const;
+
+    /**
+     * @brief Set the id the next append will use
+     * @param id Next id; ignored if not above every stored id
+     */
+    void setNextId(MessageId id);
+
+    /**
+     * @brief Compress cold history in segments of this many entries
+     * 
+     * Enabling it on a long history compresses the cold part right away.
+     * Setting 0 stops compressing new entries; existing segments stay.
+     * 
+     * @param entries Entries per segment, or 0 to keep all text raw
+     */
+    void setSegmentSize(size_t entries);
+
+    /**
+     * @brief Get the compression segment size
+     * @return Entries per segment, or 0 if compression is off
+     */
+    size_t getSegmentSize() const;
+
+    /**
+     * @brief Get the number of compressed segments
+     * @return Segment count
+     */
+    size_t getSegmentCount() const;
+
+    /**
+     * @brief Get the number of stored entries held in segments
+     * @return Cold entries, tombstones included; they come before every hot entry
+     */
+    size_t getColdCount() const;
+
+    /**
+     * @brief Get the serial of a segment's current image
+     * @param segment Segment position, oldest first
+     * @return The serial, which changes whenever the segment is resealed
+     */
+    uint64_t getSegmentSerial(size_t segment) const;
+
+    /**
+     * @brief Copy a segment's image without decompressing it
+     * @param segment Segment position, oldest first
+     * @param image Filled with the segment's image
+     */
+    void getSegmentImage(size_t segment, SegmentImage& image) const;
+
+    /**
+     * @brief Get the number of leading entries of a segment that were trimmed
+     * @param segment Segment position, oldest first
+     * @return Skipped entry count
+     */
+    size_t getSegmentSkipped(size_t segment) const;
+
+    /**
+     * @brief Get a segment's tombstone flags
+     * @param segment Segment position, oldest first
+     * @return One flag per entry, skipped entries included
+     */
+    const std::vector<bool>& getSegmentTombstones(size_t segment) const;
+
+    /**
+     * @brief Get the uncompressed size of the text held in segments
+     * @return Bytes before compression
+     */
+    size_t getColdRawBytes() const;
+
+    /**
+     * @brief Get the compressed size of the text held in segments
+     * @return Bytes after compression
+     */
+    size_t getColdCompressedBytes() const;
+
+    /**
+     * @brief Get the number of hot texts too long to store inline
+     * @return Spilled entry count
+     */
+    size_t getSpilledCount() const;
+
+    /**
+     * @brief Get the memory held by the overflow arena
+     * @return Bytes in allocated chunks
+     */
+    size_t getOverflowBytes() const;
+
+    /**
+     * @brief Compare live and tombstoned entries, ids included
+     */
+    bool operator==(const ChatHistory& other) const;
+    bool operator!=(const ChatHistory& other) const;
+
+private:
+    /**
+     * @brief Allocator giving the hot deque's blocks cache-line alignment
+     */
+    template <typename T>
+    struct SlotAllocator {
+        typedef T value_type;
+
+        SlotAllocator() {}
+        template <typename U>
+        SlotAllocator(const SlotAllocator<U>&) {}
+
+        T* allocate(size_t count) {
+            // Over-allocate and align by hand; posix_memalign is several
+            // times slower than malloc for blocks this small
+            char* raw = static_cast<char*>(malloc(count * sizeof(T) + 64));
+            if (raw == nullptr) {
+                throw std::bad_alloc();
+            }
+            char* aligned = raw + 64 - (reinterpret_cast<uintptr_t>(raw) & 63);
+            memcpy(aligned - sizeof(char*), &raw, sizeof(char*));
+            return reinterpret_cast<T*>(aligned);
+        }
+
+        void deallocate(T* memory, size_t) {
+            char* raw;
+            memcpy(&raw, reinterpret_cast<char*>(memory) - sizeof(char*), sizeof(char*));
+            free(raw);
+        }
+
+        template <typename U>
+        struct rebind {
+            typedef SlotAllocator<U> other;
+        };
+
+        template <typename U>
+        bool operator==(const SlotAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const SlotAllocator<U>&) const { return false; }
+    };
+
+    /**
+     * @brief A block of the overflow arena, bump-allocated and freed once empty
+     */
+    struct Chunk {
+        char* data;
+        size_t capacity;
+        size_t used;
+        size_t live;                        ///< Bytes still referenced by entries
+    };
+
+    /**
+     * @brief A compressed run of the oldest entries
+     * 
+     * The first skipped entries were trimmed away but stay in the
+     * compressed text until the whole segment is dropped.
+     */
+    struct Segment {
+        uint64_t serial;
+        MessageId firstId;
+        MessageId lastId;
+        std::vector<MessageId> ids;         ///< Empty when ids run firstId..lastId
+        std::vector<bool> tombstoned;
+        std::vector<bool> erased;           ///< Tombstones with no text to restore
+        size_t count;
+        size_t skipped;
+        size_t tombstones;                  ///< Among entries not skipped
+        size_t rawBytes;
+        std::string data;                   ///< Length-prefixed texts, LzCodec block
+    };
+
+    std::vector<Segment> segments;          ///< Oldest first
+    std::vector<size_t> segmentEnds;        ///< Running entry counts, skipped entries included
+    size_t coldCount;                       ///< Entries held in segments, skipped excluded
+    std::deque<Entry, SlotAllocator<Entry> > entries;  ///< Hot entries, newer than every segment
+    MessageId nextId;
+    size_t tombstones;
+    size_t segmentSize;
+
+    mutable size_t cachedSegment;           ///< Segment decoded into cache, or npos
+    mutable std::vector<Entry> cache;       ///< Long texts point into cacheRaw
+    mutable std::string cacheRaw;
+    std::deque<Chunk> chunks;               ///< Overflow arena, oldest first
+    uint64_t firstChunk;                    ///< Sequence number of chunks.front()
+    size_t spilledCount;
+
+    void storeText(Text& target, const char* source, size_t count);
+    void releaseText(const Text& text);
+    void releaseChunks();
+    void copyFrom(const ChatHistory& other);
+
+    Entry* findEntry(MessageId id, size_t& segment);
+    Entry* findColdEntry(MessageId id, size_t& segment);
+    bool locateCold(MessageId id, size_t& segment, size_t& index) const;
+    const Entry& coldEntry(size_t index) const;
+    void decodeSegment(size_t segment) const;
+    void encodeSegment(Segment& segment, const Entry* first, size_t count);
+    bool setColdFlag(size_t segment, size_t index, bool tombstoned);
+    void resealSegment(size_t segment);
+    void sealCold();
+    void skipFrontEntry();
+    void dropFrontSegment();
+    void rebuildSegmentEnds();
+    size_t compactCold();
+};
+
+/**
+ * @brief Write a history text to a stream
+ */
+std::ostream& operator<<(std::ostream& out, const ChatHistory::Text& text);
+
+#endif
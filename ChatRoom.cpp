@@ -6,44 +6,287 @@
 #include "ChatIterator.h"      
 #include "UserIterator.h"  
 #include "MessageIterator.h"
+#include "MessageFilter.h"
+#include "FloodGuard.h"
+#include "CommandJournal.h"
+#include "PresenceAggregator.h"
+#include "BumpArena.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
 
-ChatRoom::ChatRoom() : chatHistory(), roomName("DefaultRoom") {
+namespace {
+
+std::atomic<size_t> liveRooms(0);
+
+}
+
+ChatRoom::ChatRoom() : deliverySequence(0), chatHistory(), roomName("DefaultRoom"), messageFilter(nullptr),
+                       floodGuard(nullptr), journal(nullptr), presence(nullptr), undoLimit(0),
+      compactionRatio(0.25), compactionMinimum(1024), firstAuthored(0) {
+    liveRooms.fetch_add(1, std::memory_order_relaxed);
+}
+
+ChatRoom::ChatRoom(const std::string& name) : deliverySequence(0), chatHistory(), roomName(name), messageFilter(nullptr),
+                                              floodGuard(nullptr), journal(nullptr), presence(nullptr), undoLimit(0),
+      compactionRatio(0.25), compactionMinimum(1024), firstAuthored(0) {
+    policy.setName(name);
+    liveRooms.fetch_add(1, std::memory_order_relaxed);
+}
+
+ChatRoom::ChatRoom(const RoomPolicy& roomPolicy) : deliverySequence(0), chatHistory(), roomName(roomPolicy.getName()),
+                                                   policy(roomPolicy), messageFilter(nullptr),
+                                                   floodGuard(nullptr), journal(nullptr), presence(nullptr), undoLimit(0),
+      compactionRatio(0.25), compactionMinimum(1024), firstAuthored(0) {
+    if (!policy.getCreatedBanner().empty()) {
+        std::cout << policy.getCreatedBanner().render("", roomName, 0) << std::endl;
+    }
+    liveRooms.fetch_add(1, std::memory_order_relaxed);
 }
 
 ChatRoom::~ChatRoom() {
+    if (!policy.getDestroyedBanner().empty()) {
+        std::cout << policy.getDestroyedBanner().render("", roomName, users.size()) << std::endl;
+    }
+
     for (auto* command : commandQueue) {
         delete command;
     }
     commandQueue.clear();
+
+    delete floodGuard;
+
+    clearStack(undoStack);
+    clearStack(redoStack);
     
-    users.clear();
+    if (presence != nullptr) {
+        presence->forget(this);
+    }
+
+    for (User* user : users) {
+        user->detachChatRoom(this);
+    }
+    clearMembers();
     //observers.clear();
+    liveRooms.fetch_sub(1, std::memory_order_relaxed);
 }
 
-void ChatRoom::registerUser(User* user) {
-    if (user != nullptr) {
-        for (const auto& existingUser : users) {
-            if (existingUser == user) {
-                return;
-            }
-        }
-        users.push_back(user);
-        
-        notifyObservers("USER_JOINED", "User joined the chat room");
+bool ChatRoom::registerUser(User* user) {
+    if (user == nullptr) {
+        std::cerr << "Error: Cannot register null user in " << roomName << std::endl;
+        return false;
+    }
+
+    if (memberIndex.count(user) != 0) {
+        std::cerr << "User " << user->getName() << " is already registered in " << roomName << std::endl;
+        return false;
+    }
+
+    if (policy.getMaxUsers() != 0 && users.size() >= policy.getMaxUsers()) {
+        std::cerr << "Error: " << roomName << " is full (" << policy.getMaxUsers() << " users)" << std::endl;
+        return false;
+    }
+
+    addMember(user);
+
+    if (journal != nullptr) {
+        journal->appendJoin(user->getId(), user->getName());
+        snapshotIfDue();
+    }
+
+    if (!policy.getJoinGreeting().empty()) {
+        std::cout << policy.getJoinGreeting().render(user->getName(), roomName, users.size()) << std::endl;
+    }
+
+    notifyObservers("USER_JOINED", user->getName());
+
+    if (!policy.getMemberCount().empty()) {
+        std::cout << policy.getMemberCount().render(user->getName(), roomName, users.size()) << std::endl;
     }
+    return true;
 }
 
 void ChatRoom::removeUser(User* user) {
-    if (user != nullptr) {
-        for (auto it = users.begin(); it != users.end(); ++it) {
-            if (*it == user) {
-                users.erase(it);
-                
-                notifyObservers("USER_LEFT", "User left the chat room");
-                break;
+    if (user == nullptr) {
+        std::cerr << "Error: Cannot remove null user from " << roomName << std::endl;
+        return;
+    }
+
+    auto found = memberIndex.find(user);
+    if (found == memberIndex.end()) {
+        std::cerr << "User " << user->getName() << " is not in " << roomName << " room" << std::endl;
+        return;
+    }
+    removeMemberAt(found->second);
+    forgetMember(user);
+
+    if (journal != nullptr) {
+        journal->appendLeave(user->getId());
+        snapshotIfDue();
+    }
+
+    if (!policy.getLeaveFarewell().empty()) {
+        std::cout << policy.getLeaveFarewell().render(user->getName(), roomName, users.size()) << std::endl;
+    }
+
+    notifyObservers("USER_LEFT", user->getName());
+
+    if (!policy.getMemberCount().empty()) {
+        std::cout << policy.getMemberCount().render(user->getName(), roomName, users.size()) << std::endl;
+    }
+}
+
+size_t ChatRoom::joinUsers(const std::vector<User*>& newcomers) {
+    std::vector<User*> admitted;
+    admitted.reserve(newcomers.size());
+    std::unordered_set<User*> seen;
+    size_t refused = 0;
+    for (User* user : newcomers) {
+        if (user == nullptr || memberIndex.count(user) != 0 || !seen.insert(user).second) {
+            continue;
+        }
+        if (policy.getMaxUsers() != 0 && users.size() + admitted.size() >= policy.getMaxUsers()) {
+            refused++;
+            continue;
+        }
+        admitted.push_back(user);
+    }
+    if (refused != 0) {
+        std::cerr << "Error: " << roomName << " is full (" << policy.getMaxUsers() << " users), turned away "
+                  << refused << " users" << std::endl;
+    }
+    if (admitted.empty()) {
+        return 0;
+    }
+
+    users.reserve(users.size() + admitted.size());
+    memberOnline.reserve(users.size() + admitted.size());
+    memberDelivered.reserve(users.size() + admitted.size());
+    for (User* user : admitted) {
+        addMember(user);
+        user->attachChatRoom(this);
+        if (journal != nullptr) {
+            journal->appendJoin(user->getId(), user->getName());
+        }
+    }
+    if (journal != nullptr) {
+        snapshotIfDue();
+    }
+
+    std::string names;
+    for (User* user : admitted) {
+        appendName(names, user->getName());
+    }
+    notifyObservers("USERS_JOINED", names);
+
+    for (User* user : admitted) {
+        if (observerIndex.count(user) == 0) {
+            observerIndex[user] = observers.size();
+            observers.push_back(user);
+        }
+    }
+    return admitted.size();
+}
+
+size_t ChatRoom::leaveUsers(const std::vector<User*>& leavers) {
+    std::unordered_set<User*> leaving;
+    for (User* user : leavers) {
+        if (user != nullptr && memberIndex.count(user) != 0) {
+            leaving.insert(user);
+        }
+    }
+    if (leaving.empty()) {
+        return 0;
+    }
+
+    // Compact every member array in one pass, keeping join order
+    std::string names;
+    size_t kept = 0;
+    for (size_t i = 0; i < users.size(); ++i) {
+        User* user = users[i];
+        if (leaving.count(user) != 0) {
+            appendName(names, user->getName());
+            memberIndex.erase(user);
+            user->detachChatRoom(this);
+            forgetMember(user);
+            if (journal != nullptr) {
+                journal->appendLeave(user->getId());
             }
+            continue;
         }
+        users[kept] = user;
+        memberOnline[kept] = memberOnline[i];
+        memberDelivered[kept] = memberDelivered[i];
+        memberIndex[user] = kept;
+        kept++;
+    }
+    users.resize(kept);
+    memberOnline.resize(kept);
+    memberDelivered.resize(kept);
+    if (journal != nullptr) {
+        snapshotIfDue();
     }
+
+    std::unordered_set<NotificationObserver*> departing(leaving.begin(), leaving.end());
+    observers.erase(std::remove_if(observers.begin(), observers.end(),
+                                   [&departing](NotificationObserver* observer) { return departing.count(observer) != 0; }),
+                    observers.end());
+    rebuildObserverIndex();
+
+    notifyObservers("USERS_LEFT", names);
+    return leaving.size();
+}
+
+void ChatRoom::detachUser(User* user) {
+    dropObserver(user);
+    auto found = memberIndex.find(user);
+    if (found == memberIndex.end()) {
+        return;
+    }
+    size_t slot = found->second;
+    memberIndex.erase(found);
+    size_t last = users.size() - 1;
+    if (slot != last) {
+        users[slot] = users[last];
+        memberOnline[slot] = memberOnline[last];
+        memberDelivered[slot] = memberDelivered[last];
+        memberIndex[users[slot]] = slot;
+    }
+    users.pop_back();
+    memberOnline.pop_back();
+    memberDelivered.pop_back();
+    forgetMember(user);
+
+    if (journal != nullptr) {
+        journal->appendLeave(user->getId());
+        snapshotIfDue();
+    }
+}
+
+void ChatRoom::addMember(User* user) {
+    memberIndex[user] = users.size();
+    users.push_back(user);
+    memberOnline.push_back(user->getOnlineStatus() ? 1 : 0);
+    memberDelivered.push_back(0);
+}
+
+void ChatRoom::removeMemberAt(size_t slot) {
+    memberIndex.erase(users[slot]);
+    users.erase(users.begin() + slot);
+    memberOnline.erase(memberOnline.begin() + slot);
+    memberDelivered.erase(memberDelivered.begin() + slot);
+    for (size_t i = slot; i < users.size(); ++i) {
+        memberIndex[users[i]] = i;
+    }
+}
+
+void ChatRoom::clearMembers() {
+    users.clear();
+    memberOnline.clear();
+    memberDelivered.clear();
+    memberIndex.clear();
 }
 
 User* ChatRoom::getUser(const std::string& name) {
@@ -57,16 +300,108 @@ User* ChatRoom::getUser(const std::string& name) {
 
 void ChatRoom::sendMessage(const std::string& message, User* fromUser) {
     if (fromUser != nullptr && !message.empty()) {
-        saveMessage(message, fromUser);
-        
-       for (auto* user : users) {
-            if (user != fromUser) {
-                user->receiveMessage(message, fromUser);
+        sendMessage(Message::create(fromUser, message, BumpArena::local()), fromUser);
+    }
+}
+
+void ChatRoom::sendMessage(const MessagePtr& message, User* fromUser) {
+    if (fromUser != nullptr && message && !message->empty()) {
+        METRICS_TIMER(SEND_LATENCY_NS);
+        TRACE_SPAN("ChatRoom::sendMessage");
+
+        MessagePtr text = screenMessage(message, fromUser);
+        if (text) {
+            deliverMessage(*text, fromUser);
+        }
+    }
+}
+
+MessagePtr ChatRoom::screenMessage(const MessagePtr& message, User* fromUser) {
+    if (floodGuard != nullptr && floodGuard->check(fromUser, *message) != FloodGuard::ALLOWED) {
+        METRICS_INCREMENT(MESSAGES_THROTTLED);
+        notifyObservers("MESSAGE_THROTTLED", fromUser->getName());
+        return MessagePtr();
+    }
+
+    if (messageFilter != nullptr) {
+        TRACE_SPAN("ChatRoom::filter");
+        MessageFilter::Verdict verdict = messageFilter->scan(message->data(), message->size());
+        if (verdict.categories != 0) {
+            if (verdict.categories & MessageFilter::KEYWORD_ALERT) {
+                notifyObservers("KEYWORD_ALERT", verdict.alertKeyword);
+            }
+            if (verdict.blocked()) {
+                METRICS_INCREMENT(MESSAGES_BLOCKED);
+                notifyObservers("MESSAGE_BLOCKED", fromUser->getName());
+                return MessagePtr();
+            }
+            if (verdict.categories & MessageFilter::PROFANITY) {
+                return Message::create(fromUser, messageFilter->mask(message->data(), message->size()),
+                                       BumpArena::local());
+            }
+        }
+    }
+
+    return message;
+}
+
+void ChatRoom::deliverMessage(const Message& message, User* fromUser) {
+    {
+        TRACE_SPAN("ChatRoom::saveMessage");
+        Message::format(historyLine, fromUser->getName(), message.data(), message.size());
+        appendHistory(historyLine, fromUser);
+    }
+    if (journal != nullptr) {
+        journal->appendSend(fromUser->getId(), fromUser->getName(), message.data(), message.size());
+        snapshotIfDue();
+    }
+
+    size_t delivered = 0;
+    {
+        TRACE_SPAN("ChatRoom::fanOut");
+        unsigned long sequence = ++deliverySequence;
+        for (size_t i = 0; i < users.size(); ++i) {
+            if (memberOnline[i] && users[i] != fromUser) {
+                users[i]->receiveMessage(message, fromUser, this);
+                memberDelivered[i] = sequence;
+                delivered++;
+            }
+        }
+    }
+    METRICS_INCREMENT(MESSAGES_SENT);
+    METRICS_ADD(DELIVERIES, delivered);
+    METRICS_RECORD(FANOUT_SIZE, delivered);
+    (void)delivered;
+
+    notifyMessageSent(message);
+}
+
+size_t ChatRoom::deliverBroadcast(const Message& message, const std::string& formattedMessage,
+                                  User* fromUser, uint64_t generation) {
+    appendHistory(formattedMessage, fromUser);
+    if (journal != nullptr) {
+        journal->appendSend(fromUser->getId(), fromUser->getName(), message.data(), message.size());
+        snapshotIfDue();
+    }
+
+    size_t delivered = 0;
+    {
+        TRACE_SPAN("ChatRoom::fanOut");
+        unsigned long sequence = ++deliverySequence;
+        for (size_t i = 0; i < users.size(); ++i) {
+            if (memberOnline[i] && users[i] != fromUser && users[i]->claimDelivery(generation)) {
+                users[i]->receiveMessage(message, fromUser, this);
+                memberDelivered[i] = sequence;
+                delivered++;
             }
         }
-        
-        notifyObservers("MESSAGE_SENT", message);
     }
+    METRICS_INCREMENT(MESSAGES_SENT);
+    METRICS_ADD(DELIVERIES, delivered);
+    METRICS_RECORD(FANOUT_SIZE, delivered);
+
+    notifyMessageSent(message);
+    return delivered;
 }
 
 void ChatRoom::receiveMessage(const std::string& message, User* fromUser) {
@@ -75,11 +410,49 @@ void ChatRoom::receiveMessage(const std::string& message, User* fromUser) {
 
 void ChatRoom::saveMessage(const std::string& message, User* fromUser) {
     if (fromUser != nullptr && !message.empty()) {
-        std::string formattedMessage = "[" + fromUser->getName() + "]: " + message + "\n";
-        chatHistory.push_back(formattedMessage);
+        TRACE_SPAN("ChatRoom::saveMessage");
+        Message::format(historyLine, fromUser->getName(), message);
+        appendHistory(historyLine, fromUser);
+    }
+}
+
+void ChatRoom::snapshotIfDue() {
+    if (journal->snapshotDue()) {
+        journal->appendSnapshot(*this);
     }
 }
 
+ChatHistory::MessageId ChatRoom::appendHistory(const std::string& formattedMessage, const User* author) {
+    if (policy.getHistoryLimit() != 0 && chatHistory.size() >= policy.getHistoryLimit()) {
+        chatHistory.trimTo(policy.getHistoryLimit() - 1);
+        dropUnredoable();
+    }
+    ChatHistory::MessageId id = chatHistory.append(formattedMessage);
+
+    // Forget the senders of entries that have been trimmed or compacted away
+    ChatHistory::MessageId first = chatHistory.getFirstId();
+    if (authors.empty() || first >= firstAuthored + authors.size()) {
+        authors.clear();
+        firstAuthored = first;
+    }
+    while (firstAuthored < first) {
+        authors.pop_front();
+        firstAuthored++;
+    }
+    authors.resize(id - firstAuthored, 0);
+    authors.push_back(author->getId());
+    METRICS_INCREMENT(MESSAGES_SAVED);
+    METRICS_RECORD(HISTORY_SIZE, chatHistory.size());
+    return id;
+}
+
+uint64_t ChatRoom::getAuthor(ChatHistory::MessageId id) const {
+    if (id < firstAuthored || id - firstAuthored >= authors.size()) {
+        return 0;
+    }
+    return authors[id - firstAuthored];
+}
+
 UserIterator* ChatRoom::createUserIterator() {
     return new UserIterator(users);
 }
@@ -88,7 +461,14 @@ MessageIterator* ChatRoom::createMessageIterator() {
     return new MessageIterator(chatHistory);
 }
 
+MessageIterator* ChatRoom::createMessageIterator(bool includeTombstones) {
+    return new MessageIterator(chatHistory, includeTombstones);
+}
+
 void ChatRoom::notifyObservers(const std::string& event, const std::string& data) {
+    METRICS_TIMER(NOTIFY_LATENCY_NS);
+    TRACE_SPAN("ChatRoom::notifyObservers");
+    METRICS_ADD(NOTIFICATIONS, observers.size());
     for (auto* observer : observers) {
         if (observer != nullptr) {
             observer->update(event, data, this);
@@ -96,6 +476,17 @@ void ChatRoom::notifyObservers(const std::string& event, const std::string& data
     }
 }
 
+void ChatRoom::notifyMessageSent(const Message& message) {
+    METRICS_TIMER(NOTIFY_LATENCY_NS);
+    TRACE_SPAN("ChatRoom::notifyObservers");
+    METRICS_ADD(NOTIFICATIONS, observers.size());
+    for (auto* observer : observers) {
+        if (observer != nullptr) {
+            observer->messageSent(message, this);
+        }
+    }
+}
+
 void ChatRoom::addCommand(Command* command) {
     if (command != nullptr) {
         commandQueue.push_back(command);
@@ -103,13 +494,21 @@ void ChatRoom::addCommand(Command* command) {
 }
 
 void ChatRoom::executeAll() {
+    METRICS_TIMER(EXECUTE_ALL_LATENCY_NS);
+    TRACE_SPAN("ChatRoom::executeAll");
+    METRICS_RECORD(COMMAND_QUEUE_DEPTH, commandQueue.size());
+    METRICS_ADD(COMMANDS_EXECUTED, commandQueue.size());
     for (auto* command : commandQueue) {
         if (command != nullptr) {
             command->execute();
         }
     }
     
+    // Undoable commands are handed to their room's undo stack instead
     for (auto* command : commandQueue) {
+        if (command != nullptr && command->getRoom() != nullptr && command->getRoom()->retainForUndo(command)) {
+            continue;
+        }
         delete command;
     }
     commandQueue.clear();
@@ -120,18 +519,33 @@ bool ChatRoom::hasUser(User* user) const {
         return false;
     }
     
-    for (const User* u : users) {
-        if (u == user) {
-            return true;
-        }
-    }
-    return false;
+    return memberIndex.count(user) != 0;
 }
 
 int ChatRoom::getUserCount() const {
     return static_cast<int>(users.size());
 }
 
+void ChatRoom::setMemberOnline(User* user, bool online) {
+    auto found = memberIndex.find(user);
+    if (found != memberIndex.end()) {
+        memberOnline[found->second] = online ? 1 : 0;
+    }
+}
+
+unsigned long ChatRoom::getDeliveredSequence(User* user) const {
+    auto found = memberIndex.find(user);
+    return found != memberIndex.end() ? memberDelivered[found->second] : 0;
+}
+
+unsigned long ChatRoom::getDeliverySequence() const {
+    return deliverySequence;
+}
+
+size_t ChatRoom::getLiveCount() {
+    return liveRooms.load(std::memory_order_relaxed);
+}
+
 const std::vector<NotificationObserver*>& ChatRoom::getObservers() const {
     return observers;
 }
@@ -140,7 +554,7 @@ const std::vector<User*>& ChatRoom::getUsers() const {
     return users;
 }
 
-const std::vector<std::string>& ChatRoom::getChatHistory() const {
+const ChatHistory& ChatRoom::getChatHistory() const {
     return chatHistory;
 }
 
@@ -148,7 +562,358 @@ std::string ChatRoom::getName() const {
     return roomName;
 }
 
+const RoomPolicy& ChatRoom::getPolicy() const {
+    return policy;
+}
+
+void ChatRoom::setMessageFilter(MessageFilter* filter) {
+    messageFilter = filter;
+}
+
+MessageFilter* ChatRoom::getMessageFilter() const {
+    return messageFilter;
+}
+
+void ChatRoom::enableFloodGuard(double messagesPerSecond, unsigned int burst) {
+    delete floodGuard;
+    floodGuard = new FloodGuard(messagesPerSecond, burst);
+}
+
+void ChatRoom::disableFloodGuard() {
+    delete floodGuard;
+    floodGuard = nullptr;
+}
+
+const FloodGuard* ChatRoom::getFloodGuard() const {
+    return floodGuard;
+}
+
 void ChatRoom::clearChatHistory() {
     chatHistory.clear();
+    authors.clear();
+    if (journal != nullptr) {
+        journal->appendClear();
+        snapshotIfDue();
+    }
     std::cout << "[" << roomName << "] Chat history cleared" << std::endl;
-}
\ No newline at end of file
+}
+
+void ChatRoom::setJournal(CommandJournal* commandJournal) {
+    journal = commandJournal;
+    if (journal != nullptr) {
+        // Snapshots only skip history that is held in segments
+        if (journal->getSnapshotInterval() != 0 && chatHistory.getSegmentSize() == 0) {
+            chatHistory.setSegmentSize(CommandJournal::SEGMENT_SIZE);
+        }
+        journal->appendSnapshot(*this);
+    }
+}
+
+CommandJournal* ChatRoom::getJournal() const {
+    return journal;
+}
+
+void ChatRoom::setPresenceAggregator(PresenceAggregator* aggregator) {
+    if (presence == aggregator) {
+        return;
+    }
+    if (presence != nullptr) {
+        presence->flush();
+        presence->forget(this);
+    }
+    presence = aggregator;
+    if (presence != nullptr) {
+        presence->attach(this);
+    }
+}
+
+void ChatRoom::detachPresenceAggregator() {
+    presence = nullptr;
+}
+
+PresenceAggregator* ChatRoom::getPresenceAggregator() const {
+    return presence;
+}
+
+void ChatRoom::restoreState(const std::vector<User*>& members, const ChatHistory& history,
+                            const std::map<ChatHistory::MessageId, uint64_t>& messageAuthors) {
+    // Sets instead of removeObserver()/addObserver(), which scan the
+    // observer list once per member
+    std::unordered_set<NotificationObserver*> former(users.begin(), users.end());
+    observers.erase(std::remove_if(observers.begin(), observers.end(),
+                                   [&former](NotificationObserver* observer) { return former.count(observer) != 0; }),
+                    observers.end());
+    for (auto* user : users) {
+        user->detachChatRoom(this);
+    }
+    clearMembers();
+
+    rebuildObserverIndex();
+    users.reserve(members.size());
+    memberOnline.reserve(members.size());
+    memberDelivered.reserve(members.size());
+    memberIndex.reserve(members.size());
+    for (auto* user : members) {
+        if (user != nullptr && !hasUser(user)) {
+            addMember(user);
+            if (observerIndex.count(user) == 0) {
+                observerIndex[user] = observers.size();
+                observers.push_back(user);
+            }
+            user->attachChatRoom(this);
+        }
+    }
+
+    // The commands refer to the history being replaced
+    clearStack(undoStack);
+    clearStack(redoStack);
+    size_t segmentSize = chatHistory.getSegmentSize();
+    chatHistory = history;
+    chatHistory.setSegmentSize(segmentSize);
+    authors.clear();
+    if (policy.getHistoryLimit() != 0) {
+        chatHistory.trimTo(policy.getHistoryLimit());
+    }
+    firstAuthored = chatHistory.getFirstId();
+    ChatHistory::MessageId last = chatHistory.getLastId();
+    for (auto it = messageAuthors.lower_bound(firstAuthored); it != messageAuthors.end() && it->first <= last; ++it) {
+        authors.resize(it->first - firstAuthored, 0);
+        authors.push_back(it->second);
+    }
+
+    if (journal != nullptr) {
+        journal->appendSnapshot(*this);
+    }
+}
+
+ChatHistory::MessageId ChatRoom::importMessage(ChatHistory::MessageId id, const std::string& formattedMessage,
+                                               bool tombstoned) {
+    if (id == 0 || id <= chatHistory.getLastId()) {
+        id = chatHistory.getNextId();
+    }
+    chatHistory.restoreEntry(id, formattedMessage, tombstoned);
+    if (policy.getHistoryLimit() != 0 && chatHistory.size() > policy.getHistoryLimit()) {
+        chatHistory.trimTo(policy.getHistoryLimit());
+        dropUnredoable();
+    }
+    return id;
+}
+
+void ChatRoom::finishImport(size_t imported) {
+    if (journal != nullptr) {
+        journal->appendSnapshot(*this);
+    }
+    notifyObservers("HISTORY_IMPORTED", std::to_string(imported));
+}
+
+bool ChatRoom::retractMessage(ChatHistory::MessageId id) {
+    if (!chatHistory.tombstone(id)) {
+        return false;
+    }
+    if (journal != nullptr) {
+        journal->appendTombstone(id);
+        snapshotIfDue();
+    }
+    notifyObservers("MESSAGE_RETRACTED", std::to_string(id));
+    compactIfDue();
+    return true;
+}
+
+bool ChatRoom::restoreMessage(ChatHistory::MessageId id) {
+    if (!chatHistory.restore(id)) {
+        return false;
+    }
+    if (journal != nullptr) {
+        journal->appendRestore(id);
+        snapshotIfDue();
+    }
+    notifyObservers("MESSAGE_RESTORED", std::to_string(id));
+    return true;
+}
+
+bool ChatRoom::editMessage(ChatHistory::MessageId id, const std::string& newMessage, User* editor) {
+    if (editor == nullptr || newMessage.empty()) {
+        return false;
+    }
+
+    const ChatHistory::Entry* entry = chatHistory.find(id);
+    if (entry == nullptr || entry->tombstoned) {
+        std::cerr << "Error: Message " << id << " does not exist in " << roomName << std::endl;
+        return false;
+    }
+    if (getAuthor(id) != editor->getId()) {
+        std::cerr << "Error: User " << editor->getName() << " cannot edit message " << id << std::endl;
+        return false;
+    }
+
+    MessagePtr text = screenMessage(Message::create(editor, newMessage, BumpArena::local()), editor);
+    if (!text) {
+        return false;
+    }
+
+    std::string formattedMessage = text->format();
+    chatHistory.edit(id, formattedMessage);
+    if (journal != nullptr) {
+        journal->appendEdit(id, formattedMessage);
+        snapshotIfDue();
+    }
+    notifyObservers("MESSAGE_EDITED", std::to_string(id));
+    return true;
+}
+
+bool ChatRoom::deleteMessage(ChatHistory::MessageId id, User* requester) {
+    if (requester == nullptr) {
+        return false;
+    }
+
+    const ChatHistory::Entry* entry = chatHistory.find(id);
+    if (entry == nullptr || entry->tombstoned) {
+        std::cerr << "Error: Message " << id << " does not exist in " << roomName << std::endl;
+        return false;
+    }
+    if (getAuthor(id) != requester->getId()) {
+        std::cerr << "Error: User " << requester->getName() << " cannot delete message " << id << std::endl;
+        return false;
+    }
+
+    chatHistory.erase(id);
+    if (journal != nullptr) {
+        journal->appendDelete(id);
+        snapshotIfDue();
+    }
+    notifyObservers("MESSAGE_DELETED", std::to_string(id));
+    compactIfDue();
+    return true;
+}
+
+void ChatRoom::setCompactionThreshold(double ratio, size_t minimum) {
+    compactionRatio = ratio;
+    compactionMinimum = minimum;
+}
+
+size_t ChatRoom::compactHistory() {
+    clearStack(redoStack);
+    size_t dropped = chatHistory.compact();
+    if (dropped != 0 && journal != nullptr) {
+        journal->appendCompact();
+        snapshotIfDue();
+    }
+    return dropped;
+}
+
+void ChatRoom::setHistorySegmentSize(size_t messages) {
+    chatHistory.setSegmentSize(messages);
+}
+
+void ChatRoom::compactIfDue() {
+    if (!redoStack.empty()) {
+        return;
+    }
+    size_t tombstones = chatHistory.getTombstoneCount();
+    if (compactionRatio > 0.0 && tombstones >= compactionMinimum &&
+        tombstones >= compactionRatio * chatHistory.getStoredCount() && chatHistory.compact() != 0 &&
+        journal != nullptr) {
+        journal->appendCompact();
+        snapshotIfDue();
+    }
+}
+
+void ChatRoom::setUndoLimit(size_t limit) {
+    undoLimit = limit;
+    while (undoStack.size() > undoLimit) {
+        delete undoStack.front();
+        undoStack.pop_front();
+    }
+    if (undoLimit == 0) {
+        clearStack(redoStack);
+    }
+}
+
+size_t ChatRoom::getUndoLimit() const {
+    return undoLimit;
+}
+
+bool ChatRoom::retainForUndo(Command* command) {
+    if (undoLimit == 0 || command == nullptr || !command->isUndoable()) {
+        return false;
+    }
+    if (undoStack.size() >= undoLimit) {
+        delete undoStack.front();
+        undoStack.pop_front();
+    }
+    undoStack.push_back(command);
+    clearStack(redoStack);
+    return true;
+}
+
+bool ChatRoom::undo() {
+    if (undoStack.empty()) {
+        return false;
+    }
+    Command* command = undoStack.back();
+    undoStack.pop_back();
+    // On the redo stack before undoing, so the retraction does not compact it away
+    redoStack.push_back(command);
+    command->undo();
+    return true;
+}
+
+bool ChatRoom::redo() {
+    if (redoStack.empty()) {
+        return false;
+    }
+    Command* command = redoStack.back();
+    redoStack.pop_back();
+    command->redo();
+    undoStack.push_back(command);
+    return true;
+}
+
+size_t ChatRoom::getUndoDepth() const {
+    return undoStack.size();
+}
+
+size_t ChatRoom::getRedoDepth() const {
+    return redoStack.size();
+}
+
+void ChatRoom::clearStack(std::deque<Command*>& stack) {
+    for (auto* command : stack) {
+        delete command;
+    }
+    stack.clear();
+}
+
+void ChatRoom::dropUnredoable() {
+    size_t kept = 0;
+    for (Command* command : redoStack) {
+        if (command->canRedo()) {
+            redoStack[kept++] = command;
+        } else {
+            delete command;
+        }
+    }
+    if (kept != redoStack.size()) {
+        std::cerr << "Error: " << redoStack.size() - kept << " undone message(s) in " << roomName
+                  << " passed the history limit and can no longer be redone" << std::endl;
+        redoStack.resize(kept);
+    }
+}
+
+void ChatRoom::forgetMember(User* user) {
+    if (floodGuard != nullptr) {
+        floodGuard->forget(user);
+    }
+    std::deque<Command*>* stacks[] = { &undoStack, &redoStack };
+    for (std::deque<Command*>* stack : stacks) {
+        size_t kept = 0;
+        for (Command* command : *stack) {
+            if (command->getUser() == user) {
+                delete command;
+            } else {
+                (*stack)[kept++] = command;
+            }
+        }
+        stack->resize(kept);
+    }
+}
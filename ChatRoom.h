@@ -12,10 +12,15 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <list>
 #include <iostream>
 #include "ChatAggregate.h"
 #include "NotificationSubject.h"
+#include "RoomPolicy.h"
+#include "ChatHistory.h"
+#include "Message.h"
+#include <deque>
 
 // Forward declarations
 class User;
@@ -23,6 +28,10 @@ class NotificationObserver;
 class UserIterator;
 class MessageIterator;
 class Command;
+class MessageFilter;
+class FloodGuard;
+class CommandJournal;
+class PresenceAggregator;
 
 /**
  * @brief ChatRoom class implementing chat room functionality with multiple design patterns
@@ -39,11 +48,119 @@ class Command;
 
 class ChatRoom : public ChatAggregate, public NotificationSubject {
   protected:
+        // Members in join order. memberOnline and memberDelivered run
+        // parallel to users, so fan-out scans contiguous arrays instead of
+        // reading each User; memberIndex maps a member to its slot.
         std::vector<User*> users;
-        std::vector<std::string> chatHistory;
+        std::vector<unsigned char> memberOnline;
+        std::vector<unsigned long> memberDelivered;
+        std::unordered_map<User*, size_t> memberIndex;
+        unsigned long deliverySequence;
+        ChatHistory chatHistory;
         //std::vector<NotificationObserver*> observers;
         std::vector<Command*> commandQueue;
         std::string roomName;
+        RoomPolicy policy;
+        MessageFilter* messageFilter;
+        FloodGuard* floodGuard;
+        CommandJournal* journal;
+        PresenceAggregator* presence;
+        std::deque<Command*> undoStack;
+        std::deque<Command*> redoStack;
+        size_t undoLimit;
+        double compactionRatio;
+        size_t compactionMinimum;
+        std::string historyLine;    ///< Reused by saveMessage() to format entries
+        // Sender of each message as User::getId(), so edits and deletes are
+        // authorized by identity rather than by the name in the text.
+        // authors[i] belongs to id firstAuthored + i; 0 means unknown.
+        std::deque<uint64_t> authors;
+        ChatHistory::MessageId firstAuthored;
+
+        /**
+         * @brief Save and fan out a message that has passed the content filter
+         * 
+         * The history entry is formatted from the message, and recipients
+         * and observers read the message itself, so its text is not copied.
+         * 
+         * @param message The (possibly masked) message
+         * @param fromUser Pointer to the user sending the message
+         */
+        void deliverMessage(const Message& message, User* fromUser);
+
+        /**
+         * @brief Hand a delivered message to every observer's messageSent()
+         * 
+         * @param message The delivered message
+         */
+        void notifyMessageSent(const Message& message);
+
+        /**
+         * @brief Append a member to every member array
+         * 
+         * @param user The new member, not already in the room
+         */
+        void addMember(User* user);
+
+        /**
+         * @brief Remove a member from every member array, keeping join order
+         * 
+         * @param slot The member's slot
+         */
+        void removeMemberAt(size_t slot);
+
+        /**
+         * @brief Empty every member array
+         */
+        void clearMembers();
+
+        /**
+         * @brief Append a formatted entry to the chat history
+         * 
+         * Drops the oldest entry first once the policy's history limit is
+         * reached, and records the sender for editMessage() and deleteMessage().
+         * 
+         * @param formattedMessage The entry, already in "[Username]: Message\n" form
+         * @param author The sender
+         * @return ChatHistory::MessageId The new entry's id
+         */
+        ChatHistory::MessageId appendHistory(const std::string& formattedMessage, const User* author);
+
+        /**
+         * @brief Compact the history if enough tombstones have built up
+         */
+        void compactIfDue();
+
+        /**
+         * @brief Delete every command on a stack
+         */
+        static void clearStack(std::deque<Command*>& stack);
+
+        /**
+         * @brief Delete the redo commands whose messages the history limit dropped
+         * 
+         * Trimming cannot keep an undone message without keeping everything
+         * after it, so the redo is given up instead and reported on std::cerr.
+         */
+        void dropUnredoable();
+
+        /**
+         * @brief Drop what the room keeps about a departing member
+         * 
+         * Frees the user's flood bucket and deletes the undo and redo
+         * commands the user sent, since they hold the user's pointer and
+         * the user may be deleted once it has left. Those messages can no
+         * longer be undone or redone through the room.
+         * 
+         * @param user The departing member
+         */
+        void forgetMember(User* user);
+
+        /**
+         * @brief Write a journal snapshot if the journal's interval has passed
+         */
+        void snapshotIfDue();
+
     public:
         /**
          * @brief Default constructor
@@ -53,11 +170,32 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
         // Constructor and Destructor
         ChatRoom();
 
+        /**
+         * @brief Named constructor
+         * 
+         * Initializes an empty chat room with the given name
+         * 
+         * @param name The name of the chat room
+         */
+        explicit ChatRoom(const std::string& name);
+
+        /**
+         * @brief Policy constructor
+         * 
+         * Initializes an empty chat room that takes its name, greetings and
+         * limits from the given policy, and prints the policy's creation banner
+         * 
+         * @param roomPolicy The policy describing this type of room
+         */
+        explicit ChatRoom(const RoomPolicy& roomPolicy);
+
         /**
          * @brief Virtual destructor
          * 
          * Cleans up command queue and clears collections.
          * Note: Users and observers are not deleted as they may be managed elsewhere.
+         * Each member forgets the room, without notifications, so members
+         * may outlive the room. Teardown is linear in the member count.
          */
         virtual ~ChatRoom();
         
@@ -66,24 +204,75 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
         /**
          * @brief Register a user to the chat room
          * 
-         * Adds a user to the chat room if not already registered.
-         * Notifies all observers when a user joins.
+         * Adds a user to the chat room if not already registered and the
+         * room is not full, prints the policy's greeting and member count,
+         * and notifies all observers with the user's name.
          * 
          * @param user Pointer to the user to register (must not be nullptr)
+         * @return bool True if the user was added
          */
 
-        void registerUser(User* user);
+        bool registerUser(User* user);
 
         /**
          * @brief Remove a user from the chat room
          * 
-         * Removes the specified user from the chat room and notifies observers.
+         * Removes the specified user from the chat room, prints the policy's
+         * farewell and member count, and notifies observers with the user's name.
+         * The user's undo and redo commands are dropped.
          * 
          * @param user Pointer to the user to remove (must not be nullptr)
          */
 
         void removeUser(User* user);
 
+        /**
+         * @brief Add many users to the chat room in one pass
+         * 
+         * Each newcomer becomes a member and an observer and records the
+         * room, as if it had called User::joinChatRoom, but without
+         * per-user greetings or notifications. Null pointers, repeats and
+         * existing members are skipped; newcomers beyond the policy's
+         * member limit are turned away. Observers present before the call
+         * get one USERS_JOINED notification listing the names added, in join
+         * order, each written by NotificationSubject::appendName(). Runs in
+         * time linear in the room size plus the batch size.
+         * 
+         * @param newcomers The users to add, in join order
+         * @return size_t Number of users added
+         */
+        size_t joinUsers(const std::vector<User*>& newcomers);
+
+        /**
+         * @brief Remove many users from the chat room in one pass
+         * 
+         * Each leaver stops being a member and an observer and forgets the
+         * room, as if it had called User::leaveChatRoom, but without per-user
+         * farewells or notifications. Users that are not members are skipped.
+         * The remaining observers get one USERS_LEFT notification listing
+         * the names removed in the same encoding as USERS_JOINED. Runs in
+         * time linear in the room size plus the batch size.
+         * 
+         * @param leavers The users to remove
+         * @return size_t Number of users removed
+         */
+        size_t leaveUsers(const std::vector<User*>& leavers);
+
+        /**
+         * @brief Remove a member that is being destroyed, in constant time
+         * 
+         * Called by User::~User. The user stops being a member and an
+         * observer without a farewell or notification, since it can no
+         * longer be asked for anything but its name. The last member moves
+         * into the freed slot, so join order is not kept. The journal
+         * still records the leave. Like any departure, it drops the user's
+         * flood bucket and undo/redo commands. Does not touch the user's
+         * room list.
+         * 
+         * @param user The departing user
+         */
+        void detachUser(User* user);
+
         // /**
         // * @brief Get the name of the chat room (pure virtual implementation)
         // * 
@@ -107,8 +296,11 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
         /**
          * @brief Send a message to all users in the chat room
          * 
-         * Distributes the message to all users except the sender,
-         * saves it to chat history, and notifies observers.
+         * Drops floods and exact repeats (if the flood guard is enabled),
+         * runs the message through the content filter (if one is set),
+         * distributes it to all users except the sender,
+         * saves it to chat history, and notifies observers. The text is
+         * wrapped in a Message from the thread's BumpArena first.
          * 
          * @param message The message content to send (must not be empty)
          * @param fromUser Pointer to the user sending the message (must not be nullptr)
@@ -116,10 +308,25 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
 
         void sendMessage(const std::string& message, User* fromUser);
 
+        /**
+         * @brief Send a shared message to all users in the chat room
+         * 
+         * Same as sendMessage(const std::string&, User*), for callers that
+         * already hold the message, such as queued commands. The text is
+         * never copied: the flood guard, filter and history read it in
+         * place, and every recipient and observer is handed the message
+         * itself. Only a masked message is copied, once, into a new Message.
+         * 
+         * @param message The shared message (must not be null or empty)
+         * @param fromUser Pointer to the user sending the message (must not be nullptr)
+         */
+        void sendMessage(const MessagePtr& message, User* fromUser);
+
         /**
          * @brief Save a message to the chat history
          * 
-         * Formats and stores the message in the chat history with username.
+         * Formats and stores the message in the chat history with username,
+         * dropping the oldest entry once the policy's history limit is reached.
          * Format: [Username]: Message\n
          * 
          * @param message The message content to save (must not be empty)
@@ -128,6 +335,35 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
 
         void saveMessage(const std::string& message, User* fromUser);
 
+        /**
+         * @brief Run a message through the flood guard and content filter
+         * 
+         * Raises the same MESSAGE_THROTTLED, MESSAGE_BLOCKED and KEYWORD_ALERT
+         * notifications as sendMessage.
+         * 
+         * @param message The message (must not be null)
+         * @param fromUser Pointer to the user sending the message
+         * @return MessagePtr The message to deliver - message itself, or a
+         *         masked copy from the thread's BumpArena - or null if dropped
+         */
+        MessagePtr screenMessage(const MessagePtr& message, User* fromUser);
+
+        /**
+         * @brief Deliver one room's share of a multi-room broadcast
+         * 
+         * Saves the pre-formatted entry and delivers the message to every
+         * member that has not already received this broadcast from another
+         * room, then notifies observers.
+         * 
+         * @param message The screened message
+         * @param formattedMessage The history entry, formatted once for all rooms
+         * @param fromUser Pointer to the user sending the message
+         * @param generation Broadcast generation used to skip members already reached
+         * @return size_t The number of members reached through this room
+         */
+        size_t deliverBroadcast(const Message& message, const std::string& formattedMessage,
+                                User* fromUser, uint64_t generation);
+
         /**
          * @brief Receive an incoming message
          * 
@@ -153,11 +389,21 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
          * @brief Create an iterator for messages
          * 
          * Creates and returns a MessageIterator for traversing the chat history.
-         * Caller is responsible for deleting the returned iterator.
+         * Caller is responsible for deleting the returned iterator. The
+         * iterator reads the live history, so it must be deleted before the
+         * room and not used while the history changes.
          * 
          * @return MessageIterator* Pointer to a new MessageIterator instance
          */
         MessageIterator* createMessageIterator();
+
+        /**
+         * @brief Create an iterator for messages, optionally showing tombstones
+         * 
+         * @param includeTombstones Show retracted and deleted messages as placeholders
+         * @return MessageIterator* Pointer to a new MessageIterator instance
+         */
+        MessageIterator* createMessageIterator(bool includeTombstones);
         
         /**
          * @brief Notify all observers about an event
@@ -199,9 +445,9 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
         /**
          * @brief Get the chat history
          * 
-         * @return const std::vector<std::string>& Reference to the chat history vector
+         * @return const ChatHistory& Reference to the chat history
          */
-        const std::vector<std::string>& getChatHistory() const;
+        const ChatHistory& getChatHistory() const;
 
         /**
          * @brief Get the list of observers
@@ -218,6 +464,13 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
          */
         std::string getName() const;
 
+        /**
+         * @brief Get the policy this room was created with
+         * 
+         * @return const RoomPolicy& The room's policy
+         */
+        const RoomPolicy& getPolicy() const;
+
         // Utility methods
 
         /**
@@ -227,6 +480,42 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
          */
         int getUserCount() const;
 
+        /**
+         * @brief Mirror a member's online status
+         * 
+         * Called by User::setOnlineStatus for each of the user's rooms, so
+         * fan-out can skip offline members without reading them.
+         * 
+         * @param user The member
+         * @param online The member's new status
+         */
+        void setMemberOnline(User* user, bool online);
+
+        /**
+         * @brief Get the sequence number of the last message delivered to a member
+         * 
+         * Each message the room fans out takes the next sequence number,
+         * starting at 1.
+         * 
+         * @param user The member
+         * @return unsigned long The sequence number, or 0 if nothing was delivered
+         */
+        unsigned long getDeliveredSequence(User* user) const;
+
+        /**
+         * @brief Get the sequence number of the last message the room fanned out
+         * 
+         * @return unsigned long The sequence number, or 0 before the first message
+         */
+        unsigned long getDeliverySequence() const;
+
+        /**
+         * @brief Get the number of rooms currently alive
+         * 
+         * @return size_t Live room count, across all threads
+         */
+        static size_t getLiveCount();
+
         /**
          * @brief Check if a user is in the chat room
          * 
@@ -235,6 +524,297 @@ class ChatRoom : public ChatAggregate, public NotificationSubject {
          */
         bool hasUser(User* user) const;
 
+        /**
+         * @brief Set the content filter applied before messages are saved
+         * 
+         * Messages matching a banned link are dropped and reported with a
+         * MESSAGE_BLOCKED notification, keyword alerts raise KEYWORD_ALERT,
+         * and profanity is masked before delivery. The filter is not owned
+         * by the room and may be shared between rooms.
+         * 
+         * @param filter Pointer to a compiled filter, or nullptr to disable filtering
+         */
+        void setMessageFilter(MessageFilter* filter);
+
+        /**
+         * @brief Get the content filter
+         * 
+         * @return MessageFilter* The current filter, or nullptr if none is set
+         */
+        MessageFilter* getMessageFilter() const;
+
+        /**
+         * @brief Enable the per-room flood guard
+         * 
+         * Each sender may send up to burst messages back to back and then
+         * messagesPerSecond on average. Exact repeats of a sender's recent
+         * messages are dropped. Dropped messages are reported with a
+         * MESSAGE_THROTTLED notification carrying the sender's name.
+         * Calling this again replaces the guard and forgets all senders.
+         * 
+         * @param messagesPerSecond Sustained rate allowed per sender
+         * @param burst Messages a sender may send back to back
+         */
+        void enableFloodGuard(double messagesPerSecond, unsigned int burst);
+
+        /**
+         * @brief Disable the flood guard
+         */
+        void disableFloodGuard();
+
+        /**
+         * @brief Get the flood guard
+         * 
+         * @return FloodGuard* The room's flood guard, or nullptr if disabled
+         */
+        const FloodGuard* getFloodGuard() const;
+
+        /**
+         * @brief Record this room's joins, leaves, sends and clears in a journal
+         * 
+         * The journal is not owned by the room. Setting a journal writes a
+         * snapshot first, so the journal can be replayed on its own. If the
+         * journal takes snapshots and history segments are off, they are
+         * turned on with CommandJournal::SEGMENT_SIZE messages per segment,
+         * so snapshots do not repeat the whole history.
+         * 
+         * @param commandJournal The journal to append to, or nullptr to stop journaling
+         */
+        void setJournal(CommandJournal* commandJournal);
+
+        /**
+         * @brief Get the journal
+         * 
+         * @return CommandJournal* The current journal, or nullptr if none is set
+         */
+        CommandJournal* getJournal() const;
+
+        /**
+         * @brief Coalesce members' online/offline notifications
+         * 
+         * With an aggregator set, members' status changes are sent as one
+         * PRESENCE_DIFF notification per tick of the aggregator instead of a
+         * USER_ONLINE or USER_OFFLINE notification each. The aggregator is
+         * not owned by the room and may be shared between rooms. Replacing
+         * or clearing the aggregator flushes the old one first.
+         * 
+         * @param aggregator The aggregator, or nullptr to notify each change at once
+         */
+        void setPresenceAggregator(PresenceAggregator* aggregator);
+
+        /**
+         * @brief Get the presence aggregator
+         * 
+         * @return PresenceAggregator* The current aggregator, or nullptr if none is set
+         */
+        PresenceAggregator* getPresenceAggregator() const;
+
+        /**
+         * @brief Stop using an aggregator that is being destroyed
+         * 
+         * Called by PresenceAggregator::~PresenceAggregator. Its pending
+         * changes are not sent; later changes are notified at once.
+         */
+        void detachPresenceAggregator();
+
+        /**
+         * @brief Replace the room's members and history without notifications
+         * 
+         * Used by ReplayEngine to restore a recovered room in one step. Current
+         * members are detached first. The history is trimmed to the policy's
+         * history limit, and the undo and redo stacks, which refer to the old
+         * history, are cleared. Runs in time linear in the old and new member
+         * counts.
+         * 
+         * @param members The members, in join order
+         * @param history The history, ids and tombstones included
+         * @param messageAuthors Sender of each message as User::getId(), by
+         * message id; messages left out have no known sender
+         */
+        void restoreState(const std::vector<User*>& members, const ChatHistory& history,
+                          const std::map<ChatHistory::MessageId, uint64_t>& messageAuthors =
+                              std::map<ChatHistory::MessageId, uint64_t>());
+
+        /**
+         * @brief Append an already formatted message during a bulk import
+         * 
+         * Skips the send path entirely: no filter, flood guard, delivery,
+         * journal record or notification. The id is kept if it is above
+         * every id in the history, otherwise the message gets the next free
+         * id. The history is trimmed to the policy's history limit. The
+         * message has no known sender, so it cannot be edited or deleted.
+         * 
+         * @param id The message's original id, or 0 for the next free id
+         * @param formattedMessage The history entry, e.g. "[Name]: text\n"
+         * @param tombstoned Whether the message was retracted
+         * @return ChatHistory::MessageId The id the message was stored under
+         */
+        ChatHistory::MessageId importMessage(ChatHistory::MessageId id, const std::string& formattedMessage,
+                                             bool tombstoned);
+
+        /**
+         * @brief Finish a bulk import
+         * 
+         * Writes one journal snapshot in place of per-message records and
+         * notifies observers with HISTORY_IMPORTED and the message count.
+         * 
+         * @param imported Number of messages imported
+         */
+        void finishImport(size_t imported);
+
+        /**
+         * @brief Retract a message, leaving a tombstone in the history
+         * 
+         * Notifies observers with MESSAGE_RETRACTED and the message id.
+         * 
+         * @param id The message id
+         * @return bool True if the message was live
+         */
+        bool retractMessage(ChatHistory::MessageId id);
+
+        /**
+         * @brief Bring back a retracted message
+         * 
+         * Notifies observers with MESSAGE_RESTORED and the message id.
+         * 
+         * @param id The message id
+         * @return bool True if the message was retracted
+         */
+        bool restoreMessage(ChatHistory::MessageId id);
+
+        /**
+         * @brief Edit one of a user's own messages
+         * 
+         * The new text passes through the flood guard and content filter like
+         * a send and replaces the entry in place. Notifies observers with
+         * MESSAGE_EDITED and the message id.
+         * 
+         * Only the user object that sent the message may edit it; another
+         * user with the same name may not. Senders are kept in the journal,
+         * so a room restored by ReplayEngine keeps them for the senders it
+         * recovers. Imported messages have no known sender, since user ids
+         * do not carry over between processes, and cannot be edited.
+         * 
+         * @param id The message id
+         * @param newMessage The new message content
+         * @param editor The user editing, who must be the message's sender
+         * @return bool True if the message was edited
+         */
+        bool editMessage(ChatHistory::MessageId id, const std::string& newMessage, User* editor);
+
+        /**
+         * @brief Delete one of a user's own messages
+         * 
+         * The entry becomes an empty tombstone and cannot be restored.
+         * Notifies observers with MESSAGE_DELETED and the message id.
+         * The sender is checked as for editMessage().
+         * 
+         * @param id The message id
+         * @param requester The user deleting, who must be the message's sender
+         * @return bool True if the message was deleted
+         */
+        bool deleteMessage(ChatHistory::MessageId id, User* requester);
+
+        /**
+         * @brief Get the sender of a stored message
+         * 
+         * @param id The message id
+         * @return uint64_t The sender's User::getId(), or 0 if it is not known
+         */
+        uint64_t getAuthor(ChatHistory::MessageId id) const;
+
+        /**
+         * @brief Set when retracting or deleting compacts the history
+         * 
+         * The history is compacted once tombstones make up at least ratio of
+         * the stored entries and number at least minimum. Compaction runs
+         * after the retraction or deletion that crosses the threshold, never
+         * on the send path, and its cost is spread over the tombstones that
+         * built up since the last pass. A ratio of 0 disables it. While
+         * commands wait on the redo stack the pass is put off, since it
+         * would drop the retracted messages they restore.
+         * 
+         * @param ratio Share of stored entries, defaults to 0.25
+         * @param minimum Minimum tombstone count, defaults to 1024
+         */
+        void setCompactionThreshold(double ratio, size_t minimum);
+
+        /**
+         * @brief Drop every tombstone from the history now
+         * 
+         * The messages waiting on the redo stack go with them, so it is cleared.
+         * 
+         * @return size_t Number of tombstones dropped
+         */
+        size_t compactHistory();
+
+        /**
+         * @brief Compress cold history in segments of this many messages
+         * 
+         * The newest one to two segments' worth of messages stay raw; older
+         * ones are compressed and decompressed a segment at a time when read.
+         * 
+         * @param messages Messages per segment, e.g. 4096, or 0 to keep all
+         * history raw (the default)
+         */
+        void setHistorySegmentSize(size_t messages);
+
+        /**
+         * @brief Keep up to limit executed commands so they can be undone
+         * 
+         * The oldest command is dropped once the limit is reached. A limit of
+         * 0 (the default) disables undo and discards anything retained.
+         * 
+         * @param limit Maximum undo depth
+         */
+        void setUndoLimit(size_t limit);
+
+        /**
+         * @brief Get the undo limit
+         * 
+         * @return size_t Maximum undo depth, 0 if undo is disabled
+         */
+        size_t getUndoLimit() const;
+
+        /**
+         * @brief Take ownership of an executed command for undo
+         * 
+         * Retaining a new command clears the redo stack.
+         * 
+         * @param command The executed command
+         * @return bool False if undo is disabled or the command cannot be undone;
+         *              the caller still owns the command then
+         */
+        bool retainForUndo(Command* command);
+
+        /**
+         * @brief Undo the most recent retained command
+         * 
+         * @return bool False if there is nothing to undo
+         */
+        bool undo();
+
+        /**
+         * @brief Redo the most recently undone command
+         * 
+         * @return bool False if there is nothing to redo
+         */
+        bool redo();
+
+        /**
+         * @brief Get the number of commands that can be undone
+         * 
+         * @return size_t Undo depth
+         */
+        size_t getUndoDepth() const;
+
+        /**
+         * @brief Get the number of commands that can be redone
+         * 
+         * @return size_t Redo depth
+         */
+        size_t getRedoDepth() const;
+
         /**
          * @brief Clear all chat history
          * 
@@ -0,0 +1,559 @@
+#include "ChatServer.h"
+#include "ChatRoom.h"
+#include "RemoteUser.h"
+#include <iostream>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * @file ChatServer.cpp
+ * @brief Implementation of the epoll chat server
+ */
+
+namespace {
+
+const int MAX_EVENTS = 256;
+const size_t MAX_IOVECS = 64;
+
+bool validName(const std::string& name) {
+    return !name.empty() && name.size() <= 64 && name.find(' ') == std::string::npos;
+}
+
+}
+
+ChatServer::ChatServer()
+    : listenFd(-1), epollFd(-1), wakeFd(-1), port(0), stopping(false),
+      framesReceived(0), framesSent(0), writeCalls(0), outboundLimit(DEFAULT_OUTBOUND_LIMIT),
+      slowConsumersClosed(0), lastDeliveryRoom(nullptr),
+      lastDeliveryFrom(nullptr) {
+}
+
+ChatServer::~ChatServer() {
+    std::vector<Connection*> open;
+    for (auto& entry : connections) {
+        open.push_back(entry.second);
+    }
+    for (Connection* connection : open) {
+        closeConnection(connection);
+    }
+    for (auto& entry : rooms) {
+        delete entry.second;
+    }
+    rooms.clear();
+
+    if (listenFd >= 0) {
+        close(listenFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+bool ChatServer::start(uint16_t listenPort, const std::string& host) {
+    if (listenFd >= 0) {
+        std::cerr << "Error: Chat server is already listening" << std::endl;
+        return false;
+    }
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(listenPort);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Error: Invalid listen address " << host << std::endl;
+        return false;
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (listenFd < 0 || setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Error: Cannot listen on " << host << ":" << listenPort << ": " << strerror(errno) << std::endl;
+        if (listenFd >= 0) {
+            close(listenFd);
+            listenFd = -1;
+        }
+        return false;
+    }
+
+    socklen_t length = sizeof(address);
+    getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+    port = ntohs(address.sin_port);
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    return true;
+}
+
+uint16_t ChatServer::getPort() const {
+    return port;
+}
+
+size_t ChatServer::pollOnce(int timeoutMs) {
+    if (epollFd < 0) {
+        return 0;
+    }
+    if (presence.getPendingRooms() != 0) {
+        int presenceMs = static_cast<int>(presence.getTimeToTick().count());
+        if (timeoutMs < 0 || presenceMs < timeoutMs) {
+            timeoutMs = presenceMs;
+        }
+    }
+    epoll_event events[MAX_EVENTS];
+    int ready = epoll_wait(epollFd, events, MAX_EVENTS, timeoutMs);
+
+    for (int i = 0; i < ready; i++) {
+        int fd = events[i].data.fd;
+        if (fd == listenFd) {
+            acceptConnections();
+            continue;
+        }
+        if (fd == wakeFd) {
+            uint64_t count;
+            ssize_t ignored = read(wakeFd, &count, sizeof(count));
+            (void)ignored;
+            continue;
+        }
+
+        std::unordered_map<int, Connection*>::iterator it = connections.find(fd);
+        if (it == connections.end()) {
+            continue;
+        }
+        Connection* connection = it->second;
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            readConnection(connection);
+            if (connections.find(fd) == connections.end()) {
+                continue;
+            }
+        }
+        if (events[i].events & EPOLLOUT) {
+            flushConnection(connection);
+            if (connection->closing) {
+                closeConnection(connection);
+            }
+        }
+    }
+    // Also on a poll that timed out, which is when a quiet window ends
+    presence.tick();
+    flushPending();
+    return ready > 0 ? static_cast<size_t>(ready) : 0;
+}
+
+void ChatServer::run() {
+    while (!stopping.load()) {
+        pollOnce(-1);
+    }
+}
+
+void ChatServer::stop() {
+    stopping.store(true);
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+void ChatServer::queueFrame(int fd, const std::string& payload) {
+    if (!lastFrame || lastPayload != payload) {
+        lastFrame = encodeFrame(payload);
+        lastPayload = payload;
+    }
+    queueFrame(fd, lastFrame);
+}
+
+void ChatServer::queueDelivery(int fd, ChatRoom* room, User* fromUser, const Message& message) {
+    if (!lastDelivery || room != lastDeliveryRoom || fromUser != lastDeliveryFrom ||
+        lastDeliveryText.compare(0, std::string::npos, message.data(), message.size()) != 0) {
+        std::string payload;
+        payload.reserve(6 + room->getName().size() + fromUser->getName().size() + message.size());
+        payload += "MSG ";
+        payload += room->getName();
+        payload.push_back(' ');
+        payload += fromUser->getName();
+        payload.push_back(' ');
+        payload.append(message.data(), message.size());
+        lastDelivery = encodeFrame(payload);
+        lastDeliveryRoom = room;
+        lastDeliveryFrom = fromUser;
+        lastDeliveryText.assign(message.data(), message.size());
+    }
+    queueFrame(fd, lastDelivery);
+}
+
+void ChatServer::queueFrame(int fd, const Frame& frame) {
+    std::unordered_map<int, Connection*>::iterator it = connections.find(fd);
+    if (it == connections.end() || it->second->closing) {
+        return;
+    }
+    Connection* connection = it->second;
+    if (outboundLimit != 0 && connection->outboundBytes + frame->size() > outboundLimit) {
+        // Closed by flushPending(), as the caller may be iterating a room's members
+        connection->closing = true;
+        connection->outbound.clear();
+        connection->outboundSent = 0;
+        connection->outboundBytes = 0;
+        pendingWrites.push_back(fd);
+        slowConsumersClosed++;
+        return;
+    }
+    if (connection->outbound.empty() && !connection->watchingWrites) {
+        pendingWrites.push_back(fd);
+    }
+    connection->outbound.push_back(frame);
+    connection->outboundBytes += frame->size();
+    framesSent++;
+}
+
+void ChatServer::setOutboundLimit(size_t bytes) {
+    outboundLimit = bytes;
+}
+
+void ChatServer::setPresenceWindow(std::chrono::milliseconds window) {
+    presence.setWindow(window);
+}
+
+size_t ChatServer::getOutboundLimit() const {
+    return outboundLimit;
+}
+
+uint64_t ChatServer::getSlowConsumersClosed() const {
+    return slowConsumersClosed;
+}
+
+size_t ChatServer::getConnectionCount() const {
+    return connections.size();
+}
+
+size_t ChatServer::getRoomCount() const {
+    return rooms.size();
+}
+
+uint64_t ChatServer::getFramesReceived() const {
+    return framesReceived;
+}
+
+uint64_t ChatServer::getFramesSent() const {
+    return framesSent;
+}
+
+uint64_t ChatServer::getWriteCalls() const {
+    return writeCalls;
+}
+
+void ChatServer::appendFrame(std::string& out, const std::string& payload) {
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    char header[4] = {
+        static_cast<char>(length & 0xFF), static_cast<char>((length >> 8) & 0xFF),
+        static_cast<char>((length >> 16) & 0xFF), static_cast<char>((length >> 24) & 0xFF)
+    };
+    out.append(header, sizeof(header));
+    out += payload;
+}
+
+ChatServer::Frame ChatServer::encodeFrame(const std::string& payload) {
+    std::shared_ptr<std::string> encoded = std::make_shared<std::string>();
+    encoded->reserve(4 + payload.size());
+    appendFrame(*encoded, payload);
+    return encoded;
+}
+
+int ChatServer::takeFrame(const std::string& in, size_t& offset, std::string& payload) {
+    if (in.size() - offset < 4) {
+        return 0;
+    }
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(in.data() + offset);
+    size_t length = header[0] | (header[1] << 8) | (header[2] << 16) | (static_cast<size_t>(header[3]) << 24);
+    if (length > MAX_FRAME_BYTES) {
+        return -1;
+    }
+    if (in.size() - offset - 4 < length) {
+        return 0;
+    }
+    payload.assign(in, offset + 4, length);
+    offset += 4 + length;
+    return 1;
+}
+
+void ChatServer::acceptConnections() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Error: Cannot accept connection: " << strerror(errno) << std::endl;
+            }
+            if (errno != EINTR) {
+                return;
+            }
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+
+        Connection* connection = new Connection();
+        connection->fd = fd;
+        connection->outboundSent = 0;
+        connection->outboundBytes = 0;
+        connection->watchingWrites = false;
+        connection->closing = false;
+        connection->user = nullptr;
+        connections[fd] = connection;
+    }
+}
+
+void ChatServer::readConnection(Connection* connection) {
+    char buffer[64 * 1024];
+    for (;;) {
+        ssize_t received = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection->inbound.append(buffer, static_cast<size_t>(received));
+            if (static_cast<size_t>(received) < sizeof(buffer)) {
+                break;
+            }
+        } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else {
+            connection->closing = true;
+            break;
+        }
+    }
+
+    std::string payload;
+    size_t offset = 0;
+    int status = 0;
+    while (!connection->closing && (status = takeFrame(connection->inbound, offset, payload)) == 1) {
+        framesReceived++;
+        handleFrame(connection, payload);
+    }
+    if (!connection->closing && status < 0) {
+        queueFrame(connection->fd, "ERR frame too large");
+        connection->closing = true;
+    }
+    connection->inbound.erase(0, offset);
+
+    if (connection->closing) {
+        flushConnection(connection);
+        closeConnection(connection);
+    }
+}
+
+void ChatServer::handleFrame(Connection* connection, const std::string& payload) {
+    size_t space = payload.find(' ');
+    std::string verb = payload.substr(0, space);
+    std::string argument = space == std::string::npos ? std::string() : payload.substr(space + 1);
+    RemoteUser* user = connection->user;
+    // A fan-out never spans two requests, and names may change between them
+    lastDelivery.reset();
+
+    if (verb == "PING") {
+        queueFrame(connection->fd, "PONG");
+        return;
+    }
+    if (verb == "QUIT") {
+        queueFrame(connection->fd, "OK QUIT");
+        connection->closing = true;
+        return;
+    }
+    if (verb == "NICK") {
+        if (user != nullptr) {
+            queueFrame(connection->fd, "ERR already logged in");
+        } else if (!validName(argument)) {
+            queueFrame(connection->fd, "ERR invalid name");
+        } else if (usersByName.count(argument) != 0) {
+            queueFrame(connection->fd, "ERR name taken");
+        } else {
+            user = new RemoteUser(argument, *this, connection->fd);
+            connection->user = user;
+            usersByName[argument] = user;
+            user->setOnlineStatus(true);
+            queueFrame(connection->fd, "OK NICK " + argument);
+        }
+        return;
+    }
+    if (user == nullptr) {
+        queueFrame(connection->fd, "ERR not logged in");
+        return;
+    }
+
+    if (verb == "JOIN") {
+        if (!validName(argument)) {
+            queueFrame(connection->fd, "ERR invalid room");
+            return;
+        }
+        ChatRoom* room = findRoom(argument);
+        if (room == nullptr) {
+            room = new ChatRoom(argument);
+            room->setPresenceAggregator(&presence);
+            rooms[argument] = room;
+        }
+        if (room->hasUser(user)) {
+            queueFrame(connection->fd, "ERR already in " + argument);
+            return;
+        }
+        user->joinChatRoom(room);
+        queueFrame(connection->fd, room->hasUser(user) ? "OK JOIN " + argument : "ERR cannot join " + argument);
+    } else if (verb == "LEAVE") {
+        ChatRoom* room = findRoom(argument);
+        if (room == nullptr || !room->hasUser(user)) {
+            queueFrame(connection->fd, "ERR not in " + argument);
+            return;
+        }
+        user->leaveChatRoom(room);
+        queueFrame(connection->fd, "OK LEAVE " + argument);
+    } else if (verb == "SAY") {
+        size_t split = argument.find(' ');
+        ChatRoom* room = findRoom(argument.substr(0, split));
+        if (room == nullptr || !room->hasUser(user)) {
+            queueFrame(connection->fd, "ERR not in " + argument.substr(0, split));
+            return;
+        }
+        if (split == std::string::npos || split + 1 == argument.size()) {
+            queueFrame(connection->fd, "ERR empty message");
+            return;
+        }
+        user->sendMessage(argument.substr(split + 1), room);
+    } else if (verb == "AWAY" || verb == "BACK") {
+        user->setOnlineStatus(verb == "BACK");
+        queueFrame(connection->fd, "OK " + verb);
+    } else {
+        queueFrame(connection->fd, "ERR unknown request " + verb);
+    }
+}
+
+void ChatServer::flushConnection(Connection* connection) {
+    std::deque<Frame>& queue = connection->outbound;
+    while (!queue.empty()) {
+        iovec chunks[MAX_IOVECS];
+        size_t count = 0;
+        size_t batchBytes = 0;
+        for (std::deque<Frame>::const_iterator it = queue.begin(); it != queue.end() && count < MAX_IOVECS; ++it) {
+            size_t skip = count == 0 ? connection->outboundSent : 0;
+            chunks[count].iov_base = const_cast<char*>((*it)->data() + skip);
+            chunks[count].iov_len = (*it)->size() - skip;
+            batchBytes += chunks[count].iov_len;
+            count++;
+        }
+
+        // sendmsg rather than writev so a closed peer cannot raise SIGPIPE
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = chunks;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(connection->fd, &message, MSG_NOSIGNAL);
+        writeCalls++;
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (sent <= 0) {
+            connection->closing = true;
+            queue.clear();
+            connection->outboundSent = 0;
+            connection->outboundBytes = 0;
+            return;
+        }
+
+        connection->outboundBytes -= static_cast<size_t>(sent);
+        size_t left = static_cast<size_t>(sent);
+        while (left > 0) {
+            size_t remaining = queue.front()->size() - connection->outboundSent;
+            if (left < remaining) {
+                connection->outboundSent += left;
+                break;
+            }
+            left -= remaining;
+            queue.pop_front();
+            connection->outboundSent = 0;
+        }
+        if (static_cast<size_t>(sent) < batchBytes) {
+            break;      // Socket buffer is full
+        }
+    }
+
+    bool drained = queue.empty();
+    if (drained == connection->watchingWrites) {
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = drained ? EPOLLIN : (EPOLLIN | EPOLLOUT);
+        event.data.fd = connection->fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection->fd, &event);
+        connection->watchingWrites = !drained;
+    }
+}
+
+void ChatServer::flushPending() {
+    // Swapped out first: a failed flush closes its connection, which may
+    // queue frames for others
+    std::vector<int> batch;
+    batch.swap(pendingWrites);
+    for (int fd : batch) {
+        std::unordered_map<int, Connection*>::iterator it = connections.find(fd);
+        if (it == connections.end()) {
+            continue;
+        }
+        Connection* connection = it->second;
+        flushConnection(connection);
+        if (connection->closing) {
+            closeConnection(connection);
+        }
+    }
+    if (!pendingWrites.empty()) {
+        flushPending();
+    }
+}
+
+void ChatServer::closeConnection(Connection* connection) {
+    int fd = connection->fd;
+    connection->closing = true;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+
+    RemoteUser* user = connection->user;
+    if (user != nullptr) {
+        std::vector<ChatRoom*> joined = user->getChatRooms();
+        for (ChatRoom* room : joined) {
+            user->leaveChatRoom(room);
+        }
+        usersByName.erase(user->getName());
+        delete user;
+    }
+    delete connection;
+}
+
+ChatRoom* ChatServer::findRoom(const std::string& name) const {
+    std::map<std::string, ChatRoom*>::const_iterator it = rooms.find(name);
+    return it == rooms.end() ? nullptr : it->second;
+}
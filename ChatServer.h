@@ -0,0 +1,244 @@
+/**
+ * @file ChatServer.h
+ * @brief TCP front end for chat rooms on a non-blocking epoll loop
+ * @date 19/10/2026
+ */
+
+#ifndef CHATSERVER_H
+#define CHATSERVER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+#include "PresenceAggregator.h"
+
+class ChatRoom;
+class RemoteUser;
+class User;
+class Message;
+
+/**
+ * @brief Accepts TCP connections and drives ChatRooms from their frames
+ *
+ * Everything runs on the thread that calls run() or pollOnce(), so rooms
+ * and users need no locks; only stop() may be called from elsewhere.
+ * Sockets are non-blocking and level-triggered. Outbound frames are
+ * queued per connection and flushed once per poll with one vectored send
+ * per connection; a connection whose socket is full is watched for
+ * EPOLLOUT until its queue drains. Frames are encoded once and shared by
+ * reference count, so a fan-out to N members queues N pointers to the same
+ * bytes rather than N copies. A client that stops reading cannot make its
+ * queue grow without bound: once the unsent bytes would pass the outbound
+ * limit, its queue is dropped and the connection closed after the poll.
+ *
+ * Every frame, in both directions, is a 4-byte little-endian length and
+ * that many bytes of text. Client requests:
+ *
+ *     NICK <name>          log in; names are unique
+ *     JOIN <room>          join, creating the room on first use
+ *     LEAVE <room>
+ *     SAY <room> <text>    send through User::sendMessage
+ *     AWAY                 go offline; rooms stop delivering until BACK
+ *     BACK                 go online again
+ *     PING
+ *     QUIT
+ *
+ * Replies are "OK <request>", "ERR <reason>" or "PONG"; a successful SAY
+ * gets no reply. Deliveries arrive as "MSG <room> <from> <text>" and room
+ * notifications as "EVENT <room> <event> <data>".
+ *
+ * Every room the server creates shares one PresenceAggregator, so AWAY and
+ * BACK reach the other members as one PRESENCE_DIFF per room per presence
+ * window. pollOnce() ticks it and waits no longer than the window has
+ * left while changes are pending.
+ */
+class ChatServer {
+public:
+    static const size_t MAX_FRAME_BYTES = 1 << 20;
+
+    /** Default for setOutboundLimit() */
+    static const size_t DEFAULT_OUTBOUND_LIMIT = 8 << 20;
+
+    /// Encoded frame, length prefix included, shared by every connection it is queued on
+    typedef std::shared_ptr<const std::string> Frame;
+
+    ChatServer();
+
+    /**
+     * @brief Destructor - closes every connection and deletes all rooms
+     */
+    ~ChatServer();
+
+    /**
+     * @brief Start listening
+     * @param port TCP port, or 0 for any free port
+     * @param host IPv4 address to bind
+     * @return False if the socket could not be set up, which is reported on std::cerr
+     */
+    bool start(uint16_t port, const std::string& host = "127.0.0.1");
+
+    /**
+     * @brief Get the port the server is listening on
+     * @return Port, or 0 before start()
+     */
+    uint16_t getPort() const;
+
+    /**
+     * @brief Wait for and handle one batch of socket events
+     * @param timeoutMs Longest wait, or -1 to wait indefinitely
+     * @return Number of events handled
+     */
+    size_t pollOnce(int timeoutMs);
+
+    /**
+     * @brief Handle events until stop() is called
+     */
+    void run();
+
+    /**
+     * @brief Make run() return; safe from any thread or a signal handler
+     */
+    void stop();
+
+    /**
+     * @brief Queue a frame for a connection
+     *
+     * Consecutive calls with the same payload, as in a room fan-out, reuse
+     * one encoded frame.
+     *
+     * @param fd The connection's socket
+     * @param payload Frame contents
+     */
+    void queueFrame(int fd, const std::string& payload);
+
+    /**
+     * @brief Queue a "MSG <room> <from> <text>" frame for a connection
+     *
+     * Every recipient of one fan-out shares a single encoded frame.
+     *
+     * @param fd The connection's socket
+     * @param room Room the message was sent in
+     * @param fromUser Sender
+     * @param message The delivered message
+     */
+    void queueDelivery(int fd, ChatRoom* room, User* fromUser, const Message& message);
+
+    /**
+     * @brief Queue an already encoded frame for a connection
+     * @param fd The connection's socket
+     * @param frame Frame from encodeFrame()
+     */
+    void queueFrame(int fd, const Frame& frame);
+
+    /**
+     * @brief Set how many unsent bytes one connection may have queued
+     *
+     * A frame that would take a connection past the limit is not queued;
+     * the connection's queue is dropped and it is closed once the current
+     * poll has finished, so a room fan-out is never cut short.
+     *
+     * @param bytes The limit, or 0 for none
+     */
+    void setOutboundLimit(size_t bytes);
+
+    size_t getOutboundLimit() const;
+
+    /**
+     * @brief Get the number of connections closed for passing the outbound limit
+     * @return Slow consumers closed
+     */
+    uint64_t getSlowConsumersClosed() const;
+
+    /**
+     * @brief Set how long presence changes are collected before being sent
+     * @param window The window; 0 sends them on the next poll
+     */
+    void setPresenceWindow(std::chrono::milliseconds window);
+
+    size_t getConnectionCount() const;
+    size_t getRoomCount() const;
+    uint64_t getFramesReceived() const;
+    uint64_t getFramesSent() const;
+
+    /**
+     * @brief Get the number of vectored send calls made to flush frames
+     * @return Send system calls, including ones that wrote nothing
+     */
+    uint64_t getWriteCalls() const;
+
+    /**
+     * @brief Append a length-prefixed frame to a buffer
+     * @param out Buffer to append to
+     * @param payload Frame contents
+     */
+    static void appendFrame(std::string& out, const std::string& payload);
+
+    /**
+     * @brief Encode a frame that can be queued on many connections
+     * @param payload Frame contents
+     * @return Shared encoded frame
+     */
+    static Frame encodeFrame(const std::string& payload);
+
+    /**
+     * @brief Take the next complete frame from a buffer
+     * @param in Buffer holding received bytes
+     * @param offset Read position in in, advanced past the frame
+     * @param payload Set to the frame contents
+     * @return 1 for a frame, 0 if more bytes are needed, -1 if the frame is too large
+     */
+    static int takeFrame(const std::string& in, size_t& offset, std::string& payload);
+
+private:
+    struct Connection {
+        int fd;
+        std::string inbound;
+        std::deque<Frame> outbound;
+        size_t outboundSent;        ///< Bytes of the front frame already sent
+        size_t outboundBytes;       ///< Bytes queued and not yet sent
+        bool watchingWrites;
+        bool closing;
+        RemoteUser* user;
+    };
+
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    uint16_t port;
+    std::atomic<bool> stopping;
+
+    std::unordered_map<int, Connection*> connections;
+    std::vector<int> pendingWrites;
+    std::map<std::string, ChatRoom*> rooms;
+    PresenceAggregator presence;    ///< Set on every room in rooms
+    std::unordered_map<std::string, RemoteUser*> usersByName;
+    uint64_t framesReceived;
+    uint64_t framesSent;
+    uint64_t writeCalls;
+    size_t outboundLimit;
+    uint64_t slowConsumersClosed;
+    std::string lastPayload;    ///< Payload of lastFrame, for sharing across a fan-out
+    Frame lastFrame;
+    ChatRoom* lastDeliveryRoom;
+    User* lastDeliveryFrom;
+    std::string lastDeliveryText;
+    Frame lastDelivery;         ///< Shared by every recipient of the current fan-out
+
+    void acceptConnections();
+    void readConnection(Connection* connection);
+    void handleFrame(Connection* connection, const std::string& payload);
+    void flushConnection(Connection* connection);
+    void flushPending();
+    void closeConnection(Connection* connection);
+    ChatRoom* findRoom(const std::string& name) const;
+
+    ChatServer(const ChatServer&);
+    ChatServer& operator=(const ChatServer&);
+};
+
+#endif
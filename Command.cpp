@@ -1,12 +1,87 @@
 #include "Command.h"
 #include "ChatRoom.h"
 #include "Users.h"
+#include "BumpArena.h"
+#include <new>
+
+namespace {
+
+// Each command is preceded by the arena it came from, or nullptr for the heap
+const size_t ORIGIN_BYTES = BumpArena::ALIGNMENT;
+
+void* placeCommand(void* block, BumpArena* arena) {
+    *static_cast<BumpArena**>(block) = arena;
+    return static_cast<char*>(block) + ORIGIN_BYTES;
+}
+
+}
 
 // Base Command class implementation
 Command::Command(ChatRoom* room, User* user, const std::string& msg)
-    : room (room), fromUser(user), message(msg) {
+    : room (room), fromUser(user), message(Message::create(user, msg)) {
+}
+
+Command::Command(ChatRoom* room, User* user, const MessagePtr& msg)
+    : room (room), fromUser(user), message(msg ? msg : Message::create(user, std::string())) {
 }
 
 Command::~Command() {
     // Base destructor - no cleanup needed for pointers we don't own
-}
\ No newline at end of file
+}
+
+void* Command::operator new(size_t size) {
+    return placeCommand(::operator new(size + ORIGIN_BYTES), nullptr);
+}
+
+void* Command::operator new(size_t size, BumpArena& arena) {
+    return placeCommand(arena.allocate(size + ORIGIN_BYTES), &arena);
+}
+
+void Command::operator delete(void* pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+    void* block = static_cast<char*>(pointer) - ORIGIN_BYTES;
+    BumpArena* arena = *static_cast<BumpArena**>(block);
+    if (arena != nullptr) {
+        arena->release(block);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+void Command::operator delete(void* pointer, BumpArena& arena) {
+    if (pointer != nullptr) {
+        arena.release(static_cast<char*>(pointer) - ORIGIN_BYTES);
+    }
+}
+std::string Command::getType() const {
+    return "Command";
+}
+
+void Command::undo() {
+}
+
+bool Command::canRedo() const {
+    return true;
+}
+
+void Command::redo() {
+    execute();
+}
+
+bool Command::isUndoable() const {
+    return false;
+}
+
+ChatRoom* Command::getRoom() const {
+    return room;
+}
+
+User* Command::getUser() const {
+    return fromUser;
+}
+
+const MessagePtr& Command::getMessage() const {
+    return message;
+}
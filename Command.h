@@ -9,9 +9,12 @@
 #define COMMAND_H
 
 #include <string>
+#include <cstddef>
+#include "Message.h"
 
 class ChatRoom;
 class User;
+class BumpArena;
 
 /**
  * @brief Abstract base Command class for the Command pattern
@@ -25,7 +28,7 @@ class Command {
     protected:
         ChatRoom* room;
         User* fromUser;
-        std::string message;
+        MessagePtr message;     ///< Never null; shared with other commands for the same send
 
     public:
 
@@ -37,12 +40,38 @@ class Command {
          */
 
         Command(ChatRoom* room, User* user, const std::string& msg);
+
+        /**
+         * @brief Constructor for a command sharing an existing message
+         * @param room Pointer to the ChatRoom where the command will be executed
+         * @param user Pointer to the User who initiated the command
+         * @param msg The shared message; a null pointer is treated as an empty message
+         */
+        Command(ChatRoom* room, User* user, const MessagePtr& msg);
         
         /**
          * @brief Virtual destructor for proper inheritance
          */
 
         virtual ~Command();
+
+        /**
+         * @brief Allocate a command on the heap
+         * 
+         * Each command records where it was allocated, so delete works the
+         * same for heap and arena commands.
+         */
+        static void* operator new(size_t size);
+
+        /**
+         * @brief Allocate a command from an arena: new (arena) SendMessageCommand(...)
+         * 
+         * For commands deleted by the executeAll() batch that runs them.
+         */
+        static void* operator new(size_t size, BumpArena& arena);
+
+        static void operator delete(void* pointer);
+        static void operator delete(void* pointer, BumpArena& arena);
         
         /**
          * @brief Pure virtual execute method
@@ -51,6 +80,65 @@ class Command {
          * to define the specific action to be performed.
          */
         virtual void execute() = 0;
+
+        /**
+         * @brief Reverse the effect of execute()
+         * 
+         * Only called on commands for which isUndoable() returned true.
+         * The default does nothing.
+         */
+        virtual void undo();
+
+        /**
+         * @brief Re-apply the command after undo()
+         * 
+         * The default executes the command again.
+         */
+        virtual void redo();
+
+        /**
+         * @brief Check whether redo() still has something to re-apply
+         * 
+         * Asked of commands on the redo stack after the room drops history.
+         * 
+         * @return bool False once redo() could no longer take effect; true by default
+         */
+        virtual bool canRedo() const;
+
+        /**
+         * @brief Check whether the command can be undone
+         * 
+         * @return bool True if undo() would reverse an executed command; false by default
+         */
+        virtual bool isUndoable() const;
+
+        /**
+         * @brief Get the room the command acts on
+         * 
+         * @return ChatRoom* The target room
+         */
+        ChatRoom* getRoom() const;
+
+        /**
+         * @brief Get the user who initiated the command
+         * 
+         * @return User* The initiating user
+         */
+        User* getUser() const;
+
+        /**
+         * @brief Get the message the command carries
+         * 
+         * @return const MessagePtr& The shared message
+         */
+        const MessagePtr& getMessage() const;
+
+        /**
+         * @brief Get the command's type name
+         * 
+         * @return std::string Type name used by the journal, e.g. "SendMessage"
+         */
+        virtual std::string getType() const;
 };
 
 #endif 
\ No newline at end of file
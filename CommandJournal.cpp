@@ -0,0 +1,200 @@
+#include "CommandJournal.h"
+#include "ChatRoom.h"
+#include "Users.h"
+#include <algorithm>
+
+/**
+ * @file CommandJournal.cpp
+ * @brief Implementation of the append-only room journal
+ */
+
+CommandJournal::CommandJournal(std::ostream& stream, size_t interval)
+    : out(stream), snapshotInterval(interval), sinceSnapshot(0), recordCount(0), byteCount(0),
+      checkpointCount(0) {
+}
+
+void CommandJournal::appendJoin(uint64_t userId, const std::string& userName) {
+    scratch.clear();
+    putUint64(scratch, userId);
+    putString(scratch, userName);
+    writeRecord(JOIN, scratch);
+}
+
+void CommandJournal::appendLeave(uint64_t userId) {
+    scratch.clear();
+    putUint64(scratch, userId);
+    writeRecord(LEAVE, scratch);
+}
+
+void CommandJournal::appendSend(uint64_t userId, const std::string& userName, const char* message, size_t length) {
+    scratch.clear();
+    putUint64(scratch, userId);
+    putString(scratch, userName);
+    putString(scratch, message, length);
+    writeRecord(SEND, scratch);
+}
+
+void CommandJournal::appendClear() {
+    scratch.clear();
+    writeRecord(CLEAR, scratch);
+}
+
+void CommandJournal::appendCompact() {
+    scratch.clear();
+    writeRecord(COMPACT, scratch);
+}
+
+void CommandJournal::appendTombstone(uint64_t messageId) {
+    scratch.clear();
+    putUint64(scratch, messageId);
+    writeRecord(TOMBSTONE, scratch);
+}
+
+void CommandJournal::appendRestore(uint64_t messageId) {
+    scratch.clear();
+    putUint64(scratch, messageId);
+    writeRecord(RESTORE, scratch);
+}
+
+void CommandJournal::appendEdit(uint64_t messageId, const std::string& formattedMessage) {
+    scratch.clear();
+    putUint64(scratch, messageId);
+    putString(scratch, formattedMessage);
+    writeRecord(EDIT, scratch);
+}
+
+void CommandJournal::appendDelete(uint64_t messageId) {
+    scratch.clear();
+    putUint64(scratch, messageId);
+    writeRecord(DELETE, scratch);
+}
+
+void CommandJournal::appendSnapshot(const ChatRoom& room) {
+    const ChatHistory& history = room.getChatHistory();
+
+    // Offsets count from the journal's first record
+    std::unordered_map<uint64_t, uint64_t> referenced;
+    ChatHistory::SegmentImage image;
+    for (size_t s = 0; s < history.getSegmentCount(); s++) {
+        uint64_t serial = history.getSegmentSerial(s);
+        std::unordered_map<uint64_t, uint64_t>::const_iterator known = checkpoints.find(serial);
+        if (known != checkpoints.end()) {
+            referenced[serial] = known->second;
+            continue;
+        }
+        history.getSegmentImage(s, image);
+        scratch.clear();
+        putUint64(scratch, image.firstId);
+        putUint64(scratch, image.lastId);
+        putUint32(scratch, static_cast<uint32_t>(image.count));
+        putUint32(scratch, static_cast<uint32_t>(image.ids.size()));
+        for (size_t i = 0; i < image.ids.size(); i++) {
+            putUint64(scratch, image.ids[i]);
+        }
+        putPositions(scratch, image.erased);
+        putUint64(scratch, image.rawBytes);
+        putString(scratch, image.data);
+        for (size_t i = 0; i < image.count; i++) {
+            putUint64(scratch, room.getAuthor(image.ids.empty() ? image.firstId + i : image.ids[i]));
+        }
+        referenced[serial] = byteCount;
+        writeRecord(CHECKPOINT, scratch);
+        checkpointCount++;
+    }
+    // Segments that were resealed or dropped are never referenced again
+    checkpoints.swap(referenced);
+
+    scratch.clear();
+    const std::vector<User*>& members = room.getUsers();
+    putUint32(scratch, static_cast<uint32_t>(members.size()));
+    for (size_t i = 0; i < members.size(); i++) {
+        putUint64(scratch, members[i]->getId());
+        putString(scratch, members[i]->getName());
+    }
+    putUint64(scratch, history.getNextId());
+    putUint32(scratch, static_cast<uint32_t>(history.getSegmentCount()));
+    for (size_t s = 0; s < history.getSegmentCount(); s++) {
+        putUint64(scratch, checkpoints[history.getSegmentSerial(s)]);
+        putUint32(scratch, static_cast<uint32_t>(history.getSegmentSkipped(s)));
+        putPositions(scratch, history.getSegmentTombstones(s));
+    }
+    size_t cold = history.getColdCount();
+    putUint32(scratch, static_cast<uint32_t>(history.getStoredCount() - cold));
+    for (size_t i = cold; i < history.getStoredCount(); i++) {
+        const ChatHistory::Entry& entry = history.getEntry(i);
+        putUint64(scratch, entry.id);
+        putUint64(scratch, room.getAuthor(entry.id));
+        scratch.push_back(entry.tombstoned ? 1 : 0);
+        putString(scratch, entry.text.data(), entry.text.size());
+    }
+    writeRecord(SNAPSHOT, scratch);
+    sinceSnapshot = 0;
+}
+
+bool CommandJournal::snapshotDue() const {
+    return snapshotInterval != 0 && sinceSnapshot >= snapshotInterval;
+}
+
+size_t CommandJournal::getSnapshotInterval() const {
+    return snapshotInterval;
+}
+
+uint64_t CommandJournal::getRecordCount() const {
+    return recordCount;
+}
+
+uint64_t CommandJournal::getByteCount() const {
+    return byteCount;
+}
+
+uint64_t CommandJournal::getCheckpointCount() const {
+    return checkpointCount;
+}
+
+void CommandJournal::putString(std::string& payload, const std::string& text) {
+    putString(payload, text.data(), text.size());
+}
+
+void CommandJournal::putString(std::string& payload, const char* text, size_t size) {
+    putUint32(payload, static_cast<uint32_t>(size));
+    payload.append(text, size);
+}
+
+void CommandJournal::putUint32(std::string& payload, uint32_t value) {
+    char bytes[4] = {
+        static_cast<char>(value & 0xFF),
+        static_cast<char>((value >> 8) & 0xFF),
+        static_cast<char>((value >> 16) & 0xFF),
+        static_cast<char>((value >> 24) & 0xFF)
+    };
+    payload.append(bytes, 4);
+}
+
+void CommandJournal::putUint64(std::string& payload, uint64_t value) {
+    putUint32(payload, static_cast<uint32_t>(value & 0xFFFFFFFFu));
+    putUint32(payload, static_cast<uint32_t>(value >> 32));
+}
+
+void CommandJournal::putPositions(std::string& payload, const std::vector<bool>& flags) {
+    uint32_t count = static_cast<uint32_t>(std::count(flags.begin(), flags.end(), true));
+    putUint32(payload, count);
+    for (size_t i = 0; count != 0 && i < flags.size(); i++) {
+        if (flags[i]) {
+            putUint32(payload, static_cast<uint32_t>(i));
+            count--;
+        }
+    }
+}
+
+void CommandJournal::writeRecord(RecordType type, const std::string& payload) {
+    std::string header;
+    putUint32(header, static_cast<uint32_t>(payload.size()));
+    header.push_back(static_cast<char>(type));
+    out.write(header.data(), header.size());
+    out.write(payload.data(), payload.size());
+    recordCount++;
+    byteCount += HEADER_SIZE + payload.size();
+    if (type != SNAPSHOT && type != CHECKPOINT) {
+        sinceSnapshot++;
+    }
+}
@@ -0,0 +1,184 @@
+/**
+ * @file CommandJournal.h
+ * @brief Append-only binary journal of room events
+ * @date 19/10/2026
+ */
+
+#ifndef COMMANDJOURNAL_H
+#define COMMANDJOURNAL_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <ostream>
+#include <stdint.h>
+
+class ChatRoom;
+
+/**
+ * @brief Writes a room's joins, leaves, sends and snapshots to a stream
+ * 
+ * Every record is a 4-byte little-endian payload length, a 1-byte record
+ * type and the payload. Strings inside a payload are a 4-byte length
+ * followed by the bytes. Records are only ever appended, so a crash can
+ * at worst leave one truncated record at the end, which ReplayEngine
+ * ignores.
+ * 
+ * With a snapshot interval set, the room writes a snapshot of its members
+ * and history after every interval records, so recovery only has to
+ * replay the records after the last snapshot. Compressed history segments
+ * are written once, as CHECKPOINT records holding the compressed bytes,
+ * and snapshots refer to them by offset along with their current
+ * tombstone flags. A snapshot therefore only repeats the hot entries and
+ * the members, and the journal grows linearly with the history. A segment
+ * that is resealed by an edit or compaction is checkpointed again. A room
+ * given a journal with snapshots turns on history segments of
+ * SEGMENT_SIZE messages if it had none.
+ * 
+ * SEND records carry the text that was actually delivered (after masking),
+ * so replay does not need the room's filter or flood guard. Replayed sends
+ * get the same history ids as the original because snapshots store every
+ * entry's id and the next id to hand out, and compactions are recorded so
+ * replay drops the same tombstones.
+ * 
+ * Users are recorded by User::getId() as well as by name, so members who
+ * share a name stay apart on replay. Every message's sender id is kept
+ * too, in its SEND record and then in the snapshots and checkpoints that
+ * hold the message, so replay can restore who may edit or delete it. Ids are only unique within the
+ * process that wrote the journal; ReplayEngine::restore() maps them to
+ * the users of the recovering process.
+ */
+class CommandJournal {
+public:
+    /**
+     * @brief Record types
+     */
+    enum RecordType {
+        JOIN = 1,       ///< User id, user name
+        LEAVE = 2,      ///< User id
+        SEND = 3,       ///< Sender id, sender name, message
+        SNAPSHOT = 4,   ///< Member ids and names, next id, segment references, hot entries with ids and sender ids
+        CLEAR = 5,      ///< History cleared, no payload
+        TOMBSTONE = 6,  ///< Message id retracted
+        RESTORE = 7,    ///< Message id restored
+        EDIT = 8,       ///< Message id, new formatted entry
+        DELETE = 9,     ///< Message id deleted for good
+        CHECKPOINT = 10,///< One compressed history segment and its sender ids, read through a snapshot
+        COMPACT = 11    ///< Tombstoned messages dropped, no payload
+    };
+
+    static const size_t HEADER_SIZE = 5;
+
+    /** History segment size a room switches on when given a journal with snapshots */
+    static const size_t SEGMENT_SIZE = 4096;
+
+    /**
+     * @brief Constructor
+     * @param out Stream records are appended to; must outlive the journal
+     * @param snapshotInterval Records between snapshots, or 0 for none
+     */
+    explicit CommandJournal(std::ostream& out, size_t snapshotInterval = 0);
+
+    void appendJoin(uint64_t userId, const std::string& userName);
+    void appendLeave(uint64_t userId);
+    void appendSend(uint64_t userId, const std::string& userName, const char* message, size_t length);
+    void appendClear();
+    void appendCompact();
+    void appendTombstone(uint64_t messageId);
+    void appendRestore(uint64_t messageId);
+    void appendEdit(uint64_t messageId, const std::string& formattedMessage);
+    void appendDelete(uint64_t messageId);
+
+    /**
+     * @brief Write a snapshot of a room's members and history
+     * 
+     * Segments not yet in the journal are checkpointed first. Segments
+     * are never decompressed.
+     * 
+     * @param room The room to snapshot
+     */
+    void appendSnapshot(const ChatRoom& room);
+
+    /**
+     * @brief Check whether the room should write a snapshot now
+     * @return True once snapshotInterval records were written since the last snapshot
+     */
+    bool snapshotDue() const;
+
+    /**
+     * @brief Get the snapshot interval
+     * @return Records between snapshots, or 0 for none
+     */
+    size_t getSnapshotInterval() const;
+
+    /**
+     * @brief Get the number of records written
+     * @return Record count, snapshots included
+     */
+    uint64_t getRecordCount() const;
+
+    /**
+     * @brief Get the number of bytes written
+     * @return Journal size in bytes
+     */
+    uint64_t getByteCount() const;
+
+    /**
+     * @brief Get the number of segment checkpoints written
+     * @return CHECKPOINT record count
+     */
+    uint64_t getCheckpointCount() const;
+
+    /**
+     * @brief Append a length-prefixed string to a payload
+     * @param payload Buffer to append to
+     * @param text The string
+     */
+    static void putString(std::string& payload, const std::string& text);
+
+    /**
+     * @brief Append a length-prefixed string to a payload
+     * @param payload Buffer to append to
+     * @param text The string's bytes
+     * @param size The string's length
+     */
+    static void putString(std::string& payload, const char* text, size_t size);
+
+    /**
+     * @brief Append a 32-bit little-endian value to a payload
+     * @param payload Buffer to append to
+     * @param value The value
+     */
+    static void putUint32(std::string& payload, uint32_t value);
+
+    /**
+     * @brief Append a 64-bit little-endian value to a payload
+     * @param payload Buffer to append to
+     * @param value The value
+     */
+    static void putUint64(std::string& payload, uint64_t value);
+
+    /**
+     * @brief Append the positions of the set flags to a payload
+     * @param payload Buffer to append to
+     * @param flags The flags; written as a 32-bit count, then one 32-bit position per set flag
+     */
+    static void putPositions(std::string& payload, const std::vector<bool>& flags);
+
+private:
+    std::ostream& out;
+    size_t snapshotInterval;
+    size_t sinceSnapshot;
+    uint64_t recordCount;
+    uint64_t byteCount;
+    uint64_t checkpointCount;
+    std::unordered_map<uint64_t, uint64_t> checkpoints;    ///< Segment serial to record offset
+    std::string scratch;
+
+    void writeRecord(RecordType type, const std::string& payload);
+
+    CommandJournal(const CommandJournal&);
+    CommandJournal& operator=(const CommandJournal&);
+};
+
+#endif
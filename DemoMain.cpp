@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <signal.h>
+
+#include "ChatServer.h"
+#include "LoadGenerator.h"
+
+/**
+ * @file DemoMain.cpp
+ * @brief Runs PetSpace as a TCP chat server, or drives one with load
+ * @date 19/10/2026
+ *
+ * Usage:
+ *     ./demo [port]                                  serve until Ctrl-C (default port 5555)
+ *     ./demo --load <host> <port> <clients> <msgs>   run one load round against a server
+ */
+
+namespace {
+
+ChatServer* runningServer = nullptr;
+
+void handleInterrupt(int) {
+    if (runningServer) {
+        runningServer->stop();
+    }
+}
+
+int runLoad(int argc, char* argv[]) {
+    if (argc < 6) {
+        std::cerr << "Error: Usage: " << argv[0] << " --load <host> <port> <clients> <messages>" << std::endl;
+        return 1;
+    }
+    LoadGenerator generator(argv[2], static_cast<uint16_t>(std::atoi(argv[3])));
+    LoadGenerator::Result result;
+    bool ok = generator.run(static_cast<size_t>(std::atol(argv[4])), static_cast<size_t>(std::atol(argv[5])), result);
+    std::cout << "Clients: " << result.clients << std::endl;
+    std::cout << "Messages sent: " << result.messagesSent << std::endl;
+    std::cout << "Messages received: " << result.messagesReceived << std::endl;
+    std::cout << "Seconds: " << result.seconds << std::endl;
+    if (result.seconds > 0.0) {
+        std::cout << "Deliveries per second: " << result.messagesReceived / result.seconds << std::endl;
+    }
+    if (!ok) {
+        std::cerr << "Error: Load round did not complete" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--load") {
+        return runLoad(argc, argv);
+    }
+
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(std::atoi(argv[1])) : 5555;
+    ChatServer server;
+    if (!server.start(port, "0.0.0.0")) {
+        return 1;
+    }
+    runningServer = &server;
+    signal(SIGINT, handleInterrupt);
+    signal(SIGTERM, handleInterrupt);
+
+    std::cout << "PetSpace chat server listening on port " << server.getPort() << std::endl;
+    server.run();
+    runningServer = nullptr;
+    std::cout << "Server stopped after " << server.getFramesReceived() << " frames in, "
+              << server.getFramesSent() << " frames out" << std::endl;
+    return 0;
+}
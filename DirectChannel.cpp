@@ -0,0 +1,79 @@
+#include "DirectChannel.h"
+#include "Users.h"
+#include <iostream>
+
+/**
+ * @file DirectChannel.cpp
+ * @brief Implementation of the one-to-one message channel
+ */
+
+DirectChannel::DirectChannel(User* firstUser, User* secondUser) : first(firstUser), second(secondUser) {
+}
+
+bool DirectChannel::append(User* fromUser, const std::string& message) {
+    if (!hasParticipant(fromUser)) {
+        std::cerr << "Error: Sender is not part of this direct channel" << std::endl;
+        return false;
+    }
+    if (message.size() > 0x7FFFFFFFu || text.size() + message.size() > 0xFFFFFFFFu) {
+        std::cerr << "Error: Direct channel history is full" << std::endl;
+        return false;
+    }
+
+    Entry entry;
+    entry.offset = static_cast<uint32_t>(text.size());
+    entry.length = static_cast<uint32_t>(message.size());
+    entry.fromSecond = (fromUser == second && fromUser != first) ? 1 : 0;
+    text.append(message);
+    entries.push_back(entry);
+    return true;
+}
+
+User* DirectChannel::getPeer(const User* self) const {
+    if (self == first) {
+        return second;
+    }
+    if (self == second) {
+        return first;
+    }
+    return nullptr;
+}
+
+bool DirectChannel::hasParticipant(const User* user) const {
+    return user != nullptr && (user == first || user == second);
+}
+
+size_t DirectChannel::size() const {
+    return entries.size();
+}
+
+std::string DirectChannel::getMessage(size_t index) const {
+    if (index >= entries.size()) {
+        return "";
+    }
+    return text.substr(entries[index].offset, entries[index].length);
+}
+
+User* DirectChannel::getSender(size_t index) const {
+    if (index >= entries.size()) {
+        return nullptr;
+    }
+    return entries[index].fromSecond ? second : first;
+}
+
+std::string DirectChannel::formatMessage(size_t index) const {
+    User* sender = getSender(index);
+    if (sender == nullptr) {
+        return "";
+    }
+    return "[" + sender->getName() + "]: " + getMessage(index) + "\n";
+}
+
+size_t DirectChannel::getTextBytes() const {
+    return text.size();
+}
+
+void DirectChannel::clear() {
+    text.clear();
+    entries.clear();
+}
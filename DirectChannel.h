@@ -0,0 +1,109 @@
+/**
+ * @file DirectChannel.h
+ * @brief Private one-to-one message channel between two users
+ * @date 19/10/2026
+ */
+
+#ifndef DIRECTCHANNEL_H
+#define DIRECTCHANNEL_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class User;
+
+/**
+ * @brief Conversation between exactly two users
+ * 
+ * A direct channel has no observers, command queue or member list. Both
+ * users hold the same channel through a shared_ptr keyed by the other user,
+ * so finding it is a single hash lookup. Message text is appended to one
+ * growing buffer and each entry stores only its offset, length and which
+ * side sent it, instead of a separately formatted string per message.
+ * 
+ * The history holds up to 4 GiB of text; sends beyond that are rejected.
+ */
+class DirectChannel {
+public:
+    /**
+     * @brief Constructor
+     * @param first One participant
+     * @param second The other participant
+     */
+    DirectChannel(User* first, User* second);
+
+    /**
+     * @brief Append a message to the history
+     * @param fromUser The sender, which must be a participant
+     * @param message The message content
+     * @return True if the message was stored
+     */
+    bool append(User* fromUser, const std::string& message);
+
+    /**
+     * @brief Get the participant that is not the given user
+     * @param self One participant
+     * @return The other participant, or nullptr if self is not a participant
+     */
+    User* getPeer(const User* self) const;
+
+    /**
+     * @brief Check whether a user is one of the two participants
+     * @param user The user to check
+     * @return True if the user is a participant
+     */
+    bool hasParticipant(const User* user) const;
+
+    /**
+     * @brief Get the number of messages in the history
+     * @return Message count
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the text of a message
+     * @param index Message index, oldest first
+     * @return The message content
+     */
+    std::string getMessage(size_t index) const;
+
+    /**
+     * @brief Get the sender of a message
+     * @param index Message index, oldest first
+     * @return The participant who sent it
+     */
+    User* getSender(size_t index) const;
+
+    /**
+     * @brief Format a message the way chat room history is formatted
+     * @param index Message index, oldest first
+     * @return "[Username]: Message\n"
+     */
+    std::string formatMessage(size_t index) const;
+
+    /**
+     * @brief Get the number of bytes of message text stored
+     * @return Text size in bytes
+     */
+    size_t getTextBytes() const;
+
+    /**
+     * @brief Remove all messages
+     */
+    void clear();
+
+private:
+    struct Entry {
+        uint32_t offset;
+        uint32_t length : 31;
+        uint32_t fromSecond : 1;
+    };
+
+    User* first;
+    User* second;
+    std::string text;
+    std::vector<Entry> entries;
+};
+
+#endif
@@ -16,12 +16,10 @@
  * 
  * Dogorithm is a concrete implementation of the ChatRoom mediator.
  * It handles all communication between users interested in dogs and
- * algorithm/programming topics.
+ * algorithm/programming topics. Its name, greetings and banners come
+ * from RoomPolicy::dogorithm().
  */
 class Dogorithm : public ChatRoom {
-private:
-    static const std::string ROOM_NAME; ///< Static room name
-
 public:
     /**
      * @brief Constructor for Dogorithm chat room
@@ -32,28 +30,6 @@ public:
      * @brief Virtual destructor
      */
     virtual ~Dogorithm();
-    
-    /**
-     * @brief Register a user with the Dogorithm chat room
-     * @param user The user to register
-     * 
-     * Adds the user to the room and notifies other users
-     */
-    void registerUser(User* user);
-    
-    /**
-     * @brief Remove a user from the Dogorithm chat room
-     * @param user The user to remove
-     * 
-     * Removes the user from the room and notifies other users
-     */
-    void removeUser(User* user);
-    
-    /**
-     * @brief Get the name of this chat room
-     * @return The room name "Dogorithm"
-     */
-    std::string getName() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,223 @@
+#include "FloodGuard.h"
+#include "Message.h"
+#include <chrono>
+#include <cstring>
+
+/**
+ * @file FloodGuard.cpp
+ * @brief Implementation of the per-room flood guard
+ */
+
+namespace {
+
+uint64_t hashPointer(const void* pointer) {
+    uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer));
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    return value;
+}
+
+uint64_t fingerprintOf(const User* sender, const char* message, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ hashPointer(sender);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(message[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash | 1;    // 0 marks an empty slot
+}
+
+uint64_t monotonicNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+
+const size_t FloodGuard::BUCKET_SLOTS;
+const size_t FloodGuard::BUCKET_PROBES;
+const size_t FloodGuard::RECENT_WINDOW;
+const size_t FloodGuard::FINGERPRINT_SLOTS;
+
+/**
+ * @brief Constructor
+ * @param messagesPerSecond Sustained rate allowed per sender
+ * @param burst Messages a sender may send back to back
+ */
+FloodGuard::FloodGuard(double messagesPerSecond, unsigned int burst)
+    : emissionInterval(1), burstTolerance(0), recentHead(0),
+      rateLimitedCount(0), duplicateCount(0) {
+    if (messagesPerSecond > 0.0) {
+        emissionInterval = static_cast<uint64_t>(1e9 / messagesPerSecond);
+        if (emissionInterval == 0) {
+            emissionInterval = 1;
+        }
+    }
+    if (burst == 0) {
+        burst = 1;
+    }
+    burstTolerance = emissionInterval * (burst - 1);
+    reset();
+}
+
+/**
+ * @brief Check a message against the current time
+ * @param sender The user sending the message
+ * @param message The message content
+ * @return Decision for this message
+ */
+FloodGuard::Decision FloodGuard::check(const User* sender, const std::string& message) {
+    return check(sender, message, monotonicNanos());
+}
+
+/**
+ * @brief Check a message against an explicit timestamp
+ * @param sender The user sending the message
+ * @param message The message content
+ * @param nowNanos Monotonic time in nanoseconds
+ * @return Decision for this message
+ */
+FloodGuard::Decision FloodGuard::check(const User* sender, const std::string& message, uint64_t nowNanos) {
+    return checkText(sender, message.data(), message.size(), nowNanos);
+}
+
+/**
+ * @brief Check a shared message against the current time, reading its text in place
+ * @param sender The user sending the message
+ * @param message The message
+ * @return Decision for this message
+ */
+FloodGuard::Decision FloodGuard::check(const User* sender, const Message& message) {
+    return checkText(sender, message.data(), message.size(), monotonicNanos());
+}
+
+/**
+ * @brief Check a message's text against a timestamp
+ * @param sender The user sending the message
+ * @param text Pointer to the message content
+ * @param length Number of bytes in the message
+ * @param nowNanos Monotonic time in nanoseconds
+ * @return Decision for this message
+ *
+ * The rate is checked first so a flooding sender cannot fill the duplicate
+ * window with messages that are dropped anyway.
+ */
+FloodGuard::Decision FloodGuard::checkText(const User* sender, const char* text, size_t length, uint64_t nowNanos) {
+    if (!admitRate(sender, nowNanos)) {
+        rateLimitedCount++;
+        return RATE_LIMITED;
+    }
+
+    if (!rememberFingerprint(fingerprintOf(sender, text, length))) {
+        duplicateCount++;
+        return DUPLICATE;
+    }
+
+    return ALLOWED;
+}
+
+/**
+ * @brief Forget all senders and recent messages
+ */
+void FloodGuard::reset() {
+    std::memset(buckets, 0, sizeof(buckets));
+    std::memset(recent, 0, sizeof(recent));
+    std::memset(fingerprints, 0, sizeof(fingerprints));
+    recentHead = 0;
+}
+
+/**
+ * @brief Free a sender's bucket
+ * @param sender The user to forget
+ *
+ * Lookups always probe every slot, so an emptied slot never hides a
+ * bucket further along.
+ */
+void FloodGuard::forget(const User* sender) {
+    size_t home = static_cast<size_t>(hashPointer(sender)) & (BUCKET_SLOTS - 1);
+    for (size_t probe = 0; probe < BUCKET_PROBES; probe++) {
+        Bucket* candidate = &buckets[(home + probe) & (BUCKET_SLOTS - 1)];
+        if (candidate->sender == sender) {
+            candidate->sender = nullptr;
+            candidate->theoreticalArrival = 0;
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Get the number of messages dropped for exceeding the rate
+ * @return Rate limited message count
+ */
+uint64_t FloodGuard::getRateLimitedCount() const {
+    return rateLimitedCount;
+}
+
+/**
+ * @brief Get the number of messages dropped as exact repeats
+ * @return Duplicate message count
+ */
+uint64_t FloodGuard::getDuplicateCount() const {
+    return duplicateCount;
+}
+
+/**
+ * @brief Find or recycle the sender's bucket and take a token from it
+ * @param sender The user sending the message
+ * @param nowNanos Monotonic time in nanoseconds
+ * @return True if the sender still had a token
+ */
+bool FloodGuard::admitRate(const User* sender, uint64_t nowNanos) {
+    size_t home = static_cast<size_t>(hashPointer(sender)) & (BUCKET_SLOTS - 1);
+    Bucket* bucket = nullptr;
+    Bucket* victim = nullptr;
+
+    for (size_t probe = 0; probe < BUCKET_PROBES; probe++) {
+        Bucket* candidate = &buckets[(home + probe) & (BUCKET_SLOTS - 1)];
+        if (candidate->sender == sender) {
+            bucket = candidate;
+            break;
+        }
+        if (victim == nullptr || candidate->theoreticalArrival < victim->theoreticalArrival) {
+            victim = candidate;
+        }
+    }
+
+    if (bucket == nullptr) {
+        bucket = victim;
+        bucket->sender = sender;
+        bucket->theoreticalArrival = 0;
+    }
+
+    uint64_t arrival = bucket->theoreticalArrival > nowNanos ? bucket->theoreticalArrival : nowNanos;
+    if (arrival - nowNanos > burstTolerance) {
+        return false;
+    }
+    bucket->theoreticalArrival = arrival + emissionInterval;
+    return true;
+}
+
+/**
+ * @brief Add a fingerprint to the rolling window
+ * @param fingerprint Non-zero message fingerprint
+ * @return False if the fingerprint is already in the window
+ */
+bool FloodGuard::rememberFingerprint(uint64_t fingerprint) {
+    size_t slot = static_cast<size_t>(fingerprint >> 7) & (FINGERPRINT_SLOTS - 1);
+    if (fingerprints[slot] == fingerprint) {
+        return false;
+    }
+
+    uint64_t expired = recent[recentHead];
+    if (expired != 0) {
+        size_t expiredSlot = static_cast<size_t>(expired >> 7) & (FINGERPRINT_SLOTS - 1);
+        if (fingerprints[expiredSlot] == expired) {
+            fingerprints[expiredSlot] = 0;
+        }
+    }
+
+    recent[recentHead] = fingerprint;
+    recentHead = (recentHead + 1) & (RECENT_WINDOW - 1);
+    fingerprints[slot] = fingerprint;
+    return true;
+}
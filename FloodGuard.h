@@ -0,0 +1,129 @@
+/**
+ * @file FloodGuard.h
+ * @brief Per-room flood detection with fixed memory and O(1) checks
+ * @date 19/10/2026
+ */
+
+#ifndef FLOODGUARD_H
+#define FLOODGUARD_H
+
+#include <string>
+#include <stdint.h>
+
+class User;
+class Message;
+
+/**
+ * @brief Drops flooding and repeated messages before they reach a room
+ *
+ * Each sender gets a token bucket, tracked with the generic cell rate
+ * algorithm so a bucket is a single timestamp. Buckets live in a fixed
+ * open-addressed table; when a probe window is full the bucket with the
+ * least outstanding debt is recycled, so memory never grows with the number
+ * of senders.
+ *
+ * Exact repeats are caught with a rolling window of the most recent message
+ * fingerprints (sender + text) backed by a direct-mapped hash set. A
+ * fingerprint collision can only let a repeat through, never drop a new
+ * message.
+ *
+ * check() does no allocation and runs in constant time.
+ */
+class FloodGuard {
+public:
+    /**
+     * @brief Outcome of a flood check
+     */
+    enum Decision {
+        ALLOWED,        ///< Message may be sent
+        RATE_LIMITED,   ///< Sender has exhausted their burst
+        DUPLICATE       ///< Same sender sent the same text recently
+    };
+
+    static const size_t BUCKET_SLOTS = 1024;    ///< Sender buckets, power of two
+    static const size_t BUCKET_PROBES = 8;      ///< Slots examined per lookup
+    static const size_t RECENT_WINDOW = 256;    ///< Fingerprints remembered for duplicates
+    static const size_t FINGERPRINT_SLOTS = 1024; ///< Hash set slots, power of two
+
+    /**
+     * @brief Constructor
+     * @param messagesPerSecond Sustained rate allowed per sender (must be > 0)
+     * @param burst Messages a sender may send back to back (at least 1)
+     */
+    FloodGuard(double messagesPerSecond, unsigned int burst);
+
+    /**
+     * @brief Check a message against the current time
+     * @param sender The user sending the message
+     * @param message The message content
+     * @return Decision for this message
+     */
+    Decision check(const User* sender, const std::string& message);
+
+    /**
+     * @brief Check a message against an explicit timestamp
+     * @param sender The user sending the message
+     * @param message The message content
+     * @param nowNanos Monotonic time in nanoseconds
+     * @return Decision for this message
+     */
+    Decision check(const User* sender, const std::string& message, uint64_t nowNanos);
+
+    /**
+     * @brief Check a shared message against the current time, reading its text in place
+     * @param sender The user sending the message
+     * @param message The message
+     * @return Decision for this message
+     */
+    Decision check(const User* sender, const Message& message);
+
+    /**
+     * @brief Forget all senders and recent messages
+     */
+    void reset();
+
+    /**
+     * @brief Free a sender's bucket
+     * 
+     * Called when the user is deleted, so a later user at the same address
+     * does not inherit the sender's rate.
+     * 
+     * @param sender The user to forget
+     */
+    void forget(const User* sender);
+
+    /**
+     * @brief Get the number of messages dropped for exceeding the rate
+     * @return Rate limited message count
+     */
+    uint64_t getRateLimitedCount() const;
+
+    /**
+     * @brief Get the number of messages dropped as exact repeats
+     * @return Duplicate message count
+     */
+    uint64_t getDuplicateCount() const;
+
+private:
+    struct Bucket {
+        const User* sender;
+        uint64_t theoreticalArrival;    ///< Time at which the bucket is full again
+    };
+
+    uint64_t emissionInterval;          ///< Nanoseconds per token
+    uint64_t burstTolerance;            ///< How far ahead of now a sender may run
+
+    Bucket buckets[BUCKET_SLOTS];
+    uint64_t recent[RECENT_WINDOW];
+    size_t recentHead;
+    uint64_t fingerprints[FINGERPRINT_SLOTS];
+
+    uint64_t rateLimitedCount;
+    uint64_t duplicateCount;
+
+    Decision checkText(const User* sender, const char* text, size_t length, uint64_t nowNanos);
+    bool admitRate(const User* sender, uint64_t nowNanos);
+    bool rememberFingerprint(uint64_t fingerprint);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "HistoryExporter.h"
+#include "ChatHistory.h"
+#include "LzCodec.h"
+#include <iostream>
+
+/**
+ * @file HistoryExporter.cpp
+ * @brief Implementation of the streaming history exporter
+ */
+
+const char HistoryExporter::MAGIC[4] = { 'P', 'S', 'H', 'X' };
+
+HistoryExporter::HistoryExporter(std::ostream& output, Format outputFormat, size_t chunk)
+    : out(output), format(outputFormat), chunkBytes(chunk == 0 ? DEFAULT_CHUNK_BYTES : chunk),
+      entriesWritten(0), bytesWritten(0), lastId(0), headerWritten(false) {
+    buffer.reserve(chunkBytes + 256);
+}
+
+bool HistoryExporter::exportHistory(const ChatHistory& history, bool includeTombstones) {
+    if (format == BINARY && !headerWritten) {
+        buffer.append(MAGIC, sizeof(MAGIC));
+        buffer.push_back(static_cast<char>(VERSION));
+    }
+    headerWritten = true;
+
+    size_t stored = history.getStoredCount();
+    for (size_t i = 0; i < stored; i++) {
+        const ChatHistory::Entry& entry = history.getEntry(i);
+        if (entry.tombstoned && !includeTombstones) {
+            continue;
+        }
+
+        if (format == NDJSON) {
+            buffer += "{\"id\":";
+            buffer += std::to_string(entry.id);
+            buffer += ",\"text\":";
+            appendJsonString(buffer, entry.text.data(), entry.text.size());
+            if (entry.tombstoned) {
+                buffer += ",\"tombstoned\":true";
+            }
+            buffer += "}\n";
+        } else {
+            LzCodec::putVarint(buffer, entry.id - lastId);
+            buffer.push_back(entry.tombstoned ? 1 : 0);
+            LzCodec::putVarint(buffer, entry.text.size());
+            buffer.append(entry.text.data(), entry.text.size());
+        }
+        lastId = entry.id;
+        entriesWritten++;
+
+        if (buffer.size() >= chunkBytes && !flush()) {
+            return false;
+        }
+    }
+    return flush();
+}
+
+uint64_t HistoryExporter::getEntriesWritten() const {
+    return entriesWritten;
+}
+
+uint64_t HistoryExporter::getBytesWritten() const {
+    return bytesWritten;
+}
+
+void HistoryExporter::appendJsonString(std::string& out, const std::string& text) {
+    appendJsonString(out, text.data(), text.size());
+}
+
+void HistoryExporter::appendJsonString(std::string& out, const char* text, size_t size) {
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    out += "\\u00";
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 0x0F]);
+                } else {
+                    out.push_back(static_cast<char>(c));
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+bool HistoryExporter::flush() {
+    if (!buffer.empty()) {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        bytesWritten += buffer.size();
+        buffer.clear();
+    }
+    if (!out) {
+        std::cerr << "Error: History export stream failed after " << entriesWritten << " entries" << std::endl;
+        return false;
+    }
+    return true;
+}
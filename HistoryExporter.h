@@ -0,0 +1,110 @@
+/**
+ * @file HistoryExporter.h
+ * @brief Streams a room's history out as NDJSON or a compact binary format
+ * @date 19/10/2026
+ */
+
+#ifndef HISTORYEXPORTER_H
+#define HISTORYEXPORTER_H
+
+#include <string>
+#include <ostream>
+#include <stdint.h>
+
+class ChatHistory;
+
+/**
+ * @brief Writes a ChatHistory to a stream one entry at a time
+ *
+ * Entries are encoded into a buffer that is written out whenever it
+ * reaches the chunk size, so memory use does not depend on the history's
+ * length; compressed history segments are decoded one at a time.
+ *
+ * NDJSON writes one object per line:
+ *
+ *     {"id":12,"text":"[Ann]: hi\n"}
+ *     {"id":13,"text":"[Bob]: oops\n","tombstoned":true}
+ *
+ * BINARY writes the magic "PSHX", a version byte, then per entry the id
+ * as a varint delta from the previous id, a flags byte (1 = tombstoned),
+ * the text length as a varint and the text. Both are read back by
+ * HistoryImporter.
+ */
+class HistoryExporter {
+public:
+    /**
+     * @brief Export formats
+     */
+    enum Format {
+        NDJSON,     ///< Newline-delimited JSON, one entry per line
+        BINARY      ///< Varint-framed records
+    };
+
+    static const char MAGIC[4];
+    static const unsigned char VERSION = 1;
+    static const size_t DEFAULT_CHUNK_BYTES = 64 * 1024;
+
+    /**
+     * @brief Constructor
+     * @param out Stream to write to; must outlive the exporter
+     * @param format Output format
+     * @param chunkBytes Bytes buffered between writes
+     */
+    HistoryExporter(std::ostream& out, Format format, size_t chunkBytes = DEFAULT_CHUNK_BYTES);
+
+    /**
+     * @brief Write every live entry of a history, oldest first
+     *
+     * May be called more than once; binary output writes its header only
+     * on the first call.
+     *
+     * @param history The history to export
+     * @param includeTombstones Also write retracted entries, flagged
+     * @return False if the stream failed, which is reported on std::cerr
+     */
+    bool exportHistory(const ChatHistory& history, bool includeTombstones = false);
+
+    /**
+     * @brief Get the number of entries written
+     * @return Entry count
+     */
+    uint64_t getEntriesWritten() const;
+
+    /**
+     * @brief Get the number of bytes written
+     * @return Output size in bytes
+     */
+    uint64_t getBytesWritten() const;
+
+    /**
+     * @brief Append text as a quoted JSON string
+     * @param out Buffer to append to
+     * @param text Text to escape
+     */
+    static void appendJsonString(std::string& out, const std::string& text);
+
+    /**
+     * @brief Append text as a quoted JSON string
+     * @param out Buffer to append to
+     * @param text Bytes to escape
+     * @param size Number of bytes
+     */
+    static void appendJsonString(std::string& out, const char* text, size_t size);
+
+private:
+    std::ostream& out;
+    Format format;
+    size_t chunkBytes;
+    std::string buffer;
+    uint64_t entriesWritten;
+    uint64_t bytesWritten;
+    uint64_t lastId;
+    bool headerWritten;
+
+    bool flush();
+
+    HistoryExporter(const HistoryExporter&);
+    HistoryExporter& operator=(const HistoryExporter&);
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include "HistoryImporter.h"
+#include "ChatRoom.h"
+#include "LzCodec.h"
+#include <iostream>
+#include <string.h>
+
+/**
+ * @file HistoryImporter.cpp
+ * @brief Implementation of the streaming history importer
+ */
+
+namespace {
+
+void skipSpace(const std::string& line, size_t& pos) {
+    while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r')) {
+        pos++;
+    }
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out.push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+bool parseHex4(const std::string& line, size_t& pos, uint32_t& value) {
+    if (line.size() - pos < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = line[pos++];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseString(const std::string& line, size_t& pos, std::string& out) {
+    if (pos >= line.size() || line[pos] != '"') {
+        return false;
+    }
+    pos++;
+    out.clear();
+    while (pos < line.size()) {
+        // Copy the run up to the next quote or escape in one go
+        size_t run = line.find_first_of("\"\\", pos);
+        if (run == std::string::npos) {
+            return false;
+        }
+        out.append(line, pos, run - pos);
+        pos = run;
+        if (line[pos] == '"') {
+            pos++;
+            return true;
+        }
+        if (++pos >= line.size()) {
+            return false;
+        }
+        char escape = line[pos++];
+        switch (escape) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t codePoint;
+                if (!parseHex4(line, pos, codePoint)) {
+                    return false;
+                }
+                if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+                    uint32_t low;
+                    if (line.compare(pos, 2, "\\u") != 0) {
+                        return false;
+                    }
+                    pos += 2;
+                    if (!parseHex4(line, pos, low) || low < 0xDC00 || low >= 0xE000) {
+                        return false;
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, codePoint);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return false;
+}
+
+bool parseUnsigned(const std::string& line, size_t& pos, uint64_t& value) {
+    size_t start = pos;
+    value = 0;
+    while (pos < line.size() && line[pos] >= '0' && line[pos] <= '9') {
+        value = value * 10 + static_cast<uint64_t>(line[pos] - '0');
+        pos++;
+    }
+    return pos != start && pos - start <= 19;
+}
+
+bool parseBool(const std::string& line, size_t& pos, bool& value) {
+    if (line.compare(pos, 4, "true") == 0) {
+        value = true;
+        pos += 4;
+        return true;
+    }
+    if (line.compare(pos, 5, "false") == 0) {
+        value = false;
+        pos += 5;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Skip a value of an unknown key, nested objects and arrays included
+ */
+bool skipValue(const std::string& line, size_t& pos) {
+    std::string ignored;
+    int depth = 0;
+    while (pos < line.size()) {
+        char c = line[pos];
+        if (c == '"') {
+            if (!parseString(line, pos, ignored)) {
+                return false;
+            }
+        } else if (c == '{' || c == '[') {
+            depth++;
+            pos++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) {
+                return true;
+            }
+            depth--;
+            pos++;
+        } else if (c == ',' && depth == 0) {
+            return true;
+        } else {
+            pos++;
+        }
+    }
+    return false;
+}
+
+}
+
+HistoryImporter::HistoryImporter(std::istream& input, HistoryExporter::Format inputFormat)
+    : in(input), format(inputFormat), chunk(CHUNK_BYTES), chunkPos(0), chunkEnd(0),
+      entriesImported(0), bytesRead(0) {
+}
+
+bool HistoryImporter::importInto(ChatRoom& room) {
+    uint64_t before = entriesImported;
+    bool ok = format == HistoryExporter::NDJSON ? importJson(room) : importBinary(room);
+    room.finishImport(static_cast<size_t>(entriesImported - before));
+    return ok;
+}
+
+uint64_t HistoryImporter::getEntriesImported() const {
+    return entriesImported;
+}
+
+uint64_t HistoryImporter::getBytesRead() const {
+    return bytesRead;
+}
+
+bool HistoryImporter::parseJsonLine(const std::string& line, uint64_t& id, std::string& text, bool& tombstoned) {
+    std::string key;
+    size_t pos = 0;
+    bool haveText = false;
+    id = 0;
+    tombstoned = false;
+
+    skipSpace(line, pos);
+    if (pos >= line.size() || line[pos] != '{') {
+        return false;
+    }
+    pos++;
+    skipSpace(line, pos);
+    while (pos < line.size() && line[pos] != '}') {
+        if (!parseString(line, pos, key)) {
+            return false;
+        }
+        skipSpace(line, pos);
+        if (pos >= line.size() || line[pos] != ':') {
+            return false;
+        }
+        pos++;
+        skipSpace(line, pos);
+
+        bool ok;
+        if (key == "id") {
+            ok = parseUnsigned(line, pos, id);
+        } else if (key == "text") {
+            ok = parseString(line, pos, text);
+            haveText = ok;
+        } else if (key == "tombstoned") {
+            ok = parseBool(line, pos, tombstoned);
+        } else {
+            ok = skipValue(line, pos);
+        }
+        if (!ok) {
+            return false;
+        }
+
+        skipSpace(line, pos);
+        if (pos < line.size() && line[pos] == ',') {
+            pos++;
+            skipSpace(line, pos);
+        } else if (pos >= line.size() || line[pos] != '}') {
+            return false;
+        }
+    }
+    if (pos >= line.size()) {
+        return false;
+    }
+    pos++;
+    skipSpace(line, pos);
+    return pos == line.size() && haveText;
+}
+
+bool HistoryImporter::importJson(ChatRoom& room) {
+    std::string line;
+    std::string text;
+    uint64_t lineNumber = 0;
+    while (readLine(line)) {
+        lineNumber++;
+        size_t pos = 0;
+        skipSpace(line, pos);
+        if (pos == line.size()) {
+            continue;
+        }
+
+        uint64_t id;
+        bool tombstoned;
+        if (!parseJsonLine(line, id, text, tombstoned)) {
+            std::cerr << "Error: Malformed history line " << lineNumber << std::endl;
+            return false;
+        }
+        room.importMessage(id, text, tombstoned);
+        entriesImported++;
+    }
+    return true;
+}
+
+bool HistoryImporter::importBinary(ChatRoom& room) {
+    std::string header;
+    if (!readBytes(header, sizeof(HistoryExporter::MAGIC) + 1) ||
+        memcmp(header.data(), HistoryExporter::MAGIC, sizeof(HistoryExporter::MAGIC)) != 0) {
+        std::cerr << "Error: Not a binary history export" << std::endl;
+        return false;
+    }
+    if (static_cast<unsigned char>(header[sizeof(HistoryExporter::MAGIC)]) != HistoryExporter::VERSION) {
+        std::cerr << "Error: Unsupported history export version" << std::endl;
+        return false;
+    }
+
+    std::string text;
+    uint64_t lastId = 0;
+    while (chunkPos < chunkEnd || refill()) {
+        uint64_t delta;
+        unsigned char flags;
+        uint64_t length;
+        if (!readVarint(delta) || !readByte(flags) || !readVarint(length) || !readBytes(text, length)) {
+            std::cerr << "Error: Truncated history record after " << entriesImported << " entries" << std::endl;
+            return false;
+        }
+        lastId += delta;
+        room.importMessage(lastId, text, (flags & 1) != 0);
+        entriesImported++;
+    }
+    return true;
+}
+
+bool HistoryImporter::refill() {
+    in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    chunkPos = 0;
+    chunkEnd = static_cast<size_t>(in.gcount());
+    bytesRead += chunkEnd;
+    return chunkEnd != 0;
+}
+
+bool HistoryImporter::readByte(unsigned char& byte) {
+    if (chunkPos == chunkEnd && !refill()) {
+        return false;
+    }
+    byte = static_cast<unsigned char>(chunk[chunkPos++]);
+    return true;
+}
+
+bool HistoryImporter::readVarint(uint64_t& value) {
+    // Fast path when the whole varint is already buffered
+    size_t pos = chunkPos;
+    if (chunkEnd - chunkPos >= 10 && LzCodec::getVarint(chunk.data(), chunkEnd, pos, value)) {
+        chunkPos = pos;
+        return true;
+    }
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        unsigned char byte;
+        if (!readByte(byte)) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HistoryImporter::readBytes(std::string& out, uint64_t length) {
+    out.clear();
+    while (length > 0) {
+        if (chunkPos == chunkEnd && !refill()) {
+            return false;
+        }
+        size_t take = chunkEnd - chunkPos;
+        if (take > length) {
+            take = static_cast<size_t>(length);
+        }
+        out.append(chunk.data() + chunkPos, take);
+        chunkPos += take;
+        length -= take;
+    }
+    return true;
+}
+
+bool HistoryImporter::readLine(std::string& line) {
+    line.clear();
+    bool any = false;
+    while (chunkPos < chunkEnd || refill()) {
+        any = true;
+        const char* start = chunk.data() + chunkPos;
+        const char* newline = static_cast<const char*>(memchr(start, '\n', chunkEnd - chunkPos));
+        if (newline != nullptr) {
+            line.append(start, newline - start);
+            chunkPos += (newline - start) + 1;
+            return true;
+        }
+        line.append(start, chunkEnd - chunkPos);
+        chunkPos = chunkEnd;
+    }
+    return any;
+}
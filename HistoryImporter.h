@@ -0,0 +1,96 @@
+/**
+ * @file HistoryImporter.h
+ * @brief Streams an exported history back into a room
+ * @date 19/10/2026
+ */
+
+#ifndef HISTORYIMPORTER_H
+#define HISTORYIMPORTER_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <stdint.h>
+#include "HistoryExporter.h"
+
+class ChatRoom;
+
+/**
+ * @brief Reads NDJSON or binary output of HistoryExporter into a ChatRoom
+ *
+ * Entries are read one at a time through a fixed-size buffer and handed
+ * straight to ChatRoom::importMessage, so memory use is the room's history
+ * and nothing more. Nothing is filtered, delivered, journaled or notified
+ * per entry; the room writes one snapshot and one notification at the end.
+ * Exports carry no senders, because user ids only mean something in the
+ * process that assigned them, so imported messages cannot be edited or
+ * deleted; a room's journal keeps its senders instead.
+ *
+ * NDJSON lines may list their keys in any order and may carry extra keys,
+ * which are ignored. Blank lines are skipped. A missing id means the next
+ * free id. The first malformed line or record stops the import; entries
+ * before it stay imported.
+ */
+class HistoryImporter {
+public:
+    /**
+     * @brief Constructor
+     * @param in Stream to read from; must outlive the importer
+     * @param format Input format
+     */
+    HistoryImporter(std::istream& in, HistoryExporter::Format format);
+
+    /**
+     * @brief Import every entry into a room
+     * @param room The room to fill
+     * @return False if the input was malformed, which is reported on std::cerr
+     */
+    bool importInto(ChatRoom& room);
+
+    /**
+     * @brief Get the number of entries imported
+     * @return Entry count
+     */
+    uint64_t getEntriesImported() const;
+
+    /**
+     * @brief Get the number of bytes read
+     * @return Input size consumed in bytes
+     */
+    uint64_t getBytesRead() const;
+
+    /**
+     * @brief Parse one NDJSON line
+     * @param line The line, without its newline
+     * @param id Set to the entry id, or 0 if the line has none
+     * @param text Set to the entry text
+     * @param tombstoned Set to the tombstone flag
+     * @return False if the line is not a valid entry
+     */
+    static bool parseJsonLine(const std::string& line, uint64_t& id, std::string& text, bool& tombstoned);
+
+private:
+    static const size_t CHUNK_BYTES = 64 * 1024;
+
+    std::istream& in;
+    HistoryExporter::Format format;
+    std::vector<char> chunk;
+    size_t chunkPos;
+    size_t chunkEnd;
+    uint64_t entriesImported;
+    uint64_t bytesRead;
+
+    bool refill();
+    bool readByte(unsigned char& byte);
+    bool readVarint(uint64_t& value);
+    bool readBytes(std::string& out, uint64_t length);
+    bool readLine(std::string& line);
+
+    bool importJson(ChatRoom& room);
+    bool importBinary(ChatRoom& room);
+
+    HistoryImporter(const HistoryImporter&);
+    HistoryImporter& operator=(const HistoryImporter&);
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "LoadGenerator.h"
+#include "ChatClient.h"
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+/**
+ * @file LoadGenerator.cpp
+ * @brief Implementation of the loopback load generator
+ */
+
+namespace {
+
+const int REPLY_TIMEOUT_MS = 10000;
+
+/**
+ * @brief Wait for a reply starting with prefix, skipping deliveries and events
+ */
+bool awaitReply(ChatClient& client, const std::string& prefix) {
+    std::string frame;
+    while (client.receive(frame, REPLY_TIMEOUT_MS)) {
+        if (frame.compare(0, prefix.size(), prefix) == 0) {
+            return true;
+        }
+        if (frame.compare(0, 4, "ERR ") == 0) {
+            return false;
+        }
+    }
+    return false;
+}
+
+}
+
+LoadGenerator::LoadGenerator(const std::string& serverHost, uint16_t serverPort)
+    : host(serverHost), port(serverPort), round(0) {
+}
+
+LoadGenerator::~LoadGenerator() {
+    closeIdle();
+}
+
+size_t LoadGenerator::openIdle(size_t count) {
+    size_t opened = 0;
+    for (size_t i = 0; i < count; i++) {
+        ChatClient* client = new ChatClient();
+        if (!client->connect(host, port)) {
+            delete client;
+            break;
+        }
+        idle.push_back(client);
+        opened++;
+    }
+    return opened;
+}
+
+void LoadGenerator::closeIdle() {
+    for (ChatClient* client : idle) {
+        delete client;
+    }
+    idle.clear();
+}
+
+size_t LoadGenerator::getIdleCount() const {
+    return idle.size();
+}
+
+bool LoadGenerator::run(size_t clients, size_t messagesPerClient, Result& result) {
+    typedef std::chrono::steady_clock Clock;
+    result.clients = clients;
+    result.messagesSent = 0;
+    result.messagesReceived = 0;
+    result.seconds = 0.0;
+    if (clients == 0) {
+        return true;
+    }
+
+    round++;
+    std::string roomName = "load" + std::to_string(round);
+    std::vector<ChatClient*> active;
+    bool ok = true;
+    for (size_t i = 0; i < clients && ok; i++) {
+        ChatClient* client = new ChatClient();
+        active.push_back(client);
+        std::string name = roomName + "-user" + std::to_string(i);
+        ok = client->connect(host, port) &&
+             client->send("NICK " + name) && awaitReply(*client, "OK NICK") &&
+             client->send("JOIN " + roomName) && awaitReply(*client, "OK JOIN");
+    }
+
+    if (ok) {
+        const uint64_t expected = static_cast<uint64_t>(messagesPerClient) * (clients - 1);
+        std::atomic<uint64_t> sent(0);
+        std::atomic<uint64_t> received(0);
+        std::atomic<bool> failed(false);
+        std::vector<std::thread> threads;
+
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < clients; i++) {
+            ChatClient* client = active[i];
+            threads.push_back(std::thread([client, &roomName, messagesPerClient, expected, &sent, &received, &failed]() {
+                std::string say = "SAY " + roomName + " load message";
+                for (size_t m = 0; m < messagesPerClient; m++) {
+                    if (!client->send(say)) {
+                        failed = true;
+                        return;
+                    }
+                    sent++;
+                }
+                // Everyone else's messages, then a PONG once the server has
+                // handled all of this client's sends
+                uint64_t got = 0;
+                std::string frame;
+                bool sentPing = false;
+                for (;;) {
+                    if (got == expected && !sentPing) {
+                        if (!client->send("PING")) {
+                            failed = true;
+                            return;
+                        }
+                        sentPing = true;
+                    }
+                    if (!client->receive(frame, REPLY_TIMEOUT_MS)) {
+                        failed = true;
+                        return;
+                    }
+                    if (frame.compare(0, 4, "MSG ") == 0) {
+                        got++;
+                        received++;
+                    } else if (frame == "PONG") {
+                        return;
+                    }
+                }
+            }));
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.messagesSent = sent.load();
+        result.messagesReceived = received.load();
+        ok = !failed.load();
+    }
+
+    for (ChatClient* client : active) {
+        if (client->isConnected() && client->send("QUIT")) {
+            awaitReply(*client, "OK QUIT");
+        }
+        delete client;
+    }
+    return ok;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file LoadGenerator.h
+ * @brief Drives a ChatServer over loopback with idle and active clients
+ * @date 19/10/2026
+ */
+
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class ChatClient;
+
+/**
+ * @brief Opens idle connections and runs timed chat rounds against a server
+ *
+ * Idle connections connect and then stay silent, which is what most
+ * sockets on a chat server look like. A round logs in active clients, puts
+ * them all in one fresh room, has each send its messages from its own
+ * thread and waits until every client has received every other client's
+ * messages.
+ */
+class LoadGenerator {
+public:
+    /**
+     * @brief Outcome of one round
+     */
+    struct Result {
+        size_t clients;
+        uint64_t messagesSent;
+        uint64_t messagesReceived;
+        double seconds;             ///< From the first send to the last delivery
+    };
+
+    /**
+     * @brief Constructor
+     * @param host Server address
+     * @param port Server port
+     */
+    LoadGenerator(const std::string& host, uint16_t port);
+
+    /**
+     * @brief Destructor - closes every connection
+     */
+    ~LoadGenerator();
+
+    /**
+     * @brief Open more idle connections
+     * @param count Connections to add
+     * @return Number actually opened, which is lower if the server or the
+     * file descriptor limit refused some
+     */
+    size_t openIdle(size_t count);
+
+    /**
+     * @brief Close every idle connection
+     */
+    void closeIdle();
+
+    size_t getIdleCount() const;
+
+    /**
+     * @brief Run one round
+     * @param clients Active clients, each on its own thread
+     * @param messagesPerClient Messages each client sends
+     * @param result Filled with the round's counts and time
+     * @return False if a client failed to log in, join or receive in time
+     */
+    bool run(size_t clients, size_t messagesPerClient, Result& result);
+
+private:
+    std::string host;
+    uint16_t port;
+    std::vector<ChatClient*> idle;
+    unsigned round;
+
+    LoadGenerator(const LoadGenerator&);
+    LoadGenerator& operator=(const LoadGenerator&);
+};
+
+#endif
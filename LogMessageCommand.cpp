@@ -2,6 +2,7 @@
 #include "LogMessageCommand.h"
 #include "ChatRoom.h"
 #include "Users.h"
+#include "Trace.h"
 #include <iostream>
 
 // LogMessageCommand implementation
@@ -9,21 +10,30 @@ LogMessageCommand::LogMessageCommand(ChatRoom* room, User* user, const std::stri
     : Command(room, user, msg) {
 }
 
+LogMessageCommand::LogMessageCommand(ChatRoom* room, User* user, const MessagePtr& msg)
+    : Command(room, user, msg) {
+}
+
 LogMessageCommand::~LogMessageCommand() {
     // Destructor - base class handles cleanup
 }
 
 void LogMessageCommand::execute() {
-    if (room != nullptr && fromUser != nullptr && !message.empty()) {
+    TRACE_SPAN("LogMessageCommand::execute");
+    if (room != nullptr && fromUser != nullptr && !message->empty()) {
         // Log the message activity to console for audit/debugging purposes
         // In a real system, this could log to a file, database, or external logging service
         std::cout << "[LOG] Timestamp: NOW" 
                   << " | User: " << fromUser->getName() 
                   << " | Room: ChatRoom"
-                  << " | Message: \"" << message << "\"" << std::endl;
+                  << " | Message: \"";
+        std::cout.write(message->data(), message->size()) << "\"" << std::endl;
         
         
                   
     }
 }
 
+std::string LogMessageCommand::getType() const {
+    return "LogMessage";
+}
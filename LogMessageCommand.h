@@ -29,6 +29,15 @@ public:
      * @param msg The message content to be logged
      */
     LogMessageCommand(ChatRoom* room, User* user, const std::string& msg);
+
+    /**
+     * @brief Constructor sharing a message with other commands
+     * 
+     * @param room Pointer to the ChatRoom where the message was sent
+     * @param user Pointer to the User who sent the message
+     * @param msg The shared message
+     */
+    LogMessageCommand(ChatRoom* room, User* user, const MessagePtr& msg);
     
     /**
      * @brief Destructor
@@ -44,6 +53,13 @@ public:
      * and message content. Only executes if all required parameters are valid.
      */
     void execute() override;
+
+    /**
+     * @brief Get the command's type name
+     * 
+     * @return std::string "LogMessage"
+     */
+    std::string getType() const override;
     
 };
 
@@ -0,0 +1,181 @@
+#include "LzCodec.h"
+#include <string.h>
+#include <vector>
+
+/**
+ * @file LzCodec.cpp
+ * @brief Implementation of the LZ77 block codec
+ */
+
+namespace {
+
+uint32_t load32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hash32(uint32_t value, unsigned bits) {
+    return (value * 2654435761u) >> (32 - bits);
+}
+
+void putLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+bool getLength(const unsigned char* data, size_t size, size_t& pos, size_t& length) {
+    unsigned char byte;
+    do {
+        if (pos >= size) {
+            return false;
+        }
+        byte = data[pos++];
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+void putSequence(std::string& out, const char* literals, size_t literalLength,
+                 size_t offset, size_t matchLength, bool last) {
+    size_t matchCode = last ? 0 : matchLength - 4;
+    unsigned char token = static_cast<unsigned char>(
+        ((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+    out.push_back(static_cast<char>(token));
+    if (literalLength >= 15) {
+        putLength(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+    if (last) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) {
+        putLength(out, matchCode - 15);
+    }
+}
+
+}
+
+void LzCodec::compress(const std::string& input, std::string& output) {
+    output.clear();
+    output.reserve(input.size() / 2 + 16);
+    putVarint(output, input.size());
+
+    const char* in = input.data();
+    const size_t size = input.size();
+    std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, UINT32_MAX);
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + MIN_MATCH <= size) {
+        uint32_t sequence = load32(in + pos);
+        uint32_t& slot = table[hash32(sequence, HASH_BITS)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(pos);
+
+        if (candidate == UINT32_MAX || pos - candidate > MAX_OFFSET || load32(in + candidate) != sequence) {
+            pos++;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        while (pos + length < size && in[candidate + length] == in[pos + length]) {
+            length++;
+        }
+        putSequence(output, in + anchor, pos - anchor, pos - candidate, length, false);
+        pos += length;
+        anchor = pos;
+        if (pos >= MIN_MATCH && pos + MIN_MATCH <= size) {
+            table[hash32(load32(in + pos - 2), HASH_BITS)] = static_cast<uint32_t>(pos - 2);
+        }
+    }
+    putSequence(output, in + anchor, size - anchor, 0, 0, true);
+}
+
+bool LzCodec::decompress(const std::string& input, std::string& output) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(input.data());
+    const size_t size = input.size();
+    size_t pos = 0;
+    uint64_t rawSize;
+    if (!getVarint(input.data(), size, pos, rawSize)) {
+        return false;
+    }
+
+    // Written through a pointer into a pre-sized buffer; every copy is
+    // bounds-checked against rawSize first
+    output.resize(static_cast<size_t>(rawSize));
+    char* out = rawSize == 0 ? nullptr : &output[0];
+    size_t written = 0;
+    while (pos < size) {
+        unsigned char token = in[pos++];
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !getLength(in, size, pos, literalLength)) {
+            return false;
+        }
+        if (literalLength > size - pos || literalLength > rawSize - written) {
+            return false;
+        }
+        if (literalLength != 0) {
+            memcpy(out + written, in + pos, literalLength);
+        }
+        written += literalLength;
+        pos += literalLength;
+        if (pos == size) {
+            break;
+        }
+
+        if (size - pos < 2) {
+            return false;
+        }
+        size_t offset = in[pos] | (static_cast<size_t>(in[pos + 1]) << 8);
+        pos += 2;
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !getLength(in, size, pos, matchLength)) {
+            return false;
+        }
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > rawSize - written) {
+            return false;
+        }
+        char* target = out + written;
+        const char* from = target - offset;
+        if (offset >= matchLength) {
+            memcpy(target, from, matchLength);
+        } else {
+            // Overlapping match: it repeats the bytes it is producing
+            for (size_t i = 0; i < matchLength; i++) {
+                target[i] = from[i];
+            }
+        }
+        written += matchLength;
+    }
+    return written == rawSize;
+}
+
+void LzCodec::putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool LzCodec::getVarint(const char* data, size_t size, size_t& pos, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (pos >= size) {
+            return false;
+        }
+        unsigned char byte = static_cast<unsigned char>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
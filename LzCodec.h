@@ -0,0 +1,67 @@
+/**
+ * @file LzCodec.h
+ * @brief Small LZ77 block codec for cold chat history
+ * @date 19/10/2026
+ */
+
+#ifndef LZCODEC_H
+#define LZCODEC_H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Byte-oriented LZ77 compression in the style of LZ4
+ *
+ * A block is the raw size as a varint followed by sequences. Each sequence
+ * is a token byte (literal length in the high nibble, match length minus
+ * four in the low nibble), any extra length bytes, the literals, then a
+ * two-byte little-endian match offset. The last sequence has literals only.
+ *
+ * Matches are found with a single hash probe of the next four bytes, so
+ * compression is one pass and decompression is a plain copy loop. Chat
+ * text repeats the same "[Name]: " prefixes and a small vocabulary, which
+ * is what the 64 KB window is sized for.
+ */
+class LzCodec {
+public:
+    /**
+     * @brief Compress a block
+     * @param input Raw bytes
+     * @param output Replaced with the compressed block
+     */
+    static void compress(const std::string& input, std::string& output);
+
+    /**
+     * @brief Decompress a block written by compress()
+     * @param input Compressed block
+     * @param output Replaced with the raw bytes
+     * @return False if the block is malformed; output is then unspecified
+     */
+    static bool decompress(const std::string& input, std::string& output);
+
+    /**
+     * @brief Append an unsigned LEB128 varint
+     * @param out Buffer to append to
+     * @param value Value to encode
+     */
+    static void putVarint(std::string& out, uint64_t value);
+
+    /**
+     * @brief Read an unsigned LEB128 varint
+     * @param data Buffer to read from
+     * @param size Buffer size
+     * @param pos Read position, advanced past the varint
+     * @param value Decoded value
+     * @return False if the varint runs past the end of the buffer
+     */
+    static bool getVarint(const char* data, size_t size, size_t& pos, uint64_t& value);
+
+private:
+    static const size_t MIN_MATCH = 4;
+    static const size_t MAX_OFFSET = 65535;
+    static const unsigned HASH_BITS = 13;
+};
+
+#endif
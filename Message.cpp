@@ -0,0 +1,180 @@
+#include "Message.h"
+#include "BumpArena.h"
+#include "Users.h"
+#include <string.h>
+#include <new>
+#ifdef PETSPACE_METRICS
+#include <atomic>
+#endif
+
+/**
+ * @file Message.cpp
+ * @brief Implementation of the shared message
+ */
+
+namespace {
+
+#ifdef PETSPACE_METRICS
+std::atomic<size_t> liveMessages(0);
+#endif
+
+/**
+ * @brief Allocator that makes room for a message's text after the shared block
+ *
+ * std::allocate_shared allocates the reference count and the message as one
+ * block through this allocator. The first allocation is extra bytes longer
+ * than asked for, and the start of those bytes is written to tail, so
+ * build() can copy the text there once the message is constructed. Any
+ * further allocation is made exactly as asked, so the tail is never handed
+ * out twice. Every allocation belongs to the shared state and is freed no
+ * earlier than the message, so the tail outlives the message whichever
+ * allocation carries it.
+ */
+template <typename T>
+class TrailingAllocator {
+public:
+    typedef T value_type;
+
+    TrailingAllocator(BumpArena* bumpArena, size_t extraBytes, char** tailOut)
+        : arena(bumpArena), extra(extraBytes), tail(tailOut) {
+    }
+
+    template <typename U>
+    TrailingAllocator(const TrailingAllocator<U>& other)
+        : arena(other.arena), extra(other.extra), tail(other.tail) {
+    }
+
+    T* allocate(size_t count) {
+        size_t bytes = count * sizeof(T);
+        size_t padding = *tail == nullptr ? extra : 0;
+        char* block = static_cast<char*>(arena != nullptr ? arena->allocate(bytes + padding)
+                                                          : ::operator new(bytes + padding));
+        if (*tail == nullptr) {
+            *tail = block + bytes;
+        }
+        return reinterpret_cast<T*>(block);
+    }
+
+    void deallocate(T* pointer, size_t) {
+        if (arena != nullptr) {
+            arena->release(pointer);
+        } else {
+            ::operator delete(pointer);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const TrailingAllocator<U>& other) const {
+        return arena == other.arena && extra == other.extra;
+    }
+
+    template <typename U>
+    bool operator!=(const TrailingAllocator<U>& other) const {
+        return !(*this == other);
+    }
+
+    BumpArena* arena;       ///< nullptr for the heap
+    size_t extra;
+    char** tail;
+};
+
+}
+
+MessagePtr Message::create(const User* sender, const std::string& text) {
+    return build(sender, text, nullptr);
+}
+
+MessagePtr Message::create(const User* sender, const std::string& text, BumpArena& arena) {
+    return build(sender, text, &arena);
+}
+
+MessagePtr Message::build(const User* sender, const std::string& text, BumpArena* arena) {
+    const std::string name = sender != nullptr ? sender->getName() : std::string();
+    char* tail = nullptr;
+    std::shared_ptr<Message> message =
+        std::allocate_shared<Message>(TrailingAllocator<Message>(arena, name.size() + text.size(), &tail),
+                                      Token(), sender != nullptr ? sender->getId() : 0);
+    memcpy(tail, name.data(), name.size());
+    memcpy(tail + name.size(), text.data(), text.size());
+    message->senderName = tail;
+    message->nameLength = name.size();
+    message->text = tail + name.size();
+    message->length = text.size();
+    return message;
+}
+
+Message::Message(Token, uint64_t messageSenderId)
+    : senderId(messageSenderId), senderName(nullptr), nameLength(0), text(nullptr), length(0) {
+#ifdef PETSPACE_METRICS
+    liveMessages.fetch_add(1, std::memory_order_relaxed);
+#endif
+}
+
+Message::~Message() {
+#ifdef PETSPACE_METRICS
+    liveMessages.fetch_sub(1, std::memory_order_relaxed);
+#endif
+}
+
+uint64_t Message::getSenderId() const {
+    return senderId;
+}
+
+std::string Message::getSenderName() const {
+    return std::string(senderName, nameLength);
+}
+
+const char* Message::data() const {
+    return text;
+}
+
+size_t Message::size() const {
+    return length;
+}
+
+bool Message::empty() const {
+    return length == 0;
+}
+
+std::string Message::getText() const {
+    return std::string(text, length);
+}
+
+std::string Message::format() const {
+    std::string line;
+    line.reserve(nameLength + length + 4);
+    line += '[';
+    line.append(senderName, nameLength);
+    line += "]: ";
+    line.append(text, length);
+    line += '\n';
+    return line;
+}
+
+std::string Message::format(const std::string& name, const std::string& body) {
+    std::string line;
+    format(line, name, body.data(), body.size());
+    return line;
+}
+
+void Message::format(std::string& line, const std::string& name, const std::string& body) {
+    format(line, name, body.data(), body.size());
+}
+
+void Message::format(std::string& line, const std::string& name, const char* body, size_t bodyLength) {
+    line.clear();
+    line.reserve(name.size() + bodyLength + 4);
+    line += '[';
+    line += name;
+    line += "]: ";
+    line.append(body, bodyLength);
+    line += '\n';
+}
+
+size_t Message::getLiveCount() {
+#ifdef PETSPACE_METRICS
+    return liveMessages.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
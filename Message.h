@@ -0,0 +1,149 @@
+/**
+ * @file Message.h
+ * @brief Immutable, reference-counted chat message
+ * @date 19/10/2026
+ */
+
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+class Message;
+class BumpArena;
+class User;
+
+typedef std::shared_ptr<const Message> MessagePtr;
+
+/**
+ * @brief One sent message, shared by every stage that handles it
+ *
+ * A message is created once, when a user sends it, and never changes.
+ * The commands that carry it, the room queue it waits in and the room that
+ * delivers it all hold the same object, so the text is not copied again
+ * however many stages or recipients it passes through. create() makes the
+ * reference count, the message and its characters one allocation: the
+ * sender's name and the text are copied once, into a buffer that trails
+ * the header, and the text is read back as data() and size().
+ *
+ * The sender is recorded by id and name rather than by pointer, so a
+ * message stays valid after its sender is deleted.
+ */
+class Message {
+private:
+    /** Lets create() call the public constructor while nobody else can */
+    struct Token {};
+
+public:
+    /**
+     * @brief Create a message
+     * @param sender The sending user, or nullptr
+     * @param text Message content, copied into the message's own allocation
+     * @return The shared message
+     */
+    static MessagePtr create(const User* sender, const std::string& text);
+
+    /**
+     * @brief Create a message in an arena
+     *
+     * For messages that do not outlive the command batch that sends them.
+     * The header and the text are one arena allocation, whatever the length.
+     *
+     * @param sender The sending user, or nullptr
+     * @param text Message content
+     * @param arena The arena holding the message and its reference count
+     * @return The shared message
+     */
+    static MessagePtr create(const User* sender, const std::string& text, BumpArena& arena);
+
+    /**
+     * @brief Constructor - only callable through create(), which fills in the text
+     */
+    Message(Token, uint64_t senderId);
+
+    ~Message();
+
+    /**
+     * @brief Get the sender's id
+     * @return User::getId() of the sender, or 0 if there was none
+     */
+    uint64_t getSenderId() const;
+
+    /**
+     * @brief Get the sender's name
+     * @return The name the sender had when the message was created
+     */
+    std::string getSenderName() const;
+
+    /**
+     * @brief Get the text
+     * @return The first of size() characters, not null-terminated
+     */
+    const char* data() const;
+
+    size_t size() const;
+    bool empty() const;
+
+    /**
+     * @brief Copy the text into a string
+     * @return The text
+     */
+    std::string getText() const;
+
+    /**
+     * @brief Format the message as a history line
+     * @return "[sender]: text\n", built with one allocation
+     */
+    std::string format() const;
+
+    /**
+     * @brief Format a sender and text as a history line
+     * @param sender Name of the sending user
+     * @param text Message content
+     * @return "[sender]: text\n", built with one allocation
+     */
+    static std::string format(const std::string& sender, const std::string& text);
+
+    /**
+     * @brief Format a sender and text as a history line into a reused buffer
+     * @param line Buffer replaced with "[sender]: text\n"; keeps its capacity
+     * @param sender Name of the sending user
+     * @param text Message content
+     */
+    static void format(std::string& line, const std::string& sender, const std::string& text);
+
+    /**
+     * @brief Format a sender and text as a history line into a reused buffer
+     * @param line Buffer replaced with "[sender]: text\n"; keeps its capacity
+     * @param sender Name of the sending user
+     * @param text Message content
+     * @param length Number of characters in text
+     */
+    static void format(std::string& line, const std::string& sender, const char* text, size_t length);
+
+    /**
+     * @brief Get the number of messages currently alive
+     *
+     * Counting takes a shared atomic on every create and destroy, so it is
+     * only compiled in with the metrics build (make METRICS=1).
+     *
+     * @return Live message count across all threads, or 0 without metrics
+     */
+    static size_t getLiveCount();
+
+private:
+    uint64_t senderId;
+    const char* senderName; ///< Trails the header in the same allocation
+    size_t nameLength;
+    const char* text;       ///< Follows the name
+    size_t length;
+
+    static MessagePtr build(const User* sender, const std::string& text, BumpArena* arena);
+
+    Message(const Message&);
+    Message& operator=(const Message&);
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "MessageFilter.h"
+#include <cctype>
+#include <cstring>
+
+/**
+ * @file MessageFilter.cpp
+ * @brief Implementation of the Aho-Corasick content filter
+ */
+
+namespace {
+
+unsigned char foldByte(unsigned char c) {
+    return static_cast<unsigned char>(std::tolower(c));
+}
+
+}
+
+/**
+ * @brief Constructor - creates a filter with no patterns
+ */
+MessageFilter::MessageFilter() : classCount(1) {
+    std::memset(byteClass, 0, sizeof(byteClass));
+    compile();
+}
+
+/**
+ * @brief Destructor
+ */
+MessageFilter::~MessageFilter() {
+    patterns.clear();
+}
+
+/**
+ * @brief Register a pattern
+ * @param pattern The text to match
+ * @param category The category reported when the pattern matches
+ */
+void MessageFilter::addPattern(const std::string& pattern, Category category) {
+    if (pattern.empty()) {
+        return;
+    }
+
+    Pattern entry;
+    entry.text.reserve(pattern.size());
+    for (size_t i = 0; i < pattern.size(); i++) {
+        entry.text.push_back(static_cast<char>(foldByte(static_cast<unsigned char>(pattern[i]))));
+    }
+    entry.category = category;
+    patterns.push_back(entry);
+}
+
+/**
+ * @brief Build the automaton from all registered patterns
+ *
+ * Builds the trie over byte classes, then walks it breadth first to compute
+ * failure links and fill in every missing transition so scanning never has
+ * to follow a failure link at run time.
+ */
+void MessageFilter::compile() {
+    std::memset(byteClass, 0, sizeof(byteClass));
+    classCount = 1;
+    for (size_t p = 0; p < patterns.size(); p++) {
+        const std::string& text = patterns[p].text;
+        for (size_t i = 0; i < text.size(); i++) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (byteClass[c] == 0) {
+                byteClass[c] = static_cast<unsigned char>(classCount++);
+            }
+        }
+    }
+    for (int c = 0; c < 256; c++) {
+        unsigned char folded = foldByte(static_cast<unsigned char>(c));
+        if (folded != c) {
+            byteClass[c] = byteClass[folded];
+        }
+    }
+
+    delta.assign(classCount, -1);
+    stateCategories.assign(1, 0);
+    maskLength.assign(1, 0);
+    alertPattern.assign(1, -1);
+
+    for (size_t p = 0; p < patterns.size(); p++) {
+        const std::string& text = patterns[p].text;
+        int32_t state = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            size_t slot = state * classCount + byteClass[static_cast<unsigned char>(text[i])];
+            if (delta[slot] < 0) {
+                int32_t next = static_cast<int32_t>(stateCategories.size());
+                delta[slot] = next;
+                delta.resize(delta.size() + classCount, -1);
+                stateCategories.push_back(0);
+                maskLength.push_back(0);
+                alertPattern.push_back(-1);
+            }
+            state = delta[state * classCount + byteClass[static_cast<unsigned char>(text[i])]];
+        }
+
+        stateCategories[state] |= static_cast<uint8_t>(patterns[p].category);
+        if (patterns[p].category == PROFANITY) {
+            uint16_t length = text.size() > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(text.size());
+            if (length > maskLength[state]) {
+                maskLength[state] = length;
+            }
+        } else if (patterns[p].category == KEYWORD_ALERT && alertPattern[state] < 0) {
+            alertPattern[state] = static_cast<int32_t>(p);
+        }
+    }
+
+    std::vector<int32_t> failure(stateCategories.size(), 0);
+    std::vector<int32_t> queue;
+    queue.reserve(stateCategories.size());
+
+    for (size_t c = 0; c < classCount; c++) {
+        int32_t next = delta[c];
+        if (next < 0) {
+            delta[c] = 0;
+        } else {
+            failure[next] = 0;
+            queue.push_back(next);
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        int32_t state = queue[head];
+        int32_t fail = failure[state];
+
+        stateCategories[state] |= stateCategories[fail];
+        if (maskLength[fail] > maskLength[state]) {
+            maskLength[state] = maskLength[fail];
+        }
+        if (alertPattern[state] < 0) {
+            alertPattern[state] = alertPattern[fail];
+        }
+
+        for (size_t c = 0; c < classCount; c++) {
+            size_t slot = state * classCount + c;
+            int32_t next = delta[slot];
+            if (next < 0) {
+                delta[slot] = delta[fail * classCount + c];
+            } else {
+                failure[next] = delta[fail * classCount + c];
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Scan a message for every registered pattern
+ * @param message The message to scan
+ * @return Verdict describing which categories matched
+ */
+MessageFilter::Verdict MessageFilter::scan(const std::string& message) const {
+    return scan(message.data(), message.size());
+}
+
+/**
+ * @brief Scan a message held in a raw buffer for every registered pattern
+ * @param message Pointer to the message content
+ * @param length Number of bytes in the message
+ * @return Verdict describing which categories matched
+ */
+MessageFilter::Verdict MessageFilter::scan(const char* message, size_t length) const {
+    Verdict verdict;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(message);
+    const int32_t* table = delta.data();
+    const uint8_t* accepts = stateCategories.data();
+
+    int32_t state = 0;
+    for (size_t i = 0; i < length; i++) {
+        state = table[state * classCount + byteClass[data[i]]];
+        if (accepts[state] != 0) {
+            verdict.categories |= accepts[state];
+            if (verdict.alertKeyword.empty() && alertPattern[state] >= 0) {
+                verdict.alertKeyword = patterns[alertPattern[state]].text;
+            }
+        }
+    }
+    return verdict;
+}
+
+/**
+ * @brief Scan a raw buffer for every registered pattern
+ * @param data Pointer to the bytes to scan
+ * @param length Number of bytes to scan
+ * @return Bitwise OR of every matched Category
+ */
+int MessageFilter::scanCategories(const char* data, size_t length) const {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    const int32_t* table = delta.data();
+    const uint8_t* accepts = stateCategories.data();
+
+    int categories = 0;
+    int32_t state = 0;
+    for (size_t i = 0; i < length; i++) {
+        state = table[state * classCount + byteClass[bytes[i]]];
+        categories |= accepts[state];
+    }
+    return categories;
+}
+
+/**
+ * @brief Return a copy of the message with profanity masked
+ * @param message The message to mask
+ * @return The masked message
+ */
+std::string MessageFilter::mask(const std::string& message) const {
+    return mask(message.data(), message.size());
+}
+
+/**
+ * @brief Return a copy of a message held in a raw buffer with profanity masked
+ * @param message Pointer to the message content
+ * @param length Number of bytes in the message
+ * @return The masked message
+ */
+std::string MessageFilter::mask(const char* message, size_t length) const {
+    std::string masked(message, length);
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(message);
+
+    int32_t state = 0;
+    for (size_t i = 0; i < length; i++) {
+        state = delta[state * classCount + byteClass[data[i]]];
+        size_t covered = maskLength[state];
+        for (size_t j = 0; j < covered; j++) {
+            masked[i - j] = '*';
+        }
+    }
+    return masked;
+}
+
+/**
+ * @brief Get the number of registered patterns
+ * @return Pattern count
+ */
+size_t MessageFilter::getPatternCount() const {
+    return patterns.size();
+}
+
+/**
+ * @brief Get the number of automaton states
+ * @return State count of the last compile()
+ */
+size_t MessageFilter::getStateCount() const {
+    return stateCategories.size();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file MessageFilter.h
+ * @brief Multi-pattern content filter applied to messages before they are saved
+ * @date 19/10/2026
+ */
+
+#ifndef MESSAGEFILTER_H
+#define MESSAGEFILTER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Aho-Corasick content filter for profanity, banned links and keyword alerts
+ *
+ * All patterns are compiled into a single deterministic automaton so a message
+ * is scanned in one pass regardless of how many patterns are registered. Input
+ * bytes are first mapped to a small set of byte classes (one per distinct
+ * pattern byte plus "other"), which keeps the transition table compact enough
+ * to stay in cache. Matching is ASCII case-insensitive and substring based.
+ *
+ * Patterns are added with addPattern() and only take effect after compile().
+ */
+class MessageFilter {
+public:
+    /**
+     * @brief Categories a pattern can belong to
+     *
+     * Values are bit flags so a scan can report several categories at once.
+     */
+    enum Category {
+        PROFANITY = 1,      ///< Matched text is masked with '*'
+        BANNED_LINK = 2,    ///< Message is blocked
+        KEYWORD_ALERT = 4   ///< Observers are alerted, message is delivered
+    };
+
+    /**
+     * @brief Result of scanning a message
+     */
+    struct Verdict {
+        int categories;             ///< Bitwise OR of every matched Category
+        std::string alertKeyword;   ///< First keyword alert matched, if any
+
+        Verdict() : categories(0) {}
+
+        /**
+         * @brief Check whether the message must be dropped
+         * @return True if a banned link was matched
+         */
+        bool blocked() const { return (categories & BANNED_LINK) != 0; }
+    };
+
+    /**
+     * @brief Constructor - creates a filter with no patterns
+     */
+    MessageFilter();
+
+    /**
+     * @brief Destructor
+     */
+    ~MessageFilter();
+
+    /**
+     * @brief Register a pattern
+     *
+     * Empty patterns are ignored. The pattern is not active until compile()
+     * is called.
+     *
+     * @param pattern The text to match (case-insensitive)
+     * @param category The category reported when the pattern matches
+     */
+    void addPattern(const std::string& pattern, Category category);
+
+    /**
+     * @brief Build the automaton from all registered patterns
+     */
+    void compile();
+
+    /**
+     * @brief Scan a message for every registered pattern
+     *
+     * @param message The message to scan
+     * @return Verdict describing which categories matched
+     */
+    Verdict scan(const std::string& message) const;
+
+    /**
+     * @brief Scan a message held in a raw buffer for every registered pattern
+     *
+     * @param message Pointer to the message content
+     * @param length Number of bytes in the message
+     * @return Verdict describing which categories matched
+     */
+    Verdict scan(const char* message, size_t length) const;
+
+    /**
+     * @brief Scan a raw buffer for every registered pattern
+     *
+     * @param data Pointer to the bytes to scan
+     * @param length Number of bytes to scan
+     * @return Bitwise OR of every matched Category
+     */
+    int scanCategories(const char* data, size_t length) const;
+
+    /**
+     * @brief Return a copy of the message with profanity masked
+     *
+     * Every byte covered by a PROFANITY match is replaced with '*'.
+     *
+     * @param message The message to mask
+     * @return The masked message
+     */
+    std::string mask(const std::string& message) const;
+
+    /**
+     * @brief Return a copy of a message held in a raw buffer with profanity masked
+     *
+     * @param message Pointer to the message content
+     * @param length Number of bytes in the message
+     * @return The masked message
+     */
+    std::string mask(const char* message, size_t length) const;
+
+    /**
+     * @brief Get the number of registered patterns
+     * @return Pattern count, including patterns not yet compiled
+     */
+    size_t getPatternCount() const;
+
+    /**
+     * @brief Get the number of automaton states
+     * @return State count of the last compile()
+     */
+    size_t getStateCount() const;
+
+private:
+    struct Pattern {
+        std::string text;
+        Category category;
+    };
+
+    std::vector<Pattern> patterns;
+
+    unsigned char byteClass[256];       ///< Byte to class id, 0 is "other"
+    size_t classCount;                  ///< Number of byte classes
+    std::vector<int32_t> delta;         ///< Transition table, state * classCount + class
+    std::vector<uint8_t> stateCategories; ///< Categories accepted in each state
+    std::vector<uint16_t> maskLength;   ///< Longest profanity ending in each state
+    std::vector<int32_t> alertPattern;  ///< Keyword alert ending in each state, -1 if none
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "MessageIterator.h"
+#include "ChatHistory.h"
 
 /**
  * @file MessageIterator.cpp
@@ -9,11 +10,25 @@
  * @brief Constructor for MessageIterator
  * @param messageHistory Reference to vector of message strings to iterate over
  */
-MessageIterator::MessageIterator(const std::vector<std::string>& messageHistory) : ChatIterator() {
+MessageIterator::MessageIterator(const std::vector<std::string>& messageHistory)
+    : ChatIterator(), source(nullptr), includeTombstones(false) {
     chatHistory = messageHistory;
     currentIndex = 0;
 }
 
+const char* const MessageIterator::TOMBSTONE_TEXT = "[message deleted]\n";
+
+/**
+ * @brief Constructor for MessageIterator over a chat history
+ * @param messageHistory The chat history
+ * @param showTombstones Whether to show tombstones as placeholders
+ */
+MessageIterator::MessageIterator(const ChatHistory& messageHistory, bool showTombstones)
+    : ChatIterator(), source(&messageHistory), includeTombstones(showTombstones) {
+    currentIndex = 0;
+    skipTombstones();
+}
+
 /**
  * @brief Destructor for MessageIterator
  */
@@ -27,6 +42,9 @@ MessageIterator::~MessageIterator() {
  * @return True if there are more messages, false otherwise
  */
 bool MessageIterator::hasNext() {
+    if (source != nullptr) {
+        return static_cast<size_t>(currentIndex) < source->getStoredCount();
+    }
     return currentIndex < static_cast<int>(chatHistory.size());
 }
 
@@ -36,6 +54,19 @@ bool MessageIterator::hasNext() {
 void MessageIterator::next() {
     if (hasNext()) {
         currentIndex++;
+        skipTombstones();
+    }
+}
+
+/**
+ * @brief Advance past tombstones when they are hidden
+ */
+void MessageIterator::skipTombstones() {
+    if (source == nullptr || includeTombstones) {
+        return;
+    }
+    while (hasNext() && source->getEntry(currentIndex).tombstoned) {
+        currentIndex++;
     }
 }
 
@@ -55,6 +86,13 @@ User* MessageIterator::current() {
  * @return Current message string, or empty string if at end
  */
 std::string MessageIterator::currentMessage() {
+    if (source != nullptr) {
+        if (!hasNext()) {
+            return "";
+        }
+        const ChatHistory::Entry& entry = source->getEntry(currentIndex);
+        return entry.tombstoned ? std::string(TOMBSTONE_TEXT) : entry.text.str();
+    }
     if (currentIndex >= 0 && currentIndex < static_cast<int>(chatHistory.size())) {
         return chatHistory[currentIndex];
     }
@@ -14,6 +14,7 @@
 
 // Forward declarations
 class User;
+class ChatHistory;
 
 /**
  * @brief Concrete iterator for iterating through chat messages
@@ -22,28 +23,58 @@ class User;
  * a collection of chat message strings. Note: Since messages
  * are strings, current() returns nullptr for User* but provides
  * currentMessage() method.
+ *
+ * Built from a vector, the iterator keeps its own copy of the messages.
+ * Built from a ChatHistory, as ChatRoom::createMessageIterator() does, it
+ * aliases the room's live history instead: the room must outlive the
+ * iterator, and the history must not be appended to, edited, trimmed or
+ * compacted while the iterator is in use. Neither form is safe to use
+ * while another thread changes the room.
  */
 class MessageIterator : public ChatIterator {
 private:
     std::vector<std::string> chatHistory;
+    const ChatHistory* source;          ///< Read in place when set
+    bool includeTombstones;
+
+    void skipTombstones();
 
 public:
     /**
      * @brief Constructor for MessageIterator
      * 
-     * Creates an iterator for the given message history. The iterator maintains
-     * its own copy of the message list to ensure thread safety and consistency
-     * during iteration.
+     * Creates an iterator for the given message history. The iterator keeps
+     * its own copy of the message list, so the vector may change or go away
+     * afterwards.
      * 
      * @param messageHistory Reference to the vector of message strings to iterate over
      */
     MessageIterator(const std::vector<std::string>& messageHistory);
+
+    /**
+     * @brief Placeholder shown for retracted or deleted messages
+     */
+    static const char* const TOMBSTONE_TEXT;
+
+    /**
+     * @brief Constructor for MessageIterator over a chat history
+     * 
+     * Reads the history in place rather than copying it, so compressed
+     * segments are decompressed one at a time as the iterator reaches them.
+     * The history must outlive the iterator and not change while it is in
+     * use. Retracted and deleted messages are skipped, or shown as
+     * TOMBSTONE_TEXT if includeTombstones is set.
+     * 
+     * @param messageHistory The chat history to iterate over
+     * @param includeTombstones Whether to show tombstones as placeholders
+     */
+    MessageIterator(const ChatHistory& messageHistory, bool includeTombstones = false);
     
     /**
      * @brief Destructor
      * 
-     * Cleans up the iterator resources. Message strings are copied so no
-     * external cleanup is needed.
+     * Cleans up the iterator resources. Never touches the aliased history,
+     * so no external cleanup is needed.
      */
     ~MessageIterator();
     
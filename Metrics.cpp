@@ -0,0 +1,377 @@
+#include "Metrics.h"
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+
+/**
+ * @file Metrics.cpp
+ * @brief Implementation of the per-thread metrics registry
+ */
+
+const int Metrics::SUB_BUCKET_BITS;
+const int Metrics::SUB_BUCKETS;
+const int Metrics::BUCKET_COUNT;
+const unsigned int Metrics::LATENCY_SAMPLE_PERIOD;
+
+namespace {
+
+/**
+ * @brief Add to a value that only one thread writes
+ *
+ * A relaxed load and store avoids the locked instruction a fetch_add would
+ * need while still letting snapshot() read the value from another thread.
+ */
+inline void bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct HistogramBlock {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> min;
+    std::atomic<uint64_t> max;
+    std::atomic<uint64_t> buckets[Metrics::BUCKET_COUNT];
+
+    void clear() {
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        min.store(UINT64_MAX, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+        for (int i = 0; i < Metrics::BUCKET_COUNT; i++) {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void mergeInto(Metrics::HistogramSnapshot& target) const {
+        uint64_t blockCount = count.load(std::memory_order_relaxed);
+        if (blockCount == 0) {
+            return;
+        }
+        target.count += blockCount;
+        target.sum += sum.load(std::memory_order_relaxed);
+        target.min = std::min(target.min, min.load(std::memory_order_relaxed));
+        target.max = std::max(target.max, max.load(std::memory_order_relaxed));
+        for (int i = 0; i < Metrics::BUCKET_COUNT; i++) {
+            target.buckets[i] += buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    void absorb(const HistogramBlock& other) {
+        uint64_t otherCount = other.count.load(std::memory_order_relaxed);
+        if (otherCount == 0) {
+            return;
+        }
+        bump(count, otherCount);
+        bump(sum, other.sum.load(std::memory_order_relaxed));
+        min.store(std::min(min.load(std::memory_order_relaxed), other.min.load(std::memory_order_relaxed)),
+                  std::memory_order_relaxed);
+        max.store(std::max(max.load(std::memory_order_relaxed), other.max.load(std::memory_order_relaxed)),
+                  std::memory_order_relaxed);
+        for (int i = 0; i < Metrics::BUCKET_COUNT; i++) {
+            bump(buckets[i], other.buckets[i].load(std::memory_order_relaxed));
+        }
+    }
+};
+
+struct ThreadBlock {
+    std::atomic<uint64_t> counters[Metrics::COUNTER_COUNT];
+    HistogramBlock histograms[Metrics::HISTOGRAM_COUNT];
+    unsigned int sampleTicks[Metrics::HISTOGRAM_COUNT];    ///< Only touched by the owning thread
+
+    ThreadBlock() {
+        for (int h = 0; h < Metrics::HISTOGRAM_COUNT; h++) {
+            sampleTicks[h] = 0;
+        }
+        clear();
+    }
+
+    void clear() {
+        for (int c = 0; c < Metrics::COUNTER_COUNT; c++) {
+            counters[c].store(0, std::memory_order_relaxed);
+        }
+        for (int h = 0; h < Metrics::HISTOGRAM_COUNT; h++) {
+            histograms[h].clear();
+        }
+    }
+
+    void mergeInto(Metrics::Snapshot& target) const {
+        for (int c = 0; c < Metrics::COUNTER_COUNT; c++) {
+            target.counters[c] += counters[c].load(std::memory_order_relaxed);
+        }
+        for (int h = 0; h < Metrics::HISTOGRAM_COUNT; h++) {
+            histograms[h].mergeInto(target.histograms[h]);
+        }
+    }
+
+    void absorb(const ThreadBlock& other) {
+        for (int c = 0; c < Metrics::COUNTER_COUNT; c++) {
+            bump(counters[c], other.counters[c].load(std::memory_order_relaxed));
+        }
+        for (int h = 0; h < Metrics::HISTOGRAM_COUNT; h++) {
+            histograms[h].absorb(other.histograms[h]);
+        }
+    }
+};
+
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<ThreadBlock*>& liveBlocks() {
+    static std::vector<ThreadBlock*> blocks;
+    return blocks;
+}
+
+ThreadBlock& retiredBlock() {
+    static ThreadBlock block;
+    return block;
+}
+
+/**
+ * @brief Owns the calling thread's block and folds it into the retired
+ * totals when the thread exits
+ */
+struct ThreadHandle {
+    ThreadBlock* block;
+
+    ThreadHandle() : block(new ThreadBlock()) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        liveBlocks().push_back(block);
+    }
+
+    ~ThreadHandle() {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        retiredBlock().absorb(*block);
+        std::vector<ThreadBlock*>& blocks = liveBlocks();
+        blocks.erase(std::remove(blocks.begin(), blocks.end(), block), blocks.end());
+        delete block;
+    }
+};
+
+ThreadBlock& localBlock() {
+    static thread_local ThreadHandle handle;
+    return *handle.block;
+}
+
+const char* const counterNames[Metrics::COUNTER_COUNT] = {
+    "messages_sent", "messages_saved", "messages_blocked", "messages_throttled",
+    "deliveries", "notifications", "commands_executed", "user_sends", "user_sends_rejected"
+};
+
+const char* const histogramNames[Metrics::HISTOGRAM_COUNT] = {
+    "send_latency_ns", "user_send_latency_ns", "notify_latency_ns", "execute_all_latency_ns",
+    "fanout_size", "command_queue_depth", "history_size"
+};
+
+}
+
+Metrics::HistogramSnapshot::HistogramSnapshot()
+    : count(0), sum(0), min(UINT64_MAX), max(0), buckets(BUCKET_COUNT, 0) {
+}
+
+/**
+ * @brief Get the value at a given quantile
+ * @param quantile Quantile in [0, 1]
+ * @return Upper bound of the bucket holding the quantile, 0 if empty
+ */
+uint64_t Metrics::HistogramSnapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    quantile = std::max(0.0, std::min(1.0, quantile));
+    uint64_t target = static_cast<uint64_t>(quantile * count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief Get the mean of all recorded values
+ * @return Mean value, 0 if empty
+ */
+double Metrics::HistogramSnapshot::mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+}
+
+Metrics::Snapshot::Snapshot() {
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        counters[c] = 0;
+    }
+}
+
+/**
+ * @brief Check whether recording was compiled in
+ * @return True if built with PETSPACE_METRICS
+ */
+bool Metrics::isEnabled() {
+#ifdef PETSPACE_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Add to a counter on the calling thread
+ * @param counter The counter to increase
+ * @param amount The amount to add
+ */
+void Metrics::increment(Counter counter, uint64_t amount) {
+    bump(localBlock().counters[counter], amount);
+}
+
+/**
+ * @brief Record a value into a histogram on the calling thread
+ * @param histogram The histogram to record into
+ * @param value The value to record
+ */
+void Metrics::record(Histogram histogram, uint64_t value) {
+    HistogramBlock& block = localBlock().histograms[histogram];
+    bump(block.count, 1);
+    bump(block.sum, value);
+    if (value < block.min.load(std::memory_order_relaxed)) {
+        block.min.store(value, std::memory_order_relaxed);
+    }
+    if (value > block.max.load(std::memory_order_relaxed)) {
+        block.max.store(value, std::memory_order_relaxed);
+    }
+    bump(block.buckets[bucketIndex(value)], 1);
+}
+
+/**
+ * @brief Decide whether the calling thread should time this scope
+ * @param histogram The latency histogram the scope records into
+ * @return True once every LATENCY_SAMPLE_PERIOD calls
+ */
+bool Metrics::sampleLatency(Histogram histogram) {
+    return (localBlock().sampleTicks[histogram]++ % LATENCY_SAMPLE_PERIOD) == 0;
+}
+
+/**
+ * @brief Merge all threads into a snapshot
+ * @return Current totals
+ */
+Metrics::Snapshot Metrics::snapshot() {
+    Snapshot result;
+    std::lock_guard<std::mutex> lock(registryMutex());
+    retiredBlock().mergeInto(result);
+    const std::vector<ThreadBlock*>& blocks = liveBlocks();
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i]->mergeInto(result);
+    }
+    return result;
+}
+
+/**
+ * @brief Zero every counter and histogram on every thread
+ */
+void Metrics::reset() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    retiredBlock().clear();
+    const std::vector<ThreadBlock*>& blocks = liveBlocks();
+    for (size_t i = 0; i < blocks.size(); i++) {
+        blocks[i]->clear();
+    }
+}
+
+/**
+ * @brief Write a snapshot as human-readable text
+ * @param out Stream to write to
+ */
+void Metrics::exportText(std::ostream& out) {
+    Snapshot current = snapshot();
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        out << counterNames[c] << ": " << current.counters[c] << std::endl;
+    }
+    for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+        const HistogramSnapshot& histogram = current.histograms[h];
+        out << histogramNames[h] << ": count=" << histogram.count
+            << " mean=" << histogram.mean()
+            << " p50=" << histogram.percentile(0.50)
+            << " p99=" << histogram.percentile(0.99)
+            << " max=" << histogram.max << std::endl;
+    }
+}
+
+/**
+ * @brief Write a snapshot as a JSON object
+ * @param out Stream to write to
+ */
+void Metrics::exportJson(std::ostream& out) {
+    Snapshot current = snapshot();
+    out << "{\"enabled\": " << (isEnabled() ? "true" : "false") << ", \"counters\": {";
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        out << (c > 0 ? ", " : "") << "\"" << counterNames[c] << "\": " << current.counters[c];
+    }
+    out << "}, \"histograms\": {";
+    for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+        const HistogramSnapshot& histogram = current.histograms[h];
+        out << (h > 0 ? ", " : "") << "\"" << histogramNames[h] << "\": {"
+            << "\"count\": " << histogram.count
+            << ", \"sum\": " << histogram.sum
+            << ", \"min\": " << (histogram.count == 0 ? 0 : histogram.min)
+            << ", \"max\": " << histogram.max
+            << ", \"p50\": " << histogram.percentile(0.50)
+            << ", \"p90\": " << histogram.percentile(0.90)
+            << ", \"p99\": " << histogram.percentile(0.99)
+            << ", \"p999\": " << histogram.percentile(0.999) << "}";
+    }
+    out << "}}" << std::endl;
+}
+
+/**
+ * @brief Get the export name of a counter
+ * @param counter The counter
+ * @return Name in snake_case
+ */
+const char* Metrics::counterName(Counter counter) {
+    return counterNames[counter];
+}
+
+/**
+ * @brief Get the export name of a histogram
+ * @param histogram The histogram
+ * @return Name in snake_case
+ */
+const char* Metrics::histogramName(Histogram histogram) {
+    return histogramNames[histogram];
+}
+
+/**
+ * @brief Map a value to its histogram bucket
+ * @param value The value
+ * @return Bucket index in [0, BUCKET_COUNT)
+ */
+int Metrics::bucketIndex(uint64_t value) {
+    if (value < static_cast<uint64_t>(SUB_BUCKETS)) {
+        return static_cast<int>(value);
+    }
+    int magnitude = 63 - __builtin_clzll(value);
+    int shift = magnitude - SUB_BUCKET_BITS;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief Get the largest value that maps to a bucket
+ * @param index Bucket index
+ * @return Inclusive upper bound of the bucket
+ */
+uint64_t Metrics::bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return static_cast<uint64_t>(index);
+    }
+    int shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t sub = static_cast<uint64_t>((index - SUB_BUCKETS) % SUB_BUCKETS);
+    uint64_t lower = (static_cast<uint64_t>(SUB_BUCKETS) + sub) << shift;
+    return lower + ((static_cast<uint64_t>(1) << shift) - 1);
+}
@@ -0,0 +1,228 @@
+/**
+ * @file Metrics.h
+ * @brief Low-overhead counters and latency histograms for the chat hot paths
+ * @date 19/10/2026
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <chrono>
+#include <stdint.h>
+
+/**
+ * @brief Process-wide metrics registry
+ *
+ * Every thread records into its own block of counters and histograms, so
+ * recording is a plain load and store with no locking or atomic
+ * read-modify-write. snapshot() merges the blocks of all live threads plus
+ * the totals left behind by threads that have exited.
+ *
+ * Latency timers only read the clock on one call in LATENCY_SAMPLE_PERIOD
+ * per thread and histogram, which keeps the cost of timing nested hot-path
+ * scopes well below the cost of the work they measure. Counters and value
+ * histograms are recorded on every call.
+ *
+ * Histograms are log-linear in the style of HdrHistogram: values below 16
+ * get exact buckets and every power of two above that is split into 16
+ * sub-buckets, giving roughly 6% relative precision over the full 64-bit
+ * range in a fixed number of buckets.
+ *
+ * Recording is done through the METRICS_* macros, which compile to nothing
+ * unless the build defines PETSPACE_METRICS (make METRICS=1). The snapshot
+ * and export API is always available and reports zeros when disabled.
+ */
+class Metrics {
+public:
+    /**
+     * @brief Monotonic event counters
+     */
+    enum Counter {
+        MESSAGES_SENT,          ///< Messages delivered by ChatRoom::sendMessage
+        MESSAGES_SAVED,         ///< Entries appended by ChatRoom::saveMessage
+        MESSAGES_BLOCKED,       ///< Messages dropped by the content filter
+        MESSAGES_THROTTLED,     ///< Messages dropped by the flood guard
+        DELIVERIES,             ///< Individual recipient deliveries
+        NOTIFICATIONS,          ///< Observer update() calls
+        COMMANDS_EXECUTED,      ///< Commands run by executeAll
+        USER_SENDS,             ///< Calls to User::sendMessage that passed validation
+        USER_SENDS_REJECTED,    ///< Sends dropped by the user's rate limit
+        COUNTER_COUNT
+    };
+
+    /**
+     * @brief Value distributions
+     */
+    enum Histogram {
+        SEND_LATENCY_NS,        ///< ChatRoom::sendMessage duration
+        USER_SEND_LATENCY_NS,   ///< User::sendMessage duration
+        NOTIFY_LATENCY_NS,      ///< ChatRoom::notifyObservers duration
+        EXECUTE_ALL_LATENCY_NS, ///< executeAll duration
+        FANOUT_SIZE,            ///< Recipients per delivered message
+        COMMAND_QUEUE_DEPTH,    ///< Commands queued when executeAll runs
+        HISTORY_SIZE,           ///< History length after each save
+        HISTOGRAM_COUNT
+    };
+
+    static const int SUB_BUCKET_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKET_COUNT = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS;
+    static const unsigned int LATENCY_SAMPLE_PERIOD = 8;
+
+    /**
+     * @brief Merged view of one histogram
+     */
+    struct HistogramSnapshot {
+        uint64_t count;
+        uint64_t sum;
+        uint64_t min;
+        uint64_t max;
+        std::vector<uint64_t> buckets;
+
+        HistogramSnapshot();
+
+        /**
+         * @brief Get the value at a given quantile
+         * @param quantile Quantile in [0, 1]
+         * @return Upper bound of the bucket holding the quantile, 0 if empty
+         */
+        uint64_t percentile(double quantile) const;
+
+        /**
+         * @brief Get the mean of all recorded values
+         * @return Mean value, 0 if empty
+         */
+        double mean() const;
+    };
+
+    /**
+     * @brief Merged view of every counter and histogram
+     */
+    struct Snapshot {
+        uint64_t counters[COUNTER_COUNT];
+        HistogramSnapshot histograms[HISTOGRAM_COUNT];
+
+        Snapshot();
+    };
+
+    /**
+     * @brief Records the lifetime of a sampled scope into a latency histogram
+     */
+    class ScopedTimer {
+        Histogram histogram;
+        bool sampled;
+        std::chrono::steady_clock::time_point start;
+    public:
+        explicit ScopedTimer(Histogram target)
+            : histogram(target), sampled(sampleLatency(target)) {
+            if (sampled) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+        ~ScopedTimer() {
+            if (sampled) {
+                record(histogram, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count()));
+            }
+        }
+    };
+
+    /**
+     * @brief Check whether recording was compiled in
+     * @return True if built with PETSPACE_METRICS
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Add to a counter on the calling thread
+     * @param counter The counter to increase
+     * @param amount The amount to add
+     */
+    static void increment(Counter counter, uint64_t amount = 1);
+
+    /**
+     * @brief Record a value into a histogram on the calling thread
+     * @param histogram The histogram to record into
+     * @param value The value to record
+     */
+    static void record(Histogram histogram, uint64_t value);
+
+    /**
+     * @brief Decide whether the calling thread should time this scope
+     * @param histogram The latency histogram the scope records into
+     * @return True once every LATENCY_SAMPLE_PERIOD calls
+     */
+    static bool sampleLatency(Histogram histogram);
+
+    /**
+     * @brief Merge all threads into a snapshot
+     * @return Current totals
+     */
+    static Snapshot snapshot();
+
+    /**
+     * @brief Zero every counter and histogram on every thread
+     *
+     * Values recorded concurrently with a reset may be kept or lost.
+     */
+    static void reset();
+
+    /**
+     * @brief Write a snapshot as human-readable text
+     * @param out Stream to write to
+     */
+    static void exportText(std::ostream& out);
+
+    /**
+     * @brief Write a snapshot as a JSON object
+     * @param out Stream to write to
+     */
+    static void exportJson(std::ostream& out);
+
+    /**
+     * @brief Get the export name of a counter
+     * @param counter The counter
+     * @return Name in snake_case
+     */
+    static const char* counterName(Counter counter);
+
+    /**
+     * @brief Get the export name of a histogram
+     * @param histogram The histogram
+     * @return Name in snake_case
+     */
+    static const char* histogramName(Histogram histogram);
+
+    /**
+     * @brief Map a value to its histogram bucket
+     * @param value The value
+     * @return Bucket index in [0, BUCKET_COUNT)
+     */
+    static int bucketIndex(uint64_t value);
+
+    /**
+     * @brief Get the largest value that maps to a bucket
+     * @param index Bucket index
+     * @return Inclusive upper bound of the bucket
+     */
+    static uint64_t bucketUpperBound(int index);
+};
+
+#ifdef PETSPACE_METRICS
+#define METRICS_CONCAT_INNER(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_INNER(a, b)
+#define METRICS_INCREMENT(counter) Metrics::increment(Metrics::counter)
+#define METRICS_ADD(counter, amount) Metrics::increment(Metrics::counter, (amount))
+#define METRICS_RECORD(histogram, value) Metrics::record(Metrics::histogram, (value))
+#define METRICS_TIMER(histogram) Metrics::ScopedTimer METRICS_CONCAT(metricsTimer, __LINE__)(Metrics::histogram)
+#else
+#define METRICS_INCREMENT(counter) ((void)0)
+#define METRICS_ADD(counter, amount) ((void)0)
+#define METRICS_RECORD(histogram, value) ((void)0)
+#define METRICS_TIMER(histogram) ((void)0)
+#endif
+
+#endif
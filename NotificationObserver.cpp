@@ -1 +1,11 @@
-
+#include "NotificationObserver.h"
+#include "Message.h"
+
+/**
+ * @file NotificationObserver.cpp
+ * @brief Default delivery of shared messages to observers
+ */
+
+void NotificationObserver::messageSent(const Message& message, ChatRoom* room) {
+    update("MESSAGE_SENT", message.getText(), room);
+}
@@ -4,6 +4,7 @@
 #include <string>
 
 class ChatRoom;
+class Message;
 
 /**
  * @file NotificationObserver.h
@@ -37,6 +38,17 @@ public:
      * notifications from subjects they are observing.
      */
     virtual void update(const std::string& event, const std::string& data, ChatRoom* room) = 0;
+
+    /**
+     * @brief Called for each message a watched room delivers
+     * @param message The delivered message, read in place
+     * @param room The chat room that delivered it
+     * 
+     * The default passes a copy of the text to update() as a MESSAGE_SENT
+     * event. Observers that ignore or only read the text override this to
+     * skip the copy.
+     */
+    virtual void messageSent(const Message& message, ChatRoom* room);
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,4 @@
 #include "NotificationSubject.h"
-#include <algorithm>
 #include <iostream>
 
 /**
@@ -22,12 +21,12 @@ void NotificationSubject::addObserver(NotificationObserver* observer) {
     }
     
     // Check if observer is already registered
-    auto it = std::find(observers.begin(), observers.end(), observer);
-    if (it != observers.end()) {
+    if (observerIndex.count(observer) != 0) {
         std::cerr << "Warning: Observer already registered" << std::endl;
         return;
     }
     
+    observerIndex[observer] = observers.size();
     observers.push_back(observer);
 }
 
@@ -43,10 +42,83 @@ void NotificationSubject::removeObserver(NotificationObserver* observer) {
         return;
     }
     
-    auto it = std::find(observers.begin(), observers.end(), observer);
-    if (it != observers.end()) {
-        observers.erase(it);
-    } else {
+    auto found = observerIndex.find(observer);
+    if (found == observerIndex.end()) {
         std::cerr << "Warning: Observer not found for removal" << std::endl;
+        return;
+    }
+    size_t slot = found->second;
+    observerIndex.erase(found);
+    observers.erase(observers.begin() + slot);
+    for (size_t i = slot; i < observers.size(); i++) {
+        observerIndex[observers[i]] = i;
+    }
+}
+
+/**
+ * @brief Rebuild observerIndex after observers was changed directly
+ */
+void NotificationSubject::rebuildObserverIndex() {
+    observerIndex.clear();
+    observerIndex.reserve(observers.size());
+    for (size_t i = 0; i < observers.size(); i++) {
+        observerIndex[observers[i]] = i;
+    }
+}
+
+/**
+ * @brief Remove an observer in constant time, moving the last observer into its slot
+ * @param observer The observer to remove
+ * @return bool True if the observer was registered
+ */
+bool NotificationSubject::dropObserver(NotificationObserver* observer) {
+    auto found = observerIndex.find(observer);
+    if (found == observerIndex.end()) {
+        return false;
     }
-}
\ No newline at end of file
+    size_t slot = found->second;
+    observerIndex.erase(found);
+    if (slot + 1 != observers.size()) {
+        observers[slot] = observers.back();
+        observerIndex[observers[slot]] = slot;
+    }
+    observers.pop_back();
+    return true;
+}
+
+/**
+ * @brief Append a name to a payload that lists several
+ * @param payload The payload to extend
+ * @param name The name
+ */
+void NotificationSubject::appendName(std::string& payload, const std::string& name) {
+    payload += std::to_string(name.size());
+    payload += ':';
+    payload += name;
+}
+
+/**
+ * @brief Read the next name written by appendName()
+ * @param payload The payload
+ * @param pos Offset of the entry; moved past it on success
+ * @param name Set to the name
+ * @return bool False at the end of the payload or if the entry is malformed
+ */
+bool NotificationSubject::readName(const std::string& payload, size_t& pos, std::string& name) {
+    size_t length = 0;
+    size_t cursor = pos;
+    while (cursor < payload.size() && payload[cursor] >= '0' && payload[cursor] <= '9') {
+        if (length > payload.size()) {
+            return false;
+        }
+        length = length * 10 + static_cast<size_t>(payload[cursor] - '0');
+        cursor++;
+    }
+    if (cursor == pos || cursor >= payload.size() || payload[cursor] != ':' ||
+        length > payload.size() - cursor - 1) {
+        return false;
+    }
+    name.assign(payload, cursor + 1, length);
+    pos = cursor + 1 + length;
+    return true;
+}
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "NotificationObserver.h"
 
 /**
@@ -22,6 +23,19 @@
 class NotificationSubject {
 protected:
     std::vector<NotificationObserver*> observers;
+    std::unordered_map<NotificationObserver*, size_t> observerIndex;  ///< Slot of each observer
+
+    /**
+     * @brief Rebuild observerIndex after observers was changed directly
+     */
+    void rebuildObserverIndex();
+
+    /**
+     * @brief Remove an observer in constant time, moving the last observer into its slot
+     * @param observer The observer to remove
+     * @return bool True if the observer was registered
+     */
+    bool dropObserver(NotificationObserver* observer);
 
 public:
     /**
@@ -41,7 +55,8 @@ public:
      * @brief Remove an observer from the notification list
      * @param observer The observer to remove
      * 
-     * Unregisters an observer from receiving notifications
+     * Unregisters an observer from receiving notifications; the others
+     * keep their order
      */
     virtual void removeObserver(NotificationObserver* observer);
     
@@ -53,6 +68,26 @@ public:
      * Calls the update method on all registered observers
      */
     virtual void notifyObservers(const std::string& event, const std::string& data) = 0;
+
+    /**
+     * @brief Append a name to a payload that lists several
+     * @param payload The payload to extend
+     * @param name The name
+     * 
+     * Each name is written as its length in decimal, a colon and the name
+     * itself, so a name may contain any character, separators included,
+     * without being mistaken for the next entry
+     */
+    static void appendName(std::string& payload, const std::string& name);
+
+    /**
+     * @brief Read the next name written by appendName()
+     * @param payload The payload
+     * @param pos Offset of the entry; moved past it on success
+     * @param name Set to the name
+     * @return bool False at the end of the payload or if the entry is malformed
+     */
+    static bool readName(const std::string& payload, size_t& pos, std::string& name);
 };
 
 #endif
\ No newline at end of file
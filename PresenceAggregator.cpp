@@ -0,0 +1,128 @@
+#include "PresenceAggregator.h"
+#include "ChatRoom.h"
+#include "Users.h"
+
+/**
+ * @file PresenceAggregator.cpp
+ * @brief Implementation of the presence aggregator
+ */
+
+PresenceAggregator::PresenceAggregator(std::chrono::milliseconds windowLength)
+    : window(windowLength), changesRecorded(0), diffsSent(0) {
+}
+
+PresenceAggregator::~PresenceAggregator() {
+    // Pending changes are dropped; the rooms fall back to notifying at once
+    std::unordered_set<ChatRoom*> attached;
+    attached.swap(rooms);
+    for (ChatRoom* room : attached) {
+        room->detachPresenceAggregator();
+    }
+}
+
+void PresenceAggregator::attach(ChatRoom* room) {
+    if (room != nullptr) {
+        rooms.insert(room);
+    }
+}
+
+void PresenceAggregator::record(ChatRoom* room, User* user, bool online) {
+    if (room == nullptr || user == nullptr) {
+        return;
+    }
+    if (pending.empty()) {
+        windowStart = Clock::now();
+    }
+    changesRecorded++;
+
+    RoomDiff& roomDiff = pending[room];
+    auto found = roomDiff.index.find(user->getId());
+    if (found != roomDiff.index.end()) {
+        roomDiff.changes[found->second].after = online;
+        return;
+    }
+    roomDiff.index[user->getId()] = roomDiff.changes.size();
+    Change change;
+    change.name = user->getName();
+    change.before = !online;
+    change.after = online;
+    roomDiff.changes.push_back(change);
+}
+
+size_t PresenceAggregator::tick() {
+    if (pending.empty() || Clock::now() - windowStart < window) {
+        return 0;
+    }
+    return flush();
+}
+
+std::chrono::milliseconds PresenceAggregator::getTimeToTick() const {
+    if (pending.empty()) {
+        return std::chrono::milliseconds(0);
+    }
+    Clock::duration left = window - (Clock::now() - windowStart);
+    if (left <= Clock::duration::zero()) {
+        return std::chrono::milliseconds(0);
+    }
+    std::chrono::milliseconds whole = std::chrono::duration_cast<std::chrono::milliseconds>(left);
+    return whole < left ? whole + std::chrono::milliseconds(1) : whole;
+}
+
+void PresenceAggregator::setWindow(std::chrono::milliseconds windowLength) {
+    window = windowLength;
+}
+
+size_t PresenceAggregator::flush() {
+    // Observers may change presence while being notified; those changes
+    // start the next window
+    std::unordered_map<ChatRoom*, RoomDiff> ready;
+    ready.swap(pending);
+
+    size_t sent = 0;
+    for (auto& entry : ready) {
+        diff.clear();
+        for (const Change& change : entry.second.changes) {
+            if (change.before == change.after) {
+                continue;
+            }
+            diff += change.after ? '+' : '-';
+            NotificationSubject::appendName(diff, change.name);
+        }
+        if (!diff.empty()) {
+            entry.first->notifyObservers("PRESENCE_DIFF", diff);
+            sent++;
+        }
+    }
+    diffsSent += sent;
+    return sent;
+}
+
+bool PresenceAggregator::readChange(const std::string& payload, size_t& pos, std::string& name, bool& online) {
+    if (pos >= payload.size() || (payload[pos] != '+' && payload[pos] != '-')) {
+        return false;
+    }
+    size_t next = pos + 1;
+    if (!NotificationSubject::readName(payload, next, name)) {
+        return false;
+    }
+    online = payload[pos] == '+';
+    pos = next;
+    return true;
+}
+
+void PresenceAggregator::forget(ChatRoom* room) {
+    pending.erase(room);
+    rooms.erase(room);
+}
+
+size_t PresenceAggregator::getPendingRooms() const {
+    return pending.size();
+}
+
+uint64_t PresenceAggregator::getChangesRecorded() const {
+    return changesRecorded;
+}
+
+uint64_t PresenceAggregator::getDiffsSent() const {
+    return diffsSent;
+}
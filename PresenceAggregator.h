@@ -0,0 +1,160 @@
+/**
+ * @file PresenceAggregator.h
+ * @brief Coalesces online/offline changes into one diff per room per tick
+ * @date 19/10/2026
+ */
+
+#ifndef PRESENCEAGGREGATOR_H
+#define PRESENCEAGGREGATOR_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdint.h>
+
+class ChatRoom;
+class User;
+
+/**
+ * @brief Batches presence notifications for the rooms that use it
+ *
+ * Without an aggregator, every status change notifies every observer of
+ * every room the user is in, so a reconnect storm of n users in a shared
+ * room costs n * n callbacks. A room with an aggregator set hands status
+ * changes to record() instead, and each tick() that ends a window sends
+ * each room one PRESENCE_DIFF notification listing its net changes, for n
+ * callbacks per tick.
+ *
+ * The diff lists '+' (now online) or '-' (now offline) followed by the
+ * name as written by NotificationSubject::appendName(), in the order the
+ * users first changed, so "-2:Bo+3:Ace" whatever characters the names
+ * hold; readChange() decodes it. A user who goes offline and back online
+ * within a window has no net change and is left out; a room with no net
+ * changes gets no notification.
+ *
+ * The room's member mirror is updated at once, so delivery never waits for
+ * a tick; only the notifications are deferred. Users are keyed by
+ * User::getId(), so a user deleted before the tick is still reported by
+ * name, and a new user at its address is kept apart from it. Rooms attach
+ * themselves when the aggregator is set and call forget() when they drop it
+ * or are destroyed; an aggregator destroyed first detaches itself from the
+ * rooms still using it. Not thread-safe: record and tick on the
+ * thread that runs the rooms.
+ */
+class PresenceAggregator {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief Constructor
+     * @param window How long the first pending change may wait before tick() sends it
+     */
+    explicit PresenceAggregator(std::chrono::milliseconds window = std::chrono::milliseconds(50));
+
+    /**
+     * @brief Destructor - detaches the aggregator from every room still using it
+     */
+    ~PresenceAggregator();
+
+    /**
+     * @brief Register a room that records changes here
+     * @param room The room, called by ChatRoom::setPresenceAggregator()
+     */
+    void attach(ChatRoom* room);
+
+    /**
+     * @brief Record a member's status change in a room
+     * @param room The room the user is a member of
+     * @param user The user whose status changed
+     * @param online The user's new status
+     */
+    void record(ChatRoom* room, User* user, bool online);
+
+    /**
+     * @brief Send the pending diffs once the window has passed
+     * @return size_t Number of PRESENCE_DIFF notifications sent
+     */
+    size_t tick();
+
+    /**
+     * @brief Get how long tick() will wait before sending the pending diffs
+     *
+     * Lets an event loop bound its wait so diffs go out on time.
+     *
+     * @return Time left in the window, rounded up; zero if due or nothing is pending
+     */
+    std::chrono::milliseconds getTimeToTick() const;
+
+    /**
+     * @brief Set how long the first pending change may wait
+     * @param window The new window; applies to the current one too
+     */
+    void setWindow(std::chrono::milliseconds window);
+
+    /**
+     * @brief Send the pending diffs now
+     * @return size_t Number of PRESENCE_DIFF notifications sent
+     */
+    size_t flush();
+
+    /**
+     * @brief Unregister a room and drop its pending changes without sending them
+     * @param room The room, usually one being destroyed
+     */
+    void forget(ChatRoom* room);
+
+    /**
+     * @brief Read the next change from a PRESENCE_DIFF payload
+     * @param diff The payload
+     * @param pos Offset of the change; moved past it on success
+     * @param name Set to the user's name
+     * @param online Set to the user's new status
+     * @return bool False at the end of the payload or if the change is malformed
+     */
+    static bool readChange(const std::string& diff, size_t& pos, std::string& name, bool& online);
+
+    /**
+     * @brief Get the number of rooms with pending changes
+     * @return Rooms waiting for the next tick
+     */
+    size_t getPendingRooms() const;
+
+    /**
+     * @brief Get the number of status changes recorded so far
+     * @return Changes passed to record()
+     */
+    uint64_t getChangesRecorded() const;
+
+    /**
+     * @brief Get the number of PRESENCE_DIFF notifications sent so far
+     * @return Notifications sent
+     */
+    uint64_t getDiffsSent() const;
+
+private:
+    struct Change {
+        std::string name;
+        bool before;        ///< Status before the window's first change
+        bool after;         ///< Latest status
+    };
+
+    struct RoomDiff {
+        std::unordered_map<uint64_t, size_t> index; ///< Position of each user's change, by id
+        std::vector<Change> changes;                ///< In order of first change
+    };
+
+    std::unordered_map<ChatRoom*, RoomDiff> pending;
+    std::unordered_set<ChatRoom*> rooms;    ///< Rooms with this aggregator set
+    std::chrono::milliseconds window;
+    Clock::time_point windowStart;
+    uint64_t changesRecorded;
+    uint64_t diffsSent;
+    std::string diff;       ///< Reused between rooms
+
+    PresenceAggregator(const PresenceAggregator&);
+    PresenceAggregator& operator=(const PresenceAggregator&);
+};
+
+#endif
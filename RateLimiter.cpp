@@ -0,0 +1,114 @@
+#include "RateLimiter.h"
+#include <chrono>
+
+/**
+ * @file RateLimiter.cpp
+ * @brief Implementation of the lock-free token bucket
+ */
+
+/**
+ * @brief Constructor - creates an unlimited limiter
+ */
+RateLimiter::RateLimiter()
+    : emissionInterval(0), burstTolerance(0), theoreticalArrival(0),
+      acceptedCount(0), rejectedCount(0) {
+}
+
+/**
+ * @brief Constructor
+ * @param messagesPerSecond Sustained rate, or 0 for unlimited
+ * @param burst Tokens available back to back
+ */
+RateLimiter::RateLimiter(double messagesPerSecond, unsigned int burst)
+    : emissionInterval(0), burstTolerance(0), theoreticalArrival(0),
+      acceptedCount(0), rejectedCount(0) {
+    setLimit(messagesPerSecond, burst);
+}
+
+/**
+ * @brief Change the limit
+ * @param messagesPerSecond Sustained rate, or 0 for unlimited
+ * @param burst Tokens available back to back
+ */
+void RateLimiter::setLimit(double messagesPerSecond, unsigned int burst) {
+    uint64_t interval = 0;
+    if (messagesPerSecond > 0.0) {
+        interval = static_cast<uint64_t>(1e9 / messagesPerSecond);
+        if (interval == 0) {
+            interval = 1;
+        }
+    }
+    if (burst == 0) {
+        burst = 1;
+    }
+
+    burstTolerance.store(interval * (burst - 1), std::memory_order_relaxed);
+    theoreticalArrival.store(0, std::memory_order_relaxed);
+    emissionInterval.store(interval, std::memory_order_release);
+}
+
+/**
+ * @brief Take a token at the current time
+ * @return True if a token was available
+ */
+bool RateLimiter::tryAcquire() {
+    if (emissionInterval.load(std::memory_order_acquire) == 0) {
+        acceptedCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    return tryAcquire(now);
+}
+
+/**
+ * @brief Take a token at an explicit time
+ * @param nowNanos Monotonic time in nanoseconds
+ * @return True if a token was available
+ */
+bool RateLimiter::tryAcquire(uint64_t nowNanos) {
+    uint64_t interval = emissionInterval.load(std::memory_order_acquire);
+    if (interval == 0) {
+        acceptedCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    uint64_t tolerance = burstTolerance.load(std::memory_order_relaxed);
+
+    uint64_t arrival = theoreticalArrival.load(std::memory_order_relaxed);
+    for (;;) {
+        uint64_t start = arrival > nowNanos ? arrival : nowNanos;
+        if (start - nowNanos > tolerance) {
+            rejectedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (theoreticalArrival.compare_exchange_weak(arrival, start + interval,
+                                                     std::memory_order_relaxed)) {
+            acceptedCount.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief Check whether a limit is configured
+ * @return False if the limiter is unlimited
+ */
+bool RateLimiter::isLimited() const {
+    return emissionInterval.load(std::memory_order_relaxed) != 0;
+}
+
+/**
+ * @brief Get the number of acquisitions that succeeded
+ * @return Accepted count
+ */
+uint64_t RateLimiter::getAcceptedCount() const {
+    return acceptedCount.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Get the number of acquisitions that were refused
+ * @return Rejected count
+ */
+uint64_t RateLimiter::getRejectedCount() const {
+    return rejectedCount.load(std::memory_order_relaxed);
+}
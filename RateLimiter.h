@@ -0,0 +1,89 @@
+/**
+ * @file RateLimiter.h
+ * @brief Lock-free token bucket used to throttle a user's sends
+ * @date 19/10/2026
+ */
+
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * @brief Thread-safe token bucket built on a single atomic timestamp
+ *
+ * Uses the generic cell rate algorithm: the bucket is represented by the
+ * time at which it will be full again, and taking a token is one
+ * compare-and-swap that pushes that time forward. Any number of threads may
+ * call tryAcquire() concurrently without locks.
+ *
+ * A limiter with a rate of zero is unlimited and only counts accepted sends.
+ */
+class RateLimiter {
+public:
+    /**
+     * @brief Constructor - creates an unlimited limiter
+     */
+    RateLimiter();
+
+    /**
+     * @brief Constructor
+     * @param messagesPerSecond Sustained rate, or 0 for unlimited
+     * @param burst Tokens available back to back (at least 1)
+     */
+    RateLimiter(double messagesPerSecond, unsigned int burst);
+
+    /**
+     * @brief Change the limit
+     *
+     * The bucket starts full again under the new limit. Counters are kept.
+     *
+     * @param messagesPerSecond Sustained rate, or 0 for unlimited
+     * @param burst Tokens available back to back (at least 1)
+     */
+    void setLimit(double messagesPerSecond, unsigned int burst);
+
+    /**
+     * @brief Take a token at the current time
+     * @return True if a token was available
+     */
+    bool tryAcquire();
+
+    /**
+     * @brief Take a token at an explicit time
+     * @param nowNanos Monotonic time in nanoseconds
+     * @return True if a token was available
+     */
+    bool tryAcquire(uint64_t nowNanos);
+
+    /**
+     * @brief Check whether a limit is configured
+     * @return False if the limiter is unlimited
+     */
+    bool isLimited() const;
+
+    /**
+     * @brief Get the number of acquisitions that succeeded
+     * @return Accepted count
+     */
+    uint64_t getAcceptedCount() const;
+
+    /**
+     * @brief Get the number of acquisitions that were refused
+     * @return Rejected count
+     */
+    uint64_t getRejectedCount() const;
+
+private:
+    std::atomic<uint64_t> emissionInterval;     ///< Nanoseconds per token, 0 if unlimited
+    std::atomic<uint64_t> burstTolerance;       ///< How far ahead of now the bucket may run
+    std::atomic<uint64_t> theoreticalArrival;   ///< Time at which the bucket is full again
+    std::atomic<uint64_t> acceptedCount;
+    std::atomic<uint64_t> rejectedCount;
+
+    RateLimiter(const RateLimiter&);
+    RateLimiter& operator=(const RateLimiter&);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#include "RemoteUser.h"
+#include "ChatServer.h"
+#include "ChatRoom.h"
+
+/**
+ * @file RemoteUser.cpp
+ * @brief Implementation of the socket-backed user
+ */
+
+RemoteUser::RemoteUser(const std::string& userName, ChatServer& chatServer, int socketFd)
+    : User(userName), server(chatServer), fd(socketFd) {
+}
+
+void RemoteUser::receiveMessage(const Message& message, User* fromUser, ChatRoom* room) {
+    if (fromUser == nullptr || fromUser == this || room == nullptr) {
+        return;
+    }
+    server.queueDelivery(fd, room, fromUser, message);
+}
+
+void RemoteUser::update(const std::string& event, const std::string& data, ChatRoom* room) {
+    if (room == nullptr || event == "MESSAGE_SENT") {
+        return;
+    }
+    frame.assign("EVENT ");
+    frame += room->getName();
+    frame.push_back(' ');
+    frame += event;
+    frame.push_back(' ');
+    frame += data;
+    server.queueFrame(fd, frame);
+}
+
+int RemoteUser::getFd() const {
+    return fd;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file RemoteUser.h
+ * @brief User connected through ChatServer
+ * @date 19/10/2026
+ */
+
+#ifndef REMOTEUSER_H
+#define REMOTEUSER_H
+
+#include "Users.h"
+
+class ChatServer;
+
+/**
+ * @brief A user whose deliveries and notifications go to a socket
+ *
+ * Instead of printing, RemoteUser turns every delivery into a MSG frame
+ * and every room notification except MESSAGE_SENT into an EVENT frame, and
+ * queues them on its connection. Everything else - joining, sending, rate
+ * limits, commands - is inherited from User unchanged.
+ */
+class RemoteUser : public User {
+public:
+    /**
+     * @brief Constructor
+     * @param userName The user's name
+     * @param chatServer Server that owns the connection
+     * @param socketFd The connection's socket
+     */
+    RemoteUser(const std::string& userName, ChatServer& chatServer, int socketFd);
+
+    using User::receiveMessage;
+
+    /**
+     * @brief Queue a "MSG <room> <from> <text>" frame
+     */
+    void receiveMessage(const Message& message, User* fromUser, ChatRoom* room) override;
+
+    /**
+     * @brief Queue an "EVENT <room> <event> <data>" frame
+     */
+    void update(const std::string& event, const std::string& data, ChatRoom* room) override;
+
+    /**
+     * @brief Get the connection's socket
+     * @return File descriptor
+     */
+    int getFd() const;
+
+private:
+    ChatServer& server;
+    int fd;
+    std::string frame;      ///< Reused between event frames
+};
+
+#endif
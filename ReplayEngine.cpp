@@ -0,0 +1,401 @@
+#include "ReplayEngine.h"
+#include "CommandJournal.h"
+#include "ChatRoom.h"
+#include "Users.h"
+#include <algorithm>
+#include <iostream>
+
+/**
+ * @file ReplayEngine.cpp
+ * @brief Implementation of journal replay
+ */
+
+namespace {
+
+uint32_t decodeUint32(const char* bytes) {
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(bytes);
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+           (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+/**
+ * @brief Reads length-prefixed fields from a record payload
+ */
+class PayloadReader {
+    const std::string& payload;
+    size_t position;
+public:
+    explicit PayloadReader(const std::string& data) : payload(data), position(0) {}
+
+    bool readUint32(uint32_t& value) {
+        if (payload.size() - position < 4) {
+            return false;
+        }
+        value = decodeUint32(payload.data() + position);
+        position += 4;
+        return true;
+    }
+
+    bool readString(std::string& text) {
+        uint32_t length;
+        if (!readUint32(length) || payload.size() - position < length) {
+            return false;
+        }
+        text.assign(payload, position, length);
+        position += length;
+        return true;
+    }
+
+    bool readUint64(uint64_t& value) {
+        uint32_t low;
+        uint32_t high;
+        if (!readUint32(low) || !readUint32(high)) {
+            return false;
+        }
+        value = static_cast<uint64_t>(low) | (static_cast<uint64_t>(high) << 32);
+        return true;
+    }
+
+    bool readByte(unsigned char& value) {
+        if (position >= payload.size()) {
+            return false;
+        }
+        value = static_cast<unsigned char>(payload[position++]);
+        return true;
+    }
+
+    bool readPositions(size_t size, std::vector<bool>& flags) {
+        uint32_t count;
+        if (!readUint32(count)) {
+            return false;
+        }
+        flags.assign(size, false);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t position;
+            if (!readUint32(position) || position >= size) {
+                return false;
+            }
+            flags[position] = true;
+        }
+        return true;
+    }
+
+    bool atEnd() const {
+        return position == payload.size();
+    }
+};
+
+}
+
+ReplayEngine::ReplayEngine(std::istream& stream)
+    : in(stream), journalStart(0), journalEnd(0), recordsScanned(0), recordsApplied(0), snapshotFound(false),
+      truncated(false) {
+}
+
+bool ReplayEngine::replay() {
+    memberNames.clear();
+    memberIds.clear();
+    history = ChatHistory();
+    authors.clear();
+    recordsScanned = 0;
+    recordsApplied = 0;
+    snapshotFound = false;
+    truncated = false;
+
+    std::streampos start = in.tellg();
+    in.seekg(0, std::ios::end);
+    std::streampos end = in.tellg();
+    in.seekg(start);
+    journalStart = start;
+
+    // First pass: headers only, to find the last snapshot and the end of
+    // the last complete record
+    std::streampos replayFrom = start;
+    std::streampos validEnd = start;
+    char header[CommandJournal::HEADER_SIZE];
+    while (validEnd < end) {
+        if (end - validEnd < static_cast<std::streamoff>(CommandJournal::HEADER_SIZE)) {
+            truncated = true;
+            break;
+        }
+        in.seekg(validEnd);
+        in.read(header, CommandJournal::HEADER_SIZE);
+        std::streamoff recordSize = CommandJournal::HEADER_SIZE + static_cast<std::streamoff>(decodeUint32(header));
+        if (end - validEnd < recordSize) {
+            truncated = true;
+            break;
+        }
+        if (header[4] == CommandJournal::SNAPSHOT) {
+            replayFrom = validEnd;
+            snapshotFound = true;
+        }
+        validEnd += recordSize;
+        recordsScanned++;
+    }
+
+    journalEnd = validEnd;
+
+    // Second pass: decode from the last snapshot on
+    in.clear();
+    in.seekg(replayFrom);
+    std::string payload;
+    std::streampos position = replayFrom;
+    while (position < validEnd) {
+        in.read(header, CommandJournal::HEADER_SIZE);
+        uint32_t length = decodeUint32(header);
+        payload.resize(length);
+        if (length > 0) {
+            in.read(&payload[0], length);
+        }
+        if (!apply(header[4], payload)) {
+            std::cerr << "Error: Malformed journal record at byte " << static_cast<long long>(position) << std::endl;
+            return false;
+        }
+        recordsApplied++;
+        position += static_cast<std::streamoff>(CommandJournal::HEADER_SIZE + length);
+    }
+
+    in.clear();
+    in.seekg(validEnd);
+    return true;
+}
+
+bool ReplayEngine::apply(int type, const std::string& payload) {
+    PayloadReader reader(payload);
+    std::string name;
+    uint64_t userId;
+
+    switch (type) {
+        case CommandJournal::JOIN: {
+            if (!reader.readUint64(userId) || !reader.readString(name)) {
+                return false;
+            }
+            if (std::find(memberIds.begin(), memberIds.end(), userId) == memberIds.end()) {
+                memberIds.push_back(userId);
+                memberNames.push_back(name);
+            }
+            break;
+        }
+        case CommandJournal::LEAVE: {
+            if (!reader.readUint64(userId)) {
+                return false;
+            }
+            std::vector<uint64_t>::iterator it = std::find(memberIds.begin(), memberIds.end(), userId);
+            if (it != memberIds.end()) {
+                memberNames.erase(memberNames.begin() + (it - memberIds.begin()));
+                memberIds.erase(it);
+            }
+            break;
+        }
+        case CommandJournal::SEND: {
+            std::string message;
+            if (!reader.readUint64(userId) || !reader.readString(name) || !reader.readString(message)) {
+                return false;
+            }
+            ChatHistory::MessageId id = history.append("[" + name + "]: " + message + "\n");
+            if (userId != 0) {
+                authors[id] = userId;
+            }
+            break;
+        }
+        case CommandJournal::SNAPSHOT: {
+            uint32_t count;
+            if (!reader.readUint32(count)) {
+                return false;
+            }
+            memberNames.clear();
+            memberIds.clear();
+            for (uint32_t i = 0; i < count; i++) {
+                if (!reader.readUint64(userId) || !reader.readString(name)) {
+                    return false;
+                }
+                memberIds.push_back(userId);
+                memberNames.push_back(name);
+            }
+            uint64_t nextId;
+            if (!reader.readUint64(nextId) || !reader.readUint32(count)) {
+                return false;
+            }
+            history = ChatHistory();
+            authors.clear();
+            ChatHistory::SegmentImage image;
+            std::vector<bool> tombstoned;
+            for (uint32_t s = 0; s < count; s++) {
+                uint64_t offset;
+                uint32_t skipped;
+                if (!reader.readUint64(offset) || !reader.readUint32(skipped) || !readCheckpoint(offset, image) ||
+                    !reader.readPositions(image.count, tombstoned) ||
+                    !history.restoreSegment(image, skipped, tombstoned)) {
+                    return false;
+                }
+            }
+            if (!reader.readUint32(count)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t id;
+                uint64_t author;
+                unsigned char tombstoned;
+                std::string text;
+                if (!reader.readUint64(id) || !reader.readUint64(author) || !reader.readByte(tombstoned) ||
+                    !reader.readString(text) || !history.restoreEntry(id, text, tombstoned != 0)) {
+                    return false;
+                }
+                if (author != 0) {
+                    authors[id] = author;
+                }
+            }
+            history.setNextId(nextId);
+            break;
+        }
+        case CommandJournal::CLEAR:
+            history.clear();
+            authors.clear();
+            break;
+        case CommandJournal::COMPACT:
+            history.compact();
+            break;
+        case CommandJournal::CHECKPOINT:
+            // Only read through the snapshots that refer to it
+            return true;
+        case CommandJournal::TOMBSTONE:
+        case CommandJournal::RESTORE:
+        case CommandJournal::DELETE: {
+            uint64_t id;
+            if (!reader.readUint64(id)) {
+                return false;
+            }
+            if (type == CommandJournal::TOMBSTONE) {
+                history.tombstone(id);
+            } else if (type == CommandJournal::RESTORE) {
+                history.restore(id);
+            } else {
+                history.erase(id);
+            }
+            break;
+        }
+        case CommandJournal::EDIT: {
+            uint64_t id;
+            std::string text;
+            if (!reader.readUint64(id) || !reader.readString(text)) {
+                return false;
+            }
+            history.edit(id, text);
+            break;
+        }
+        default:
+            return false;
+    }
+    return reader.atEnd();
+}
+
+/**
+ * @brief Read the compressed segment a snapshot refers to
+ * 
+ * The stream is left where it was, so the second pass carries on after
+ * the snapshot. The segment's senders are added to authors.
+ * 
+ * @param offset The CHECKPOINT record's offset from the journal's first record
+ * @param image Filled with the segment's image
+ * @return False if no complete, well-formed checkpoint is at that offset
+ */
+bool ReplayEngine::readCheckpoint(uint64_t offset, ChatHistory::SegmentImage& image) {
+    uint64_t journalSize = static_cast<uint64_t>(journalEnd - journalStart);
+    if (journalSize < CommandJournal::HEADER_SIZE || offset > journalSize - CommandJournal::HEADER_SIZE) {
+        return false;
+    }
+    std::streampos resume = in.tellg();
+    in.seekg(journalStart + static_cast<std::streamoff>(offset));
+    char header[CommandJournal::HEADER_SIZE];
+    in.read(header, CommandJournal::HEADER_SIZE);
+    uint32_t length = decodeUint32(header);
+
+    bool ok = header[4] == CommandJournal::CHECKPOINT &&
+              length <= journalSize - CommandJournal::HEADER_SIZE - offset;
+    if (ok) {
+        std::string payload(length, '\0');
+        if (length > 0) {
+            in.read(&payload[0], length);
+        }
+        PayloadReader reader(payload);
+        uint32_t count = 0;
+        uint32_t idCount = 0;
+        ok = reader.readUint64(image.firstId) && reader.readUint64(image.lastId) &&
+             reader.readUint32(count) && reader.readUint32(idCount) && idCount <= count;
+        image.count = count;
+        image.ids.clear();
+        for (uint32_t i = 0; ok && i < idCount; i++) {
+            uint64_t id;
+            ok = reader.readUint64(id);
+            image.ids.push_back(id);
+        }
+        uint64_t rawBytes = 0;
+        ok = ok && reader.readPositions(count, image.erased) && reader.readUint64(rawBytes) &&
+             reader.readString(image.data);
+        image.rawBytes = static_cast<size_t>(rawBytes);
+        for (uint32_t i = 0; ok && i < count; i++) {
+            uint64_t author;
+            ok = reader.readUint64(author);
+            if (ok && author != 0) {
+                authors[image.ids.empty() ? image.firstId + i : image.ids[i]] = author;
+            }
+        }
+        ok = ok && reader.atEnd();
+    }
+    in.clear();
+    in.seekg(resume);
+    return ok;
+}
+
+void ReplayEngine::restore(ChatRoom& room, std::map<uint64_t, User*>& users) const {
+    std::vector<User*> members;
+    members.reserve(memberNames.size());
+    for (size_t i = 0; i < memberNames.size(); i++) {
+        User*& user = users[memberIds[i]];
+        if (user == nullptr) {
+            user = new User(memberNames[i]);
+        }
+        members.push_back(user);
+    }
+
+    std::map<ChatHistory::MessageId, uint64_t> roomAuthors;
+    for (const auto& entry : authors) {
+        std::map<uint64_t, User*>::const_iterator author = users.find(entry.second);
+        if (author != users.end() && author->second != nullptr) {
+            roomAuthors.insert(roomAuthors.end(), std::make_pair(entry.first, author->second->getId()));
+        }
+    }
+    room.restoreState(members, history, roomAuthors);
+}
+
+const std::vector<std::string>& ReplayEngine::getMemberNames() const {
+    return memberNames;
+}
+
+const std::vector<uint64_t>& ReplayEngine::getMemberIds() const {
+    return memberIds;
+}
+
+const std::map<ChatHistory::MessageId, uint64_t>& ReplayEngine::getAuthors() const {
+    return authors;
+}
+
+const ChatHistory& ReplayEngine::getHistory() const {
+    return history;
+}
+
+uint64_t ReplayEngine::getRecordsScanned() const {
+    return recordsScanned;
+}
+
+uint64_t ReplayEngine::getRecordsApplied() const {
+    return recordsApplied;
+}
+
+bool ReplayEngine::usedSnapshot() const {
+    return snapshotFound;
+}
+
+bool ReplayEngine::wasTruncated() const {
+    return truncated;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file ReplayEngine.h
+ * @brief Rebuilds a room's members and history from a CommandJournal
+ * @date 19/10/2026
+ */
+
+#ifndef REPLAYENGINE_H
+#define REPLAYENGINE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include <stdint.h>
+#include "ChatHistory.h"
+
+class ChatRoom;
+class User;
+
+/**
+ * @brief Recovers room state from a journal written by CommandJournal
+ * 
+ * Replay runs in two passes. The first reads only record headers and seeks
+ * over payloads to find the last complete snapshot; the second decodes the
+ * snapshot and applies every later record to a list of members and a
+ * ChatHistory. Members are tracked by the user id the journal recorded, so
+ * two members with the same name stay two members. The compressed segments the snapshot refers to are read
+ * from their CHECKPOINT records and kept compressed. Nothing is sent,
+ * filtered or notified, so the cost is bounded by the records written
+ * since the last snapshot.
+ * 
+ * A truncated record at the end of the journal (a write cut short by a
+ * crash) is ignored; a malformed record inside the journal stops replay.
+ */
+class ReplayEngine {
+public:
+    /**
+     * @brief Constructor
+     * @param in Journal stream, positioned at its first record
+     */
+    explicit ReplayEngine(std::istream& in);
+
+    /**
+     * @brief Replay the journal
+     * @return False if a malformed record was found, which is reported on std::cerr
+     */
+    bool replay();
+
+    /**
+     * @brief Apply the replayed state to a room
+     * 
+     * Members are looked up by their journaled id in users; ids that are
+     * missing are created as new User objects with the journaled name and
+     * added to the map, and the caller owns them. The map can be passed to
+     * the restore of every room replayed from the same process's journals,
+     * so a user who was in several rooms is recovered as one user.
+     * 
+     * Each message's sender is mapped through users the same way, so a
+     * recovered user may edit and delete their own messages. Senders who
+     * are neither members nor in the map are left unknown.
+     * 
+     * @param room The room to restore
+     * @param users Recovering users by journaled id
+     */
+    void restore(ChatRoom& room, std::map<uint64_t, User*>& users) const;
+
+    const std::vector<std::string>& getMemberNames() const;
+
+    /**
+     * @brief Get the members' ids as journaled
+     * @return One id per member, in the same order as getMemberNames()
+     */
+    const std::vector<uint64_t>& getMemberIds() const;
+
+    /**
+     * @brief Get each message's sender as journaled
+     * @return Sender ids by message id; messages without a known sender are left out
+     */
+    const std::map<ChatHistory::MessageId, uint64_t>& getAuthors() const;
+    const ChatHistory& getHistory() const;
+
+    /**
+     * @brief Get the number of records whose headers were read
+     * @return Records scanned in the first pass
+     */
+    uint64_t getRecordsScanned() const;
+
+    /**
+     * @brief Get the number of records applied
+     * @return Records decoded in the second pass, including the snapshot
+     */
+    uint64_t getRecordsApplied() const;
+
+    /**
+     * @brief Check whether replay started from a snapshot
+     * @return True if a snapshot was found
+     */
+    bool usedSnapshot() const;
+
+    /**
+     * @brief Check whether the journal ended with a truncated record
+     * @return True if a partial record was ignored
+     */
+    bool wasTruncated() const;
+
+private:
+    std::istream& in;
+    std::streampos journalStart;
+    std::streampos journalEnd;              ///< End of the last complete record
+    std::vector<std::string> memberNames;
+    std::vector<uint64_t> memberIds;        ///< Parallel to memberNames
+    ChatHistory history;
+    std::map<ChatHistory::MessageId, uint64_t> authors;    ///< Journaled sender ids
+    uint64_t recordsScanned;
+    uint64_t recordsApplied;
+    bool snapshotFound;
+    bool truncated;
+
+    bool apply(int type, const std::string& payload);
+    bool readCheckpoint(uint64_t offset, ChatHistory::SegmentImage& image);
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "RoomManager.h"
+#include "ChatRoom.h"
+#include "Users.h"
+#include "SendMessageCommand.h"
+#include "LogMessageCommand.h"
+#include <condition_variable>
+#include <future>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * @file RoomManager.cpp
+ * @brief Implementation of the sharded room registry
+ */
+
+/**
+ * @brief One shard thread, its mailbox and the rooms it owns
+ */
+class RoomManager::Shard {
+public:
+    typedef std::function<void()> Task;
+
+    std::unordered_map<RoomId, ChatRoom*> rooms;    ///< Only touched by the shard thread
+
+    Shard() : stopping(false), worker(&Shard::run, this) {
+    }
+
+    ~Shard() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    /**
+     * @brief Queue a task for the shard thread
+     *
+     * The thread is only woken when the mailbox was empty, since otherwise it
+     * is already awake or about to drain the mailbox.
+     */
+    void enqueue(const Task& task) {
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wasEmpty = inbox.empty();
+            inbox.push_back(task);
+        }
+        if (wasEmpty) {
+            wake.notify_one();
+        }
+    }
+
+    ChatRoom* find(RoomId id) {
+        std::unordered_map<RoomId, ChatRoom*>::iterator it = rooms.find(id);
+        return it == rooms.end() ? nullptr : it->second;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Task> inbox;
+    bool stopping;
+    std::thread worker;
+
+    /**
+     * @brief Take the whole mailbox at once and run it outside the lock
+     */
+    void run() {
+        std::vector<Task> batch;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !inbox.empty(); });
+                if (inbox.empty() && stopping) {
+                    break;
+                }
+                batch.swap(inbox);
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                batch[i]();
+            }
+            batch.clear();
+        }
+
+        for (std::unordered_map<RoomId, ChatRoom*>::iterator it = rooms.begin(); it != rooms.end(); ++it) {
+            delete it->second;
+        }
+        rooms.clear();
+    }
+};
+
+/**
+ * @brief Constructor - starts the shard threads
+ * @param shardCount Number of shard threads
+ */
+RoomManager::RoomManager(size_t shardCount) : nextRoomId(1) {
+    if (shardCount == 0) {
+        shardCount = 1;
+    }
+    for (size_t i = 0; i < shardCount; i++) {
+        shards.push_back(new Shard());
+    }
+}
+
+/**
+ * @brief Destructor - runs outstanding work, destroys all rooms and stops
+ * the shard threads
+ */
+RoomManager::~RoomManager() {
+    for (size_t i = 0; i < shards.size(); i++) {
+        delete shards[i];
+    }
+    shards.clear();
+}
+
+/**
+ * @brief Create a room
+ * @param name Unique room name
+ * @return Id of the new room, or 0 if the name is taken or empty
+ */
+RoomManager::RoomId RoomManager::createRoom(const std::string& name) {
+    return createRoom(name, std::function<ChatRoom*()>());
+}
+
+/**
+ * @brief Create a room using a custom factory
+ * @param name Unique room name
+ * @param factory Builds the room
+ * @return Id of the new room, or 0 if the name is taken or empty
+ */
+RoomManager::RoomId RoomManager::createRoom(const std::string& name, const std::function<ChatRoom*()>& factory) {
+    if (name.empty()) {
+        return 0;
+    }
+
+    RoomId id;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (roomsByName.find(name) != roomsByName.end()) {
+            return 0;
+        }
+        id = nextRoomId.fetch_add(1);
+        roomsByName[name] = id;
+        namesById[id] = name;
+    }
+
+    Shard* shard = shards[getShardOf(id)];
+    shard->enqueue([shard, id, name, factory]() {
+        ChatRoom* room = factory ? factory() : new ChatRoom(name);
+        shard->rooms[id] = room;
+    });
+    return id;
+}
+
+/**
+ * @brief Look up a room by name
+ * @param name Room name
+ * @return Id of the room, or 0 if there is none
+ */
+RoomManager::RoomId RoomManager::findRoom(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::map<std::string, RoomId>::const_iterator it = roomsByName.find(name);
+    return it == roomsByName.end() ? 0 : it->second;
+}
+
+/**
+ * @brief Destroy a room on its shard
+ * @param id The room to destroy
+ * @return True if the room existed
+ */
+bool RoomManager::destroyRoom(RoomId id) {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::map<RoomId, std::string>::iterator it = namesById.find(id);
+        if (it == namesById.end()) {
+            return false;
+        }
+        roomsByName.erase(it->second);
+        namesById.erase(it);
+    }
+
+    Shard* shard = shards[getShardOf(id)];
+    shard->enqueue([shard, id]() {
+        ChatRoom* room = shard->find(id);
+        if (room != nullptr) {
+            shard->rooms.erase(id);
+            delete room;
+        }
+    });
+    return true;
+}
+
+/**
+ * @brief Run a task on the room's owning shard
+ * @param id The room to run against
+ * @param task Work to run with the room
+ */
+void RoomManager::post(RoomId id, const RoomTask& task) {
+    if (id == 0) {
+        return;
+    }
+    Shard* shard = shards[getShardOf(id)];
+    shard->enqueue([shard, id, task]() {
+        ChatRoom* room = shard->find(id);
+        if (room != nullptr) {
+            task(*room);
+        }
+    });
+}
+
+/**
+ * @brief Send a message into a room from any thread
+ * @param id The target room
+ * @param fromUser The sender
+ * @param message The message content
+ *
+ * Uses the room's own command queue rather than the sender's, so a user
+ * sending into rooms on several shards never shares a queue between threads.
+ */
+void RoomManager::sendMessage(RoomId id, User* fromUser, const std::string& message) {
+    if (fromUser == nullptr || message.empty()) {
+        return;
+    }
+    MessagePtr shared = Message::create(fromUser, message);
+    post(id, [fromUser, shared](ChatRoom& room) {
+        if (!room.hasUser(fromUser) || !fromUser->getOnlineStatus()) {
+            return;
+        }
+        if (!fromUser->getRateLimiter().tryAcquire()) {
+            return;
+        }
+        room.addCommand(new SendMessageCommand(&room, fromUser, shared));
+        room.addCommand(new LogMessageCommand(&room, fromUser, shared));
+        room.executeAll();
+    });
+}
+
+/**
+ * @brief Block until every task posted before this call has run
+ */
+void RoomManager::drain() {
+    std::vector<std::shared_ptr<std::promise<void> > > done;
+    for (size_t i = 0; i < shards.size(); i++) {
+        std::shared_ptr<std::promise<void> > signal(new std::promise<void>());
+        done.push_back(signal);
+        shards[i]->enqueue([signal]() { signal->set_value(); });
+    }
+    for (size_t i = 0; i < done.size(); i++) {
+        done[i]->get_future().wait();
+    }
+}
+
+/**
+ * @brief Get the shard that owns a room id
+ * @param id Room id
+ * @return Shard index
+ */
+size_t RoomManager::getShardOf(RoomId id) const {
+    return static_cast<size_t>(id % shards.size());
+}
+
+/**
+ * @brief Get the number of shard threads
+ * @return Shard count
+ */
+size_t RoomManager::getShardCount() const {
+    return shards.size();
+}
+
+/**
+ * @brief Get the number of live rooms
+ * @return Room count
+ */
+size_t RoomManager::getRoomCount() const {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return namesById.size();
+}
@@ -0,0 +1,157 @@
+/**
+ * @file RoomManager.h
+ * @brief Registry of chat rooms spread across shard threads
+ * @date 19/10/2026
+ */
+
+#ifndef ROOMMANAGER_H
+#define ROOMMANAGER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+class ChatRoom;
+class User;
+
+/**
+ * @brief Creates, finds and destroys rooms and runs each room on one shard
+ *
+ * Every room is owned by exactly one shard thread, chosen from its id. All
+ * work on a room - creation, membership changes, sends, destruction - is
+ * posted to that shard's mailbox and runs on the shard thread, so ChatRoom
+ * itself needs no locks. Callers on any thread, including other shards,
+ * reach a room only by posting to it.
+ *
+ * Only the name registry is shared and guarded by a mutex; it is used when
+ * rooms are created, looked up by name or destroyed, never when posting.
+ *
+ * User objects are shared between shards. Sends through the manager only
+ * read the sender and recipients, so a user may send into rooms on several
+ * shards at once. The user's own room list and online status are safe to
+ * touch from any thread, so members may join, leave or lose rooms being
+ * destroyed on several shards at once. Deleting a user still requires that
+ * none of its rooms is in use.
+ */
+class RoomManager {
+public:
+    typedef unsigned long RoomId;   ///< 0 is never a valid id
+
+    /**
+     * @brief Work to run on a room's owning shard
+     */
+    typedef std::function<void(ChatRoom&)> RoomTask;
+
+    /**
+     * @brief Constructor - starts the shard threads
+     * @param shardCount Number of shard threads (at least 1)
+     */
+    explicit RoomManager(size_t shardCount);
+
+    /**
+     * @brief Destructor - runs outstanding work, destroys all rooms and
+     * stops the shard threads
+     */
+    ~RoomManager();
+
+    /**
+     * @brief Create a room
+     * @param name Unique room name
+     * @return Id of the new room, or 0 if the name is taken or empty
+     */
+    RoomId createRoom(const std::string& name);
+
+    /**
+     * @brief Create a room using a custom factory
+     *
+     * The factory runs on the owning shard and its result is owned by the
+     * manager.
+     *
+     * @param name Unique room name
+     * @param factory Builds the room, e.g. a CtrlCat or Dogorithm
+     * @return Id of the new room, or 0 if the name is taken or empty
+     */
+    RoomId createRoom(const std::string& name, const std::function<ChatRoom*()>& factory);
+
+    /**
+     * @brief Look up a room by name
+     * @param name Room name
+     * @return Id of the room, or 0 if there is none
+     */
+    RoomId findRoom(const std::string& name) const;
+
+    /**
+     * @brief Destroy a room on its shard
+     * @param id The room to destroy
+     * @return True if the room existed
+     */
+    bool destroyRoom(RoomId id);
+
+    /**
+     * @brief Run a task on the room's owning shard
+     *
+     * Posting never touches the registry. The task is dropped if the room
+     * does not exist when it runs.
+     *
+     * @param id The room to run against
+     * @param task Work to run with the room
+     */
+    void post(RoomId id, const RoomTask& task);
+
+    /**
+     * @brief Send a message into a room from any thread
+     *
+     * Checks membership, online status and the sender's rate limit on the
+     * owning shard, then runs the room's SendMessageCommand and
+     * LogMessageCommand.
+     *
+     * @param id The target room
+     * @param fromUser The sender
+     * @param message The message content
+     */
+    void sendMessage(RoomId id, User* fromUser, const std::string& message);
+
+    /**
+     * @brief Block until every task posted before this call has run
+     *
+     * Must not be called from inside a room task.
+     */
+    void drain();
+
+    /**
+     * @brief Get the shard that owns a room id
+     * @param id Room id
+     * @return Shard index in [0, getShardCount())
+     */
+    size_t getShardOf(RoomId id) const;
+
+    /**
+     * @brief Get the number of shard threads
+     * @return Shard count
+     */
+    size_t getShardCount() const;
+
+    /**
+     * @brief Get the number of live rooms
+     * @return Room count
+     */
+    size_t getRoomCount() const;
+
+private:
+    class Shard;
+
+    std::vector<Shard*> shards;
+    std::atomic<RoomId> nextRoomId;
+
+    mutable std::mutex registryMutex;
+    std::map<std::string, RoomId> roomsByName;
+    std::map<RoomId, std::string> namesById;
+
+    RoomManager(const RoomManager&);
+    RoomManager& operator=(const RoomManager&);
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "RoomPolicy.h"
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+/**
+ * @file RoomPolicy.cpp
+ * @brief Implementation of room policies and their config loader
+ */
+
+namespace {
+
+std::string trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+bool parseCount(const std::string& value, size_t& result) {
+    if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    result = static_cast<size_t>(std::strtoul(value.c_str(), nullptr, 10));
+    return true;
+}
+
+}
+
+RoomPolicy::Template::Template() {
+}
+
+/**
+ * @brief Parse a template into literal and placeholder segments
+ * @param source Template text
+ *
+ * Braces that do not form a known placeholder are kept as literal text.
+ */
+RoomPolicy::Template::Template(const std::string& source) : text(source) {
+    static const char* const names[] = { "{user}", "{room}", "{count}" };
+    static const Field fields[] = { USER, ROOM, COUNT };
+
+    std::string literal;
+    size_t i = 0;
+    while (i < text.size()) {
+        bool matched = false;
+        if (text[i] == '{') {
+            for (size_t f = 0; f < 3; f++) {
+                std::string placeholder = names[f];
+                if (text.compare(i, placeholder.size(), placeholder) == 0) {
+                    if (!literal.empty()) {
+                        Segment segment = { LITERAL, literal };
+                        segments.push_back(segment);
+                        literal.clear();
+                    }
+                    Segment segment = { fields[f], "" };
+                    segments.push_back(segment);
+                    i += placeholder.size();
+                    matched = true;
+                    break;
+                }
+            }
+        }
+        if (!matched) {
+            literal.push_back(text[i]);
+            i++;
+        }
+    }
+    if (!literal.empty()) {
+        Segment segment = { LITERAL, literal };
+        segments.push_back(segment);
+    }
+}
+
+std::string RoomPolicy::Template::render(const std::string& user, const std::string& room, size_t count) const {
+    std::string result;
+    result.reserve(text.size() + user.size() + room.size());
+    for (size_t i = 0; i < segments.size(); i++) {
+        switch (segments[i].field) {
+            case LITERAL: result += segments[i].literal; break;
+            case USER: result += user; break;
+            case ROOM: result += room; break;
+            case COUNT: result += std::to_string(count); break;
+        }
+    }
+    return result;
+}
+
+const std::string& RoomPolicy::Template::getText() const {
+    return text;
+}
+
+bool RoomPolicy::Template::empty() const {
+    return text.empty();
+}
+
+RoomPolicy::RoomPolicy() : name("DefaultRoom"), maxUsers(0), historyLimit(0) {
+}
+
+RoomPolicy RoomPolicy::ctrlCat() {
+    RoomPolicy policy;
+    policy.setName("CtrlCat");
+    policy.setCreatedBanner("{room} room created - Welcome to the feline programming paradise!");
+    policy.setDestroyedBanner("{room} room destroyed - The cats have logged off!");
+    policy.setJoinGreeting("🐱 {user} has pounced into {room}! Ready to discuss cats and code! 🐱");
+    policy.setLeaveFarewell("🐱 {user} has left {room}. The cat has wandered off to chase other code! 🐱");
+    policy.setMemberCount("{room} now has {count} coding cats online.");
+    return policy;
+}
+
+RoomPolicy RoomPolicy::dogorithm() {
+    RoomPolicy policy;
+    policy.setName("Dogorithm");
+    policy.setCreatedBanner("{room} room created - Where algorithms meet adorable dogs!");
+    policy.setDestroyedBanner("{room} room destroyed - The pack has disbanded!");
+    policy.setJoinGreeting("{user} has joined the pack in {room}! Ready to fetch some algorithms and discuss good dogs!");
+    policy.setLeaveFarewell("{user} has left the {room} pack. Gone to chase new coding adventures!");
+    policy.setMemberCount("{room} pack now has {count} coding companions.");
+    return policy;
+}
+
+bool RoomPolicy::loadConfig(std::istream& in, std::map<std::string, RoomPolicy>& policies) {
+    std::string line;
+    std::string section;
+    RoomPolicy current;
+    int lineNumber = 0;
+
+    while (std::getline(in, line)) {
+        lineNumber++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+
+        if (line[0] == '[') {
+            if (line[line.size() - 1] != ']' || trim(line.substr(1, line.size() - 2)).empty()) {
+                std::cerr << "Error: Invalid section on line " << lineNumber << " of room config" << std::endl;
+                return false;
+            }
+            if (!section.empty()) {
+                policies[section] = current;
+            }
+            section = trim(line.substr(1, line.size() - 2));
+            current = RoomPolicy();
+            current.setName(section);
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (section.empty() || equals == std::string::npos) {
+            std::cerr << "Error: Expected key = value inside a section on line " << lineNumber
+                      << " of room config" << std::endl;
+            return false;
+        }
+        std::string key = trim(line.substr(0, equals));
+        std::string value = trim(line.substr(equals + 1));
+        if (!current.set(key, value)) {
+            std::cerr << "Error: Invalid setting '" << key << "' on line " << lineNumber
+                      << " of room config" << std::endl;
+            return false;
+        }
+    }
+
+    if (!section.empty()) {
+        policies[section] = current;
+    }
+    return true;
+}
+
+bool RoomPolicy::loadConfigFile(const std::string& path, std::map<std::string, RoomPolicy>& policies) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        std::cerr << "Error: Cannot open room config " << path << std::endl;
+        return false;
+    }
+    return loadConfig(file, policies);
+}
+
+bool RoomPolicy::set(const std::string& key, const std::string& value) {
+    if (key == "name") {
+        if (value.empty()) {
+            return false;
+        }
+        setName(value);
+    } else if (key == "created") {
+        setCreatedBanner(value);
+    } else if (key == "destroyed") {
+        setDestroyedBanner(value);
+    } else if (key == "join") {
+        setJoinGreeting(value);
+    } else if (key == "leave") {
+        setLeaveFarewell(value);
+    } else if (key == "count") {
+        setMemberCount(value);
+    } else if (key == "max_users") {
+        return parseCount(value, maxUsers);
+    } else if (key == "history_limit") {
+        return parseCount(value, historyLimit);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const std::string& RoomPolicy::getName() const {
+    return name;
+}
+
+const RoomPolicy::Template& RoomPolicy::getCreatedBanner() const {
+    return createdBanner;
+}
+
+const RoomPolicy::Template& RoomPolicy::getDestroyedBanner() const {
+    return destroyedBanner;
+}
+
+const RoomPolicy::Template& RoomPolicy::getJoinGreeting() const {
+    return joinGreeting;
+}
+
+const RoomPolicy::Template& RoomPolicy::getLeaveFarewell() const {
+    return leaveFarewell;
+}
+
+const RoomPolicy::Template& RoomPolicy::getMemberCount() const {
+    return memberCount;
+}
+
+size_t RoomPolicy::getMaxUsers() const {
+    return maxUsers;
+}
+
+size_t RoomPolicy::getHistoryLimit() const {
+    return historyLimit;
+}
+
+void RoomPolicy::setName(const std::string& newName) {
+    name = newName;
+}
+
+void RoomPolicy::setCreatedBanner(const std::string& text) {
+    createdBanner = Template(text);
+}
+
+void RoomPolicy::setDestroyedBanner(const std::string& text) {
+    destroyedBanner = Template(text);
+}
+
+void RoomPolicy::setJoinGreeting(const std::string& text) {
+    joinGreeting = Template(text);
+}
+
+void RoomPolicy::setLeaveFarewell(const std::string& text) {
+    leaveFarewell = Template(text);
+}
+
+void RoomPolicy::setMemberCount(const std::string& text) {
+    memberCount = Template(text);
+}
+
+void RoomPolicy::setMaxUsers(size_t limit) {
+    maxUsers = limit;
+}
+
+void RoomPolicy::setHistoryLimit(size_t limit) {
+    historyLimit = limit;
+}
@@ -0,0 +1,175 @@
+/**
+ * @file RoomPolicy.h
+ * @brief Per-room-type greetings, limits and history policy
+ * @date 19/10/2026
+ */
+
+#ifndef ROOMPOLICY_H
+#define ROOMPOLICY_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+
+/**
+ * @brief Describes how a type of room greets users and what it allows
+ *
+ * Room types such as CtrlCat and Dogorithm differ only in data: their
+ * name, the banners printed when the room is created and destroyed, the
+ * lines printed when users join and leave, a member limit and a history
+ * limit. A ChatRoom copies its policy on construction, so adding a room
+ * type needs no subclass and no virtual calls.
+ *
+ * Text templates are parsed once when they are set. The placeholders
+ * {user}, {room} and {count} are replaced when a template is rendered;
+ * an empty template prints nothing.
+ *
+ * Policies can be built in code or loaded from an INI-style config:
+ *
+ *     [Birdbrain]
+ *     created = Birdbrain room created - mind the feathers!
+ *     join = {user} flew into {room}!
+ *     leave = {user} has flown off.
+ *     count = {room} now has {count} birds.
+ *     max_users = 50
+ *     history_limit = 1000
+ */
+class RoomPolicy {
+public:
+    /**
+     * @brief Text with {user}, {room} and {count} placeholders
+     */
+    class Template {
+    public:
+        Template();
+
+        /**
+         * @brief Parse a template
+         * @param text Template text
+         */
+        explicit Template(const std::string& text);
+
+        /**
+         * @brief Render the template
+         * @param user Value for {user}
+         * @param room Value for {room}
+         * @param count Value for {count}
+         * @return The rendered text
+         */
+        std::string render(const std::string& user, const std::string& room, size_t count) const;
+
+        /**
+         * @brief Get the original template text
+         * @return Template text
+         */
+        const std::string& getText() const;
+
+        /**
+         * @brief Check whether the template prints nothing
+         * @return True if the template text is empty
+         */
+        bool empty() const;
+
+    private:
+        enum Field { LITERAL, USER, ROOM, COUNT };
+
+        struct Segment {
+            Field field;
+            std::string literal;
+        };
+
+        std::string text;
+        std::vector<Segment> segments;
+    };
+
+    /**
+     * @brief Default policy - a silent, unlimited room named "DefaultRoom"
+     */
+    RoomPolicy();
+
+    /**
+     * @brief Policy of the cat-themed CtrlCat room
+     * @return The CtrlCat policy
+     */
+    static RoomPolicy ctrlCat();
+
+    /**
+     * @brief Policy of the dog-themed Dogorithm room
+     * @return The Dogorithm policy
+     */
+    static RoomPolicy dogorithm();
+
+    /**
+     * @brief Load policies from an INI-style config
+     *
+     * Each [section] starts a policy named after the section. Lines that
+     * are blank or start with '#' or ';' are ignored. Loaded policies are
+     * added to (or replace entries in) the given map.
+     *
+     * @param in Stream to read from
+     * @param policies Map of policy name to policy
+     * @return False if the config has an error, which is reported on std::cerr
+     */
+    static bool loadConfig(std::istream& in, std::map<std::string, RoomPolicy>& policies);
+
+    /**
+     * @brief Load policies from a config file
+     * @param path Path of the config file
+     * @param policies Map of policy name to policy
+     * @return False if the file cannot be read or has an error
+     */
+    static bool loadConfigFile(const std::string& path, std::map<std::string, RoomPolicy>& policies);
+
+    /**
+     * @brief Set a field by its config key
+     *
+     * Keys are name, created, destroyed, join, leave, count, max_users and
+     * history_limit.
+     *
+     * @param key Config key
+     * @param value Value to set
+     * @return False if the key is unknown or the value is not valid
+     */
+    bool set(const std::string& key, const std::string& value);
+
+    const std::string& getName() const;
+    const Template& getCreatedBanner() const;
+    const Template& getDestroyedBanner() const;
+    const Template& getJoinGreeting() const;
+    const Template& getLeaveFarewell() const;
+    const Template& getMemberCount() const;
+
+    /**
+     * @brief Get the member limit
+     * @return Maximum number of users, 0 for no limit
+     */
+    size_t getMaxUsers() const;
+
+    /**
+     * @brief Get the history limit
+     * @return Maximum number of history entries kept, 0 for no limit
+     */
+    size_t getHistoryLimit() const;
+
+    void setName(const std::string& name);
+    void setCreatedBanner(const std::string& text);
+    void setDestroyedBanner(const std::string& text);
+    void setJoinGreeting(const std::string& text);
+    void setLeaveFarewell(const std::string& text);
+    void setMemberCount(const std::string& text);
+    void setMaxUsers(size_t maxUsers);
+    void setHistoryLimit(size_t historyLimit);
+
+private:
+    std::string name;
+    Template createdBanner;
+    Template destroyedBanner;
+    Template joinGreeting;
+    Template leaveFarewell;
+    Template memberCount;
+    size_t maxUsers;
+    size_t historyLimit;
+};
+
+#endif
@@ -1,10 +1,15 @@
 #include "SendMessageCommand.h"
 #include "ChatRoom.h"
 #include "Users.h"
+#include "Trace.h"
 
 // SendMessageCommand implementation
 SendMessageCommand::SendMessageCommand(ChatRoom* room, User* user, const std::string& msg)
-    : Command(room, user, msg) {
+    : Command(room, user, msg), messageId(0) {
+}
+
+SendMessageCommand::SendMessageCommand(ChatRoom* room, User* user, const MessagePtr& msg)
+    : Command(room, user, msg), messageId(0) {
 }
 
 SendMessageCommand::~SendMessageCommand() {
@@ -12,9 +17,44 @@ SendMessageCommand::~SendMessageCommand() {
 }
 
 void SendMessageCommand::execute() {
-    if (room != nullptr && fromUser != nullptr && !message.empty()) {
+    TRACE_SPAN("SendMessageCommand::execute");
+    if (room != nullptr && fromUser != nullptr && !message->empty()) {
         // Use ChatRoom's sendMessage method to deliver message to all users
         // This will distribute the message to all users in the chat room
+        // The flood guard or filter may drop the message, so only a new
+        // history entry counts as delivered
+        ChatHistory::MessageId nextId = room->getChatHistory().getNextId();
         room->sendMessage(message, fromUser);
+        if (room->getChatHistory().getNextId() != nextId) {
+            messageId = room->getChatHistory().getLastId();
+        }
     }
-}
\ No newline at end of file
+}
+
+std::string SendMessageCommand::getType() const {
+    return "SendMessage";
+}
+
+void SendMessageCommand::undo() {
+    if (room != nullptr && messageId != 0) {
+        room->retractMessage(messageId);
+    }
+}
+
+void SendMessageCommand::redo() {
+    if (room != nullptr && messageId != 0) {
+        room->restoreMessage(messageId);
+    }
+}
+
+bool SendMessageCommand::canRedo() const {
+    return room != nullptr && messageId != 0 && room->getChatHistory().find(messageId) != nullptr;
+}
+
+bool SendMessageCommand::isUndoable() const {
+    return messageId != 0;
+}
+
+ChatHistory::MessageId SendMessageCommand::getMessageId() const {
+    return messageId;
+}
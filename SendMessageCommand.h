@@ -9,6 +9,7 @@
 #define SENDMESSAGECOMMAND_H
 
 #include "Command.h"
+#include "ChatHistory.h"
 
 /**
  * @brief Command for sending messages in a chat room
@@ -29,6 +30,15 @@ public:
      * @param msg The message content to be sent to all users
      */
     SendMessageCommand(ChatRoom* room, User* user, const std::string& msg);
+
+    /**
+     * @brief Constructor sharing a message with other commands
+     * 
+     * @param room Pointer to the ChatRoom where the message will be sent
+     * @param user Pointer to the User who is sending the message
+     * @param msg The shared message
+     */
+    SendMessageCommand(ChatRoom* room, User* user, const MessagePtr& msg);
     
     /**
      * @brief Destructor
@@ -44,6 +54,47 @@ public:
      * sendMessage method. Only executes if all required parameters are valid.
      */
     void execute() override;
+
+    /**
+     * @brief Get the command's type name
+     * 
+     * @return std::string "SendMessage"
+     */
+    std::string getType() const override;
+
+    /**
+     * @brief Retract the sent message, leaving a tombstone in the history
+     */
+    void undo() override;
+
+    /**
+     * @brief Restore the retracted message without sending it again
+     */
+    void redo() override;
+
+    /**
+     * @brief Check whether the retracted message is still in the history
+     * 
+     * @return bool False once the history limit has dropped the message
+     */
+    bool canRedo() const override;
+
+    /**
+     * @brief Check whether the message was delivered and can be retracted
+     * 
+     * @return bool True once execute() has added the message to the history
+     */
+    bool isUndoable() const override;
+
+    /**
+     * @brief Get the history id of the delivered message
+     * 
+     * @return ChatHistory::MessageId The id, or 0 if nothing was delivered
+     */
+    ChatHistory::MessageId getMessageId() const;
+
+private:
+    ChatHistory::MessageId messageId;
 };
 
 #endif
\ No newline at end of file
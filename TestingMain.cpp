@@ -1,6 +1,13 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <thread>
+#include <sstream>
+#include <map>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 
 #include "Users.h"
 #include "ChatRoom.h"
@@ -13,8 +20,27 @@
 #include "ChatAggregate.h"
 #include "SendMessageCommand.h"
 #include "LogMessageCommand.h"
+#include "BroadcastCommand.h"
 #include "NotificationObserver.h"
 #include "NotificationSubject.h"
+#include "MessageFilter.h"
+#include "FloodGuard.h"
+#include "RateLimiter.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "RoomManager.h"
+#include "RoomPolicy.h"
+#include "DirectChannel.h"
+#include "CommandJournal.h"
+#include "ReplayEngine.h"
+#include "LzCodec.h"
+#include "HistoryExporter.h"
+#include "HistoryImporter.h"
+#include "Message.h"
+#include "BumpArena.h"
+#include "PresenceAggregator.h"
+#include "ChatServer.h"
+#include "ChatClient.h"
 
 /**
  * @file TestingMain.cpp
@@ -23,6 +49,31 @@
  * @date 20/09/2025
  */
 
+namespace {
+
+// Counted by the replacement operator new below, so a test can tell how
+// often a send reaches the heap. Kept out of line as in BenchMain.cpp.
+std::atomic<size_t> heapAllocations(0);
+
+}
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = std::malloc(size != 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+__attribute__((noinline)) void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
 int main() {
     std::cout << "PetSpace Chat System - Basic Testing" << std::endl;
     std::cout << "Starting with User instantiation...\n" << std::endl;
@@ -112,7 +163,7 @@ int main() {
         User* foundUser = ctrlCat->getUser("Rachel");
         std::cout << "User: " << sofia->getName() << std::endl;
 
-        const std::vector<std::string>& history = ctrlCat->getChatHistory();
+        const ChatHistory& history = ctrlCat->getChatHistory();
         std::cout << "Chat history: " << history.size() << std::endl;
 
         std::cout << "\nTesting clearChatHistory():" << std::endl;
@@ -226,6 +277,15 @@ int main() {
         newUser->leaveChatRoom(dogorithm);
         
         std::cout << "\nObserver completed\n" << std::endl;
+
+        delete ctrlCat;
+        delete dogorithm;
+        delete sofia;
+        delete rachel;
+        delete bobby;
+        delete testUser;
+        delete outsider;
+        delete newUser;
         
         //Command
          std::cout << "\nCOMMAND PATTERN COMPREHENSIVE TEST SUITE" << std::endl;
@@ -248,7 +308,9 @@ int main() {
             
             std::cout << "Queue size after execution: " << alice->getCommandQueueSize() << std::endl;
 
-        
+            delete room;
+            delete alice;
+            delete bob;
         }
 
         // TEST 2: SendMessageCommand Execution
@@ -271,6 +333,10 @@ int main() {
 
             std::cout << "Chat history size: " << room->getChatHistory().size() << std::endl;
 
+            delete room;
+            delete sender;
+            delete receiver1;
+            delete receiver2;
         }
 
         // TEST 3: LogMessageCommand Execution
@@ -284,6 +350,8 @@ int main() {
 
             logger->sendMessage("Message to be logged", room);
 
+            delete room;
+            delete logger;
         }
 
         // TEST 4: Multiple Commands in Sequence
@@ -301,6 +369,8 @@ int main() {
 
             std::cout << "Total messages in history: " << room->getChatHistory().size() << std::endl;
 
+            delete room;
+            delete user;
         }
 
         // TEST 5: Command Execution with Offline Users
@@ -321,7 +391,9 @@ int main() {
 
             std::cout << "Messages saved (should be 1): " << room->getChatHistory().size() << std::endl;
 
-            
+            delete room;
+            delete online;
+            delete offline;
         }
 
         // TEST 6: Command Execution with Invalid Parameters
@@ -338,7 +410,8 @@ int main() {
 
             std::cout << "Messages saved (should be 0): " << room->getChatHistory().size() << std::endl;
 
-            
+            delete room;
+            delete user;
         }
 
         // TEST 7: User Not in ChatRoom Scenario
@@ -355,7 +428,9 @@ int main() {
 
             std::cout << "Room2 messages (should be 0): " << room2->getChatHistory().size() << std::endl;
 
-        
+            delete room1;
+            delete room2;
+            delete user;
         }
 
         // TEST 8: Command Queue Management During Multiple Operations
@@ -374,7 +449,8 @@ int main() {
             std::cout << "Total messages processed: " << room->getChatHistory().size() << std::endl;
             std::cout << "Queue size after processing: " << user->getCommandQueueSize() << std::endl;
 
-        
+            delete room;
+            delete user;
         }
 
         // TEST 9: Direct Command Creation and Execution
@@ -397,7 +473,11 @@ int main() {
 
             std::cout << "Messages after direct execution: " << room->getChatHistory().size() << std::endl;
 
-        
+            delete sendCmd;
+            delete logCmd;
+            delete room;
+            delete sender;
+            delete receiver;
         }
 
         // TEST 10: Multiple Users, Multiple Rooms
@@ -427,8 +507,11 @@ int main() {
             std::cout << "General room messages: " << general->getChatHistory().size() << std::endl;
             std::cout << "Tech room messages: " << tech->getChatHistory().size() << std::endl;
 
-            
-            
+            delete general;
+            delete tech;
+            delete alice;
+            delete bob;
+            delete charlie;
         }
 
         // TEST 11: Observer Notification with Commands
@@ -451,7 +534,10 @@ int main() {
 
             std::cout << "Number of observers: " << room->getObservers().size() << std::endl;
 
-            
+            delete room;
+            delete sender;
+            delete observer1;
+            delete observer2;
         }
 
         // TEST 12: User Status Changes During Command Execution
@@ -474,7 +560,9 @@ int main() {
 
             std::cout << "Messages sent (should be 1): " << room->getChatHistory().size() << std::endl;
 
-        
+            delete room;
+            delete user;
+            delete receiver;
         }
 
         // TEST 13: Memory Management and Cleanup
@@ -495,6 +583,9 @@ int main() {
             
 
             std::cout << "Memory cleanup completed successfully" << std::endl;
+
+            delete room;
+            delete user;
         }
 
         // TEST 14: Stress Test - High Volume Message Sending
@@ -515,7 +606,9 @@ int main() {
 
             std::cout << "Total messages processed: " << room->getChatHistory().size() << std::endl;
 
-        
+            delete room;
+            delete spammer;
+            delete listener;
         }
 
         // TEST 15: Edge Case - Self-Messaging
@@ -531,7 +624,8 @@ int main() {
 
             std::cout << "Self-message saved: " << room->getChatHistory().size() << std::endl;
 
-        
+            delete room;
+            delete user;
         }
 
         // TEST 16: Command Pattern with Room Switching
@@ -555,7 +649,9 @@ int main() {
             std::cout << "Room1 messages: " << room1->getChatHistory().size() << std::endl;
             std::cout << "Room2 messages: " << room2->getChatHistory().size() << std::endl;
 
-        
+            delete room1;
+            delete room2;
+            delete user;
         }
 
         // TEST 17: Null Command Handling
@@ -568,7 +664,7 @@ int main() {
             
             std::cout << "Null command handling completed" << std::endl;
 
-            
+            delete room;
         }
 
         // TEST 18: Message History Verification
@@ -588,11 +684,13 @@ int main() {
             user1->sendMessage("Third", room);
 
             std::cout << "Chat history:" << std::endl;
-            for (const std::string& msg : room->getChatHistory()) {
+            for (const ChatHistory::Text& msg : room->getChatHistory()) {
                 std::cout << msg;
             }
 
-            
+            delete room;
+            delete user1;
+            delete user2;
         }
 
         // TEST 19: Command Execution Order
@@ -611,10 +709,12 @@ int main() {
 
             std::cout << "Verifying order in history:" << std::endl;
             int count = 1;
-            for (const std::string& msg : room->getChatHistory()) {
+            for (const ChatHistory::Text& msg : room->getChatHistory()) {
                 std::cout << count++ << ". " << msg;
             }
 
+            delete room;
+            delete user;
         }
 
         // TEST 20: Complex Scenario - Multiple Patterns Integration
@@ -652,6 +752,12 @@ int main() {
             std::cout << "Total users in lobby: " << lobby->getUserCount() << std::endl;
             std::cout << "Total users in support: " << support->getUserCount() << std::endl;
 
+            delete lobby;
+            delete support;
+            delete admin;
+            delete user1;
+            delete user2;
+            delete support_agent;
         }
 
 
@@ -685,7 +791,11 @@ int main() {
                 iter->next();
             }
 
-        
+            delete iter;
+            delete lounge;
+            delete john;
+            delete sarah;
+            delete mike;
         }
 
         // Basic MessageIterator Functionality
@@ -713,7 +823,10 @@ int main() {
                 msgIter->next();
             }
 
-        
+            delete msgIter;
+            delete channel;
+            delete sender1;
+            delete sender2;
         }
 
         //  Empty Collection Iteration
@@ -727,7 +840,9 @@ int main() {
             std::cout << "Has users: " << (emptyUserIter->hasNext() ? "Yes" : "No") << std::endl;
             std::cout << "Has messages: " << (emptyMsgIter->hasNext() ? "Yes" : "No") << std::endl;
 
-        
+            delete emptyUserIter;
+            delete emptyMsgIter;
+            delete emptyRoom;
         }
 
         //  Iterator Reset and Multiple Iterations
@@ -762,7 +877,11 @@ int main() {
                 secondIter->next();
             }
 
-        
+            delete firstIter;
+            delete secondIter;
+            delete space;
+            delete alex;
+            delete beth;
         }
 
         // Single Element Iteration
@@ -793,7 +912,10 @@ int main() {
             }
             std::cout << msgCount << std::endl;
 
-            
+            delete singleUserIter;
+            delete singleMsgIter;
+            delete solo;
+            delete lonely;
         }
 
         //  Iterator Boundary Conditions
@@ -820,6 +942,9 @@ int main() {
             boundIter->next();
             std::cout << "After extra next() - hasNext: " << boundIter->hasNext() << std::endl;
 
+            delete boundIter;
+            delete boundary;
+            delete tester;
         }
 
     
@@ -863,7 +988,12 @@ int main() {
                 if (u) std::cout << u->getName() << std::endl;
             }
 
-            
+            delete iter1;
+            delete iter2;
+            delete concurrent;
+            delete personA;
+            delete personB;
+            delete personC;
         }
 
         //Message Content Verification
@@ -892,6 +1022,10 @@ int main() {
                 verifyIter->next();
             }
 
+            delete verifyIter;
+            delete verification;
+            delete writer;
+            delete reader;
         }
 
         //Iterator After User Deletion
@@ -917,7 +1051,10 @@ int main() {
                 snapshot->next();
             }
 
-        
+            delete snapshot;
+            delete independent;
+            delete temp1;
+            delete temp2;
         }
 
         //Multiple Message Iterators
@@ -948,7 +1085,10 @@ int main() {
                 second->next();
             }
 
-        
+            delete first;
+            delete second;
+            delete multiMsg;
+            delete chatter;
         }
 
         //Iterator with User Leaving Room
@@ -981,6 +1121,11 @@ int main() {
                 after->next();
             }
 
+            delete before;
+            delete after;
+            delete changing;
+            delete stayer;
+            delete leaver;
         }
 
         // Current() Without hasNext() Check
@@ -1005,7 +1150,9 @@ int main() {
             User* afterExtraNext = edge->current();
             std::cout << "Current after extra next(): " << (afterExtraNext ? afterExtraNext->getName() : "null") << std::endl;
 
-        
+            delete edge;
+            delete bounds;
+            delete single;
         }
 
         // MessageIterator currentMessage() Edge Cases
@@ -1027,7 +1174,9 @@ int main() {
             std::string after = msgCheck->currentMessage();
             std::cout << "Message after next(): " << (after.empty() ? "[empty]" : after) << std::endl;
 
-        
+            delete msgCheck;
+            delete msgEdge;
+            delete messenger;
         }
 
         // Iterator Pattern with Multiple Rooms
@@ -1069,7 +1218,13 @@ int main() {
                 yUsers->next();
             }
 
-        
+            delete xUsers;
+            delete yUsers;
+            delete roomX;
+            delete roomY;
+            delete multiRoom;
+            delete xOnly;
+            delete yOnly;
         }
 
     //Nested Iteration
@@ -1105,6 +1260,11 @@ int main() {
                 }
                 userLoop->next();
             }
+
+            delete userLoop;
+            delete nested;
+            delete person1;
+            delete person2;
         }
 
         //Complex Scenario - Full System Integration
@@ -1168,8 +1328,1616 @@ int main() {
                 privateMsgs->next();
             }
 
+            delete mainUsers;
+            delete privateUsers;
+            delete mainMsgs;
+            delete privateMsgs;
+            delete mainHall;
+            delete privateRoom;
+            delete admin;
+            delete member1;
+            delete member2;
+            delete guest;
+        }
+
+
+        //Content Filter
+        std::cout << "\nCONTENT FILTER\n" << std::endl;
+
+        // Profanity masking, banned links and keyword alerts
+        std::cout << "\n--- Content Filter Before saveMessage ---" << std::endl;
+        {
+            MessageFilter* filter = new MessageFilter();
+            filter->addPattern("darn", MessageFilter::PROFANITY);
+            filter->addPattern("spam-site.example", MessageFilter::BANNED_LINK);
+            filter->addPattern("outage", MessageFilter::KEYWORD_ALERT);
+            filter->compile();
+
+            ChatRoom* filtered = new ChatRoom();
+            filtered->setMessageFilter(filter);
+
+            User* poster = new User("Poster");
+            User* reader = new User("Reader");
+            poster->setOnlineStatus(true);
+            reader->setOnlineStatus(true);
+            poster->joinChatRoom(filtered);
+            reader->joinChatRoom(filtered);
+
+            poster->sendMessage("Clean message", filtered);
+            poster->sendMessage("This DARN build again", filtered);
+            poster->sendMessage("Visit http://spam-site.example now", filtered);
+            poster->sendMessage("Is there an outage?", filtered);
+
+            std::cout << "Messages saved (should be 3): " << filtered->getChatHistory().size() << std::endl;
+            for (const ChatHistory::Text& msg : filtered->getChatHistory()) {
+                std::cout << msg;
+            }
+
+            std::cout << "Overlapping patterns: " 
+                      << filter->mask("darndarn") << std::endl;
+            std::cout << "Filter states: " << filter->getStateCount() 
+                      << " for " << filter->getPatternCount() << " patterns" << std::endl;
+
+            delete filtered;
+            delete poster;
+            delete reader;
+            delete filter;
+        }
+
+        // Flood guard: the TEST 14 spammer with a per-room limit
+        std::cout << "\n--- Flood Guard Against High Volume Messages ---" << std::endl;
+        {
+            ChatRoom* guarded = new ChatRoom();
+            guarded->enableFloodGuard(1.0, 10);
+
+            User* spammer = new User("Spammer");
+            User* listener = new User("Listener");
+            spammer->setOnlineStatus(true);
+            listener->setOnlineStatus(true);
+            spammer->joinChatRoom(guarded);
+            listener->joinChatRoom(guarded);
+
+            listener->sendMessage("Hello", guarded);
+            listener->sendMessage("Hello", guarded);
+
+            for (int i = 0; i < 100; i++) {
+                spammer->sendMessage("Stress test message " + std::to_string(i), guarded);
+            }
+
+            std::cout << "Messages accepted (should be 11): " << guarded->getChatHistory().size() << std::endl;
+            std::cout << "Rate limited: " << guarded->getFloodGuard()->getRateLimitedCount() << std::endl;
+            std::cout << "Duplicates: " << guarded->getFloodGuard()->getDuplicateCount() << std::endl;
+
+            FloodGuard guard(2.0, 2);
+            User* timed = new User("Timed");
+            const uint64_t second = 1000000000ULL;
+            std::cout << "Burst 1: " << (guard.check(timed, "a", second) == FloodGuard::ALLOWED) << std::endl;
+            std::cout << "Burst 2: " << (guard.check(timed, "b", second) == FloodGuard::ALLOWED) << std::endl;
+            std::cout << "Burst 3 (should be 0): " << (guard.check(timed, "c", second) == FloodGuard::ALLOWED) << std::endl;
+            std::cout << "After 0.5s: " << (guard.check(timed, "d", second + second / 2) == FloodGuard::ALLOWED) << std::endl;
+            std::cout << "Repeat of d (should be 0): " << (guard.check(timed, "d", 10 * second) == FloodGuard::ALLOWED) << std::endl;
+            std::string burst = "e";
+            while (guard.check(timed, burst, 10 * second) == FloodGuard::ALLOWED) {
+                burst += 'e';
+            }
+            guard.forget(timed);
+            std::cout << "Allowed again after forget: " << (guard.check(timed, burst + "!", 10 * second) == FloodGuard::ALLOWED)
+                      << " (should be 1)" << std::endl;
+
+            delete guarded;
+            delete spammer;
+            delete listener;
+            delete timed;
+        }
+
+        // Per-user rate limit in User::sendMessage
+        std::cout << "\n--- Per-User Rate Limiting ---" << std::endl;
+        {
+            ChatRoom* roomA = new ChatRoom();
+            ChatRoom* roomB = new ChatRoom();
+            User* chatty = new User("Chatty");
+
+            chatty->setOnlineStatus(true);
+            chatty->joinChatRoom(roomA);
+            chatty->joinChatRoom(roomB);
+            chatty->setRateLimit(1.0, 3);
+
+            chatty->sendMessage("One", roomA);
+            chatty->sendMessage("Two", roomB);
+            chatty->sendMessage("Three", roomA);
+            chatty->sendMessage("Four", roomB);
+            chatty->sendMessage("Five", roomA);
+
+            std::cout << "Messages sent across rooms (should be 3): " 
+                      << roomA->getChatHistory().size() + roomB->getChatHistory().size() << std::endl;
+            std::cout << "Rejected sends (should be 2): " << chatty->getRejectedSendCount() << std::endl;
+
+            RateLimiter shared(1.0, 100);
+            std::vector<std::thread> senders;
+            for (int t = 0; t < 4; t++) {
+                senders.push_back(std::thread([&shared]() {
+                    for (int i = 0; i < 1000; i++) {
+                        shared.tryAcquire(1000);
+                    }
+                }));
+            }
+            for (size_t t = 0; t < senders.size(); t++) {
+                senders[t].join();
+            }
+            std::cout << "Concurrent accepted (should be 100): " << shared.getAcceptedCount() << std::endl;
+            std::cout << "Concurrent rejected (should be 3900): " << shared.getRejectedCount() << std::endl;
+
+            // One user sending from several threads, each to its own room
+            User* busy = new User("Busy");
+            busy->setOnlineStatus(true);
+            std::vector<ChatRoom*> lanes;
+            for (int t = 0; t < 4; t++) {
+                lanes.push_back(new ChatRoom("Lane" + std::to_string(t)));
+                busy->joinChatRoom(lanes.back());
+            }
+            std::vector<std::thread> laneSenders;
+            for (int t = 0; t < 4; t++) {
+                ChatRoom* lane = lanes[t];
+                laneSenders.push_back(std::thread([busy, lane]() {
+                    for (int i = 0; i < 500; i++) {
+                        busy->sendMessage("lane message " + std::to_string(i), lane);
+                    }
+                }));
+            }
+            size_t laneMessages = 0;
+            for (int t = 0; t < 4; t++) {
+                laneSenders[t].join();
+                laneMessages += lanes[t]->getChatHistory().size();
+            }
+            std::cout << "Messages from threads sending as one user (should be 2000): " << laneMessages << std::endl;
+            std::cout << "Queue left empty (should be 0): " << busy->getCommandQueueSize() << std::endl;
+            delete busy;
+            for (ChatRoom* lane : lanes) {
+                delete lane;
+            }
+
+            delete roomA;
+            delete roomB;
+            delete chatty;
+        }
+
+        // Metrics registry snapshot and export
+        std::cout << "\n--- Metrics Snapshot ---" << std::endl;
+        {
+            std::cout << "Metrics compiled in: " << (Metrics::isEnabled() ? "yes" : "no") << std::endl;
+            Metrics::reset();
+
+            ChatRoom* measured = new ChatRoom();
+            User* talker = new User("Talker");
+            User* hearer = new User("Hearer");
+            talker->setOnlineStatus(true);
+            hearer->setOnlineStatus(true);
+            talker->joinChatRoom(measured);
+            hearer->joinChatRoom(measured);
+
+            for (int i = 0; i < 10; i++) {
+                talker->sendMessage("Measured message " + std::to_string(i), measured);
+            }
+
+            Metrics::Snapshot snapshot = Metrics::snapshot();
+            std::cout << "Messages sent (10 if enabled, else 0): " 
+                      << snapshot.counters[Metrics::MESSAGES_SENT] << std::endl;
+            std::cout << "Deliveries (10 if enabled, else 0): " 
+                      << snapshot.counters[Metrics::DELIVERIES] << std::endl;
+            std::cout << "Max history size (10 if enabled, else 0): " 
+                      << snapshot.histograms[Metrics::HISTORY_SIZE].max << std::endl;
+
+            std::cout << "Bucket of 1000 holds 1000: " 
+                      << (Metrics::bucketUpperBound(Metrics::bucketIndex(1000)) >= 1000) << std::endl;
+            Metrics::exportText(std::cout);
+
+            delete measured;
+            delete talker;
+            delete hearer;
+        }
+
+        // Trace spans across the Command pipeline
+        std::cout << "\n--- Trace Spans ---" << std::endl;
+        {
+            std::cout << "Tracing compiled in: " << (Trace::isCompiledIn() ? "yes" : "no") << std::endl;
+            ChatRoom* traced = new ChatRoom();
+            User* first = new User("TraceA");
+            User* second = new User("TraceB");
+            first->setOnlineStatus(true);
+            second->setOnlineStatus(true);
+            first->joinChatRoom(traced);
+            second->joinChatRoom(traced);
+
+            Trace::clear();
+            Trace::setEnabled(true);
+            first->sendMessage("Traced message", traced);
+            Trace::setEnabled(false);
+
+            std::cout << "Spans recorded (9 if compiled in, else 0): " << Trace::getEventCount() << std::endl;
+            std::ostringstream chromeJson;
+            Trace::exportChromeJson(chromeJson);
+            std::cout << "Chrome trace export bytes > 0: " << (chromeJson.str().size() > 0) << std::endl;
+            if (Trace::isCompiledIn()) {
+                std::cout << chromeJson.str();
+            }
+
+            delete traced;
+            delete first;
+            delete second;
+        }
+
+        // Rooms spread across shard threads
+        std::cout << "\n--- Sharded Room Manager ---" << std::endl;
+        {
+            RoomManager* manager = new RoomManager(4);
+            RoomManager::RoomId lobby = manager->createRoom("Lobby");
+            RoomManager::RoomId cats = manager->createRoom("Cats", []() { return new CtrlCat(); });
+            RoomManager::RoomId duplicate = manager->createRoom("Lobby");
+
+            std::cout << "Shards: " << manager->getShardCount() << " (should be 4)" << std::endl;
+            std::cout << "Rooms: " << manager->getRoomCount() << " (should be 2)" << std::endl;
+            std::cout << "Duplicate name rejected: " << (duplicate == 0) << " (should be 1)" << std::endl;
+            std::cout << "Lookup by name: " << (manager->findRoom("Cats") == cats) << " (should be 1)" << std::endl;
+            std::cout << "Different shards: " << (manager->getShardOf(lobby) != manager->getShardOf(cats))
+                      << " (should be 1)" << std::endl;
+
+            User* ada = new User("ShardAda");
+            User* bob = new User("ShardBob");
+            ada->setOnlineStatus(true);
+            bob->setOnlineStatus(true);
+            manager->post(lobby, [ada, bob](ChatRoom& room) {
+                ada->joinChatRoom(&room);
+                bob->joinChatRoom(&room);
+            });
+            manager->drain();
+
+            manager->sendMessage(lobby, ada, "Hello from another thread");
+            manager->sendMessage(lobby, bob, "Hi Ada");
+            manager->sendMessage(cats, ada, "Not a member here");
+            manager->drain();
+
+            size_t lobbyHistory = 0;
+            size_t catsHistory = 0;
+            manager->post(lobby, [&lobbyHistory](ChatRoom& room) { lobbyHistory = room.getChatHistory().size(); });
+            manager->post(cats, [&catsHistory](ChatRoom& room) { catsHistory = room.getChatHistory().size(); });
+            manager->drain();
+            std::cout << "Lobby history: " << lobbyHistory << " (should be 2)" << std::endl;
+            std::cout << "Cats history: " << catsHistory << " (should be 0)" << std::endl;
+
+            std::cout << "Destroy Lobby: " << manager->destroyRoom(lobby) << " (should be 1)" << std::endl;
+            manager->drain();
+            std::cout << "Ada rooms after destroy: " << ada->getChatRooms().size() << " (should be 0)" << std::endl;
+            std::cout << "Rooms: " << manager->getRoomCount() << " (should be 1)" << std::endl;
+
+            // Rooms on every shard share both members and are torn down at
+            // once, so the shards unlink the same users concurrently
+            std::vector<RoomManager::RoomId> shared;
+            for (int i = 0; i < 8; i++) {
+                RoomManager::RoomId id = manager->createRoom("Shared" + std::to_string(i));
+                shared.push_back(id);
+                manager->post(id, [ada, bob](ChatRoom& room) {
+                    ada->joinChatRoom(&room);
+                    bob->joinChatRoom(&room);
+                });
+            }
+            manager->drain();
+            std::cout << "Ada rooms on every shard: " << ada->getChatRooms().size() << " (should be 8)" << std::endl;
+            for (size_t i = 0; i < shared.size(); i++) {
+                manager->destroyRoom(shared[i]);
+                manager->sendMessage(shared[(i + 1) % shared.size()], bob, "Still here?");
+            }
+            manager->drain();
+            std::cout << "Ada rooms after shared teardown: " << ada->getChatRooms().size() << " (should be 0)" << std::endl;
+            std::cout << "Bob rooms after shared teardown: " << bob->getChatRooms().size() << " (should be 0)" << std::endl;
+            delete manager;
+
+            delete ada;
+            delete bob;
+        }
+
+        // Room types described by data instead of subclasses
+        std::cout << "\n--- Room Policies ---" << std::endl;
+        {
+            std::istringstream config(
+                "# Rooms loaded at start-up\n"
+                "[Birdbrain]\n"
+                "created = {room} room created - mind the feathers!\n"
+                "join = {user} flew into {room}!\n"
+                "leave = {user} has flown off.\n"
+                "count = {room} now has {count} birds.\n"
+                "max_users = 2\n"
+                "history_limit = 3\n");
+            std::map<std::string, RoomPolicy> policies;
+            std::cout << "Config loaded: " << RoomPolicy::loadConfig(config, policies) << " (should be 1)" << std::endl;
+            std::cout << "Policies: " << policies.size() << " (should be 1)" << std::endl;
+
+            ChatRoom* birds = new ChatRoom(policies["Birdbrain"]);
+            std::cout << "Room name: " << birds->getName() << " (should be Birdbrain)" << std::endl;
+
+            User* robin = new User("Robin");
+            User* wren = new User("Wren");
+            User* jay = new User("Jay");
+            robin->setOnlineStatus(true);
+            wren->setOnlineStatus(true);
+            jay->setOnlineStatus(true);
+            robin->joinChatRoom(birds);
+            wren->joinChatRoom(birds);
+            jay->joinChatRoom(birds);
+            std::cout << "Members: " << birds->getUserCount() << " (should be 2)" << std::endl;
+            std::cout << "Jay rooms: " << jay->getChatRooms().size() << " (should be 0)" << std::endl;
+
+            for (int i = 1; i <= 5; i++) {
+                robin->sendMessage("Tweet " + std::to_string(i), birds);
+            }
+            std::cout << "History kept: " << birds->getChatHistory().size() << " (should be 3)" << std::endl;
+            std::cout << "Oldest kept: " << birds->getChatHistory().front();
+
+            ChatRoom* viaBase = new CtrlCat();
+            std::cout << "CtrlCat via ChatRoom*: " << viaBase->getName() << " (should be CtrlCat)" << std::endl;
+            jay->joinChatRoom(viaBase);
+            jay->leaveChatRoom(viaBase);
+            delete viaBase;
+
+            std::istringstream broken("[Broken]\nmax_users = lots\n");
+            bool rejected = !RoomPolicy::loadConfig(broken, policies);
+            std::cout << "Bad value rejected: " << rejected << " (should be 1)" << std::endl;
+
+            delete birds;
+            delete robin;
+            delete wren;
+            delete jay;
+        }
+
+        // One message announced in several rooms
+        std::cout << "\n--- Multi-Room Broadcast ---" << std::endl;
+        {
+            ChatRoom* north = new ChatRoom("North");
+            ChatRoom* south = new ChatRoom("South");
+            ChatRoom* east = new ChatRoom("East");
+            User* herald = new User("Herald");
+            User* both = new User("InBoth");
+            User* onlySouth = new User("OnlySouth");
+            herald->setOnlineStatus(true);
+            both->setOnlineStatus(true);
+            onlySouth->setOnlineStatus(true);
+            herald->joinChatRoom(north);
+            herald->joinChatRoom(south);
+            both->joinChatRoom(north);
+            both->joinChatRoom(south);
+            onlySouth->joinChatRoom(south);
+
+            std::vector<ChatRoom*> targets;
+            targets.push_back(north);
+            targets.push_back(south);
+            targets.push_back(north);
+            BroadcastCommand* command = new BroadcastCommand(targets, herald, "Announcement for everyone");
+            command->execute();
+            std::cout << "Rooms delivered (repeat not removed by the command): " << command->getDeliveredRoomCount()
+                      << " (should be 3)" << std::endl;
+            std::cout << "Distinct recipients: " << command->getRecipientCount() << " (should be 2)" << std::endl;
+            delete command;
+
+            north->clearChatHistory();
+            south->clearChatHistory();
+            herald->broadcastMessage("Second announcement");
+            std::cout << "North history: " << north->getChatHistory().size() << " (should be 1)" << std::endl;
+            std::cout << "South history: " << south->getChatHistory().size() << " (should be 1)" << std::endl;
+
+            std::vector<ChatRoom*> notJoined(1, east);
+            herald->broadcastMessage("Nobody hears this", notJoined);
+            std::cout << "East history: " << east->getChatHistory().size() << " (should be 0)" << std::endl;
+
+            // One broadcast delivered by two rooms on two threads at once
+            // still reaches each shared member once
+            ChatRoom* left = new ChatRoom("Left");
+            ChatRoom* right = new ChatRoom("Right");
+            std::vector<User*> crowd;
+            for (int i = 0; i < 64; i++) {
+                User* member = new User("Crowd" + std::to_string(i));
+                member->setOnlineStatus(true);
+                crowd.push_back(member);
+            }
+            left->joinUsers(crowd);
+            right->joinUsers(crowd);
+            size_t leftReached = 0;
+            size_t rightReached = 0;
+            MessagePtr atOnce = Message::create(herald, "Both at once");
+            const std::string entry = atOnce->format();
+            std::thread leftLane([&]() { leftReached = left->deliverBroadcast(*atOnce, entry, herald, 1u << 30); });
+            std::thread rightLane([&]() { rightReached = right->deliverBroadcast(*atOnce, entry, herald, 1u << 30); });
+            leftLane.join();
+            rightLane.join();
+            std::cout << "Crowd reached across both threads: " << leftReached + rightReached << " (should be 64)" << std::endl;
+            delete left;
+            delete right;
+            for (User* member : crowd) {
+                delete member;
+            }
+
+            delete north;
+            delete south;
+            delete east;
+            delete herald;
+            delete both;
+            delete onlySouth;
+        }
+
+        // Private messages without a room
+        std::cout << "\n--- Direct Messages ---" << std::endl;
+        {
+            User* alice = new User("DmAlice");
+            User* carol = new User("DmCarol");
+            alice->setOnlineStatus(true);
+            carol->setOnlineStatus(true);
+
+            alice->sendDirectMessage("Hi Carol, quick question", carol);
+            carol->sendDirectMessage("Sure, go ahead", alice);
+            alice->sendDirectMessage("Never mind, found it", carol);
+
+            DirectChannel* channel = alice->getDirectChannel(carol);
+            std::cout << "Shared channel: " << (channel != nullptr && channel == carol->getDirectChannel(alice))
+                      << " (should be 1)" << std::endl;
+            std::cout << "Channel messages: " << channel->size() << " (should be 3)" << std::endl;
+            std::cout << "Second sender: " << channel->getSender(1)->getName() << " (should be DmCarol)" << std::endl;
+            std::cout << "Formatted: " << channel->formatMessage(1);
+            std::cout << "Peer of Alice: " << channel->getPeer(alice)->getName() << " (should be DmCarol)" << std::endl;
+
+            alice->sendDirectMessage("Talking to myself", alice);
+
+            delete carol;
+            std::cout << "Alice channels after Carol leaves: " << alice->getDirectChannelCount()
+                      << " (should be 0)" << std::endl;
+
+            delete alice;
+        }
+
+        // Rebuilding a room from its journal
+        std::cout << "\n--- Command Journal and Replay ---" << std::endl;
+        {
+            std::stringstream journalStream;
+            CommandJournal* journal = new CommandJournal(journalStream, 4);
+            ChatRoom* original = new ChatRoom("Journaled");
+            original->setJournal(journal);
+
+            User* kim = new User("Kim");
+            User* lee = new User("Lee");
+            User* max = new User("Max");
+            kim->setOnlineStatus(true);
+            lee->setOnlineStatus(true);
+            max->setOnlineStatus(true);
+            kim->joinChatRoom(original);
+            lee->joinChatRoom(original);
+            max->joinChatRoom(original);
+            kim->sendMessage("First", original);
+            lee->sendMessage("Second", original);
+            max->leaveChatRoom(original);
+            kim->sendMessage("Third", original);
+
+            SendMessageCommand* queued = new SendMessageCommand(original, lee, "Queued");
+            std::cout << "Command type: " << queued->getType() << " (should be SendMessage)" << std::endl;
+            delete queued;
+
+            std::cout << "Records written: " << journal->getRecordCount() << " (should be 9)" << std::endl;
+
+            // Simulate a crash part-way through writing one more record
+            journalStream.write("\x20\x00\x00\x00\x03partial", 12);
+
+            ReplayEngine replay(journalStream);
+            std::cout << "Replay ok: " << replay.replay() << " (should be 1)" << std::endl;
+            std::cout << "Started from snapshot: " << replay.usedSnapshot() << " (should be 1)" << std::endl;
+            std::cout << "Records applied: " << replay.getRecordsApplied() << " (should be 4)" << std::endl;
+            std::cout << "Truncated tail ignored: " << replay.wasTruncated() << " (should be 1)" << std::endl;
+
+            std::map<uint64_t, User*> known;
+            known[kim->getId()] = kim;
+            ChatRoom* recovered = new ChatRoom("Recovered");
+            replay.restore(*recovered, known);
+            std::cout << "Recovered members: " << recovered->getUserCount() << " (should be 2)" << std::endl;
+            std::cout << "Existing user reused: " << recovered->hasUser(kim) << " (should be 1)" << std::endl;
+            std::cout << "Recovered history: " << recovered->getChatHistory().size() << " (should be 3)" << std::endl;
+            std::cout << "History matches: " << (recovered->getChatHistory() == original->getChatHistory())
+                      << " (should be 1)" << std::endl;
+
+            delete original;
+            delete recovered;
+            delete known[lee->getId()];
+            delete kim;
+            delete lee;
+            delete max;
+            delete journal;
+
+            // Members who share a name are told apart by id, and compaction is replayed
+            std::stringstream twinStream;
+            CommandJournal* twinJournal = new CommandJournal(twinStream);
+            ChatRoom* twins = new ChatRoom("Twins");
+            twins->setJournal(twinJournal);
+            User* firstTwin = new User("Twin");
+            User* secondTwin = new User("Twin");
+            firstTwin->setOnlineStatus(true);
+            secondTwin->setOnlineStatus(true);
+            firstTwin->joinChatRoom(twins);
+            secondTwin->joinChatRoom(twins);
+            firstTwin->sendMessage("Kept", twins);
+            firstTwin->sendMessage("Dropped", twins);
+            twins->retractMessage(twins->getChatHistory().getLastId());
+            std::cout << "Tombstones compacted: " << twins->compactHistory() << " (should be 1)" << std::endl;
+            firstTwin->leaveChatRoom(twins);
+
+            ReplayEngine twinReplay(twinStream);
+            std::cout << "Twin replay ok: " << twinReplay.replay() << " (should be 1)" << std::endl;
+            std::cout << "Same-name member left: " << twinReplay.getMemberNames().size() << " (should be 1)" << std::endl;
+            std::cout << "Remaining twin by id: " << (twinReplay.getMemberIds()[0] == secondTwin->getId())
+                      << " (should be 1)" << std::endl;
+            std::cout << "Compaction replayed: " << twinReplay.getHistory().getStoredCount() << " (should be 1)" << std::endl;
+
+            std::map<uint64_t, User*> twinsKnown;
+            twinsKnown[secondTwin->getId()] = secondTwin;
+            ChatRoom* twinsRecovered = new ChatRoom("TwinsRecovered");
+            twinReplay.restore(*twinsRecovered, twinsKnown);
+            std::cout << "Recovered twin is the one who stayed: " << twinsRecovered->hasUser(secondTwin)
+                      << " (should be 1)" << std::endl;
+
+            delete twinsRecovered;
+            delete twins;
+            delete firstTwin;
+            delete secondTwin;
+            delete twinJournal;
+        }
+
+        // Compressed segments go into the journal once
+        std::cout << "\n--- Journal Checkpoints ---" << std::endl;
+        {
+            std::stringstream checkpointStream;
+            CommandJournal* journal = new CommandJournal(checkpointStream, 8);
+            ChatRoom* archive = new ChatRoom("Checkpointed");
+            archive->setHistorySegmentSize(4);
+            archive->setJournal(journal);
+            User* scribe = new User("Scribe");
+            scribe->setOnlineStatus(true);
+            scribe->joinChatRoom(archive);
+            for (int i = 0; i < 40; i++) {
+                scribe->sendMessage("entry " + std::to_string(i), archive);
+            }
+            archive->retractMessage(2);
+            const ChatHistory& history = archive->getChatHistory();
+
+            journal->appendSnapshot(*archive);
+            uint64_t checkpoints = journal->getCheckpointCount();
+            uint64_t bytesBefore = journal->getByteCount();
+            journal->appendSnapshot(*archive);
+            std::cout << "Checkpoints cover the segments: " << (checkpoints == history.getSegmentCount())
+                      << " (should be 1)" << std::endl;
+            std::cout << "Repeat snapshot checkpoints: " << journal->getCheckpointCount() - checkpoints
+                      << " (should be 0)" << std::endl;
+            std::cout << "Repeat snapshot smaller than cold text: "
+                      << (journal->getByteCount() - bytesBefore < history.getColdRawBytes()) << " (should be 1)" << std::endl;
+
+            archive->editMessage(6, "entry five, edited", scribe);
+            journal->appendSnapshot(*archive);
+            std::cout << "Resealed segment checkpointed again: " << journal->getCheckpointCount() - checkpoints
+                      << " (should be 1)" << std::endl;
+            scribe->sendMessage("after the snapshot", archive);
+
+            ReplayEngine replay(checkpointStream);
+            std::cout << "Replay ok: " << replay.replay() << " (should be 1)" << std::endl;
+            std::cout << "Replayed history matches: " << (replay.getHistory() == history) << " (should be 1)" << std::endl;
+            std::cout << "Replayed segments stay compressed: "
+                      << (replay.getHistory().getSegmentCount() == history.getSegmentCount()) << " (should be 1)" << std::endl;
+
+            std::map<uint64_t, User*> scribes;
+            scribes[scribe->getId()] = scribe;
+            ChatRoom* restoredArchive = new ChatRoom("Restored");
+            replay.restore(*restoredArchive, scribes);
+            std::cout << "Sender restored from a checkpoint: " << (restoredArchive->getAuthor(3) == scribe->getId())
+                      << " (should be 1)" << std::endl;
+            std::cout << "Sender restored from a snapshot entry: "
+                      << (restoredArchive->getAuthor(history.getLastId() - 1) == scribe->getId()) << " (should be 1)" << std::endl;
+            std::cout << "Sender restored from a send: " << (restoredArchive->getAuthor(history.getLastId()) == scribe->getId())
+                      << " (should be 1)" << std::endl;
+            delete restoredArchive;
+
+            archive->setJournal(nullptr);
+            delete archive;
+            delete scribe;
+            delete journal;
+        }
+
+        // Retracting messages through the room's undo stack
+        std::cout << "\n--- Undo and Redo ---" << std::endl;
+        {
+            ChatRoom* moderated = new ChatRoom("Moderated");
+            User* poster = new User("Poster");
+            User* reader = new User("Reader");
+            poster->setOnlineStatus(true);
+            reader->setOnlineStatus(true);
+            poster->joinChatRoom(moderated);
+            reader->joinChatRoom(moderated);
+
+            poster->sendMessage("Kept before undo was enabled", moderated);
+            std::cout << "Undo depth while disabled: " << moderated->getUndoDepth() << " (should be 0)" << std::endl;
+
+            moderated->setUndoLimit(2);
+            poster->sendMessage("Oops, wrong room", moderated);
+            poster->sendMessage("Second mistake", moderated);
+            poster->sendMessage("Third mistake", moderated);
+            std::cout << "Undo depth is bounded: " << moderated->getUndoDepth() << " (should be 2)" << std::endl;
+
+            moderated->undo();
+            moderated->undo();
+            std::cout << "Nothing left to undo: " << !moderated->undo() << " (should be 1)" << std::endl;
+            std::cout << "Live history: " << moderated->getChatHistory().size() << " (should be 2)" << std::endl;
+            std::cout << "Tombstones: " << moderated->getChatHistory().getTombstoneCount() << " (should be 2)" << std::endl;
+            std::cout << "Stored entries unchanged: " << moderated->getChatHistory().getStoredCount()
+                      << " (should be 4)" << std::endl;
+            std::cout << "Newest live: " << moderated->getChatHistory().back();
+
+            moderated->redo();
+            std::cout << "Live history after redo: " << moderated->getChatHistory().size() << " (should be 3)" << std::endl;
+            std::cout << "Redo depth: " << moderated->getRedoDepth() << " (should be 1)" << std::endl;
+
+            poster->sendMessage("A new message clears redo", moderated);
+            std::cout << "Redo depth after new send: " << moderated->getRedoDepth() << " (should be 0)" << std::endl;
+
+            MessageIterator* live = moderated->createMessageIterator();
+            int liveCount = 0;
+            while (live->hasNext()) {
+                liveCount++;
+                live->next();
+            }
+            delete live;
+            std::cout << "Iterator skips tombstones: " << liveCount << " (should be 4)" << std::endl;
+
+            // Undo tombstones the message; compaction must not drop it while redo can bring it back
+            ChatRoom* eager = new ChatRoom("Eager");
+            poster->joinChatRoom(eager);
+            eager->setUndoLimit(1);
+            eager->setCompactionThreshold(0.5, 1);
+            poster->sendMessage("Undone then redone", eager);
+            eager->undo();
+            std::cout << "Compaction waits for redo: " << eager->getChatHistory().getStoredCount()
+                      << " (should be 1)" << std::endl;
+            std::cout << "Redo after undo with compaction due: " << eager->redo() << " (should be 1)" << std::endl;
+            std::cout << "Redone message live: " << eager->getChatHistory().size() << " (should be 1)" << std::endl;
+            eager->undo();
+            eager->compactHistory();
+            std::cout << "Explicit compaction clears redo: " << eager->getRedoDepth() << " (should be 0)" << std::endl;
+
+            // A deleted user's commands leave the stacks with it
+            User* fleeting = new User("Fleeting");
+            fleeting->setOnlineStatus(true);
+            fleeting->joinChatRoom(eager);
+            fleeting->sendMessage("Soon orphaned", eager);
+            std::cout << "Undo depth before the sender is deleted: " << eager->getUndoDepth() << " (should be 1)" << std::endl;
+            delete fleeting;
+            std::cout << "Undo depth after the sender is deleted: " << eager->getUndoDepth() << " (should be 0)" << std::endl;
+            delete eager;
+
+            // The history limit may drop an undone message; its redo goes with it
+            RoomPolicy cappedPolicy;
+            cappedPolicy.setName("Capped");
+            cappedPolicy.setHistoryLimit(2);
+            ChatRoom* capped = new ChatRoom(cappedPolicy);
+            poster->joinChatRoom(capped);
+            capped->setUndoLimit(2);
+            poster->sendMessage("One", capped);
+            poster->sendMessage("Two", capped);
+            capped->undo();
+            capped->importMessage(0, "[Importer]: Three\n", false);
+            std::cout << "Redo kept while its message is stored: " << capped->getRedoDepth() << " (should be 1)" << std::endl;
+            capped->importMessage(0, "[Importer]: Four\n", false);
+            std::cout << "Redo dropped with its trimmed message: " << capped->getRedoDepth() << " (should be 0)" << std::endl;
+            std::cout << "Nothing left to redo: " << !capped->redo() << " (should be 1)" << std::endl;
+            delete capped;
+
+            delete moderated;
+            delete poster;
+            delete reader;
+        }
+
+        std::cout << "\n--- Edit and Delete ---" << std::endl;
+        {
+            ChatRoom* board = new ChatRoom("Board");
+            User* author = new User("Author");
+            User* other = new User("Other");
+            author->setOnlineStatus(true);
+            other->setOnlineStatus(true);
+            author->joinChatRoom(board);
+            other->joinChatRoom(board);
+            std::stringstream boardJournal;
+            CommandJournal* journal = new CommandJournal(boardJournal, 100);
+            board->setJournal(journal);
+
+            author->sendMessage("Helo everyone", board);
+            ChatHistory::MessageId typo = board->getChatHistory().getLastId();
+            other->sendMessage("Hi Author", board);
+            ChatHistory::MessageId reply = board->getChatHistory().getLastId();
+
+            std::cout << "Author edits own message: " << board->editMessage(typo, "Hello everyone", author)
+                      << " (should be 1)" << std::endl;
+            std::cout << "Edited entry: " << board->getChatHistory().find(typo)->text;
+            bool foreignEdit = board->editMessage(reply, "Bye", author);
+            std::cout << "Editing someone else's message: " << foreignEdit << " (should be 0)" << std::endl;
+            std::cout << "Stored entries after edit: " << board->getChatHistory().getStoredCount()
+                      << " (should be 2)" << std::endl;
+
+            bool foreignDelete = board->deleteMessage(typo, other);
+            std::cout << "Deleting someone else's message: " << foreignDelete << " (should be 0)" << std::endl;
+            User* impostor = new User("Author");
+            bool spoofedEdit = board->editMessage(typo, "Bye", impostor);
+            std::cout << "Same name, different user edits: " << spoofedEdit << " (should be 0)" << std::endl;
+            bool spoofedDelete = board->deleteMessage(typo, impostor);
+            std::cout << "Same name, different user deletes: " << spoofedDelete << " (should be 0)" << std::endl;
+            delete impostor;
+            std::cout << "Author deletes own message: " << board->deleteMessage(typo, author)
+                      << " (should be 1)" << std::endl;
+            std::cout << "Deleted message cannot be restored: " << !board->restoreMessage(typo)
+                      << " (should be 1)" << std::endl;
+
+            MessageIterator* hidden = board->createMessageIterator();
+            int hiddenCount = 0;
+            while (hidden->hasNext()) {
+                hiddenCount++;
+                hidden->next();
+            }
+            delete hidden;
+            MessageIterator* shown = board->createMessageIterator(true);
+            std::string placeholder = shown->currentMessage();
+            delete shown;
+            std::cout << "Iterator skipping tombstones: " << hiddenCount << " (should be 1)" << std::endl;
+            std::cout << "Iterator showing tombstones: " << placeholder;
+
+            ReplayEngine replay(boardJournal);
+            replay.replay();
+            std::cout << "Edits and deletes replay: " << (replay.getHistory() == board->getChatHistory())
+                      << " (should be 1)" << std::endl;
+
+            // Senders survive replay, mapped to the recovering users
+            std::map<uint64_t, User*> recovering;
+            User* recoveredAuthor = new User("Author");
+            recovering[author->getId()] = recoveredAuthor;
+            ChatRoom* rebuilt = new ChatRoom("Rebuilt");
+            replay.restore(*rebuilt, recovering);
+            User* recoveredOther = recovering[other->getId()];
+            std::cout << "Recovered sender edits own message: " << rebuilt->editMessage(reply, "Hi again", recoveredOther)
+                      << " (should be 1)" << std::endl;
+            bool recoveredForeignEdit = rebuilt->editMessage(reply, "Bye", recoveredAuthor);
+            std::cout << "Recovered user edits someone else's: " << recoveredForeignEdit << " (should be 0)" << std::endl;
+            bool originalEdit = rebuilt->editMessage(reply, "Bye", other);
+            std::cout << "Original user has no say after replay: " << originalEdit << " (should be 0)" << std::endl;
+            delete rebuilt;
+            delete recoveredAuthor;
+            delete recoveredOther;
+
+            board->setJournal(nullptr);
+            delete journal;
+
+            board->setCompactionThreshold(0.5, 3);
+            for (int i = 0; i < 4; i++) {
+                author->sendMessage("Draft " + std::to_string(i), board);
+            }
+            ChatHistory::MessageId lastDraft = board->getChatHistory().getLastId();
+            board->deleteMessage(lastDraft - 3, author);
+            std::cout << "Below threshold, tombstones kept: " << board->getChatHistory().getTombstoneCount()
+                      << " (should be 2)" << std::endl;
+            board->deleteMessage(lastDraft - 2, author);
+            std::cout << "Threshold reached, tombstones compacted: " << board->getChatHistory().getTombstoneCount()
+                      << " (should be 0)" << std::endl;
+            std::cout << "Stored entries after compaction: " << board->getChatHistory().getStoredCount()
+                      << " (should be 3)" << std::endl;
+            std::cout << "Ids survive compaction: " << board->getChatHistory().find(lastDraft)->text;
+
+            author->leaveChatRoom(board);
+            other->leaveChatRoom(board);
+            delete author;
+            delete other;
+            delete board;
+        }
+
+        std::cout << "\n--- Compressed History ---" << std::endl;
+        {
+            std::string sample;
+            for (int i = 0; i < 50; i++) {
+                sample += "[Whiskers]: meow meow " + std::to_string(i % 7) + "\n";
+            }
+            std::string packed;
+            std::string unpacked;
+            LzCodec::compress(sample, packed);
+            std::cout << "Codec round trip: " << (LzCodec::decompress(packed, unpacked) && unpacked == sample)
+                      << " (should be 1)" << std::endl;
+            std::cout << "Codec shrinks chat text: " << (packed.size() * 4 < sample.size()) << " (should be 1)" << std::endl;
+            LzCodec::compress("", packed);
+            std::cout << "Empty block round trip: " << (LzCodec::decompress(packed, unpacked) && unpacked.empty())
+                      << " (should be 1)" << std::endl;
+            std::cout << "Corrupt block rejected: " << !LzCodec::decompress(std::string("\x05\x10", 2), unpacked)
+                      << " (should be 1)" << std::endl;
+
+            ChatHistory history;
+            history.setSegmentSize(8);
+            for (int i = 0; i < 40; i++) {
+                history.append("[Ann]: message " + std::to_string(i) + "\n");
+            }
+            std::cout << "Segments sealed: " << history.getSegmentCount() << " (should be 4)" << std::endl;
+            std::cout << "Live messages: " << history.size() << " (should be 40)" << std::endl;
+            std::cout << "Compressed below raw: " << (history.getColdCompressedBytes() < history.getColdRawBytes())
+                      << " (should be 1)" << std::endl;
+            std::cout << "Cold lookup: " << history.find(3)->text;
+
+            std::cout << "Cold retract: " << history.tombstone(5) << " (should be 1)" << std::endl;
+            std::cout << "Live after retract: " << history.size() << " (should be 39)" << std::endl;
+            std::cout << "Cold restore: " << history.restore(5) << " (should be 1)" << std::endl;
+            std::cout << "Cold restore of live entry: " << history.restore(5) << " (should be 0)" << std::endl;
+            history.edit(10, "[Ann]: edited\n");
+            std::cout << "Cold edit: " << history.find(10)->text;
+
+            size_t iterated = 0;
+            for (const ChatHistory::Text& message : history) {
+                iterated += message.empty() ? 0 : 1;
+            }
+            std::cout << "Iterated across segments: " << iterated << " (should be 40)" << std::endl;
+
+            history.trimTo(30);
+            std::cout << "Live after trim: " << history.size() << " (should be 30)" << std::endl;
+            std::cout << "Segments after trim: " << history.getSegmentCount() << " (should be 3)" << std::endl;
+            std::cout << "Oldest after trim: " << history.front();
+            history.erase(12);
+            std::cout << "Erased cold entry not restorable: " << history.restore(12) << " (should be 0)" << std::endl;
+            std::cout << "Compaction drops cold tombstones: " << history.compact() << " (should be 1)" << std::endl;
+            std::cout << "Lookup after compaction: " << history.find(13)->text;
+            std::cout << "Newest: " << history.back();
+
+            ChatRoom* archive = new ChatRoom("Archive");
+            archive->setHistorySegmentSize(4);
+            User* chatty = new User("Chatty");
+            chatty->setOnlineStatus(true);
+            chatty->joinChatRoom(archive);
+            for (int i = 0; i < 10; i++) {
+                chatty->sendMessage("note " + std::to_string(i), archive);
+            }
+            archive->retractMessage(archive->getChatHistory().getLastId() - 9);
+            MessageIterator* notes = archive->createMessageIterator();
+            int noteCount = 0;
+            std::string firstNote = notes->currentMessage();
+            while (notes->hasNext()) {
+                noteCount++;
+                notes->next();
+            }
+            delete notes;
+            std::cout << "Room iterator over segments: " << noteCount << " (should be 9)" << std::endl;
+            std::cout << "First visible note: " << firstNote;
+
+            chatty->leaveChatRoom(archive);
+            delete chatty;
+            delete archive;
+        }
+
+        std::cout << "\n--- History Export and Import ---" << std::endl;
+        {
+            ChatRoom* source = new ChatRoom("Source");
+            User* writer = new User("Writer");
+            writer->setOnlineStatus(true);
+            writer->joinChatRoom(source);
+            writer->sendMessage("plain message", source);
+            writer->sendMessage("quote \" backslash \\ tab \t caf\xc3\xa9", source);
+            writer->sendMessage("retract me", source);
+            writer->sendMessage("last one", source);
+            source->retractMessage(source->getChatHistory().getLastId() - 1);
+
+            std::stringstream json;
+            HistoryExporter jsonOut(json, HistoryExporter::NDJSON);
+            jsonOut.exportHistory(source->getChatHistory());
+            std::cout << "NDJSON entries: " << jsonOut.getEntriesWritten() << " (should be 3)" << std::endl;
+            std::string firstLine;
+            std::getline(json, firstLine);
+            std::cout << "First line: " << firstLine << std::endl;
+            json.clear();
+            json.seekg(0);
+
+            std::stringstream jsonAll;
+            HistoryExporter allOut(jsonAll, HistoryExporter::NDJSON, 16);
+            allOut.exportHistory(source->getChatHistory(), true);
+            std::cout << "With tombstones: " << allOut.getEntriesWritten() << " (should be 4)" << std::endl;
+
+            ChatRoom* fromJson = new ChatRoom("FromJson");
+            HistoryImporter jsonIn(jsonAll, HistoryExporter::NDJSON);
+            std::cout << "NDJSON import ok: " << jsonIn.importInto(*fromJson) << " (should be 1)" << std::endl;
+            std::cout << "NDJSON round trip: " << (fromJson->getChatHistory() == source->getChatHistory())
+                      << " (should be 1)" << std::endl;
+
+            std::stringstream binary;
+            HistoryExporter binaryOut(binary, HistoryExporter::BINARY, 8);
+            binaryOut.exportHistory(source->getChatHistory(), true);
+            std::cout << "Binary smaller than NDJSON: " << (binaryOut.getBytesWritten() < allOut.getBytesWritten())
+                      << " (should be 1)" << std::endl;
+            ChatRoom* fromBinary = new ChatRoom("FromBinary");
+            HistoryImporter binaryIn(binary, HistoryExporter::BINARY);
+            std::cout << "Binary import ok: " << binaryIn.importInto(*fromBinary) << " (should be 1)" << std::endl;
+            std::cout << "Binary round trip: " << (fromBinary->getChatHistory() == source->getChatHistory())
+                      << " (should be 1)" << std::endl;
+
+            HistoryImporter again(json, HistoryExporter::NDJSON);
+            again.importInto(*fromBinary);
+            std::cout << "Import into existing history: " << fromBinary->getChatHistory().size()
+                      << " (should be 6)" << std::endl;
+            std::cout << "Clashing ids renumbered: "
+                      << (fromBinary->getChatHistory().getLastId() > source->getChatHistory().getLastId())
+                      << " (should be 1)" << std::endl;
+
+            std::string escaped;
+            uint64_t id;
+            bool tombstoned;
+            HistoryImporter::parseJsonLine(" { \"extra\": [1, {\"a\": \"}\"}], \"text\": \"\\u00e9\\ud83d\\ude00\" } ",
+                                           id, escaped, tombstoned);
+            std::cout << "Unicode escapes decoded: " << (escaped == "\xc3\xa9\xf0\x9f\x98\x80") << " (should be 1)" << std::endl;
+
+            std::istringstream broken("{\"id\":1,\"text\":\"ok\\n\"}\n\n{broken\n{\"text\":\"never\"}\n");
+            ChatRoom* partial = new ChatRoom("Partial");
+            HistoryImporter brokenIn(broken, HistoryExporter::NDJSON);
+            bool brokenOk = brokenIn.importInto(*partial);
+            std::cout << "Malformed line stops import: " << !brokenOk << " (should be 1)" << std::endl;
+            std::cout << "Entries before it kept: " << partial->getChatHistory().size() << " (should be 1)" << std::endl;
+
+            std::string cut = binary.str();
+            std::istringstream truncated(cut.substr(0, cut.size() - 3));
+            ChatRoom* cutRoom = new ChatRoom("Cut");
+            HistoryImporter cutIn(truncated, HistoryExporter::BINARY);
+            bool cutOk = cutIn.importInto(*cutRoom);
+            std::cout << "Truncated binary detected: " << !cutOk << " (should be 1)" << std::endl;
+
+            writer->leaveChatRoom(source);
+            delete writer;
+            delete source;
+            delete fromJson;
+            delete fromBinary;
+            delete partial;
+            delete cutRoom;
+        }
+
+        std::cout << "\n--- Chat Server ---" << std::endl;
+        {
+            ChatServer server;
+            bool listening = server.start(0);
+            std::cout << "Server listening: " << listening << " (should be 1)" << std::endl;
+
+            ChatClient alice;
+            ChatClient bob;
+            bool connected = alice.connect("127.0.0.1", server.getPort()) && bob.connect("127.0.0.1", server.getPort());
+            while (server.pollOnce(20) > 0) {}
+            std::cout << "Connections accepted: " << server.getConnectionCount() << " (should be 2)" << std::endl;
+            std::cout << "Clients connected: " << connected << " (should be 1)" << std::endl;
+
+            // Single-threaded: send, let the server drain its events, then read.
+            // Replies skip room events; awaitEvent skips everything else.
+            std::string reply;
+            auto nextReply = [](ChatClient& client, std::string& frame) {
+                while (client.receive(frame, 1000) && frame.compare(0, 6, "EVENT ") == 0) {}
+            };
+            auto awaitEvent = [](ChatClient& client, const std::string& event) {
+                std::string frame;
+                while (client.receive(frame, 1000)) {
+                    if (frame == event) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            alice.send("SAY Lobby too early");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(alice, reply);
+            std::cout << "Request before NICK: " << reply << " (should be ERR not logged in)" << std::endl;
+
+            alice.send("NICK Alice");
+            bob.send("NICK Alice");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(alice, reply);
+            std::cout << "NICK reply: " << reply << " (should be OK NICK Alice)" << std::endl;
+            nextReply(bob, reply);
+            std::cout << "Duplicate NICK: " << reply << " (should be ERR name taken)" << std::endl;
+            bob.send("NICK Bob");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(bob, reply);
+
+            alice.send("JOIN Lobby");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(alice, reply);
+            std::cout << "JOIN reply: " << reply << " (should be OK JOIN Lobby)" << std::endl;
+            bob.send("JOIN Lobby");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(bob, reply);
+            std::cout << "Join seen by member: " << awaitEvent(alice, "EVENT Lobby USER_JOINED Bob") << " (should be 1)" << std::endl;
+            std::cout << "Rooms created: " << server.getRoomCount() << " (should be 1)" << std::endl;
+
+            bob.send("SAY Lobby hello over tcp");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(alice, reply);
+            std::cout << "Delivered frame: " << reply << " (should be MSG Lobby Bob hello over tcp)" << std::endl;
+
+            alice.send("SAY Garden hi");
+            alice.send("PING");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(alice, reply);
+            std::cout << "SAY to unjoined room: " << reply << " (should be ERR not in Garden)" << std::endl;
+            nextReply(alice, reply);
+            std::cout << "PING reply: " << reply << " (should be PONG)" << std::endl;
+
+            // Frames queued in one tick leave in one vectored send
+            uint64_t writesBefore = server.getWriteCalls();
+            bob.send("SAY Lobby one");
+            bob.send("SAY Lobby two");
+            bob.send("SAY Lobby three");
+            while (server.pollOnce(20) > 0) {}
+            std::cout << "Sends to flush three frames: " << server.getWriteCalls() - writesBefore << " (should be 1)" << std::endl;
+            nextReply(alice, reply);
+            nextReply(alice, reply);
+            nextReply(alice, reply);
+            std::cout << "Last batched frame: " << reply << " (should be MSG Lobby Bob three)" << std::endl;
+
+            bob.send("QUIT");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(bob, reply);
+            std::cout << "QUIT reply: " << reply << " (should be OK QUIT)" << std::endl;
+            std::cout << "Connections after QUIT: " << server.getConnectionCount() << " (should be 1)" << std::endl;
+            std::cout << "Departure seen by member: " << awaitEvent(alice, "EVENT Lobby USER_LEFT Bob") << " (should be 1)" << std::endl;
+
+            // Presence goes out as one diff per window, ticked by the poll loop
+            server.setPresenceWindow(std::chrono::milliseconds(30));
+            ChatClient carol;
+            carol.connect("127.0.0.1", server.getPort());
+            carol.send("NICK Carol");
+            carol.send("JOIN Lobby");
+            while (server.pollOnce(20) > 0) {}
+            nextReply(carol, reply);
+            nextReply(carol, reply);
+            alice.send("AWAY");
+            carol.send("AWAY");
+            carol.send("BACK");
+            while (server.pollOnce(0) > 0) {}
+            nextReply(alice, reply);
+            std::cout << "AWAY reply: " << reply << " (should be OK AWAY)" << std::endl;
+            std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+            server.pollOnce(5000);
+            long long waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - waitStart).count();
+            std::cout << "Poll woke for the presence window: " << (waitedMs < 1000) << " (should be 1)" << std::endl;
+            std::cout << "Away seen by member: " << awaitEvent(carol, "EVENT Lobby PRESENCE_DIFF -5:Alice") << " (should be 1)" << std::endl;
+        }
+
+        std::cout << "\n--- Slow Consumers ---" << std::endl;
+        {
+            ChatServer server;
+            server.start(0);
+            server.setOutboundLimit(256 * 1024);
+            ChatClient talker;
+            ChatClient lurker;
+            talker.connect("127.0.0.1", server.getPort());
+            lurker.connect("127.0.0.1", server.getPort());
+            talker.send("NICK Talker");
+            lurker.send("NICK Lurker");
+            talker.send("JOIN Den");
+            while (server.pollOnce(20) > 0) {}
+            lurker.send("JOIN Den");
+            while (server.pollOnce(20) > 0) {}
+
+            // The lurker never reads, so once the socket buffers are full its
+            // queue grows until it passes the limit
+            std::string chunk = "SAY Den " + std::string(32 * 1024, 'x');
+            int sent = 0;
+            while (server.getConnectionCount() == 2 && sent < 4000) {
+                talker.send(chunk);
+                sent++;
+                while (server.pollOnce(0) > 0) {}
+            }
+            std::cout << "Slow consumer closed: " << server.getSlowConsumersClosed() << " (should be 1)" << std::endl;
+            std::cout << "Connections left: " << server.getConnectionCount() << " (should be 1)" << std::endl;
+            std::cout << "Room kept the talker: " << server.getRoomCount() << " (should be 1)" << std::endl;
+
+            std::string reply;
+            talker.send("PING");
+            while (server.pollOnce(20) > 0) {}
+            while (talker.receive(reply, 1000) && reply != "PONG") {}
+            std::cout << "Talker still served: " << reply << " (should be PONG)" << std::endl;
+        }
+
+        std::cout << "\n--- Shared Messages ---" << std::endl;
+        {
+            ChatRoom* room = new ChatRoom("Shared");
+            User* sam = new User("Sam");
+            std::vector<User*> listeners;
+            sam->setOnlineStatus(true);
+            sam->joinChatRoom(room);
+            for (int i = 0; i < 3; i++) {
+                listeners.push_back(new User("Listener" + std::to_string(i)));
+                listeners.back()->setOnlineStatus(true);
+                listeners.back()->joinChatRoom(room);
+            }
+
+            MessagePtr shared = Message::create(sam, "one copy");
+            SendMessageCommand* send = new SendMessageCommand(room, sam, shared);
+            LogMessageCommand* log = new LogMessageCommand(room, sam, shared);
+            std::cout << "Commands share one message: " << (send->getMessage() == log->getMessage()) << " (should be 1)" << std::endl;
+            std::cout << "References held: " << shared.use_count() << " (should be 3)" << std::endl;
+            send->execute();
+            log->execute();
+            std::cout << "History line matches: " << (room->getChatHistory().back() == shared->format()) << " (should be 1)" << std::endl;
+            delete send;
+            delete log;
+            std::cout << "References after commands are deleted: " << shared.use_count() << " (should be 1)" << std::endl;
+
+            size_t liveBefore = Message::getLiveCount();
+            sam->sendMessage("through the user", room);
+            std::cout << "Messages left alive after a send to three listeners: " << Message::getLiveCount() - liveBefore
+                      << " (should be 0)" << std::endl;
+
+            sam->leaveChatRoom(room);
+            delete sam;
+            for (User* listener : listeners) {
+                listener->leaveChatRoom(room);
+                delete listener;
+            }
+            delete room;
+        }
+
+        std::cout << "\n--- Inline History Slots ---" << std::endl;
+        {
+            std::cout << "Entry size: " << sizeof(ChatHistory::Entry) << " (should be 64)" << std::endl;
+            ChatHistory history;
+            std::string longLine = "[Rex]: " + std::string(200, 'w') + "\n";
+            ChatHistory::MessageId shortId = history.append("[Rex]: woof\n");
+            ChatHistory::MessageId longId = history.append(longLine);
+            std::cout << "Short message inline: " << history.find(shortId)->text.isInline() << " (should be 1)" << std::endl;
+            std::cout << "Long message inline: " << history.find(longId)->text.isInline() << " (should be 0)" << std::endl;
+            std::cout << "Long message intact: " << (history.find(longId)->text == longLine) << " (should be 1)" << std::endl;
+            std::cout << "Spilled entries: " << history.getSpilledCount() << " (should be 1)" << std::endl;
+
+            history.edit(longId, "[Rex]: woof woof\n");
+            std::cout << "Spilled after shortening edit: " << history.getSpilledCount() << " (should be 0)" << std::endl;
+
+            for (int i = 0; i < 2000; i++) {
+                history.append(longLine);
+            }
+            size_t grown = history.getOverflowBytes();
+            history.trimTo(10);
+            std::cout << "Arena released by trim: " << (history.getOverflowBytes() < grown / 2) << " (should be 1)" << std::endl;
+            std::cout << "Spilled after trim: " << history.getSpilledCount() << " (should be 10)" << std::endl;
+
+            ChatHistory copy = history;
+            history.clear();
+            std::cout << "Copy keeps its own text: " << (copy.back() == longLine) << " (should be 1)" << std::endl;
+            std::cout << "Cleared arena: " << history.getOverflowBytes() << " (should be 0)" << std::endl;
+        }
+
+        std::cout << "\n--- Member Mirror ---" << std::endl;
+        {
+            ChatRoom* room = new ChatRoom("Mirror");
+            User* ann = new User("Ann");
+            User* ben = new User("Ben");
+            User* cal = new User("Cal");
+            ann->setOnlineStatus(true);
+            cal->setOnlineStatus(true);
+            ann->joinChatRoom(room);
+            ben->joinChatRoom(room);
+            cal->joinChatRoom(room);
+
+            ann->sendMessage("first", room);
+            std::cout << "Offline member skipped: " << room->getDeliveredSequence(ben) << " (should be 0)" << std::endl;
+            std::cout << "Online member reached: " << room->getDeliveredSequence(cal) << " (should be 1)" << std::endl;
+            std::cout << "Sender not delivered to: " << room->getDeliveredSequence(ann) << " (should be 0)" << std::endl;
+
+            ben->setOnlineStatus(true);
+            ann->sendMessage("second", room);
+            std::cout << "Member reached after coming online: " << room->getDeliveredSequence(ben) << " (should be 2)" << std::endl;
+
+            ann->leaveChatRoom(room);
+            std::cout << "Left member forgotten: " << room->hasUser(ann) << " (should be 0)" << std::endl;
+            cal->sendMessage("third", room);
+            std::cout << "Slots kept after a leave: " << room->getDeliveredSequence(ben) << " (should be 3)" << std::endl;
+            std::cout << "Join order kept: " << room->getUsers()[1]->getName() << " (should be Cal)" << std::endl;
+
+            ben->leaveChatRoom(room);
+            cal->leaveChatRoom(room);
+            delete ann;
+            delete ben;
+            delete cal;
+            delete room;
+        }
+
+        std::cout << "\n--- Command Arena ---" << std::endl;
+        {
+            BumpArena& arena = BumpArena::local();
+            ChatRoom* room = new ChatRoom("Arena");
+            User* rex = new User("Rex");
+            User* pip = new User("Pip");
+            rex->setOnlineStatus(true);
+            pip->setOnlineStatus(true);
+            rex->joinChatRoom(room);
+            pip->joinChatRoom(room);
+
+            rex->sendMessage("warm up", room);
+            size_t capacity = arena.getCapacity();
+            size_t rewinds = arena.getRewindCount();
+            for (int i = 0; i < 100; i++) {
+                rex->sendMessage("from the arena " + std::to_string(i), room);
+            }
+            std::cout << "Live after the batches: " << arena.getLiveCount() << " (should be 0)" << std::endl;
+            std::cout << "Rewound once per send: " << arena.getRewindCount() - rewinds << " (should be 100)" << std::endl;
+            std::cout << "Arena did not grow: " << (arena.getCapacity() == capacity) << " (should be 1)" << std::endl;
+            std::cout << "History kept the text: " << (room->getChatHistory().back() == "[Rex]: from the arena 99\n") << " (should be 1)" << std::endl;
+
+            size_t bytesBefore = arena.getBytesInUse();
+            MessagePtr kept = Message::create(rex, std::string(200, 'r'), arena);
+            std::cout << "Long message is one arena allocation: " << arena.getLiveCount() << " (should be 1)" << std::endl;
+            std::cout << "Text inside that allocation: " << (arena.getBytesInUse() - bytesBefore >= 200) << " (should be 1)" << std::endl;
+            rex->sendMessage("while one is kept", room);
+            std::cout << "Kept message pins the arena: " << arena.getLiveCount() << " (should be 1)" << std::endl;
+            std::cout << "Kept message intact: " << (kept->getText() == std::string(200, 'r')) << " (should be 1)" << std::endl;
+            kept.reset();
+            std::cout << "Live after release: " << arena.getLiveCount() << " (should be 0)" << std::endl;
+
+            room->setUndoLimit(5);
+            rex->sendMessage("undo me", room);
+            std::cout << "Undoable send left the arena: " << arena.getLiveCount() << " (should be 0)" << std::endl;
+            std::cout << "Undo still works: " << room->undo() << " (should be 1)" << std::endl;
+
+            rex->leaveChatRoom(room);
+            pip->leaveChatRoom(room);
+            delete rex;
+            delete pip;
+            delete room;
+        }
+
+        std::cout << "\n--- Message Text Buffers ---" << std::endl;
+        {
+            // Records the buffer each sent message is read from
+            struct BufferWatcher : public NotificationObserver {
+                const char* seen;
+                BufferWatcher() : seen(nullptr) {}
+                void update(const std::string&, const std::string&, ChatRoom*) override {
+                }
+                void messageSent(const Message& message, ChatRoom*) override {
+                    seen = message.data();
+                }
+            };
+            // Only knows update(), so is handed a copy of the text
+            struct TextWatcher : public NotificationObserver {
+                std::string text;
+                void update(const std::string& event, const std::string& data, ChatRoom*) override {
+                    if (event == "MESSAGE_SENT") {
+                        text = data;
+                    }
+                }
+            };
+            struct BufferReader : public User {
+                const char* read;
+                explicit BufferReader(const std::string& name) : User(name), read(nullptr) {}
+                using User::receiveMessage;
+                void receiveMessage(const Message& message, User*, ChatRoom*) override {
+                    read = message.data();
+                }
+            };
+
+            ChatRoom* room = new ChatRoom("Buffers");
+            User* max = new User("Max");
+            BufferReader* kit = new BufferReader("Kit");
+            max->setOnlineStatus(true);
+            kit->setOnlineStatus(true);
+            max->joinChatRoom(room);
+            kit->joinChatRoom(room);
+            BufferWatcher watcher;
+            TextWatcher textWatcher;
+            room->addObserver(&watcher);
+            room->addObserver(&textWatcher);
+
+            std::string longText(100, 'm');
+            MessagePtr copied = Message::create(max, longText);
+            std::cout << "Message holds its own copy: " << (copied->data() != longText.data()) << " (should be 1)" << std::endl;
+            std::cout << "Copy matches: " << (copied->getText() == longText) << " (should be 1)" << std::endl;
+            std::cout << "Sender id kept: " << (copied->getSenderId() == max->getId()) << " (should be 1)" << std::endl;
+            std::cout << "Formatted from the sender: " << (copied->format() == "[Max]: " + longText + "\n") << " (should be 1)" << std::endl;
+
+            User* gone = new User("Gone");
+            MessagePtr orphan = Message::create(gone, "outlives its sender");
+            delete gone;
+            std::cout << "Sender name after the sender is deleted: " << orphan->getSenderName() << " (should be Gone)" << std::endl;
+            std::cout << "Formatted after the sender is deleted: " << (orphan->format() == "[Gone]: outlives its sender\n") << " (should be 1)" << std::endl;
+
+            MessagePtr shared = Message::create(max, std::string(100, 's'));
+            SendMessageCommand* send = new SendMessageCommand(room, max, shared);
+            send->execute();
+            delete send;
+            std::cout << "Recipient read the message in place: " << (kit->read == shared->data()) << " (should be 1)" << std::endl;
+            std::cout << "Observer read the message in place: " << (watcher.seen == shared->data()) << " (should be 1)" << std::endl;
+            std::cout << "Observer without messageSent got the text: " << (textWatcher.text == shared->getText()) << " (should be 1)" << std::endl;
+            std::cout << "History holds the text: " << (room->getChatHistory().back() == "[Max]: " + std::string(100, 's') + "\n") << " (should be 1)" << std::endl;
+
+            std::string keptText(100, 'k');
+            max->sendMessage(keptText, room);
+            std::cout << "Lvalue left intact: " << keptText.size() << " (should be 100)" << std::endl;
+
+            // A send copies the text twice: into the message block, which
+            // comes from the arena, and into the history, which keeps a short
+            // entry in its slot and a long one on the heap. Nothing else on
+            // the way allocates once the arena has warmed up.
+            std::string movedText(100, 'v');
+            max->sendMessage(std::move(movedText), room);
+            const size_t measuredSends = 256;
+            size_t allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < measuredSends; i++) {
+                max->sendMessage(keptText, room);
+            }
+            size_t longAllocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+            const std::string shortText = "short";
+            allocationsBefore = heapAllocations.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < measuredSends; i++) {
+                max->sendMessage(shortText, room);
+            }
+            size_t shortAllocations = heapAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+            std::cout << "Long sends: about one heap allocation each: "
+                      << (longAllocations >= measuredSends && longAllocations * 10 < measuredSends * 11) << " (should be 1)" << std::endl;
+            std::cout << "Short sends: under 0.1 heap allocations each: " << (shortAllocations * 10 < measuredSends) << " (should be 1)" << std::endl;
+
+            room->removeObserver(&watcher);
+            room->removeObserver(&textWatcher);
+            max->leaveChatRoom(room);
+            kit->leaveChatRoom(room);
+            delete max;
+            delete kit;
+            delete room;
+        }
+
+        std::cout << "\n--- Room and User Lifetimes ---" << std::endl;
+        {
+            size_t usersBefore = User::getLiveCount();
+            size_t roomsBefore = ChatRoom::getLiveCount();
+
+            ChatRoom* hall = new ChatRoom("Hall");
+            std::vector<User*> crowd;
+            for (int i = 0; i < 1000; i++) {
+                crowd.push_back(new User("Member" + std::to_string(i)));
+            }
+            hall->restoreState(crowd, ChatHistory());
+            std::cout << "Hall members: " << hall->getUserCount() << " (should be 1000)" << std::endl;
+            delete hall;
+            bool forgotten = true;
+            for (User* member : crowd) {
+                forgotten = forgotten && member->getChatRooms().empty();
+            }
+            std::cout << "Members forgot the deleted room: " << forgotten << " (should be 1)" << std::endl;
+            for (User* member : crowd) {
+                delete member;
+            }
+
+            ChatRoom* yard = new ChatRoom("Yard");
+            crowd.clear();
+            for (int i = 0; i < 1000; i++) {
+                crowd.push_back(new User("Member" + std::to_string(i)));
+            }
+            yard->restoreState(crowd, ChatHistory());
+            for (size_t i = 0; i < crowd.size(); i += 2) {
+                delete crowd[i];
+            }
+            bool intact = yard->getUserCount() == 500 && yard->getObservers().size() == 500;
+            for (size_t i = 1; i < crowd.size(); i += 2) {
+                intact = intact && yard->hasUser(crowd[i]);
+            }
+            std::cout << "Survivors intact after members deleted first: " << intact << " (should be 1)" << std::endl;
+            for (size_t i = 1; i < crowd.size(); i += 2) {
+                delete crowd[i];
+            }
+            std::cout << "Room emptied by deleting members: " << yard->getUserCount() + yard->getObservers().size()
+                      << " (should be 0)" << std::endl;
+            delete yard;
+
+            ChatRoom* den = new ChatRoom("Den");
+            User* fox = new User("Fox");
+            User* owl = new User("Owl");
+            fox->setOnlineStatus(true);
+            owl->setOnlineStatus(true);
+            fox->joinChatRoom(den);
+            owl->joinChatRoom(den);
+            delete fox;
+            std::cout << "Room forgot the deleted member: " << den->getUserCount() << " (should be 1)" << std::endl;
+            std::cout << "Deleted member stopped observing: " << den->getObservers().size() << " (should be 1)" << std::endl;
+            owl->sendMessage("still safe", den);
+            std::cout << "Send after a member is deleted: " << den->getChatHistory().size() << " (should be 1)" << std::endl;
+            delete den;
+            std::cout << "Survivor forgot the deleted room: " << owl->getChatRooms().size() << " (should be 0)" << std::endl;
+            delete owl;
+
+            std::cout << "Users left alive: " << User::getLiveCount() - usersBefore << " (should be 0)" << std::endl;
+            std::cout << "Rooms left alive: " << ChatRoom::getLiveCount() - roomsBefore << " (should be 0)" << std::endl;
+        }
+
+        std::cout << "\n--- Bulk Membership ---" << std::endl;
+        {
+            struct EventCounter : public NotificationObserver {
+                std::map<std::string, int> counts;
+                std::map<std::string, std::string> names;
+                void update(const std::string& event, const std::string& data, ChatRoom*) override {
+                    counts[event]++;
+                    std::string name;
+                    size_t pos = 0;
+                    names[event].clear();
+                    while (NotificationSubject::readName(data, pos, name)) {
+                        names[event] += names[event].empty() ? name : " " + name;
+                    }
+                }
+            };
+
+            ChatRoom* crowd = new ChatRoom("Crowd");
+            EventCounter counter;
+            crowd->addObserver(&counter);
+            User* host = new User("Host");
+            host->setOnlineStatus(true);
+            host->joinChatRoom(crowd);
+            counter.counts.clear();
+
+            std::vector<User*> guests;
+            for (int i = 0; i < 4; i++) {
+                guests.push_back(new User("Guest" + std::to_string(i)));
+                guests.back()->setOnlineStatus(true);
+            }
+            std::vector<User*> batch = guests;
+            batch.push_back(guests[1]);
+            batch.push_back(nullptr);
+            batch.push_back(host);
+            size_t added = crowd->joinUsers(batch);
+            std::cout << "Users added: " << added << " (should be 4)" << std::endl;
+            std::cout << "Members after bulk join: " << crowd->getUserCount() << " (should be 5)" << std::endl;
+            std::cout << "Batched join notifications: " << counter.counts["USERS_JOINED"] << " (should be 1)" << std::endl;
+            std::cout << "Single join notifications: " << counter.counts["USER_JOINED"] << " (should be 0)" << std::endl;
+            std::cout << "Names joined: " << counter.names["USERS_JOINED"] << " (should be Guest0 Guest1 Guest2 Guest3)" << std::endl;
+            std::cout << "Observers after bulk join: " << crowd->getObservers().size() << " (should be 6)" << std::endl;
+            std::cout << "Guest records the room: " << guests[2]->getChatRooms().size() << " (should be 1)" << std::endl;
+
+            host->sendMessage("welcome all", crowd);
+            std::cout << "Bulk-joined guest reached: " << crowd->getDeliveredSequence(guests[3]) << " (should be 1)" << std::endl;
+
+            std::vector<User*> leaving;
+            leaving.push_back(guests[0]);
+            leaving.push_back(guests[2]);
+            leaving.push_back(guests[2]);
+            size_t removed = crowd->leaveUsers(leaving);
+            std::cout << "Users removed: " << removed << " (should be 2)" << std::endl;
+            std::cout << "Batched leave notifications: " << counter.counts["USERS_LEFT"] << " (should be 1)" << std::endl;
+            std::cout << "Names left: " << counter.names["USERS_LEFT"] << " (should be Guest0 Guest2)" << std::endl;
+
+            std::string tricky;
+            NotificationSubject::appendName(tricky, "Rex,2:Max");
+            NotificationSubject::appendName(tricky, "");
+            NotificationSubject::appendName(tricky, "12:");
+            std::vector<std::string> decoded;
+            std::string field;
+            size_t at = 0;
+            while (NotificationSubject::readName(tricky, at, field)) {
+                decoded.push_back(field);
+            }
+            std::cout << "Names with separators round trip: "
+                      << (decoded.size() == 3 && decoded[0] == "Rex,2:Max" && decoded[1].empty() && decoded[2] == "12:")
+                      << " (should be 1)" << std::endl;
+            at = 0;
+            std::cout << "Truncated entry rejected: " << NotificationSubject::readName("9:Rex", at, field) << " (should be 0)" << std::endl;
+            std::cout << "Join order kept: " << crowd->getUsers()[2]->getName() << " (should be Guest3)" << std::endl;
+            std::cout << "Leaver forgot the room: " << guests[0]->getChatRooms().size() << " (should be 0)" << std::endl;
+            std::cout << "Leaver stopped observing: " << crowd->getObservers().size() << " (should be 4)" << std::endl;
+
+            RoomPolicy smallPolicy;
+            smallPolicy.setName("Small");
+            smallPolicy.setMaxUsers(2);
+            ChatRoom* small = new ChatRoom(smallPolicy);
+            size_t seated = small->joinUsers(guests);
+            std::cout << "Users added to a two-seat room: " << seated << " (should be 2)" << std::endl;
+
+            crowd->removeObserver(&counter);
+            delete small;
+            delete crowd;
+            delete host;
+            for (User* guest : guests) {
+                delete guest;
+            }
+        }
+
+        std::cout << "\n--- Presence Aggregation ---" << std::endl;
+        {
+            struct DiffWatcher : public NotificationObserver {
+                std::map<std::string, int> counts;
+                std::string lastDiff;
+                void update(const std::string& event, const std::string& data, ChatRoom*) override {
+                    counts[event]++;
+                    if (event == "PRESENCE_DIFF") {
+                        lastDiff = data;
+                    }
+                }
+            };
+
+            PresenceAggregator presence(std::chrono::milliseconds(60000));
+            ChatRoom* park = new ChatRoom("Park");
+            ChatRoom* pond = new ChatRoom("Pond");
+            DiffWatcher parkWatcher;
+            DiffWatcher pondWatcher;
+            park->addObserver(&parkWatcher);
+            pond->addObserver(&pondWatcher);
+            park->setPresenceAggregator(&presence);
+            pond->setPresenceAggregator(&presence);
+
+            std::vector<User*> walkers;
+            walkers.push_back(new User("Ace"));
+            walkers.push_back(new User("Bo"));
+            walkers.push_back(new User("Cy"));
+            for (User* walker : walkers) {
+                walker->setOnlineStatus(true);
+            }
+            park->joinUsers(walkers);
+            walkers[2]->joinChatRoom(pond);
+
+            walkers[0]->setOnlineStatus(false);
+            walkers[1]->setOnlineStatus(false);
+            walkers[0]->setOnlineStatus(true);
+            walkers[2]->setOnlineStatus(false);
+            std::cout << "Changes recorded: " << presence.getChangesRecorded() << " (should be 5)" << std::endl;
+            std::cout << "Single presence notifications: " << parkWatcher.counts["USER_OFFLINE"] + parkWatcher.counts["USER_ONLINE"]
+                      << " (should be 0)" << std::endl;
+            std::cout << "Rooms pending: " << presence.getPendingRooms() << " (should be 2)" << std::endl;
+            std::cout << "Diffs before the window ends: " << presence.tick() << " (should be 0)" << std::endl;
+
+            walkers[0]->sendMessage("anyone here?", park);
+            std::cout << "Offline member skipped before the tick: " << park->getDeliveredSequence(walkers[1]) << " (should be 0)" << std::endl;
+
+            size_t sent = presence.flush();
+            std::cout << "Diffs sent, one per room: " << sent << " (should be 2)" << std::endl;
+            std::cout << "Park diff: " << parkWatcher.lastDiff << " (should be -2:Bo-2:Cy)" << std::endl;
+            std::cout << "Pond diff: " << pondWatcher.lastDiff << " (should be -2:Cy)" << std::endl;
+            std::cout << "Park diff notifications: " << parkWatcher.counts["PRESENCE_DIFF"] << " (should be 1)" << std::endl;
+
+            walkers[1]->setOnlineStatus(true);
+            walkers[1]->setOnlineStatus(false);
+            std::cout << "Diffs for a change undone in the window: " << presence.flush() << " (should be 0)" << std::endl;
+
+            walkers[1]->setOnlineStatus(true);
+            delete pond;
+            walkers[2]->setOnlineStatus(true);
+            delete park;
+            std::cout << "Deleted rooms forgotten: " << presence.getPendingRooms() << " (should be 0)" << std::endl;
+
+            PresenceAggregator immediate(std::chrono::milliseconds(0));
+            ChatRoom* yard = new ChatRoom("Yard");
+            DiffWatcher yardWatcher;
+            yard->addObserver(&yardWatcher);
+            yard->setPresenceAggregator(&immediate);
+            walkers[0]->joinChatRoom(yard);
+            walkers[0]->setOnlineStatus(false);
+            std::cout << "Tick after the window: " << immediate.tick() << " (should be 1)" << std::endl;
+            std::cout << "Yard diff: " << yardWatcher.lastDiff << " (should be -3:Ace)" << std::endl;
+
+            // A name that looks like a list of changes is still one change
+            User* spoofer = new User("Bo,+Mallory");
+            spoofer->setOnlineStatus(true);
+            spoofer->joinChatRoom(yard);
+            spoofer->setOnlineStatus(false);
+            immediate.tick();
+            std::string changedName;
+            bool nowOnline = true;
+            size_t pos = 0;
+            int changes = 0;
+            while (PresenceAggregator::readChange(yardWatcher.lastDiff, pos, changedName, nowOnline)) {
+                changes++;
+            }
+            std::cout << "Changes in a spoofing name's diff: " << changes << " (should be 1)" << std::endl;
+            std::cout << "Name decoded whole: " << (changedName == "Bo,+Mallory" && !nowOnline) << " (should be 1)" << std::endl;
+            delete spoofer;
+
+            // An aggregator deleted before its room detaches itself
+            PresenceAggregator* shortLived = new PresenceAggregator();
+            yard->setPresenceAggregator(shortLived);
+            walkers[0]->setOnlineStatus(true);
+            delete shortLived;
+            std::cout << "Aggregator cleared by its destructor: " << (yard->getPresenceAggregator() == nullptr) << " (should be 1)" << std::endl;
+            walkers[0]->setOnlineStatus(false);
+            std::cout << "Change after the aggregator is gone sent at once: " << yardWatcher.counts["USER_OFFLINE"] << " (should be 1)" << std::endl;
+
+            delete yard;
+            for (User* walker : walkers) {
+                delete walker;
+            }
         }
-        
 
     } catch (const std::exception& e) {
         std::cout << "Error during testing: " << e.what() << std::endl;
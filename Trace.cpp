@@ -0,0 +1,229 @@
+#include "Trace.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <set>
+#include <chrono>
+
+/**
+ * @file Trace.cpp
+ * @brief Implementation of the per-thread trace ring buffers
+ */
+
+const size_t Trace::RING_CAPACITY;
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t traceId;
+    uint32_t depth;
+};
+
+/**
+ * @brief One thread's ring of finished spans
+ *
+ * The mutex is only contended while an export or clear is running.
+ */
+struct ThreadRing {
+    std::mutex mutex;
+    std::vector<Event> events;
+    size_t next;
+    size_t size;
+    uint32_t threadId;
+    uint32_t depth;         ///< Only touched by the owning thread
+    uint64_t traceId;       ///< Only touched by the owning thread
+
+    explicit ThreadRing(uint32_t id)
+        : events(Trace::RING_CAPACITY), next(0), size(0), threadId(id), depth(0), traceId(0) {}
+
+    void push(const Event& event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events[next] = event;
+        next = (next + 1) % events.size();
+        if (size < events.size()) {
+            size++;
+        }
+    }
+};
+
+std::atomic<bool> recording(false);
+std::atomic<uint64_t> nextTraceId(1);
+
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+/**
+ * @brief Every ring ever created; rings of exited threads are kept so
+ * their spans can still be exported
+ */
+std::vector<ThreadRing*>& rings() {
+    static std::vector<ThreadRing*> all;
+    return all;
+}
+
+ThreadRing& localRing() {
+    static thread_local ThreadRing* ring = nullptr;
+    if (ring == nullptr) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        ring = new ThreadRing(static_cast<uint32_t>(rings().size() + 1));
+        rings().push_back(ring);
+    }
+    return *ring;
+}
+
+uint64_t nowNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+
+/**
+ * @brief Start a span
+ * @param spanName Name of the stage
+ */
+Trace::Span::Span(const char* spanName) : name(spanName), start(0), active(false) {
+    if (!recording.load(std::memory_order_relaxed)) {
+        return;
+    }
+    ThreadRing& ring = localRing();
+    if (ring.depth == 0) {
+        ring.traceId = nextTraceId.fetch_add(1, std::memory_order_relaxed);
+    }
+    ring.depth++;
+    active = true;
+    start = nowNanos();
+}
+
+/**
+ * @brief End the span and record it
+ */
+Trace::Span::~Span() {
+    if (!active) {
+        return;
+    }
+    uint64_t end = nowNanos();
+    ThreadRing& ring = localRing();
+    ring.depth--;
+
+    Event event;
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.traceId = ring.traceId;
+    event.depth = ring.depth;
+    ring.push(event);
+}
+
+/**
+ * @brief Check whether tracing was compiled in
+ * @return True if built with PETSPACE_TRACE
+ */
+bool Trace::isCompiledIn() {
+#ifdef PETSPACE_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Turn recording on or off at run time
+ * @param enabled True to record spans
+ */
+void Trace::setEnabled(bool enabled) {
+    recording.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Check whether spans are being recorded
+ * @return True if recording
+ */
+bool Trace::isEnabled() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Discard every recorded event on every thread
+ */
+void Trace::clear() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::vector<ThreadRing*>& all = rings();
+    for (size_t i = 0; i < all.size(); i++) {
+        std::lock_guard<std::mutex> ringLock(all[i]->mutex);
+        all[i]->next = 0;
+        all[i]->size = 0;
+    }
+}
+
+/**
+ * @brief Get the number of events currently held across all threads
+ * @return Event count
+ */
+size_t Trace::getEventCount() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    size_t total = 0;
+    std::vector<ThreadRing*>& all = rings();
+    for (size_t i = 0; i < all.size(); i++) {
+        std::lock_guard<std::mutex> ringLock(all[i]->mutex);
+        total += all[i]->size;
+    }
+    return total;
+}
+
+/**
+ * @brief Write recorded events in Chrome trace-event JSON format
+ * @param out Stream to write to
+ * @param minRootNanos Minimum duration of a trace's outermost span
+ *
+ * Events are copied out of each ring under its lock and written afterwards,
+ * so recording threads are only held up for the copy.
+ */
+void Trace::exportChromeJson(std::ostream& out, uint64_t minRootNanos) {
+    std::vector<Event> events;
+    std::vector<uint32_t> threadIds;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        std::vector<ThreadRing*>& all = rings();
+        for (size_t i = 0; i < all.size(); i++) {
+            ThreadRing& ring = *all[i];
+            std::lock_guard<std::mutex> ringLock(ring.mutex);
+            size_t first = (ring.next + ring.events.size() - ring.size) % ring.events.size();
+            for (size_t e = 0; e < ring.size; e++) {
+                events.push_back(ring.events[(first + e) % ring.events.size()]);
+                threadIds.push_back(ring.threadId);
+            }
+        }
+    }
+
+    std::set<uint64_t> selected;
+    for (size_t i = 0; i < events.size(); i++) {
+        if (events[i].depth == 0 && events[i].duration >= minRootNanos) {
+            selected.insert(events[i].traceId);
+        }
+    }
+
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first = true;
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event& event = events[i];
+        if (selected.count(event.traceId) == 0) {
+            continue;
+        }
+        out << (first ? "\n" : ",\n")
+            << "  {\"name\": \"" << event.name << "\", \"cat\": \"petspace\", \"ph\": \"X\""
+            << ", \"ts\": " << event.start / 1000 << "." << (event.start % 1000) / 100
+            << (event.start % 100) / 10 << event.start % 10
+            << ", \"dur\": " << event.duration / 1000 << "." << (event.duration % 1000) / 100
+            << (event.duration % 100) / 10 << event.duration % 10
+            << ", \"pid\": 1, \"tid\": " << threadIds[i]
+            << ", \"args\": {\"trace\": " << event.traceId << ", \"depth\": " << event.depth << "}}";
+        first = false;
+    }
+    out << "\n]}" << std::endl;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file Trace.h
+ * @brief Scoped tracing spans recorded into per-thread ring buffers
+ * @date 19/10/2026
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <ostream>
+#include <stdint.h>
+
+/**
+ * @brief Nested timing spans for the send pipeline
+ *
+ * A Span records its name, start time, duration and nesting depth when it
+ * goes out of scope. Events go into a fixed-size ring buffer owned by the
+ * calling thread, so the oldest events are overwritten rather than memory
+ * growing. Every outermost span starts a new trace id that its nested spans
+ * share, which lets one slow message be pulled out of the buffer with all of
+ * its stages.
+ *
+ * Spans are placed with TRACE_SPAN, which compiles to nothing unless the
+ * build defines PETSPACE_TRACE (make TRACE=1). When compiled in, recording
+ * is still off until setEnabled(true) is called.
+ */
+class Trace {
+public:
+    static const size_t RING_CAPACITY = 1 << 14;  ///< Events kept per thread
+
+    /**
+     * @brief Times the enclosing scope
+     */
+    class Span {
+        const char* name;
+        uint64_t start;
+        bool active;
+    public:
+        /**
+         * @brief Start a span
+         * @param spanName Name of the stage, must outlive the trace (use a literal)
+         */
+        explicit Span(const char* spanName);
+
+        /**
+         * @brief End the span and record it
+         */
+        ~Span();
+    };
+
+    /**
+     * @brief Check whether tracing was compiled in
+     * @return True if built with PETSPACE_TRACE
+     */
+    static bool isCompiledIn();
+
+    /**
+     * @brief Turn recording on or off at run time
+     * @param enabled True to record spans
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief Check whether spans are being recorded
+     * @return True if recording
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Discard every recorded event on every thread
+     */
+    static void clear();
+
+    /**
+     * @brief Get the number of events currently held across all threads
+     * @return Event count
+     */
+    static size_t getEventCount();
+
+    /**
+     * @brief Write recorded events in Chrome trace-event JSON format
+     *
+     * The output loads in chrome://tracing and Perfetto. Only traces whose
+     * outermost span took at least minRootNanos are written, so passing a
+     * threshold isolates the slow messages.
+     *
+     * @param out Stream to write to
+     * @param minRootNanos Minimum duration of a trace's outermost span
+     */
+    static void exportChromeJson(std::ostream& out, uint64_t minRootNanos = 0);
+};
+
+#ifdef PETSPACE_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SPAN(name) Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define TRACE_SPAN(name) ((void)0)
+#endif
+
+#endif
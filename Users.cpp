@@ -4,7 +4,23 @@
 #include "Command.h"
 #include "SendMessageCommand.h"
 #include "LogMessageCommand.h"
+#include "BroadcastCommand.h"
+#include "BumpArena.h"
+#include "Message.h"
+#include "PresenceAggregator.h"
+#include "DirectChannel.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+std::atomic<size_t> liveUsers(0);
+std::atomic<uint64_t> userIds(0);
+
+}
 
 /**
  * @file User.cpp
@@ -17,15 +33,19 @@
  * @brief Constructor for User
  * @param userName The name of the user
  */
-User::User(const std::string& userName) : name(userName), isOnline(false) {
+User::User(const std::string& userName)
+    : name(userName), id(userIds.fetch_add(1, std::memory_order_relaxed) + 1), isOnline(false), deliveryGeneration(0) {
     chatRooms.clear();
     commandQueue.clear();
+    liveUsers.fetch_add(1, std::memory_order_relaxed);
 }
 
 /**
  * @brief Virtual destructor
  * 
- * Cleans up command queue and removes user from all chat rooms
+ * Cleans up command queue and removes user from all chat rooms. Each room
+ * drops the user quietly in constant time, so deleting every member of a
+ * room before the room is linear in the member count.
  */
 User::~User() {
     for (Command* command : commandQueue) {
@@ -33,12 +53,22 @@ User::~User() {
     }
     commandQueue.clear();
     
-    for (ChatRoom* room : chatRooms) {
+    std::vector<ChatRoom*> rooms;
+    {
+        std::lock_guard<std::mutex> lock(roomsMutex);
+        rooms.swap(chatRooms);
+    }
+    for (ChatRoom* room : rooms) {
         if (room != nullptr) {
-            room->removeUser(this);
+            room->detachUser(this);
         }
     }
-    chatRooms.clear();
+
+    for (auto& entry : directChannels) {
+        entry.first->directChannels.erase(this);
+    }
+    directChannels.clear();
+    liveUsers.fetch_sub(1, std::memory_order_relaxed);
 }
 
 /**
@@ -47,31 +77,230 @@ User::~User() {
  * @param room The chat room to send the message to
  * 
  * This method implements the Command pattern by creating command objects
- * and adding them to the queue for execution
+ * and running them as one batch
  */
 void User::sendMessage(const std::string& message, ChatRoom* room) {
+    METRICS_TIMER(USER_SEND_LATENCY_NS);
+    TRACE_SPAN("User::sendMessage");
+
+    if (admitSend(room)) {
+        queueSend(message, room);
+    }
+}
+
+/**
+ * @brief Check that a send to a room may go ahead, reporting why not
+ * @param room The target chat room
+ * @return True if the send is admitted
+ */
+bool User::admitSend(ChatRoom* room) {
     if (room == nullptr) {
         std::cerr << "Error: Cannot send message to null chat room" << std::endl;
-        return;
+        return false;
     }
     
     if (!isInChatRoom(room)) {
         std::cerr << "Error: User " << name << " is not in the specified chat room" << std::endl;
-        return;
+        return false;
     }
     
     if (!isOnline) {
         std::cerr << "Error: User " << name << " is offline and cannot send messages" << std::endl;
-        return;
+        return false;
+    }
+
+    if (!sendLimiter.tryAcquire()) {
+        METRICS_INCREMENT(USER_SENDS_REJECTED);
+        std::cerr << "Error: User " << name << " is over the send rate limit" << std::endl;
+        return false;
     }
     
-    Command* sendCommand = new SendMessageCommand(room, this, message);
-    Command* logCommand = new LogMessageCommand(room, this, message);
-    
-    addCommand(sendCommand);
-    addCommand(logCommand);
-    
-    executeAll();
+    METRICS_INCREMENT(USER_SENDS);
+    return true;
+}
+
+/**
+ * @brief Build the send and log commands for an admitted send and run them
+ * @param message The message content, copied once into the shared message
+ * @param room The target chat room
+ */
+void User::queueSend(const std::string& message, ChatRoom* room) {
+    {
+        TRACE_SPAN("User::createCommands");
+        // Both commands share one copy of the text. They and the message are
+        // gone by the end of executeAll(), so they come from the thread's
+        // arena, unless the room may keep the send for undo.
+        BumpArena& arena = BumpArena::local();
+        bool transient = room->getUndoLimit() == 0;
+        MessagePtr shared = transient ? Message::create(this, message, arena)
+                                      : Message::create(this, message);
+        Command* sendCommand = transient ? new (arena) SendMessageCommand(room, this, shared)
+                                         : new SendMessageCommand(room, this, shared);
+        Command* logCommand = new (arena) LogMessageCommand(room, this, shared);
+
+        // A local batch rather than commandQueue, so sends from several
+        // threads never share a container
+        Command* batch[2] = { sendCommand, logCommand };
+        runCommands(batch, 2);
+    }
+}
+
+/**
+ * @brief Send one message to several chat rooms in a single pass
+ * @param message The message content
+ * @param rooms The chat rooms to send to
+ */
+void User::broadcastMessage(const std::string& message, const std::vector<ChatRoom*>& rooms) {
+    TRACE_SPAN("User::broadcastMessage");
+
+    if (message.empty()) {
+        std::cerr << "Error: Cannot broadcast an empty message" << std::endl;
+        return;
+    }
+
+    if (!isOnline) {
+        std::cerr << "Error: User " << name << " is offline and cannot send messages" << std::endl;
+        return;
+    }
+
+    std::vector<ChatRoom*> targets;
+    targets.reserve(rooms.size());
+    for (ChatRoom* room : rooms) {
+        if (room == nullptr || !isInChatRoom(room)) {
+            std::cerr << "Error: User " << name << " is not in a chat room targeted by the broadcast" << std::endl;
+            continue;
+        }
+        if (std::find(targets.begin(), targets.end(), room) == targets.end()) {
+            targets.push_back(room);
+        }
+    }
+    if (targets.empty()) {
+        return;
+    }
+
+    if (!sendLimiter.tryAcquire()) {
+        METRICS_INCREMENT(USER_SENDS_REJECTED);
+        std::cerr << "Error: User " << name << " is over the send rate limit" << std::endl;
+        return;
+    }
+
+    METRICS_INCREMENT(USER_SENDS);
+
+    Command* batch[1] = { new (BumpArena::local()) BroadcastCommand(targets, this, message) };
+    runCommands(batch, 1);
+}
+
+/**
+ * @brief Send one message to every chat room the user has joined
+ * @param message The message content
+ */
+void User::broadcastMessage(const std::string& message) {
+    broadcastMessage(message, getChatRooms());
+}
+
+/**
+ * @brief Send a private message straight to another user
+ * @param message The message content
+ * @param toUser The recipient
+ */
+void User::sendDirectMessage(const std::string& message, User* toUser) {
+    TRACE_SPAN("User::sendDirectMessage");
+
+    if (toUser == nullptr || toUser == this) {
+        std::cerr << "Error: Invalid recipient for direct message" << std::endl;
+        return;
+    }
+
+    if (message.empty()) {
+        std::cerr << "Error: Cannot send an empty direct message" << std::endl;
+        return;
+    }
+
+    if (!isOnline) {
+        std::cerr << "Error: User " << name << " is offline and cannot send messages" << std::endl;
+        return;
+    }
+
+    if (!sendLimiter.tryAcquire()) {
+        METRICS_INCREMENT(USER_SENDS_REJECTED);
+        std::cerr << "Error: User " << name << " is over the send rate limit" << std::endl;
+        return;
+    }
+
+    METRICS_INCREMENT(USER_SENDS);
+
+    std::shared_ptr<DirectChannel>& channel = directChannels[toUser];
+    if (!channel) {
+        channel = std::make_shared<DirectChannel>(this, toUser);
+        toUser->directChannels[this] = channel;
+    }
+
+    if (channel->append(this, message)) {
+        toUser->receiveDirectMessage(message, this);
+    }
+}
+
+/**
+ * @brief Receive a private message
+ * @param message The message content
+ * @param fromUser The sender
+ */
+void User::receiveDirectMessage(const std::string& message, User* fromUser) {
+    if (fromUser == nullptr) {
+        std::cerr << "Error: Invalid sender for direct message" << std::endl;
+        return;
+    }
+
+    if (isOnline) {
+        std::cout << "[" << name << "] Direct from " << fromUser->getName()
+                  << ": " << message << std::endl;
+    }
+}
+
+/**
+ * @brief Get the channel shared with another user
+ * @param other The other user
+ * @return The channel, or nullptr if none is open
+ */
+DirectChannel* User::getDirectChannel(User* other) const {
+    auto it = directChannels.find(other);
+    return it == directChannels.end() ? nullptr : it->second.get();
+}
+
+/**
+ * @brief Close the channel shared with another user
+ * @param other The other user
+ */
+void User::closeDirectChannel(User* other) {
+    auto it = directChannels.find(other);
+    if (it == directChannels.end()) {
+        return;
+    }
+    other->directChannels.erase(this);
+    directChannels.erase(it);
+}
+
+/**
+ * @brief Get the number of open direct channels
+ * @return Channel count
+ */
+size_t User::getDirectChannelCount() const {
+    return directChannels.size();
+}
+
+/**
+ * @brief Mark this user as reached by a broadcast
+ * @param generation The broadcast's generation number
+ * @return True the first time a generation is claimed
+ */
+bool User::claimDelivery(uint64_t generation) {
+    uint64_t last = deliveryGeneration.load(std::memory_order_relaxed);
+    do {
+        if (last == generation) {
+            return false;
+        }
+    } while (!deliveryGeneration.compare_exchange_weak(last, generation, std::memory_order_relaxed));
+    return true;
 }
 
 /**
@@ -99,13 +328,26 @@ void User::receive(const std::string& message, User* fromUser, ChatRoom* room) {
 }
 
 /**
- * @brief Receive a message (simplified version called by ChatRoom)
+ * @brief Receive a message as if a chat room had delivered it
  * @param message The message content
  * @param fromUser The user who sent the message
+ * @param room The delivering room, or nullptr if unknown
+ */
+void User::receiveMessage(const std::string& message, User* fromUser, ChatRoom* room) {
+    receiveMessage(*Message::create(fromUser, message, BumpArena::local()), fromUser, room);
+}
+
+/**
+ * @brief Receive a message (simplified version called by ChatRoom)
+ * @param message The shared message
+ * @param fromUser The user who sent the message
+ * @param room The delivering room, unused by console users
  * 
  * This method is called by ChatRoom::sendMessage()
  */
-void User::receiveMessage(const std::string& message, User* fromUser) {
+void User::receiveMessage(const Message& message, User* fromUser, ChatRoom* room) {
+    (void)room;
+
     if (fromUser == nullptr) {
         std::cerr << "Error: Invalid sender for receive message" << std::endl;
         return;
@@ -116,11 +358,22 @@ void User::receiveMessage(const std::string& message, User* fromUser) {
     }
     
     if (isOnline) {
-        std::cout << "[" << name << "] Received from " << fromUser->getName() 
-                  << ": " << message << std::endl;
+        std::cout << "[" << name << "] Received from " << fromUser->getName() << ": ";
+        std::cout.write(message.data(), message.size());
+        std::cout << std::endl;
     }
 }
 
+/**
+ * @brief Ignore MESSAGE_SENT without copying the text
+ * @param message The delivered message
+ * @param room The delivering room
+ */
+void User::messageSent(const Message& message, ChatRoom* room) {
+    (void)message;
+    (void)room;
+}
+
 /**
  * @brief Add a command to the command queue
  * @param command The command to add
@@ -137,14 +390,34 @@ void User::addCommand(Command* command) {
  * Executes commands in FIFO order and clears the queue
  */
 void User::executeAll() {
-    for (Command* command : commandQueue) {
+    std::vector<Command*> batch;
+    batch.swap(commandQueue);
+    if (!batch.empty()) {
+        runCommands(batch.data(), batch.size());
+    }
+}
+
+/**
+ * @brief Execute a batch of commands in order
+ * @param commands The commands
+ * @param count Number of commands
+ */
+void User::runCommands(Command* const* commands, size_t count) {
+    METRICS_TIMER(EXECUTE_ALL_LATENCY_NS);
+    TRACE_SPAN("User::executeAll");
+    METRICS_RECORD(COMMAND_QUEUE_DEPTH, count);
+    METRICS_ADD(COMMANDS_EXECUTED, count);
+
+    for (size_t i = 0; i < count; i++) {
+        Command* command = commands[i];
         if (command != nullptr) {
             command->execute();
+            if (command->getRoom() != nullptr && command->getRoom()->retainForUndo(command)) {
+                continue;
+            }
             delete command;
         }
     }
-
-    commandQueue.clear();
 }
 
 /**
@@ -172,8 +445,30 @@ void User::update(const std::string& event, const std::string& data, ChatRoom* r
                       << " left " << room->getName() << std::endl;
         }
     }
+    else if (event == "USERS_JOINED" || event == "USERS_LEFT") {
+        std::string names;
+        std::string member;
+        size_t pos = 0;
+        while (NotificationSubject::readName(data, pos, member)) {
+            names += names.empty() ? member : ", " + member;
+        }
+        std::cout << "[NOTIFICATION] " << name << ": " << names
+                  << (event == "USERS_JOINED" ? " joined " : " left ") << room->getName() << std::endl;
+    }
     else if (event == "MESSAGE_SENT") {
     }
+    else if (event == "MESSAGE_BLOCKED") {
+        if (data == name) {
+            std::cout << "[NOTIFICATION] " << name << ": your message was blocked in " 
+                      << room->getName() << std::endl;
+        }
+    }
+    else if (event == "MESSAGE_THROTTLED") {
+        if (data == name) {
+            std::cout << "[NOTIFICATION] " << name << ": slow down, your message was dropped in " 
+                      << room->getName() << std::endl;
+        }
+    }
     else if (event == "USER_ONLINE") {
         if (data != name) {
             std::cout << "[NOTIFICATION] " << name << ": " << data 
@@ -186,6 +481,18 @@ void User::update(const std::string& event, const std::string& data, ChatRoom* r
                       << " is now offline" << std::endl;
         }
     }
+    else if (event == "PRESENCE_DIFF") {
+        std::string changes;
+        std::string member;
+        bool online;
+        size_t pos = 0;
+        while (PresenceAggregator::readChange(data, pos, member, online)) {
+            changes += changes.empty() ? "" : ", ";
+            changes += member + (online ? " online" : " offline");
+        }
+        std::cout << "[NOTIFICATION] " << name << ": presence changed in " 
+                  << room->getName() << ": " << changes << std::endl;
+    }
 }
 
 /**
@@ -203,9 +510,14 @@ void User::joinChatRoom(ChatRoom* room) {
         return;
     }
     
-    chatRooms.push_back(room);
-    
-    room->registerUser(this);
+    if (!room->registerUser(this)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(roomsMutex);
+        chatRooms.push_back(room);
+    }
     
     room->addObserver(this);
     
@@ -222,21 +534,44 @@ void User::leaveChatRoom(ChatRoom* room) {
         return;
     }
 
-    for (auto it = chatRooms.begin(); it != chatRooms.end(); ++it) {
-        if (*it == room) {
-            chatRooms.erase(it);
-
-            room->removeUser(this);
-
-            room->removeObserver(this);
-
-            std::cout << name << " left chat room: " << room->getName() << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(roomsMutex);
+        auto it = std::find(chatRooms.begin(), chatRooms.end(), room);
+        if (it == chatRooms.end()) {
+            std::cerr << "User " << name << " is not in chat room " << room->getName() << std::endl;
             return;
         }
+        chatRooms.erase(it);
     }
 
-    std::cerr << "User " << name << " is not in chat room " << room->getName() << std::endl;
+    room->removeUser(this);
+
+    room->removeObserver(this);
 
+    std::cout << name << " left chat room: " << room->getName() << std::endl;
+}
+
+/**
+ * @brief Record membership of a room without joining through it
+ * @param room The chat room
+ */
+void User::attachChatRoom(ChatRoom* room) {
+    std::lock_guard<std::mutex> lock(roomsMutex);
+    if (room != nullptr && std::find(chatRooms.begin(), chatRooms.end(), room) == chatRooms.end()) {
+        chatRooms.push_back(room);
+    }
+}
+
+/**
+ * @brief Forget membership of a room without leaving through it
+ * @param room The chat room
+ */
+void User::detachChatRoom(ChatRoom* room) {
+    std::lock_guard<std::mutex> lock(roomsMutex);
+    auto it = std::find(chatRooms.begin(), chatRooms.end(), room);
+    if (it != chatRooms.end()) {
+        chatRooms.erase(it);
+    }
 }
 
 /**
@@ -244,17 +579,21 @@ void User::leaveChatRoom(ChatRoom* room) {
  * @param status True for online, false for offline
  */
 void User::setOnlineStatus(bool status) {
-    if (isOnline != status) {
-        isOnline = status;
-        
-        std::string event = isOnline ? "USER_ONLINE" : "USER_OFFLINE";
-        for (ChatRoom* room : chatRooms) {
+    if (isOnline.exchange(status) != status) {
+        std::string event = status ? "USER_ONLINE" : "USER_OFFLINE";
+        for (ChatRoom* room : getChatRooms()) {
             if (room != nullptr) {
-                room->notifyObservers(event, name);
+                room->setMemberOnline(this, status);
+                PresenceAggregator* presence = room->getPresenceAggregator();
+                if (presence != nullptr) {
+                    presence->record(room, this, status);
+                } else {
+                    room->notifyObservers(event, name);
+                }
             }
         }
         
-        std::cout << name << " is now " << (isOnline ? "online" : "offline") << std::endl;
+        std::cout << name << " is now " << (status ? "online" : "offline") << std::endl;
     }
 }
 
@@ -266,6 +605,14 @@ std::string User::getName() const {
     return name;
 }
 
+/**
+ * @brief Get the user's id
+ * @return The id, unique in the process
+ */
+uint64_t User::getId() const {
+    return id;
+}
+
 /**
  * @brief Get the user's online status
  * @return True if online, false if offline
@@ -279,9 +626,18 @@ bool User::getOnlineStatus() const {
  * @return Vector of ChatRoom pointers
  */
 std::vector<ChatRoom*> User::getChatRooms() const {
+    std::lock_guard<std::mutex> lock(roomsMutex);
     return chatRooms;
 }
 
+/**
+ * @brief Get the number of users currently alive
+ * @return Live user count
+ */
+size_t User::getLiveCount() {
+    return liveUsers.load(std::memory_order_relaxed);
+}
+
 /**
  * @brief Get the current command queue size
  * @return Number of commands in queue
@@ -290,12 +646,46 @@ size_t User::getCommandQueueSize() const {
     return commandQueue.size();
 }
 
+/**
+ * @brief Limit how fast this user may send messages
+ * @param messagesPerSecond Sustained rate across all rooms, or 0 for unlimited
+ * @param burst Messages that may be sent back to back
+ */
+void User::setRateLimit(double messagesPerSecond, unsigned int burst) {
+    sendLimiter.setLimit(messagesPerSecond, burst);
+}
+
+/**
+ * @brief Get the number of sends dropped by the rate limit
+ * @return Rejected send count
+ */
+uint64_t User::getRejectedSendCount() const {
+    return sendLimiter.getRejectedCount();
+}
+
+/**
+ * @brief Get the user's send rate limiter
+ * @return Reference to the limiter
+ */
+const RateLimiter& User::getRateLimiter() const {
+    return sendLimiter;
+}
+
+/**
+ * @brief Get the user's send rate limiter for taking tokens
+ * @return Reference to the limiter
+ */
+RateLimiter& User::getRateLimiter() {
+    return sendLimiter;
+}
+
 /**
  * @brief Helper method to check if user is in a specific chat room
  * @param room The chat room to check
  * @return True if user is in the room, false otherwise
  */
 bool User::isInChatRoom(ChatRoom* room) const {
+    std::lock_guard<std::mutex> lock(roomsMutex);
     for (ChatRoom* r : chatRooms) {
         if (r == room) {
             return true;
@@ -2,14 +2,21 @@
 #define USERS_H
 
 #include "NotificationObserver.h"
+#include "RateLimiter.h"
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 
 class NotificationObserver;
 
 class ChatRoom;
 class Command;
+class DirectChannel;
+class Message;
 
 /**
  * @file User.h
@@ -30,9 +37,14 @@ class Command;
 class User : public NotificationObserver {
 private:
     std::string name;                           
-    std::vector<ChatRoom*> chatRooms;          
+    uint64_t id;                                ///< Unique in the process, never reused
+    std::vector<ChatRoom*> chatRooms;           ///< Guarded by roomsMutex
+    mutable std::mutex roomsMutex;              ///< Rooms on several shards may unlink the user at once
     std::vector<Command*> commandQueue;        
-    bool isOnline;                             
+    std::atomic<bool> isOnline;                 ///< Read by shard threads while other threads set it
+    RateLimiter sendLimiter;
+    std::atomic<uint64_t> deliveryGeneration;   ///< Last broadcast that reached this user
+    std::unordered_map<User*, std::shared_ptr<DirectChannel> > directChannels;   ///< Keyed by the other user
 
 public:
     /**
@@ -43,6 +55,10 @@ public:
     
     /**
      * @brief Virtual destructor
+     * 
+     * Drops out of every room the user is still in through
+     * ChatRoom::detachUser, without notifications and in constant time per
+     * room, so rooms may outlive their members.
      */
     virtual ~User();
     
@@ -52,8 +68,11 @@ public:
      * @param message The message content
      * @param room The chat room to send the message to
      * 
-     * This method creates SendMessageCommand and SaveMessageCommand objects
-     * and adds them to the command queue for execution
+     * This method creates SendMessageCommand and LogMessageCommand objects
+     * and runs them as one local batch, leaving the command queue alone, so
+     * sends from several threads are safe as long as each room is used by
+     * one thread at a time. Sends over the
+     * user's rate limit are dropped and counted before any command is built.
      */
     virtual void sendMessage(const std::string& message, ChatRoom* room);
     
@@ -67,9 +86,96 @@ public:
      */
     virtual void receive(const std::string& message, User* fromUser, ChatRoom* room);
 
-    void receiveMessage(const std::string& message, User* fromUser);
+    /**
+     * @brief Receive a message as if a chat room had delivered it
+     * @param message The message content
+     * @param fromUser The user who sent the message
+     * @param room The delivering room, or nullptr if unknown
+     * 
+     * Wraps the text in a Message and hands it to the overload below.
+     */
+    void receiveMessage(const std::string& message, User* fromUser, ChatRoom* room = nullptr);
+
+    /**
+     * @brief Receive a message delivered by a chat room
+     * @param message The shared message, read in place
+     * @param fromUser The user who sent the message
+     * @param room The delivering room, or nullptr if unknown
+     * 
+     * Called by ChatRoom for every delivery. Overridden by users whose
+     * messages go somewhere other than the console, such as RemoteUser.
+     */
+    virtual void receiveMessage(const Message& message, User* fromUser, ChatRoom* room);
+
+    /**
+     * @brief Send one message to several chat rooms in a single pass
+     * @param message The message content
+     * @param rooms The chat rooms to send to
+     * 
+     * Rooms the user has not joined and repeated rooms are skipped. Members
+     * of several rooms receive the message once, it is logged once, and it
+     * counts as a single send against the rate limit.
+     */
+    void broadcastMessage(const std::string& message, const std::vector<ChatRoom*>& rooms);
+
+    /**
+     * @brief Send one message to every chat room the user has joined
+     * @param message The message content
+     */
+    void broadcastMessage(const std::string& message);
+
+    /**
+     * @brief Mark this user as reached by a broadcast
+     * 
+     * The check and the stamp are one compare-and-swap, so rooms on
+     * different threads delivering the same broadcast reach the user once.
+     * 
+     * @param generation The broadcast's generation number
+     * @return True the first time a generation is claimed, false after that
+     */
+    bool claimDelivery(uint64_t generation);
 
     
+    // Direct Messages
+    /**
+     * @brief Send a private message straight to another user
+     * @param message The message content
+     * @param toUser The recipient
+     * 
+     * Opens a DirectChannel shared by both users on first use. Direct
+     * messages skip rooms, commands and observers entirely, but still
+     * count against the sender's rate limit.
+     */
+    void sendDirectMessage(const std::string& message, User* toUser);
+
+    /**
+     * @brief Receive a private message
+     * @param message The message content
+     * @param fromUser The sender
+     */
+    void receiveDirectMessage(const std::string& message, User* fromUser);
+
+    /**
+     * @brief Get the channel shared with another user
+     * @param other The other user
+     * @return The channel, or nullptr if none is open
+     * 
+     * The channel stays valid until either user closes it or is destroyed.
+     */
+    DirectChannel* getDirectChannel(User* other) const;
+
+    /**
+     * @brief Close the channel shared with another user, discarding its history
+     * @param other The other user
+     */
+    void closeDirectChannel(User* other);
+
+    /**
+     * @brief Get the number of open direct channels
+     * @return Channel count
+     */
+    size_t getDirectChannelCount() const;
+
     // Command Pattern Methods (User as Invoker)
     /**
      * @brief Add a command to the command queue
@@ -80,7 +186,10 @@ public:
     /**
      * @brief Execute all commands in the queue
      * 
-     * Executes commands in FIFO order and clears the queue
+     * Executes commands in FIFO order and clears the queue. The queue is
+     * not locked: use it from one thread at a time. sendMessage() and
+     * broadcastMessage() do not go through it, so one user may send from
+     * several threads, provided no room is used by two threads at once.
      */
     void executeAll();
     
@@ -94,6 +203,13 @@ public:
      * Implementation of Observer pattern - called by ChatRoom when events occur
      */
     virtual void update(const std::string& event, const std::string& data, ChatRoom* room);
+
+    /**
+     * @brief Ignore MESSAGE_SENT without copying the text
+     * 
+     * A user already gets the message through receiveMessage().
+     */
+    void messageSent(const Message& message, ChatRoom* room) override;
     
     // User Management Methods
     /**
@@ -120,6 +236,13 @@ public:
      * @return The user's name
      */
     std::string getName() const;
+
+    /**
+     * @brief Get the user's id
+     * @return An id no other user in the process has had or will have,
+     * unlike the name, which users may share
+     */
+    uint64_t getId() const;
     
     /**
      * @brief Get the user's online status
@@ -132,6 +255,12 @@ public:
      * @return Vector of ChatRoom pointers
      */
     std::vector<ChatRoom*> getChatRooms() const;
+
+    /**
+     * @brief Get the number of users currently alive
+     * @return Live user count, across all threads
+     */
+    static size_t getLiveCount();
     
     /**
      * @brief Get the current command queue size
@@ -139,6 +268,53 @@ public:
      */
     size_t getCommandQueueSize() const;
 
+    // Rate Limiting
+    /**
+     * @brief Limit how fast this user may send messages
+     * @param messagesPerSecond Sustained rate across all rooms, or 0 for unlimited
+     * @param burst Messages that may be sent back to back
+     * 
+     * The limit is shared by every room the user sends to and is enforced
+     * without locks, so sends from several threads are counted correctly.
+     */
+    void setRateLimit(double messagesPerSecond, unsigned int burst);
+
+    /**
+     * @brief Get the number of sends dropped by the rate limit
+     * @return Rejected send count
+     */
+    uint64_t getRejectedSendCount() const;
+
+    /**
+     * @brief Get the user's send rate limiter
+     * @return Reference to the limiter
+     */
+    const RateLimiter& getRateLimiter() const;
+
+    /**
+     * @brief Get the user's send rate limiter for taking tokens
+     * @return Reference to the limiter
+     * 
+     * Used by senders that bypass sendMessage, such as RoomManager, so the
+     * same limit applies on every path.
+     */
+    RateLimiter& getRateLimiter();
+
+    /**
+     * @brief Record membership of a room without joining through it
+     * @param room The chat room
+     * 
+     * Used when a room restores its members directly (ChatRoom::restoreState);
+     * the room has already added the user and no notifications are sent.
+     */
+    void attachChatRoom(ChatRoom* room);
+
+    /**
+     * @brief Forget membership of a room without leaving through it
+     * @param room The chat room
+     */
+    void detachChatRoom(ChatRoom* room);
+
 protected:
     /**
      * @brief Helper method to check if user is in a specific chat room
@@ -146,6 +322,28 @@ protected:
      * @return True if user is in the room, false otherwise
      */
     bool isInChatRoom(ChatRoom* room) const;
+
+private:
+    /**
+     * @brief Check that a send to a room may go ahead, reporting why not
+     * @param room The target chat room
+     * @return True if the user is online, in the room and under the rate limit
+     */
+    bool admitSend(ChatRoom* room);
+
+    /**
+     * @brief Build the send and log commands for an admitted send and run them
+     * @param message The message content
+     * @param room The target chat room
+     */
+    void queueSend(const std::string& message, ChatRoom* room);
+
+    /**
+     * @brief Execute a batch of commands in order and delete those no room keeps for undo
+     * @param commands The commands
+     * @param count Number of commands
+     */
+    void runCommands(Command* const* commands, size_t count);
 };
 
 #endif
\ No newline at end of file